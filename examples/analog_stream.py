@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+Analog stream receiver
+Starts DMA ADC sampling with the ANALOG command, subscribes over UDP and
+decodes the binary sample blocks, printing a summary per block or writing
+every sample to a CSV file.
+
+Examples:
+    python3 analog_stream.py 192.168.1.100 --pins 34,35 --rate 1000
+    python3 analog_stream.py 192.168.1.100 --pins 36 --rate 5000 --average 4 --csv samples.csv
+"""
+
+import argparse
+import json
+import socket
+import struct
+import time
+
+UDP_PORT = 8889
+
+ANALOG_MAGIC = 0xA7
+HEADER = struct.Struct('<BBHIIQ')  # magic, channels, samples, rate, sequence, time_us
+
+
+def decode_block(data: bytes):
+    """Decode one analog frame into (header dict, list of per-sample tuples), or None."""
+    if len(data) < HEADER.size or data[0] != ANALOG_MAGIC:
+        return None
+
+    _, channels, samples, rate, sequence, time_us = HEADER.unpack_from(data)
+    pins = list(data[HEADER.size:HEADER.size + channels])
+    offset = HEADER.size + channels
+    if len(data) < offset + samples * channels * 2:
+        return None
+
+    values = struct.unpack_from('<%dH' % (samples * channels), data, offset)
+    rows = [values[i * channels:(i + 1) * channels] for i in range(samples)]
+    header = {"pins": pins, "rate": rate, "sequence": sequence, "time_us": time_us}
+    return header, rows
+
+
+def send(sock: socket.socket, host: str, command: dict):
+    """Send a JSON command and wait for its (JSON) reply, skipping stray blocks."""
+    sock.sendto(json.dumps(command).encode(), (host, UDP_PORT))
+    deadline = time.time() + 2.0
+    while time.time() < deadline:
+        data, _ = sock.recvfrom(2048)
+        if data[:1] == b'{':
+            reply = json.loads(data)
+            if reply.get("command") == command["cmd"]:
+                return reply
+    raise TimeoutError("no reply to %s" % command["cmd"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream analog samples from an ESP32 controller")
+    parser.add_argument("host", help="IP address of the board")
+    parser.add_argument("--pins", default="34", help="comma-separated ANALOG_PINS to sample")
+    parser.add_argument("--rate", type=int, default=1000, help="samples per second per pin")
+    parser.add_argument("--average", type=int, default=0,
+                        help="conversions averaged per sample (0 = automatic)")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds to stream")
+    parser.add_argument("--csv", help="write time_us,pin,... rows to this file")
+    args = parser.parse_args()
+
+    pins = [int(pin) for pin in args.pins.split(",")]
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(2.0)
+
+    reply = send(sock, args.host, {"cmd": "SUBSCRIBE"})
+    reply = send(sock, args.host, {"cmd": "ANALOG", "pins": pins, "rate": args.rate, "average": args.average})
+    if not reply.get("success"):
+        raise SystemExit("ANALOG failed: %s" % reply.get("message"))
+    print("Sampling %s at %d Hz, %d conversions per sample" % (pins, args.rate, reply.get("value", 0)))
+
+    csv = open(args.csv, "w") if args.csv else None
+    if csv:
+        csv.write("time_us," + ",".join("gpio%d" % pin for pin in pins) + "\n")
+
+    expected = None
+    received = lost = 0
+    end = time.time() + args.duration
+    try:
+        while time.time() < end:
+            try:
+                data, _ = sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+
+            block = decode_block(data)
+            if block is None:
+                continue  # JSON input event or reply
+            header, rows = block
+
+            if expected is not None and header["sequence"] != expected:
+                lost += (header["sequence"] - expected) & 0xFFFFFFFF
+            expected = (header["sequence"] + 1) & 0xFFFFFFFF
+            received += len(rows)
+
+            if csv:
+                for i, row in enumerate(rows):
+                    t = header["time_us"] + i * 1000000 // header["rate"]
+                    csv.write("%d,%s\n" % (t, ",".join(str(v) for v in row)))
+            else:
+                means = [sum(row[c] for row in rows) / len(rows) for c in range(len(header["pins"]))]
+                print("block %6d  %4d samples  mean %s" % (
+                    header["sequence"], len(rows), " ".join("%7.1f" % m for m in means)))
+    finally:
+        send(sock, args.host, {"cmd": "ANALOG", "rate": 0})
+        send(sock, args.host, {"cmd": "UNSUBSCRIBE"})
+        if csv:
+            csv.close()
+
+    print("%d samples per pin received, %d blocks lost" % (received, lost))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,10 +1,15 @@
 #!/usr/bin/env python3
 """
 Simple ESP32 discovery tool
-Scans the network for ESP32 devices and displays their information.
+Finds ESP32 devices on the network and displays their information.
+
+Boards advertise _esp32ctl._tcp over mDNS/DNS-SD, so one multicast query
+finds every unit; the UDP broadcast scan is only the fallback for networks
+that drop multicast.
 """
 
 import socket
+import struct
 import json
 import time
 from typing import List, Tuple, Dict, Any, Optional
@@ -68,6 +73,132 @@ def discover_mdns(hostname: str = "esp32-controller.local", timeout: float = 2.0
         socket.setdefaulttimeout(None)
 
 
+MDNS_GROUP = ("224.0.0.251", 5353)
+DNS_TYPE_A = 1
+DNS_TYPE_PTR = 12
+DNS_TYPE_TXT = 16
+DNS_TYPE_SRV = 33
+
+
+def _encode_name(name: str) -> bytes:
+    out = b""
+    for label in name.rstrip(".").split("."):
+        out += bytes([len(label)]) + label.encode()
+    return out + b"\x00"
+
+
+def _read_name(data: bytes, offset: int) -> Tuple[str, int]:
+    """Read a (possibly compressed) DNS name, return it and the offset after it."""
+    labels = []
+    end = None
+    for _ in range(128):  # Guards against pointer loops
+        length = data[offset]
+        if length == 0:
+            offset += 1
+            break
+        if length & 0xC0 == 0xC0:
+            if end is None:
+                end = offset + 2
+            offset = ((length & 0x3F) << 8) | data[offset + 1]
+            continue
+        labels.append(data[offset + 1:offset + 1 + length].decode("utf-8", "replace"))
+        offset += 1 + length
+    return ".".join(labels), end if end is not None else offset
+
+
+def _parse_records(data: bytes) -> List[Tuple[str, int, int, int]]:
+    """Answer, authority and additional records as (name, type, rdata offset, rdata length)."""
+    qdcount, ancount, nscount, arcount = struct.unpack_from("!4H", data, 4)
+    offset = 12
+    for _ in range(qdcount):
+        _, offset = _read_name(data, offset)
+        offset += 4
+    records = []
+    for _ in range(ancount + nscount + arcount):
+        name, offset = _read_name(data, offset)
+        rtype, _, _, rdlength = struct.unpack_from("!HHIH", data, offset)
+        offset += 10
+        records.append((name.lower(), rtype, offset, rdlength))
+        offset += rdlength
+    return records
+
+
+def discover_dnssd(service: str = "_esp32ctl._tcp.local", timeout: float = 2.0) -> List[Dict[str, Any]]:
+    """
+    Browse for a DNS-SD service with one multicast PTR query.
+
+    The query goes out from an ephemeral port, so responders answer it
+    directly (RFC 6762 legacy unicast) and nothing has to bind port 5353.
+    Returns one dict per instance: name, host, ip, port and txt.
+    """
+    query = struct.pack("!6H", 0, 0, 1, 0, 0, 0) + _encode_name(service) + struct.pack("!HH", DNS_TYPE_PTR, 1)
+    service = service.lower()
+
+    instances = {}  # instance name -> displayed name
+    srv = {}        # instance name -> (port, target host)
+    txt = {}        # instance name -> {key: value}
+    addresses = {}  # host -> IP
+
+    try:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 255)
+        sock.settimeout(0.2)
+
+        start_time = time.time()
+        sends = 0
+        while time.time() - start_time < timeout:
+            # A second query catches boards that missed the first one
+            if sends < 2 and time.time() - start_time >= sends * timeout / 2:
+                sock.sendto(query, MDNS_GROUP)
+                sends += 1
+            try:
+                data, _ = sock.recvfrom(9000)
+            except socket.timeout:
+                continue
+
+            try:
+                for name, rtype, offset, length in _parse_records(data):
+                    if rtype == DNS_TYPE_PTR and name == service:
+                        instance, _ = _read_name(data, offset)
+                        instances[instance.lower()] = instance.split(".")[0]
+                    elif rtype == DNS_TYPE_SRV:
+                        port = struct.unpack_from("!H", data, offset + 4)[0]
+                        target, _ = _read_name(data, offset + 6)
+                        srv[name] = (port, target.lower())
+                    elif rtype == DNS_TYPE_TXT:
+                        entries = {}
+                        end = offset + length
+                        while offset < end:
+                            size = data[offset]
+                            entry = data[offset + 1:offset + 1 + size].decode("utf-8", "replace")
+                            key, _, value = entry.partition("=")
+                            if key:
+                                entries[key] = value
+                            offset += 1 + size
+                        txt[name] = entries
+                    elif rtype == DNS_TYPE_A and length == 4:
+                        addresses[name] = socket.inet_ntoa(data[offset:offset + 4])
+            except (IndexError, struct.error):
+                continue  # Truncated or malformed packet
+
+        sock.close()
+
+    except Exception as e:
+        print(f"DNS-SD error: {e}")
+
+    devices = []
+    for key, name in instances.items():
+        port, host = srv.get(key, (None, None))
+        ip = addresses.get(host) if host else None
+        if host and ip is None:
+            try:
+                ip = socket.gethostbyname(host)
+            except OSError:
+                pass
+        devices.append({"name": name, "host": host, "ip": ip, "port": port, "txt": txt.get(key, {})})
+    return devices
+
+
 def discover_udp_broadcast(udp_port: int = 8889, timeout: float = 3.0) -> List[Tuple[str, Dict[str, Any]]]:
     """Discover ESP32 devices using UDP broadcast."""
     devices = []
@@ -134,15 +265,41 @@ def main():
         else:
             print("    ✗ Cached IP no longer responds")
 
-    # Try mDNS
-    print("\n[2] Trying mDNS resolution (esp32-controller.local)...")
-    mdns_ip = discover_mdns()
+    # Browse for every board at once
+    print("\n[2] Browsing for _esp32ctl._tcp services (mDNS/DNS-SD)...")
+    services = [s for s in discover_dnssd() if s["ip"]]
+
+    if services:
+        print(f"    ✓ Found {len(services)} device(s):\n")
+        save_ip(services[0]["ip"])
 
+        for i, service in enumerate(services, 1):
+            txt = service["txt"]
+            print(f"    Device #{i}: {service['ip']}  ({service['name']})")
+            print(f"    {'─' * 50}")
+            print(f"      Host:          {service['host']}")
+            print(f"      Ports:         TCP {service['port']}, UDP {txt.get('udp', 'N/A')}, "
+                  f"HTTP {txt.get('http', 'N/A')}")
+            print(f"      Firmware:      {txt.get('fw', 'N/A')}")
+            print(f"      Pin map:       {txt.get('pinmap', 'N/A')} ({txt.get('pins', '?')} pins)")
+            if "group" in txt:
+                print(f"      Fleet group:   {txt['group']}")
+            print()
+
+        print("=" * 60)
+        print("Discovery complete! Use one of the following IPs:")
+        for service in services:
+            print(f"  - {service['ip']} ({service['name']})")
+        print("=" * 60)
+        return
+
+    print("    ✗ No devices answered the DNS-SD query")
+
+    # Older firmware answers the hostname only
+    mdns_ip = discover_mdns()
     if mdns_ip:
-        print(f"    ✓ Found via mDNS: {mdns_ip}")
+        print(f"    ✓ Resolved esp32-controller.local: {mdns_ip}")
         save_ip(mdns_ip)
-    else:
-        print("    ✗ mDNS resolution failed")
 
     # Try UDP broadcast
     print("\n[3] Performing UDP broadcast scan...")
@@ -193,7 +350,7 @@ def main():
         print("  • Make sure the ESP32 is powered on")
         print("  • Verify the ESP32 is connected to WiFi")
         print("  • Check that your computer is on the same network")
-        print("  • Ensure firewall allows UDP broadcast on port 8889")
+        print("  • Ensure firewall allows mDNS (UDP 5353) and UDP broadcast on port 8889")
     print("=" * 60)
 
 
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Fleet control over UDP multicast
+Sends one datagram to every board in a multicast group, optionally scheduled
+to apply at the same moment on all of them (boards sync their clock via SNTP).
+
+Examples:
+    python3 fleet_control.py set 13 1
+    python3 fleet_control.py pwm 13 128 --delay 0.5
+    python3 fleet_control.py json '{"cmd":"BATCH","ops":[{"cmd":"SET","pin":13,"value":1}]}'
+"""
+
+import argparse
+import json
+import socket
+import struct
+import time
+
+GROUP_PREFIX = "239.255.42."
+MULTICAST_PORT = 8890
+
+REQUEST_MAGIC = 0xA5
+OP_SET = 0x01
+OP_TOGGLE = 0x03
+OP_PWM = 0x04
+FLAG_SCHEDULED = 0x20
+FLAG_SEQUENCED = 0x40
+FLAG_NO_REPLY = 0x80
+
+
+def binary_frame(opcode: int, pin: int, value: int, sequence: int, apply_at_ms: int = 0) -> bytes:
+    """Build a sequenced binary frame, with an apply time trailer if given."""
+    flags = FLAG_SEQUENCED | FLAG_NO_REPLY
+    if apply_at_ms:
+        flags |= FLAG_SCHEDULED
+    frame = struct.pack('<BBBBHH', REQUEST_MAGIC, opcode, flags, pin, value, sequence & 0xFFFF)
+    if apply_at_ms:
+        frame += struct.pack('<Q', apply_at_ms)
+    return frame
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send a command to a fleet of ESP32 controllers")
+    parser.add_argument("command", choices=["set", "toggle", "pwm", "json"])
+    parser.add_argument("args", nargs="+", help="pin [value], or a JSON command for 'json'")
+    parser.add_argument("--group", type=int, default=1, help="UDP_MULTICAST_GROUP_ID of the boards")
+    parser.add_argument("--delay", type=float, default=0.0,
+                        help="apply this many seconds from now on every board (0 = immediately)")
+    parser.add_argument("--seq", type=int, default=None,
+                        help="sequence number (default: derived from the current time)")
+    parser.add_argument("--ttl", type=int, default=1, help="multicast TTL")
+    args = parser.parse_args()
+
+    sequence = args.seq if args.seq is not None else int(time.time() * 10)
+    apply_at_ms = int((time.time() + args.delay) * 1000) if args.delay > 0 else 0
+
+    if args.command == "json":
+        command = json.loads(" ".join(args.args))
+        command.setdefault("seq", sequence & 0xFFFF)
+        if apply_at_ms:
+            command["at"] = apply_at_ms
+        payload = json.dumps(command).encode()
+    else:
+        opcode = {"set": OP_SET, "toggle": OP_TOGGLE, "pwm": OP_PWM}[args.command]
+        pin = int(args.args[0])
+        value = int(args.args[1]) if len(args.args) > 1 else 0
+        payload = binary_frame(opcode, pin, value, sequence, apply_at_ms)
+
+    group = GROUP_PREFIX + str(args.group)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+    sock.sendto(payload, (group, MULTICAST_PORT))
+    sock.close()
+
+    when = f"at {apply_at_ms} ms" if apply_at_ms else "immediately"
+    print(f"Sent {len(payload)} bytes to {group}:{MULTICAST_PORT}, applies {when}")
+
+
+if __name__ == "__main__":
+    main()
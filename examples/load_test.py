@@ -0,0 +1,439 @@
+#!/usr/bin/env python3
+"""
+Load generator and latency reporter
+Drives one board over TCP, UDP, HTTP and WebSocket at once with a
+configurable command mix and target rate, then reports throughput,
+p50/p99/p999 latency and loss per transport.
+
+Examples:
+    python3 load_test.py 192.168.1.100 --tcp 4 --rate 200 --duration 10
+    python3 load_test.py 192.168.1.100 --tcp 2 --udp 2 --http 1 --ws 1 --mix set=60,toggle=30,get=10
+    python3 load_test.py 192.168.1.100 --udp 4 --rate 2000 --mix batch=100 --pins 12,13,14,15
+
+TCP, HTTP and WebSocket workers are closed-loop (one command in flight per
+connection); UDP senders are open-loop and match binary replies by
+sequence number. With --rate, latency is measured from each command's
+scheduled send time, so a board that falls behind shows up in the
+percentiles instead of silently lowering the send rate.
+"""
+
+import argparse
+import base64
+import http.client
+import json
+import math
+import os
+import random
+import socket
+import struct
+import threading
+import time
+
+TCP_PORT = 8888
+UDP_PORT = 8889
+WEB_PORT = 80
+
+REQUEST_MAGIC = 0xA5
+RESPONSE_MAGIC = 0xA6
+OP_SET = 0x01
+OP_GET = 0x02
+OP_TOGGLE = 0x03
+OP_PWM = 0x04
+OP_BATCH = 0x10
+STATUS_OK = 0x00
+
+MIX_OPS = ("set", "get", "toggle", "pwm", "batch")
+
+
+class Stats:
+    """Latencies and outcomes of one transport, shared by its workers."""
+
+    def __init__(self, name):
+        self.name = name
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.sent = 0
+        self.failed = 0  # Answered with success false / a non-OK status
+        self.lost = 0    # No answer: timeout, dropped datagram, broken connection
+        self.errors = []
+
+    def add(self, latency=None, ok=True):
+        with self.lock:
+            self.sent += 1
+            if latency is None:
+                self.lost += 1
+            else:
+                self.latencies.append(latency)
+                if not ok:
+                    self.failed += 1
+
+    def error(self, message):
+        with self.lock:
+            if len(self.errors) < 5:
+                self.errors.append(message)
+
+
+class Mix:
+    """Weighted command mix, e.g. set=60,toggle=30,get=10."""
+
+    def __init__(self, spec, pins):
+        self.ops = []
+        self.weights = []
+        for part in spec.split(","):
+            name, _, weight = part.partition("=")
+            name = name.strip().lower()
+            if name not in MIX_OPS:
+                raise ValueError(f"unknown op '{name}' in --mix (use {', '.join(MIX_OPS)})")
+            self.ops.append(name)
+            self.weights.append(float(weight) if weight else 1.0)
+        self.pins = pins
+
+    def pick(self, rng):
+        op = rng.choices(self.ops, self.weights)[0]
+        return op, rng.choice(self.pins), rng.randint(0, 1), rng.randint(0, 255)
+
+    def json_command(self, op, pin, level, duty):
+        if op == "set":
+            return {"cmd": "SET", "pin": pin, "value": level}
+        if op == "get":
+            return {"cmd": "GET", "pin": pin}
+        if op == "toggle":
+            return {"cmd": "TOGGLE", "pin": pin}
+        if op == "pwm":
+            return {"cmd": "PWM", "pin": pin, "value": duty}
+        return {"cmd": "BATCH", "ops": [{"cmd": "SET", "pin": p, "value": level} for p in self.pins]}
+
+    def binary_frame(self, op, pin, level, duty, sequence):
+        if op == "batch":
+            frame = struct.pack('<BBBBHH', REQUEST_MAGIC, OP_BATCH, 0, 0, len(self.pins), sequence)
+            for p in self.pins:
+                frame += struct.pack('<BBH', OP_SET, p, level)
+            return frame
+        opcode, value = {"set": (OP_SET, level), "get": (OP_GET, 0),
+                         "toggle": (OP_TOGGLE, 0), "pwm": (OP_PWM, duty)}[op]
+        return struct.pack('<BBBBHH', REQUEST_MAGIC, opcode, 0, pin, value, sequence)
+
+
+class Pacer:
+    """Spaces one worker's commands at its share of the target rate."""
+
+    def __init__(self, rate, deadline):
+        self.interval = 1.0 / rate if rate > 0 else 0.0
+        self.next = time.monotonic()
+        self.deadline = deadline
+
+    def wait(self):
+        """Sleep until the next send slot; returns its scheduled time, None when done."""
+        if self.interval > 0:
+            scheduled = self.next
+            self.next += self.interval
+            delay = scheduled - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        else:
+            scheduled = time.monotonic()
+        if scheduled >= self.deadline or time.monotonic() >= self.deadline:
+            return None
+        return scheduled
+
+
+def tcp_worker(args, mix, stats, rate, deadline, seed):
+    rng = random.Random(seed)
+    pacer = Pacer(rate, deadline)
+    try:
+        sock = socket.create_connection((args.host, args.tcp_port), timeout=args.timeout)
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        reader = sock.makefile("r")
+    except OSError as e:
+        stats.error(f"connect: {e}")
+        return
+
+    while True:
+        scheduled = pacer.wait()
+        if scheduled is None:
+            break
+        command = mix.json_command(*mix.pick(rng))
+        try:
+            sock.sendall((json.dumps(command) + "\n").encode())
+            line = reader.readline()
+            if not line:
+                raise OSError("connection closed")
+            response = json.loads(line)
+            stats.add(time.monotonic() - scheduled, response.get("success", False))
+        except (OSError, ValueError) as e:
+            stats.add()
+            stats.error(str(e))
+            break
+    sock.close()
+
+
+def udp_worker(args, mix, stats, rate, deadline, seed):
+    rng = random.Random(seed)
+    pacer = Pacer(rate, deadline)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(0.05)
+    pending = {}  # sequence -> scheduled send time
+    lock = threading.Lock()
+    sending = [True]
+
+    def receive():
+        while sending[0] or (pending and time.monotonic() < deadline + args.timeout):
+            try:
+                reply, _ = sock.recvfrom(64)
+            except socket.timeout:
+                continue
+            except OSError:
+                break
+            if len(reply) < 8 or reply[0] != RESPONSE_MAGIC:
+                continue
+            status = reply[2]
+            sequence = struct.unpack_from('<H', reply, 6)[0]
+            with lock:
+                scheduled = pending.pop(sequence, None)
+            if scheduled is not None:
+                stats.add(time.monotonic() - scheduled, status == STATUS_OK)
+
+    receiver = threading.Thread(target=receive, daemon=True)
+    receiver.start()
+
+    sequence = rng.randrange(0x10000)
+    while True:
+        scheduled = pacer.wait()
+        if scheduled is None:
+            break
+        sequence = (sequence + 1) & 0xFFFF
+        with lock:
+            if sequence in pending:
+                # Wrapped onto a reply that never came
+                del pending[sequence]
+                stats.add()
+            pending[sequence] = scheduled
+        try:
+            sock.sendto(mix.binary_frame(*mix.pick(rng), sequence), (args.host, args.udp_port))
+        except OSError as e:
+            stats.error(str(e))
+
+    sending[0] = False
+    receiver.join()
+    with lock:
+        for _ in pending:
+            stats.add()
+    sock.close()
+
+
+def http_worker(args, mix, stats, rate, deadline, seed):
+    rng = random.Random(seed)
+    pacer = Pacer(rate, deadline)
+    conn = http.client.HTTPConnection(args.host, args.web_port, timeout=args.timeout)
+
+    while True:
+        scheduled = pacer.wait()
+        if scheduled is None:
+            break
+        op, pin, level, duty = mix.pick(rng)
+        if op == "get":
+            method, path = "GET", f"/api/pin/get?pin={pin}"
+        elif op == "toggle":
+            method, path = "POST", f"/api/pin/toggle?pin={pin}"
+        elif op == "pwm":
+            method, path = "POST", f"/api/pin/pwm?pin={pin}&value={duty}"
+        else:
+            # No REST batch endpoint; a batch op is a plain set here
+            method, path = "POST", f"/api/pin/set?pin={pin}&value={level}"
+        try:
+            conn.request(method, path)
+            response = conn.getresponse()
+            body = response.read()
+            ok = response.status == 200 and json.loads(body).get("success", False)
+            stats.add(time.monotonic() - scheduled, ok)
+        except (OSError, http.client.HTTPException, ValueError) as e:
+            stats.add()
+            stats.error(str(e))
+            conn.close()
+            conn = http.client.HTTPConnection(args.host, args.web_port, timeout=args.timeout)
+    conn.close()
+
+
+class WebSocket:
+    """Minimal RFC 6455 client: masked text frames out, unfragmented frames in."""
+
+    def __init__(self, host, port, path, timeout):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall((f"GET {path} HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\n"
+                           f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\n"
+                           "Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        header = b""
+        while b"\r\n\r\n" not in header:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise OSError("connection closed during handshake")
+            header += chunk
+        if b" 101 " not in header.split(b"\r\n", 1)[0]:
+            raise OSError("upgrade refused: " + header.split(b"\r\n", 1)[0].decode(errors="replace"))
+        self.buffer = header.split(b"\r\n\r\n", 1)[1]
+
+    def _read(self, n):
+        while len(self.buffer) < n:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise OSError("connection closed")
+            self.buffer += chunk
+        data, self.buffer = self.buffer[:n], self.buffer[n:]
+        return data
+
+    def _send_frame(self, opcode, payload):
+        mask = os.urandom(4)
+        length = len(payload)
+        if length < 126:
+            header = struct.pack('!BB', 0x80 | opcode, 0x80 | length)
+        elif length < 0x10000:
+            header = struct.pack('!BBH', 0x80 | opcode, 0x80 | 126, length)
+        else:
+            header = struct.pack('!BBQ', 0x80 | opcode, 0x80 | 127, length)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(header + mask + masked)
+
+    def send_text(self, text):
+        self._send_frame(0x1, text.encode())
+
+    def recv_text(self):
+        """Next text message, answering pings and skipping binary frames."""
+        while True:
+            first, second = self._read(2)
+            length = second & 0x7F
+            if length == 126:
+                length = struct.unpack('!H', self._read(2))[0]
+            elif length == 127:
+                length = struct.unpack('!Q', self._read(8))[0]
+            payload = self._read(length)
+            opcode = first & 0x0F
+            if opcode == 0x1:
+                return payload.decode(errors="replace")
+            if opcode == 0x8:
+                raise OSError("closed by the device")
+            if opcode == 0x9:
+                self._send_frame(0xA, payload)
+
+    def close(self):
+        try:
+            self._send_frame(0x8, b"")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def ws_worker(args, mix, stats, rate, deadline, seed):
+    rng = random.Random(seed)
+    pacer = Pacer(rate, deadline)
+    try:
+        ws = WebSocket(args.host, args.web_port, "/ws", args.timeout)
+    except OSError as e:
+        stats.error(f"connect: {e}")
+        return
+
+    while True:
+        scheduled = pacer.wait()
+        if scheduled is None:
+            break
+        try:
+            ws.send_text(json.dumps(mix.json_command(*mix.pick(rng))))
+            while True:
+                message = json.loads(ws.recv_text())
+                # Pushed pin/status/input updates carry a "type", responses do not
+                if "type" not in message:
+                    break
+            stats.add(time.monotonic() - scheduled, message.get("success", False))
+        except (OSError, ValueError) as e:
+            stats.add()
+            stats.error(str(e))
+            break
+    ws.close()
+
+
+def percentile(sorted_values, p):
+    """Nearest-rank percentile of an already sorted list."""
+    if not sorted_values:
+        return float("nan")
+    rank = max(1, math.ceil(p / 100.0 * len(sorted_values)))
+    return sorted_values[rank - 1]
+
+
+def report(all_stats, elapsed):
+    print(f"\n{'transport':<10} {'sent':>8} {'ok/s':>9} {'failed':>7} {'lost':>7} {'loss':>7}"
+          f" {'p50 ms':>8} {'p99 ms':>8} {'p999 ms':>8} {'max ms':>8}")
+    for stats in all_stats:
+        if stats.sent == 0 and not stats.errors:
+            continue
+        latencies = sorted(stats.latencies)
+        answered = len(latencies) - stats.failed
+        loss = 100.0 * stats.lost / stats.sent if stats.sent else 0.0
+        values = [percentile(latencies, p) * 1000 for p in (50, 99, 99.9)]
+        worst = latencies[-1] * 1000 if latencies else float("nan")
+        print(f"{stats.name:<10} {stats.sent:>8} {answered / elapsed:>9.1f} {stats.failed:>7} {stats.lost:>7}"
+              f" {loss:>6.2f}% {values[0]:>8.2f} {values[1]:>8.2f} {values[2]:>8.2f} {worst:>8.2f}")
+        for message in stats.errors:
+            print(f"  {stats.name} error: {message}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load test an ESP32 controller over TCP, UDP, HTTP and WebSocket")
+    parser.add_argument("host", help="IP address of the board")
+    parser.add_argument("--tcp", type=int, default=1, help="concurrent TCP connections (default: 1)")
+    parser.add_argument("--udp", type=int, default=0, help="concurrent UDP senders")
+    parser.add_argument("--http", type=int, default=0, help="concurrent HTTP keep-alive clients")
+    parser.add_argument("--ws", type=int, default=0, help="concurrent WebSocket clients")
+    parser.add_argument("--rate", type=float, default=0,
+                        help="target commands/s per transport, shared by its workers (0 = as fast as possible)")
+    parser.add_argument("--duration", type=float, default=10, help="seconds to run (default: 10)")
+    parser.add_argument("--mix", default="set=50,toggle=30,get=20",
+                        help=f"weighted command mix of {', '.join(MIX_OPS)} (default: set=50,toggle=30,get=20)")
+    parser.add_argument("--pins", default="13", help="comma-separated pins to drive (default: 13)")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds before an answer counts as lost")
+    parser.add_argument("--tcp-port", type=int, default=TCP_PORT)
+    parser.add_argument("--udp-port", type=int, default=UDP_PORT)
+    parser.add_argument("--web-port", type=int, default=WEB_PORT)
+    parser.add_argument("--seed", type=int, default=1, help="random seed for the command sequence")
+    args = parser.parse_args()
+
+    try:
+        mix = Mix(args.mix, [int(p) for p in args.pins.split(",")])
+    except ValueError as e:
+        parser.error(str(e))
+
+    transports = [("tcp", args.tcp, tcp_worker), ("udp", args.udp, udp_worker),
+                  ("http", args.http, http_worker), ("ws", args.ws, ws_worker)]
+    all_stats = []
+    threads = []
+    start = time.monotonic()
+    deadline = start + args.duration
+
+    for name, count, worker in transports:
+        if count <= 0:
+            continue
+        stats = Stats(name)
+        all_stats.append(stats)
+        for i in range(count):
+            rate = args.rate / count if args.rate > 0 else 0
+            seed = f"{args.seed}-{name}-{i}"
+            thread = threading.Thread(target=worker, args=(args, mix, stats, rate, deadline, seed), daemon=True)
+            threads.append(thread)
+
+    if not threads:
+        parser.error("nothing to run, give at least one of --tcp, --udp, --http, --ws")
+
+    print(f"Load testing {args.host} for {args.duration:g} s: "
+          + ", ".join(f"{count} {name}" for name, count, _ in transports if count > 0)
+          + (f", {args.rate:g} commands/s per transport" if args.rate > 0 else ", unthrottled")
+          + f", mix {args.mix}")
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    report(all_stats, max(time.monotonic() - start, 1e-9))
+
+
+if __name__ == "__main__":
+    main()
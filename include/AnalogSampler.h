@@ -0,0 +1,139 @@
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include "Config.h"
+#include "BinaryProtocol.h"
+#include "SPSCQueue.h"
+
+/**
+ * AnalogSampler - DMA ADC sampling streamed as binary blocks (ANALOG command)
+ *
+ * Features:
+ * - ADC1 pins from ANALOG_PINS sampled by the continuous (DMA) ADC driver,
+ *   so the CPU never starts a conversion
+ * - On-device averaging: each value is the mean of `average` conversions.
+ *   The driver cannot convert slower than ANALOG_MIN_CONVERSION_HZ, so slow
+ *   rates average at least enough conversions to reach it.
+ * - Values are packed into blocks of up to ANALOG_BLOCK_VALUES (or
+ *   ANALOG_BLOCK_INTERVAL_MS worth) and pushed to listeners as one
+ *   BinaryProtocol analog frame each, so kHz rates cost a datagram every few
+ *   tens of milliseconds rather than a message per sample
+ * - Block times are derived from the start time and the sample count, so
+ *   sample n of a stream is at time + n / rate
+ *
+ * A sampler task owns the driver; start()/stop() and loop() belong to the
+ * main loop task.
+ */
+
+class AnalogSampler
+{
+public:
+    // Called with one encoded frame (BinaryProtocol::ANALOG_MAGIC) per block
+    typedef std::function<void(const uint8_t *frame, size_t length)> BlockListener;
+
+    AnalogSampler();
+
+    // Start the sampler task; the ADC stays off until start()
+    void begin();
+
+    // Sample the pins in mask (bit n = GPIO n, ANALOG_PINS only) at rate
+    // values per second per pin, each the mean of average conversions
+    // (0 = the fewest the driver allows). Replaces a running stream.
+    // Returns false with error set if the request cannot be met.
+    bool start(uint64_t mask, uint32_t rate, uint32_t average, const char *&error);
+
+    void stop();
+
+    bool isRunning() const { return _settings.mask != 0; }
+    uint64_t getPins() const { return _settings.mask; }
+    uint32_t getRate() const { return _settings.rate; }
+
+    // Conversions averaged per value, after raising it to the driver minimum
+    uint32_t getAverage() const { return _settings.average; }
+
+    // Main loop: send finished blocks to the listeners
+    void loop();
+
+    // Returns an id for removeBlockListener, or -1 if the table is full
+    int addBlockListener(BlockListener listener);
+    void removeBlockListener(int id);
+
+    // Called from the sampler task whenever a block is queued, to wake the
+    // main loop for loop()
+    void setBlockReadyHandler(void (*handler)()) { _blockReady = handler; }
+
+    // Blocks dropped because the main loop fell behind
+    uint32_t dropped() const { return _blocks.dropped(); }
+
+private:
+    struct Settings
+    {
+        uint64_t mask; // 0 = stopped
+        uint32_t rate;
+        uint32_t average;
+    };
+
+    // One block as filled by the sampler task; it carries its own settings,
+    // so blocks queued before a restart still encode correctly
+    struct Block
+    {
+        uint64_t mask;
+        uint32_t rate;
+        uint32_t sequence;
+        int64_t timeUs;
+        uint16_t samples; // Per channel
+        uint16_t values[ANALOG_BLOCK_VALUES];
+    };
+
+    static void taskEntry(void *arg);
+    void run();
+
+    // Hand new settings to the sampler task
+    void post(const Settings &settings);
+
+    // Sampler task only
+    bool startDriver(const Settings &settings);
+    void stopDriver();
+    void collect(const uint8_t *data, size_t length);
+
+    // Encode a block into _frame, returns the frame length
+    size_t encode(const Block &block);
+
+    // Main loop view of the running stream
+    Settings _settings;
+
+    // Handoff to the sampler task: _request is copied under _mux, and
+    // _generation changes with every start()/stop()
+    Settings _request;
+    portMUX_TYPE _mux;
+    std::atomic<uint32_t> _generation;
+    TaskHandle_t _task;
+    void (*_blockReady)();
+
+    SPSCQueue<Block, ANALOG_BLOCK_QUEUE_SIZE> _blocks;
+
+    // Sampler task state
+    Settings _active;
+    uint8_t _channels; // Pins in _active.mask
+    int8_t _slotOfChannel[8]; // ADC1 channel -> position in a sample row, -1 unused
+    uint32_t _sums[8];
+    uint32_t _counts[8];
+    uint8_t _rowFilled; // Slots of the current row that have a value
+    uint16_t _samplesPerBlock;
+    uint32_t _sequence;
+    uint64_t _emitted; // Samples per channel in earlier blocks
+    int64_t _startUs;
+    Block _block;
+    uint8_t _readBuffer[ANALOG_DMA_FRAME_BYTES];
+
+    // Main loop state
+    Block _outgoing;
+    uint32_t _reportedDrops;
+    uint8_t _frame[BinaryProtocol::ANALOG_HEADER_SIZE + 8 + ANALOG_BLOCK_VALUES * 2];
+    BlockListener _listeners[ANALOG_MAX_LISTENERS];
+};
+
+#endif // ANALOG_SAMPLER_H
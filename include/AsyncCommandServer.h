@@ -0,0 +1,86 @@
+#ifndef ASYNC_COMMAND_SERVER_H
+#define ASYNC_COMMAND_SERVER_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+#include "LineFramer.h"
+#include "BinaryProtocol.h"
+#include "BufferPrint.h"
+
+/**
+ * AsyncCommandServer - Event-driven TCP command server built on AsyncTCP
+ *
+ * Features:
+ * - No polling: commands run from AsyncTCP callbacks as bytes arrive
+ * - Fixed pool of connections, each with its own receive buffer
+ * - Newline-delimited commands and binary frames, same protocol as the
+ *   polled TCP server
+ * - Push lines (input events) to connections that subscribed
+ *
+ * Callbacks run in the AsyncTCP task, not in the Arduino loop task.
+ */
+
+class AsyncCommandServer
+{
+public:
+    // Called for every complete command line; writes the response to out.
+    // subscribed is the connection's event subscription flag, the handler may
+    // change it.
+    typedef std::function<void(const char *command, size_t length, Print &out, bool &subscribed)> CommandHandler;
+
+    // Called for every complete binary frame; writes the reply frame and
+    // returns its length
+    typedef std::function<size_t(const uint8_t *frame, size_t length, uint8_t *reply)> BinaryHandler;
+
+    AsyncCommandServer(uint16_t port, CommandHandler handler, BinaryHandler binaryHandler);
+    ~AsyncCommandServer();
+
+    // Start listening
+    void begin();
+
+    // Get number of connected clients
+    int getConnectedClients() const { return _clientCount; }
+
+    // Send a line to every subscribed connection (any task)
+    void broadcast(const char *line, size_t length);
+
+private:
+    struct Connection
+    {
+        AsyncClient *client;
+        LineFramer framer;
+        bool subscribed;
+    };
+
+    // AsyncTCP callbacks
+    void handleNewClient(AsyncClient *client);
+    void handleData(Connection &conn, const uint8_t *data, size_t len);
+    void handleDisconnect(Connection &conn);
+
+    // Run one complete command line and send the response
+    void handleLine(Connection &conn, const char *line, size_t length);
+
+    // Send a response line to a client
+    void sendLine(AsyncClient *client, const char *line, size_t length);
+    void sendLine(AsyncClient *client, const char *line) { sendLine(client, line, strlen(line)); }
+
+    AsyncServer _server;
+    CommandHandler _handler;
+    BinaryHandler _binaryHandler;
+    uint16_t _port;
+
+    Connection _connections[ASYNC_TCP_MAX_CLIENTS];
+    volatile int _clientCount;
+
+    // Responses are built here; all callbacks run in the one AsyncTCP task
+    char _response[RESPONSE_BUFFER_SIZE];
+
+    // Guards client pointers against broadcast() from other tasks
+    SemaphoreHandle_t _lock;
+};
+
+#endif // ASYNC_COMMAND_SERVER_H
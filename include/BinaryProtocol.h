@@ -0,0 +1,199 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <Arduino.h>
+
+/**
+ * BinaryProtocol - Compact fixed-size command frames
+ *
+ * Request frame (8 bytes, little-endian):
+ *   [0]    magic    0xA5
+ *   [1]    opcode   see Opcode
+ *   [2]    flags    see Flags, 0 for a plain request
+ *   [3]    pin      GPIO number
+ *   [4-5]  value    16-bit value (SET: 0/1, PWM: duty)
+ *   [6-7]  sequence echoed back in the reply
+ *
+ * Response frame (8 bytes, little-endian):
+ *   [0]    magic    0xA6
+ *   [1]    opcode   opcode of the request
+ *   [2]    status   see Status
+ *   [3]    pin
+ *   [4-5]  value    result value (GET/TOGGLE: pin state, SET/PWM: applied value)
+ *   [6-7]  sequence copied from the request
+ *
+ * SETMASK (opcode 0x06) is followed by a 16-byte payload: the 64-bit set mask
+ * then the 64-bit clear mask (bit n = GPIO n). Pin and value are ignored.
+ *
+ * PULSE (opcode 0x08) inverts the pin for value ms, then restores it.
+ *
+ * FADE (opcode 0x07) uses value as the target duty and the low flag bits as
+ * the curve (0 linear, 1 ease, 2 gamma), followed by a 4-byte duration in ms.
+ *
+ * UDP only: FLAG_SEQUENCED makes the sequence number an ordering key, so
+ * stale or duplicate commands for a pin are dropped (reply STATUS_STALE), and
+ * FLAG_NO_REPLY suppresses the reply frame. FLAG_SCHEDULED appends an 8-byte
+ * apply time (Unix time in ms, SNTP synchronized) after any payload; the
+ * command is held until then.
+ *
+ * BATCH (opcode 0x10) carries the op count in the value field and is followed
+ * by that many 4-byte op records: [opcode][pin][value lo][value hi], where
+ * opcode is OP_SET, OP_PWM or OP_TOGGLE. The reply value is the op count.
+ *
+ * The magic byte is never valid as the first byte of a JSON or text command,
+ * so all three formats can share the same TCP and UDP ports.
+ *
+ * Analog block frame (device to client, little-endian, see AnalogSampler):
+ *   [0]      magic     0xA7
+ *   [1]      channels  n
+ *   [2-3]    samples   m per channel
+ *   [4-7]    rate      samples per second per channel
+ *   [8-11]   sequence  block number since ANALOG started, gaps are drops
+ *   [12-19]  time      microseconds since boot of the first sample
+ *   [20..]   n pin numbers, then m * n uint16 values (12-bit raw ADC),
+ *            channel-interleaved: sample 0 of every pin, then sample 1, ...
+ */
+
+namespace BinaryProtocol
+{
+    static const uint8_t REQUEST_MAGIC = 0xA5;
+    static const uint8_t RESPONSE_MAGIC = 0xA6;
+    static const uint8_t ANALOG_MAGIC = 0xA7;
+    static const size_t HEADER_SIZE = 8;
+    static const size_t RESPONSE_SIZE = 8;
+    static const size_t BATCH_OP_SIZE = 4;
+    static const size_t SETMASK_PAYLOAD_SIZE = 16;
+    static const size_t FADE_PAYLOAD_SIZE = 4;
+    static const size_t SCHEDULE_TRAILER_SIZE = 8;
+    static const size_t ANALOG_HEADER_SIZE = 20;
+
+    enum Opcode : uint8_t
+    {
+        OP_SET = 0x01,
+        OP_GET = 0x02,
+        OP_TOGGLE = 0x03,
+        OP_PWM = 0x04,
+        OP_RESET_PINS = 0x05,
+        OP_SETMASK = 0x06,
+        OP_FADE = 0x07,
+        OP_PULSE = 0x08,
+        OP_BATCH = 0x10
+    };
+
+    enum Flags : uint8_t
+    {
+        FLAG_CURVE_MASK = 0x0F, // FADE curve
+        FLAG_SCHEDULED = 0x20,  // Apply time trailer follows the frame
+        FLAG_SEQUENCED = 0x40,  // Drop if not newer than the last command for the pin
+        FLAG_NO_REPLY = 0x80    // Fire and forget, no reply frame
+    };
+
+    enum Status : uint8_t
+    {
+        STATUS_OK = 0x00,
+        STATUS_BAD_FRAME = 0x01,
+        STATUS_UNKNOWN_OPCODE = 0x02,
+        STATUS_INVALID_PIN = 0x03,
+        STATUS_INVALID_VALUE = 0x04,
+        STATUS_FAILED = 0x05,
+        STATUS_STALE = 0x06 // Sequenced command older than one already applied
+    };
+
+    inline uint16_t readU16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    inline void writeU16(uint8_t *p, uint16_t value)
+    {
+        p[0] = static_cast<uint8_t>(value & 0xFF);
+        p[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    inline uint32_t readU32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    inline void writeU32(uint8_t *p, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            p[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    inline void writeU64(uint8_t *p, uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            p[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    inline uint64_t readU64(const uint8_t *p)
+    {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--)
+        {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    // True if the buffer starts with a binary request frame
+    inline bool isFrame(const uint8_t *data, size_t length)
+    {
+        return length > 0 && data[0] == REQUEST_MAGIC;
+    }
+
+    // Total length of the frame starting at data, or 0 if more bytes are
+    // needed before the length is known
+    inline size_t frameLength(const uint8_t *data, size_t available)
+    {
+        if (available < 3)
+        {
+            return 0;
+        }
+
+        size_t trailer = (data[2] & FLAG_SCHEDULED) != 0 ? SCHEDULE_TRAILER_SIZE : 0;
+
+        if (data[1] == OP_SETMASK)
+        {
+            return HEADER_SIZE + SETMASK_PAYLOAD_SIZE + trailer;
+        }
+
+        if (data[1] == OP_FADE)
+        {
+            return HEADER_SIZE + FADE_PAYLOAD_SIZE + trailer;
+        }
+
+        if (data[1] != OP_BATCH)
+        {
+            return HEADER_SIZE + trailer;
+        }
+
+        // Batch length depends on the op count in the header
+        if (available < HEADER_SIZE)
+        {
+            return 0;
+        }
+        return HEADER_SIZE + readU16(data + 4) * BATCH_OP_SIZE + trailer;
+    }
+
+    // Write a response frame into out (RESPONSE_SIZE bytes), returns its size
+    inline size_t encodeResponse(uint8_t *out, uint8_t opcode, uint8_t status,
+                                 uint8_t pin, uint16_t value, uint16_t sequence)
+    {
+        out[0] = RESPONSE_MAGIC;
+        out[1] = opcode;
+        out[2] = status;
+        out[3] = pin;
+        writeU16(out + 4, value);
+        writeU16(out + 6, sequence);
+        return RESPONSE_SIZE;
+    }
+}
+
+#endif // BINARY_PROTOCOL_H
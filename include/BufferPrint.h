@@ -0,0 +1,81 @@
+#ifndef BUFFER_PRINT_H
+#define BUFFER_PRINT_H
+
+#include <Arduino.h>
+
+/**
+ * BufferPrint - Print target backed by a caller-provided fixed buffer
+ *
+ * Features:
+ * - No heap allocation, the buffer is always NUL-terminated
+ * - Output past the capacity is dropped and flagged with overflowed()
+ * - clear() makes the same buffer reusable for the next response
+ *
+ * Lets code written against Print (JsonWriter, help text) build a complete
+ * response that is then handed to a transport in one write.
+ */
+
+class BufferPrint : public Print
+{
+public:
+    BufferPrint(char *buffer, size_t capacity)
+        : _buffer(buffer), _capacity(capacity), _length(0), _overflow(false)
+    {
+        if (_capacity > 0)
+        {
+            _buffer[0] = '\0';
+        }
+    }
+
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t *data, size_t size) override
+    {
+        // Always keep room for the terminator
+        size_t room = _capacity > _length + 1 ? _capacity - _length - 1 : 0;
+        if (size > room)
+        {
+            _overflow = true;
+            size = room;
+        }
+
+        memcpy(_buffer + _length, data, size);
+        _length += size;
+        if (_capacity > 0)
+        {
+            _buffer[_length] = '\0';
+        }
+        return size;
+    }
+
+    using Print::write;
+
+    // Discard the contents
+    void clear()
+    {
+        _length = 0;
+        _overflow = false;
+        if (_capacity > 0)
+        {
+            _buffer[0] = '\0';
+        }
+    }
+
+    const char *c_str() const { return _buffer; }
+    const uint8_t *data() const { return reinterpret_cast<const uint8_t *>(_buffer); }
+    size_t length() const { return _length; }
+
+    // True if output was dropped because the buffer was full
+    bool overflowed() const { return _overflow; }
+
+private:
+    char *_buffer;
+    size_t _capacity;
+    size_t _length;
+    bool _overflow;
+};
+
+#endif // BUFFER_PRINT_H
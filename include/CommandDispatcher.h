@@ -0,0 +1,171 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "Config.h"
+#include "CommandParser.h"
+#include "PinController.h"
+#include "MPSCQueue.h"
+#include "Metrics.h"
+
+/**
+ * CommandDispatcher - Single execution engine behind every front-end
+ *
+ * Features:
+ * - One handler per CommandType in a table indexed by the enum value, checked
+ *   at compile time to stay in enum order
+ * - Shared by TCP, UDP, serial, WebSocket, REST and Telegram, so a command
+ *   behaves and responds the same everywhere
+ * - Results are plain values (status, static message, result value); JSON
+ *   and binary responses are written by the caller's choice of dispatch call
+ *
+ * - Single owner: commands only touch PinController in the task that called
+ *   begin() (the main loop). Callers in other tasks (AsyncTCP, Telegram)
+ *   have their command queued on a lock-free MPSC queue and block until the
+ *   owner has run it and notified them, or until PIN_COMMAND_TIMEOUT_MS
+ *   passes without the owner picking it up. AsyncTCP callbacks (TCP and WEB
+ *   sources) give up after PIN_COMMAND_ASYNC_TIMEOUT_MS, since their task
+ *   serves every connection.
+ *
+ * - Parse and execute times are recorded in Metrics under the CommandSource
+ *   each front-end passes in
+ *
+ * The queued command, out stream and subscription flag stay on the caller's
+ * stack; a job can only be abandoned while it is still waiting in the queue,
+ * so the owner never touches them after the caller has returned.
+ */
+
+struct CommandResult
+{
+    bool success;
+    const char *message; // Static string, never freed
+    int value;           // Result value, -1 if none
+    bool written;        // Handler wrote its own response body (STATUS, HELP)
+    PinMode mode;        // GET: mode of the pin read, NOT_CONFIGURED otherwise
+};
+
+class CommandDispatcher
+{
+public:
+    CommandDispatcher(CommandParser &parser, PinController &pinController);
+
+    // Make the calling task the owner of PinController - call from setup()
+    void begin();
+
+    // Run queued commands from other tasks - owner task only, call regularly
+    void loop();
+
+    // Sleep up to timeoutMs, waking as soon as a command is queued, then run
+    // the queue. Replaces the owner loop's idle delay.
+    void waitForWork(uint32_t timeoutMs);
+
+    // Called by RESET with the delay before the restart should happen
+    void setRestartHandler(void (*handler)(unsigned long delayMs));
+
+    // Parse a text/JSON line, run it and write the JSON response to out.
+    // subscribed is the sender's event subscription (nullptr if it cannot
+    // subscribe).
+    void process(const char *command, size_t length, Print &out, bool *subscribed = nullptr,
+                 CommandSource source = CommandSource::INTERNAL);
+
+    // Parse a binary frame, run it, write the reply frame and return its length
+    size_t processBinary(const uint8_t *frame, size_t length, uint8_t *reply,
+                         CommandSource source = CommandSource::INTERNAL);
+
+    // Parse a text, JSON or binary command, recording the parse time
+    Command parse(const char *command, size_t length, CommandSource source);
+
+    // Run an already parsed binary command, write the reply frame and return
+    // its length
+    size_t executeBinary(const Command &cmd, uint8_t *reply, CommandSource source = CommandSource::INTERNAL);
+
+    // Run an already parsed command and write its JSON response to out
+    void dispatch(const Command &cmd, Print &out, bool *subscribed = nullptr,
+                  CommandSource source = CommandSource::INTERNAL);
+
+    // Run an already parsed command without writing anything. Commands whose
+    // result is a response body (STATUS, HELP) need an out stream. Safe from
+    // any task; off the owner task this blocks until the command has run.
+    CommandResult execute(const Command &cmd, Print *out = nullptr, bool *subscribed = nullptr,
+                          CommandSource source = CommandSource::INTERNAL);
+
+    CommandParser &parser() { return _parser; }
+
+private:
+    typedef CommandResult (CommandDispatcher::*Handler)(const Command &cmd, Print *out, bool *subscribed);
+
+    struct Entry
+    {
+        CommandType type;
+        Handler handler;
+    };
+
+    enum JobState : uint8_t
+    {
+        JOB_FREE,
+        JOB_CLAIMED,   // Being filled in by the caller
+        JOB_QUEUED,    // Waiting for the owner
+        JOB_RUNNING,   // Owner is executing it, the caller must wait
+        JOB_DONE,      // Result ready for the caller
+        JOB_ABANDONED, // Caller timed out, owner frees it when popped
+    };
+
+    // A command handed from another task to the owner
+    struct Job
+    {
+        const Command *cmd;
+        Print *out;
+        bool *subscribed;
+        CommandResult result;
+        TaskHandle_t caller;
+        std::atomic<uint8_t> state;
+    };
+
+    // Run cmd in the calling task
+    CommandResult run(const Command &cmd, Print *out, bool *subscribed);
+
+    // Queue cmd for the owner task and wait for its result, failing if the
+    // owner has not picked it up within timeoutMs
+    CommandResult submit(const Command &cmd, Print *out, bool *subscribed, uint32_t timeoutMs);
+
+    CommandResult handleInvalid(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleSet(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleGet(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleToggle(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handlePWM(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleStatus(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleReset(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleResetPins(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleHelp(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleBatch(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleSetMask(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleFade(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleInput(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleSubscribe(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handlePulse(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleAt(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleEvery(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleCancel(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleMetrics(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleLogLevel(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleProfile(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleAnalog(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleGroup(const Command &cmd, Print *out, bool *subscribed);
+    CommandResult handleScene(const Command &cmd, Print *out, bool *subscribed);
+
+    // Write the STATUS response from the shared status snapshot
+    void writeStatus(Print &out);
+
+    CommandParser &_parser;
+    PinController &_pinController;
+    void (*_restartHandler)(unsigned long);
+
+    TaskHandle_t _owner;
+    Job _jobs[PIN_COMMAND_QUEUE_SIZE];
+    MPSCQueue<uint8_t, PIN_COMMAND_QUEUE_SIZE> _queue; // Indices into _jobs
+};
+
+#endif // COMMAND_DISPATCHER_H
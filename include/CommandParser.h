@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "Config.h"
+#include "BinaryProtocol.h"
+#include "PinController.h"
 
 /**
  * Command Parser - Handles parsing and validation of pin control commands
@@ -15,29 +17,125 @@
  * {"cmd":"GET","pin":13}
  * {"cmd":"TOGGLE","pin":13}
  * {"cmd":"PWM","pin":13,"value":128}
+ * {"cmd":"PWM","pin":13,"value":4915,"freq":50,"resolution":16}
  * {"cmd":"STATUS"}
  * {"cmd":"RESET"}
+ * {"cmd":"BATCH","ops":[{"cmd":"SET","pin":13,"value":1},{"cmd":"PWM","pin":12,"value":128}]}
+ * {"cmd":"SETMASK","set":"0x3000","clear":"0x4000"}
+ * {"cmd":"FADE","pin":13,"value":255,"duration":1000,"curve":"EASE"}
+ * {"cmd":"INPUT","pin":4,"pull":"PULLUP","debounce":20}
+ * {"cmd":"SUBSCRIBE"}
+ * {"cmd":"PULSE","pin":13,"duration":200}
+ * {"cmd":"AT","delay":30000,"do":{"cmd":"SET","pin":13,"value":0}}
+ * {"cmd":"AT","time":1767225600000,"do":{"cmd":"TOGGLE","pin":13}}
+ * {"cmd":"EVERY","interval":1000,"do":{"cmd":"PULSE","pin":13,"duration":50}}
+ * {"cmd":"CANCEL","id":65537}  /  {"cmd":"CANCEL","id":"ALL"}
+ * {"cmd":"METRICS"}
+ * {"cmd":"LOGLEVEL","level":"DEBUG"}  (no "level" reports the current one)
+ * {"cmd":"PROFILE","profile":"low-power"}  (no "profile" reports the current one)
+ * {"cmd":"ANALOG","pins":[34,35],"rate":1000,"average":16}  ("rate":0 stops)
+ * {"cmd":"GROUP","define":"relays","pins":[12,13,14]}
+ * {"cmd":"GROUP","name":"relays","value":0}  ("pwm":true sets value as a duty)
+ * {"cmd":"GROUP","delete":"relays"}  /  {"cmd":"GROUP"}  (lists the groups)
+ * {"cmd":"SCENE","define":"evening","ops":[{"cmd":"SET","pin":13,"value":1},{"cmd":"PWM","pin":12,"value":64}]}
+ * {"cmd":"SCENE","save":"evening"}  (the current outputs)
+ * {"cmd":"SCENE","name":"evening"}
+ * {"cmd":"SCENE","delete":"evening"}  /  {"cmd":"SCENE"}  (lists the scenes)
+ *
+ * Any JSON command may carry "seq" (0-65535, orders commands sent over UDP),
+ * "ack":false (UDP sends no reply) and "at" (UDP only: Unix time in ms at
+ * which to apply it).
  *
  * Text Format:
  * SET 13 1
  * GET 13
  * TOGGLE 13
  * PWM 13 128
+ * PWM 13 4915 50 16   (value, frequency in Hz, resolution in bits)
  * STATUS
  * RESET
+ * BATCH SET 13 1; PWM 12 128; TOGGLE 14
+ * SETMASK 0x3000 0x4000
+ * FADE 13 255 1000 [LINEAR|EASE|GAMMA]
+ * INPUT 4 [NONE|PULLUP|PULLDOWN] [debounce_ms]
+ * SUBSCRIBE / UNSUBSCRIBE
+ * PULSE 13 200          (invert for 200 ms, then restore)
+ * AT +30000 SET 13 0    (in 30 s; AT <unix_ms> ... for an absolute time)
+ * EVERY 1000 TOGGLE 13
+ * CANCEL <id> / CANCEL ALL
+ * METRICS
+ * LOGLEVEL [NONE|ERROR|WARNING|INFO|DEBUG]
+ * PROFILE [low-latency|balanced|low-power]
+ * ANALOG 34,35 1000 [average]   (pins, values per second per pin)
+ * ANALOG OFF
+ * GROUP DEFINE relays 12,13,14
+ * GROUP relays 0 / GROUP dimmers PWM 128
+ * GROUP DELETE relays / GROUP
+ * SCENE DEFINE evening SET 13 1; PWM 12 64
+ * SCENE SAVE evening
+ * SCENE evening
+ * SCENE DELETE evening / SCENE
+ *
+ * AT and EVERY take one SET, PWM, TOGGLE or PULSE and reply with a timer id.
+ *
+ * Group and scene names are 1-15 letters, digits, '_' or '-', matched
+ * case-insensitively; DEFINE, SAVE, DELETE and PWM are reserved.
+ *
+ * ANALOG streams binary sample blocks (see AnalogSampler) to subscribed UDP
+ * endpoints and /analog WebSocket clients; the reply value is the number of
+ * conversions averaged per sample.
+ *
+ * Binary Format:
+ * 8-byte frames starting with 0xA5, see BinaryProtocol.h
  */
 
-enum class CommandType
+enum class CommandType : uint8_t
 {
     INVALID,
     SET,        // Set pin to HIGH or LOW
     GET,        // Get current pin state
     TOGGLE,     // Toggle pin state
-    PWM,        // Set PWM value (0-255)
+    PWM,        // Set PWM duty, optional frequency/resolution
     STATUS,     // Get system status
     RESET,      // Reset/restart system
     RESET_PINS, // Reset all pins to LOW
-    HELP        // Get help information
+    HELP,       // Get help information
+    BATCH,      // Apply several SET/PWM/TOGGLE ops at once
+    SETMASK,    // Set and clear many digital pins with one register write
+    FADE,       // Fade PWM duty to a target on the device
+    SET_INPUT,  // Configure an interrupt-driven input (text name INPUT)
+    SUBSCRIBE,   // Start receiving input events on this connection
+    UNSUBSCRIBE, // Stop receiving input events
+    PULSE,       // Invert a digital pin for a time, then restore it
+    AT,          // Run a pin op once, after a delay or at a time
+    EVERY,       // Run a pin op periodically
+    CANCEL,      // Cancel an AT/EVERY timer, or all of them
+    METRICS,     // Latency histograms and heap figures
+    LOG_LEVEL,   // Set or query the log level (text name LOGLEVEL)
+    PROFILE,     // Set or query the power profile
+    ANALOG,      // Start or stop streaming analog sample blocks
+    GROUP,       // Define, switch, delete or list named pin groups
+    SCENE        // Define, save, recall, delete or list named scenes
+};
+
+// Number of CommandType values; update when adding a type after SCENE
+static const size_t COMMAND_TYPE_COUNT = static_cast<size_t>(CommandType::SCENE) + 1;
+
+// What a GROUP or SCENE command does with its name
+enum class SceneAction : uint8_t
+{
+    LIST,   // No name: list every entry
+    RECALL, // Apply the named group or scene
+    DEFINE, // Create or replace it from pins (GROUP) or ops (SCENE)
+    SAVE,   // SCENE only: create or replace it from the current outputs
+    DELETE
+};
+
+enum class CommandFormat
+{
+    TEXT,
+    JSON,
+    BINARY
 };
 
 struct Command
@@ -47,7 +145,67 @@ struct Command
     int value;
     String errorMessage;
 
-    Command() : type(CommandType::INVALID), pin(-1), value(-1), errorMessage("") {}
+    // Wire format the command arrived in (responses use the same format)
+    CommandFormat format;
+
+    // Binary format only: request opcode and decode status
+    uint8_t opcode;
+    uint8_t binaryStatus;
+
+    // Sequence number (binary header or JSON "seq"); sequenced means it
+    // orders commands per pin, see SequenceFilter
+    uint16_t sequence;
+    bool sequenced;
+
+    // Sender does not want a reply (UDP)
+    bool noReply;
+
+    // Unix time in ms at which to apply the command, 0 = now (UDP)
+    uint64_t applyAt;
+
+    // BATCH only: validated pin operations
+    uint8_t batchCount;
+    PinOp batch[MAX_BATCH_OPS];
+
+    // SETMASK only: bit n = GPIO n. ANALOG: setMask holds the sampled pins.
+    uint64_t setMask;
+    uint64_t clearMask;
+
+    // PWM only: 0 keeps the pin's current setting.
+    // ANALOG: samples per second per pin, 0 stops; value is the averaging
+    // (0 = automatic).
+    uint32_t frequency;
+    uint8_t resolution;
+
+    // FADE: value is the target duty; FADE and PULSE: duration in ms
+    uint32_t duration;
+    FadeCurve curve;
+
+    // INPUT only
+    InputPull pull;
+    uint16_t debounceMs;
+
+    // AT / EVERY: the op to run is batch[0]. timerMs is the AT delay or the
+    // EVERY interval; atTime is an absolute AT time (Unix ms, 0 = use timerMs).
+    // CANCEL: value is the timer id, -1 for all.
+    uint32_t timerMs;
+    uint64_t atTime;
+
+    // GROUP / SCENE: action and name. GROUP DEFINE: setMask holds the pins.
+    // GROUP RECALL: value is the level, or the duty with groupPWM.
+    // SCENE DEFINE: the ops are in batch.
+    SceneAction action;
+    bool groupPWM;
+    char name[SCENE_NAME_LENGTH];
+
+    Command() : type(CommandType::INVALID), pin(-1), value(-1), errorMessage(""),
+                format(CommandFormat::TEXT), opcode(0),
+                binaryStatus(BinaryProtocol::STATUS_OK), sequence(0), sequenced(false),
+                noReply(false), applyAt(0), batchCount(0),
+                setMask(0), clearMask(0), frequency(0), resolution(0),
+                duration(0), curve(FadeCurve::LINEAR),
+                pull(InputPull::NONE), debounceMs(INPUT_DEFAULT_DEBOUNCE_MS),
+                timerMs(0), atTime(0), action(SceneAction::LIST), groupPWM(false), name() {}
 
     bool isValid() const
     {
@@ -63,28 +221,72 @@ public:
     // Parse command from string (auto-detects JSON or text format)
     Command parse(const String &commandString);
 
-    // Generate response for a command
-    String generateResponse(const Command &cmd, bool success,
-                            const String &message = "", int resultValue = -1);
+    // Parse command from a raw buffer view (no copy, text path does not allocate)
+    Command parse(const char *data, size_t length);
 
-    // Get help text
-    String getHelpText();
+    // Write the JSON response for a command
+    void writeResponse(Print &out, const Command &cmd, bool success,
+                       const char *message = "", int resultValue = -1);
+
+    // Generate binary response frame into out (BinaryProtocol::RESPONSE_SIZE
+    // bytes), returns number of bytes written
+    size_t generateBinaryResponse(const Command &cmd, bool success,
+                                  int resultValue, uint8_t *out);
+
+    // Write the JSON line pushed to subscribers for an input change
+    void writeInputEvent(Print &out, const InputEvent &event);
+
+    // Write the help text
+    void writeHelpText(Print &out);
 
 private:
     // Parse JSON format command
-    Command parseJSON(const String &jsonString);
+    Command parseJSON(const char *data, size_t length);
 
     // Parse text format command
-    Command parseText(const String &textString);
+    Command parseText(const char *data, size_t length);
+
+    // Decode binary format frame
+    Command parseBinary(const uint8_t *data, size_t length);
+
+    // Decode the op records of a binary BATCH frame
+    Command parseBinaryBatch(Command &cmd, const uint8_t *data, size_t length);
+
+    // Validate pin and value of SET/GET/TOGGLE/PWM (marks cmd invalid on error)
+    bool validatePinCommand(Command &cmd);
+
+    // Append a parsed SET/PWM/TOGGLE command to a batch (marks batch invalid on error)
+    bool addBatchOp(Command &batch, const Command &op);
+
+    // Parse the ';'-separated ops of a text BATCH command
+    void parseTextBatch(Command &cmd, const char *data, size_t length);
+
+    // Store the op of an AT/EVERY command (marks timed invalid on error)
+    bool setTimedOp(Command &timed, const Command &op);
+
+    // Parse the op object of a JSON AT/EVERY command
+    Command parseJSONOp(JsonObjectConst obj);
+
+    // Validate the delay/interval of AT/EVERY (marks cmd invalid on error)
+    bool validateTimerCommand(Command &cmd);
+
+    // Validate SETMASK masks (marks command invalid on error)
+    bool validateMaskCommand(Command &cmd);
+
+    // Validate the pins, rate and averaging of ANALOG (marks command invalid on error)
+    bool validateAnalogCommand(Command &cmd);
+
+    // Validate a GROUP or SCENE command (marks command invalid on error)
+    bool validateSceneCommand(Command &cmd);
 
     // Validate pin number
     bool isValidPin(int pin);
 
-    // Convert string to command type
-    CommandType stringToCommandType(const String &cmdStr);
+    // Convert string to command type (case-insensitive)
+    CommandType stringToCommandType(const char *cmdStr, size_t length);
 
     // Convert command type to string
-    String commandTypeToString(CommandType type);
+    const char *commandTypeToString(CommandType type);
 };
 
 #endif // COMMAND_PARSER_H
@@ -16,6 +16,9 @@
 // WiFi reconnection attempt interval (milliseconds)
 #define WIFI_RECONNECT_INTERVAL 30000
 
+// Longest wait for an async network scan before trying networks in order (milliseconds)
+#define WIFI_SCAN_TIMEOUT 8000
+
 // WiFi credentials structure
 // NOTE: This must be defined BEFORE including Credentials.h
 struct WiFiCredentials
@@ -48,12 +51,77 @@ struct WiFiCredentials
 // UDP Server port for receiving commands
 #define UDP_SERVER_PORT 8889
 
-// Maximum number of simultaneous TCP clients
+// Web server (UI, REST API, WebSocket) port
+#define WEB_SERVER_PORT 80
+
+// Maximum UDP datagrams handled per main loop pass; the rest wait for the
+// next pass so the loop keeps feeding the watchdog under a flood
+#define UDP_MAX_PACKETS_PER_LOOP 32
+
+// Datagrams AsyncUDP can queue for the main loop before further ones are
+// dropped; each slot holds COMMAND_BUFFER_SIZE bytes. Must be a power of two.
+#define UDP_RX_QUEUE_SIZE 16
+
+// A pin that has had no sequenced UDP command for this long accepts any
+// sequence number again (milliseconds)
+#define UDP_SEQUENCE_RESET_MS 2000
+
+// Fleet control: every board with the same group ID joins the multicast
+// group 239.255.42.<ID> and runs commands sent to it (never replies)
+#define ENABLE_UDP_MULTICAST true
+#define UDP_MULTICAST_GROUP_ID 1 // 1-254
+#define UDP_MULTICAST_PORT 8890
+
+// Scheduled UDP commands ("at" / FLAG_SCHEDULED) held at once, and how far
+// ahead they may be scheduled (milliseconds)
+#define UDP_SCHEDULE_SLOTS 4
+#define UDP_SCHEDULE_MAX_AHEAD_MS 60000
+
+// SNTP server for the clock scheduled commands are timed against
+#define NTP_SERVER "pool.ntp.org"
+
+// Maximum number of simultaneous TCP clients (polled server)
 #define MAX_TCP_CLIENTS 4
 
+// Use the event-driven AsyncTCP command server instead of the polled
+// WiFiServer. Set to false to fall back to the polled server.
+#define ENABLE_ASYNC_TCP_SERVER true
+
+// Maximum number of simultaneous TCP clients (async server)
+// lwIP allows 16 active TCP connections in total, shared with the web server
+#define ASYNC_TCP_MAX_CLIENTS 12
+
 // Command buffer size
 #define COMMAND_BUFFER_SIZE 512
 
+// Size of the fixed buffers responses are serialized into (bytes); must hold
+// the HELP text and a STATUS response with every pin configured
+#define RESPONSE_BUFFER_SIZE 3072
+
+// Commands that can wait for the main loop at once when sent from other
+// tasks (web server, Telegram); must be a power of two
+#define PIN_COMMAND_QUEUE_SIZE 8
+
+// How long such a command may wait for the main loop to pick it up before
+// it fails with "Pin controller busy" (milliseconds)
+#define PIN_COMMAND_TIMEOUT_MS 1000
+
+// The same limit for commands from AsyncTCP callbacks (TCP and WEB sources),
+// which hold up every other connection while they wait. The main loop picks
+// commands up between tasks, so this is twice the longest task budget below
+// (milliseconds)
+#define PIN_COMMAND_ASYNC_TIMEOUT_MS (2 * LOOP_HOUSEKEEPING_BUDGET_US / 1000)
+
+// Interval at which the shared status snapshot is refreshed (milliseconds)
+#define STATUS_SNAPSHOT_INTERVAL_MS 1000
+
+// Minimum interval between pin state deltas pushed over the web socket
+// (milliseconds); changes within one interval are coalesced
+#define WEB_SOCKET_UPDATE_INTERVAL_MS 50
+
+// Interval of system status pushes over the web socket (milliseconds)
+#define WEB_SOCKET_STATUS_INTERVAL_MS 5000
+
 // Response timeout (milliseconds)
 #define RESPONSE_TIMEOUT 5000
 
@@ -66,16 +134,120 @@ struct WiFiCredentials
 
 // Default pins that are safe to control (adjust based on your ESP32 board)
 // Avoid pins used for flash (6-11), boot mode (0, 2), and serial (1, 3)
-const int SAFE_PINS[] = {
+constexpr int SAFE_PINS[] = {
     4, 5, 12, 13, 14, 15, 16, 17, 18, 19,
     21, 22, 23, 25, 26, 27, 32, 33};
 
-const int SAFE_PIN_COUNT = sizeof(SAFE_PINS) / sizeof(int);
+constexpr int SAFE_PIN_COUNT = sizeof(SAFE_PINS) / sizeof(int);
 
-// Pin state persistence interval (milliseconds)
+// Number of GPIO numbers on the ESP32 (0-39), sizes the per-pin tables
+#define GPIO_PIN_COUNT 40
+
+// PWM (LEDC) defaults, used when a PWM command gives no frequency/resolution
+#define PWM_DEFAULT_FREQUENCY 5000
+#define PWM_DEFAULT_RESOLUTION 8 // bits, duty 0-255
+
+// Highest accepted PWM resolution (bits)
+#define PWM_MAX_RESOLUTION 16
+
+// Longest accepted FADE duration (milliseconds)
+#define FADE_MAX_DURATION_MS 600000
+
+// Update interval of software-curve fades (milliseconds)
+#define FADE_UPDATE_INTERVAL_MS 5
+
+// Default input debounce time (milliseconds), 0 reports every edge
+#define INPUT_DEFAULT_DEBOUNCE_MS 20
+
+// Delayed and periodic pin ops (AT / EVERY) that can be pending at once
+#define TIMER_MAX_EVENTS 128
+
+// Shortest accepted EVERY interval (milliseconds)
+#define TIMER_MIN_INTERVAL_MS 10
+
+// Longest accepted AT delay or EVERY interval (milliseconds, at most ~18.6 h)
+#define TIMER_MAX_DELAY_MS 64800000UL
+
+// Longest PULSE (milliseconds)
+#define PULSE_MAX_DURATION_MS 65535
+
+// Raw input edges buffered between the GPIO ISR and the main loop (power of two)
+#define INPUT_EVENT_QUEUE_SIZE 64
+
+// Maximum number of input event listeners (TCP/UDP server, web server, ...)
+#define INPUT_MAX_LISTENERS 4
+
+// Maximum number of UDP endpoints subscribed to input events
+#define UDP_MAX_SUBSCRIBERS 4
+
+// Maximum number of pin operations in one BATCH command
+#define MAX_BATCH_OPS 32
+
+// Longest a changed output state waits before it is saved to NVS while pins
+// keep changing, and the shortest time between two saves (milliseconds).
 // Set to 0 to disable state persistence
 #define PIN_STATE_SAVE_INTERVAL 60000
 
+// Output changes are saved once pins have been quiet this long (milliseconds)
+#define PIN_STATE_SAVE_DELAY_MS 2000
+
+// Named pin groups and scenes (GROUP / SCENE commands), kept in NVS
+#define GROUP_MAX_COUNT 16
+#define SCENE_MAX_COUNT 16
+
+// Name buffer of a group or scene, names are at most one character shorter
+#define SCENE_NAME_LENGTH 16
+
+// PWM outputs one scene can set (the ESP32 has 16 LEDC channels)
+#define SCENE_MAX_PWM_PINS 16
+
+// ============================================================================
+// Analog Sampling Configuration
+// ============================================================================
+
+// Pins the ANALOG command may sample. Only ADC1 pins (GPIO 32-39) work while
+// WiFi is on, and none may be in SAFE_PINS. 34-39 are input only, so the
+// default list never competes with a controllable pin.
+constexpr int ANALOG_PINS[] = {34, 35, 36, 39};
+
+constexpr int ANALOG_PIN_COUNT = sizeof(ANALOG_PINS) / sizeof(int);
+
+// Highest accepted output rate per channel (samples per second)
+#define ANALOG_MAX_RATE_HZ 10000
+
+// ADC conversion rate limits of the DMA driver (conversions per second,
+// all channels together). Slower requests average more conversions per
+// value to reach the minimum; the maximum bounds the sampler task's CPU use.
+#define ANALOG_MIN_CONVERSION_HZ 20000
+#define ANALOG_MAX_CONVERSION_HZ 200000
+
+// Input attenuation: 0 (0-1.1 V), 1 (0-1.5 V), 2 (0-2.2 V), 3 (0-3.3 V)
+#define ANALOG_ATTENUATION 3
+
+// Values per streamed block, all channels together (sizes each frame: 2
+// bytes per value plus the header)
+#define ANALOG_BLOCK_VALUES 256
+
+// Longest a block collects before it is sent, so slow rates still stream
+// steadily (milliseconds)
+#define ANALOG_BLOCK_INTERVAL_MS 100
+
+// Blocks buffered between the sampler task and the main loop (power of two);
+// blocks that do not fit are dropped, which shows as a sequence gap
+#define ANALOG_BLOCK_QUEUE_SIZE 4
+
+// Bytes the DMA driver collects per interrupt, and its ring buffer size
+#define ANALOG_DMA_FRAME_BYTES 1024
+#define ANALOG_DMA_BUFFER_BYTES 4096
+
+// Sampler task: owns the ADC driver and averages the raw conversions
+#define ANALOG_TASK_CORE 0
+#define ANALOG_TASK_PRIORITY 3
+#define ANALOG_TASK_STACK_SIZE 3072
+
+// Maximum number of analog block listeners (UDP, WebSocket)
+#define ANALOG_MAX_LISTENERS 2
+
 // ============================================================================
 // Watchdog Configuration
 // ============================================================================
@@ -98,6 +270,14 @@ const int SAFE_PIN_COUNT = sizeof(SAFE_PINS) / sizeof(int);
 // Device hostname (for mDNS)
 #define DEVICE_HOSTNAME "esp32-controller"
 
+// Firmware version, advertised in the mDNS TXT records
+#define FIRMWARE_VERSION "1.0.0"
+
+// Answer mDNS as DEVICE_HOSTNAME.local and advertise the _esp32ctl._tcp,
+// _esp32ctl._udp and _http._tcp services, so clients browse for boards
+// instead of scanning the subnet
+#define ENABLE_MDNS true
+
 // Status LED pin (set to -1 to disable)
 #define STATUS_LED_PIN 2
 
@@ -107,12 +287,57 @@ const int SAFE_PIN_COUNT = sizeof(SAFE_PINS) / sizeof(int);
 #define LED_BLINK_ERROR 100
 
 // Serial debug output
+#ifndef ENABLE_SERIAL_DEBUG
 #define ENABLE_SERIAL_DEBUG true
+#endif
 #define SERIAL_BAUD_RATE 115200
 
+// Log level at boot, changed at runtime with LOGLEVEL
+// (0 none, 1 error, 2 warning, 3 info, 4 debug - every command)
+#define LOG_DEFAULT_LEVEL 3
+
+// Log lines queued for the log task (power of two); lines logged while it is
+// full are dropped and counted
+#define LOG_QUEUE_SIZE 32
+
+// Longest log line in characters, longer lines are cut
+#define LOG_LINE_LENGTH 128
+
+// Log task: writes queued lines to Serial and syslog, below everything else
+#define LOG_TASK_CORE 0
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_STACK_SIZE 3072
+
+// How often the log task looks for queued lines when idle (milliseconds)
+#define LOG_DRAIN_INTERVAL_MS 20
+
+// UDP syslog receiver for log lines (RFC 3164), "" to log to Serial only
+#define LOG_SYSLOG_HOST ""
+#define LOG_SYSLOG_PORT 514
+
+// Power profile until one is set with PROFILE (saved in NVS):
+// 0 low-latency (no modem sleep, 240 MHz), 1 balanced (modem sleep, 160 MHz),
+// 2 low-power (deepest modem sleep, 80 MHz, slower loop)
+#define POWER_PROFILE_DEFAULT 1
+
 // Heartbeat interval for status messages (milliseconds)
 #define HEARTBEAT_INTERVAL 60000
 
+// Main loop scheduler (see LoopScheduler.h): most tasks that can register
+#define LOOP_MAX_TASKS 16
+
+// Default time budget of one task run by priority (microseconds); a run over
+// budget is reported to WatchdogManager as an overrun
+#define LOOP_COMMAND_BUDGET_US 2000
+#define LOOP_IO_BUDGET_US 5000
+#define LOOP_HOUSEKEEPING_BUDGET_US 10000
+
+// Overrun warnings are logged at most this often (milliseconds)
+#define LOOP_OVERRUN_LOG_INTERVAL_MS 5000
+
+// How often the status LED task runs (milliseconds)
+#define LED_UPDATE_INTERVAL_MS 50
+
 // ============================================================================
 // Telegram Configuration
 // ============================================================================
@@ -121,9 +346,28 @@ const int SAFE_PIN_COUNT = sizeof(SAFE_PINS) / sizeof(int);
 #define ENABLE_TELEGRAM_NOTIFICATIONS true
 
 // Telegram message check interval (milliseconds)
-// How often to check for new messages from Telegram
+// How often to check for new messages from Telegram when long polling is off
 #define TELEGRAM_CHECK_INTERVAL 10000
 
+// getUpdates long-poll timeout (seconds), 0 for short polls every
+// TELEGRAM_CHECK_INTERVAL. Telegram holds the request open until a message
+// arrives, so replies are immediate and the TLS connection stays in use.
+#define TELEGRAM_LONG_POLL_SEC 20
+
+// Notifications queued within this window are sent as one message (milliseconds)
+#define TELEGRAM_COALESCE_MS 2000
+
+// Telegram worker and poll tasks (each gets this stack)
+// All HTTPS traffic runs in these tasks so the main loop never blocks on TLS.
+// Core 0 keeps them away from the Arduino loop task (core 1).
+#define TELEGRAM_TASK_CORE 0
+#define TELEGRAM_TASK_PRIORITY 1
+#define TELEGRAM_TASK_STACK_SIZE 10240
+
+// Outbound message queue (messages are copied into fixed-size slots)
+#define TELEGRAM_QUEUE_LENGTH 8
+#define TELEGRAM_MAX_MESSAGE_LENGTH 512
+
 // ============================================================================
 // Error Recovery Configuration
 // ============================================================================
@@ -0,0 +1,241 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+/**
+ * JsonWriter - Streaming JSON serializer that writes straight to a Print
+ *
+ * Features:
+ * - No document tree and no heap allocation: every call emits bytes
+ * - Commas and key/value separators handled automatically
+ * - Works with any Print: BufferPrint, AsyncResponseStream, Serial, WiFiClient
+ * - Nesting up to 32 levels
+ *
+ * Usage:
+ *   JsonWriter json(out);
+ *   json.beginObject().field("success", true).field("pin", 13).endObject();
+ *
+ * The writer does not check that calls are balanced; callers are expected to
+ * close everything they open.
+ */
+
+class JsonWriter
+{
+public:
+    explicit JsonWriter(Print &out) : _out(out), _depth(0), _hasItems(0), _afterKey(false) {}
+
+    JsonWriter &beginObject()
+    {
+        separate();
+        _out.write('{');
+        push();
+        return *this;
+    }
+
+    JsonWriter &beginObject(const char *name)
+    {
+        key(name);
+        return beginObject();
+    }
+
+    JsonWriter &endObject()
+    {
+        pop();
+        _out.write('}');
+        return *this;
+    }
+
+    JsonWriter &beginArray()
+    {
+        separate();
+        _out.write('[');
+        push();
+        return *this;
+    }
+
+    JsonWriter &beginArray(const char *name)
+    {
+        key(name);
+        return beginArray();
+    }
+
+    JsonWriter &endArray()
+    {
+        pop();
+        _out.write(']');
+        return *this;
+    }
+
+    JsonWriter &key(const char *name)
+    {
+        separate();
+        writeString(name);
+        _out.write(':');
+        _afterKey = true;
+        return *this;
+    }
+
+    JsonWriter &value(const char *text)
+    {
+        separate();
+        if (text == nullptr)
+        {
+            _out.write("null");
+        }
+        else
+        {
+            writeString(text);
+        }
+        return *this;
+    }
+
+    JsonWriter &value(const String &text) { return value(text.c_str()); }
+
+    JsonWriter &value(bool flag)
+    {
+        separate();
+        _out.write(flag ? "true" : "false");
+        return *this;
+    }
+
+    JsonWriter &value(int number) { return value(static_cast<long long>(number)); }
+    JsonWriter &value(long number) { return value(static_cast<long long>(number)); }
+    JsonWriter &value(unsigned int number) { return value(static_cast<unsigned long long>(number)); }
+    JsonWriter &value(unsigned long number) { return value(static_cast<unsigned long long>(number)); }
+
+    JsonWriter &value(long long number)
+    {
+        char digits[24];
+        int len = snprintf(digits, sizeof(digits), "%lld", number);
+        separate();
+        _out.write(digits, len);
+        return *this;
+    }
+
+    JsonWriter &value(unsigned long long number)
+    {
+        char digits[24];
+        int len = snprintf(digits, sizeof(digits), "%llu", number);
+        separate();
+        _out.write(digits, len);
+        return *this;
+    }
+
+    JsonWriter &value(double number, int decimals = 2)
+    {
+        char digits[32];
+        int len = snprintf(digits, sizeof(digits), "%.*f", decimals, number);
+        separate();
+        _out.write(digits, len);
+        return *this;
+    }
+
+    // Emit already-serialized JSON as a value
+    JsonWriter &raw(const char *json)
+    {
+        separate();
+        _out.write(json);
+        return *this;
+    }
+
+    template <typename T>
+    JsonWriter &field(const char *name, T v)
+    {
+        key(name);
+        return value(v);
+    }
+
+private:
+    // Emit the comma between items, except directly after a key
+    void separate()
+    {
+        if (_afterKey)
+        {
+            _afterKey = false;
+            return;
+        }
+        if (_depth == 0)
+        {
+            return;
+        }
+
+        uint32_t bit = 1UL << (_depth - 1);
+        if (_hasItems & bit)
+        {
+            _out.write(',');
+        }
+        _hasItems |= bit;
+    }
+
+    void push()
+    {
+        if (_depth < 32)
+        {
+            _depth++;
+            _hasItems &= ~(1UL << (_depth - 1));
+        }
+    }
+
+    void pop()
+    {
+        if (_depth > 0)
+        {
+            _depth--;
+        }
+        _afterKey = false;
+    }
+
+    void writeString(const char *text)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        _out.write('"');
+
+        // Copy runs of plain characters in one write
+        const char *run = text;
+        for (const char *p = text; *p != '\0'; p++)
+        {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c >= 0x20 && c != '"' && c != '\\')
+            {
+                continue;
+            }
+
+            _out.write(run, p - run);
+            run = p + 1;
+
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+            switch (c)
+            {
+            case '"':
+            case '\\':
+                escaped[1] = static_cast<char>(c);
+                _out.write(escaped, 2);
+                break;
+            case '\n':
+                _out.write("\\n");
+                break;
+            case '\r':
+                _out.write("\\r");
+                break;
+            case '\t':
+                _out.write("\\t");
+                break;
+            default:
+                _out.write(escaped, 6);
+                break;
+            }
+        }
+        _out.write(run, strlen(run));
+
+        _out.write('"');
+    }
+
+    Print &_out;
+    uint8_t _depth;
+    uint32_t _hasItems; // Bit n set once level n+1 has an item
+    bool _afterKey;
+};
+
+#endif // JSON_WRITER_H
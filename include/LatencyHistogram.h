@@ -0,0 +1,91 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+/**
+ * LatencyHistogram - Fixed-bucket histogram of durations in microseconds
+ *
+ * Features:
+ * - Power-of-two buckets from 8 us to 2^25 us (~33 s) plus overflow, so
+ *   one histogram covers loop passes and WiFi reconnects alike
+ * - Recording is a count-leading-zeros and three additions, no allocation
+ * - Count, sum and maximum for averages and worst cases
+ *
+ * Not synchronized; see Metrics for the shared instances.
+ */
+
+class LatencyHistogram
+{
+public:
+    static const int BUCKET_COUNT = 24; // Bucket i counts values <= upperBound(i), the last is unbounded
+
+    LatencyHistogram() { clear(); }
+
+    void record(uint32_t us)
+    {
+        _buckets[bucketFor(us)]++;
+        _count++;
+        _sum += us;
+        if (us > _max)
+        {
+            _max = us;
+        }
+    }
+
+    void clear()
+    {
+        memset(_buckets, 0, sizeof(_buckets));
+        _count = 0;
+        _sum = 0;
+        _max = 0;
+    }
+
+    // Upper bound of bucket i in microseconds (0 for the overflow bucket)
+    static uint32_t upperBound(int i) { return i < BUCKET_COUNT - 1 ? 8UL << i : 0; }
+
+    static int bucketFor(uint32_t us)
+    {
+        if (us <= 8)
+        {
+            return 0;
+        }
+        int bucket = (32 - __builtin_clz(us - 1)) - 3; // ceil(log2(us)) - 3
+        return bucket < BUCKET_COUNT - 1 ? bucket : BUCKET_COUNT - 1;
+    }
+
+    // Upper bound of the bucket holding the given quantile (0-1), the
+    // maximum if it falls in the overflow bucket
+    uint32_t quantile(float q) const
+    {
+        if (_count == 0)
+        {
+            return 0;
+        }
+
+        uint32_t rank = static_cast<uint32_t>(q * (_count - 1)) + 1;
+        uint32_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT - 1; i++)
+        {
+            seen += _buckets[i];
+            if (seen >= rank)
+            {
+                return upperBound(i) < _max ? upperBound(i) : _max;
+            }
+        }
+        return _max;
+    }
+
+    uint32_t bucket(int i) const { return _buckets[i]; }
+    uint32_t count() const { return _count; }
+    uint64_t sum() const { return _sum; }
+    uint32_t max() const { return _max; }
+
+private:
+    uint32_t _buckets[BUCKET_COUNT];
+    uint32_t _count;
+    uint64_t _sum;
+    uint32_t _max;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,170 @@
+#ifndef LINE_FRAMER_H
+#define LINE_FRAMER_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "BinaryProtocol.h"
+
+/**
+ * LineFramer - Splits a byte stream into newline-terminated command lines
+ *
+ * Features:
+ * - Fixed COMMAND_BUFFER_SIZE buffer per instance, no heap allocation
+ * - Never blocks: only consumes bytes that are already available
+ * - Hands out complete lines as trimmed, NUL-terminated views
+ * - Binary frames (BinaryProtocol magic byte at the start of a frame) are
+ *   passed through untrimmed once their full length has arrived
+ * - Over-long lines are dropped and reported once
+ *
+ * Use one instance per connection. The line pointer passed to the handler is
+ * only valid for the duration of the call.
+ *
+ * Handler signature: void(const char *line, size_t length)
+ * A nullptr line means the previous line exceeded the buffer and was dropped.
+ */
+
+class LineFramer
+{
+public:
+    LineFramer() : _length(0), _frameLength(0), _overflow(false), _binary(false) {}
+
+    // Discard any partially received line
+    void reset()
+    {
+        _length = 0;
+        _frameLength = 0;
+        _overflow = false;
+        _binary = false;
+    }
+
+    // Feed raw bytes and dispatch every complete line
+    template <typename Handler>
+    void feed(const uint8_t *data, size_t len, Handler onLine)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            char c = static_cast<char>(data[i]);
+
+            if (_length == 0 && !_overflow && data[i] == BinaryProtocol::REQUEST_MAGIC)
+            {
+                _binary = true;
+            }
+
+            if (_binary)
+            {
+                feedBinary(data[i], onLine);
+                continue;
+            }
+
+            if (c == '\n')
+            {
+                if (_overflow)
+                {
+                    onLine(nullptr, 0);
+                }
+                else
+                {
+                    dispatch(onLine);
+                }
+                reset();
+                continue;
+            }
+
+            if (_overflow)
+            {
+                continue;
+            }
+
+            if (_length >= COMMAND_BUFFER_SIZE - 1)
+            {
+                // Drop the line and resynchronise on the next newline
+                _overflow = true;
+                continue;
+            }
+
+            _buffer[_length++] = c;
+        }
+    }
+
+    // Read everything currently available from a stream without waiting
+    template <typename Handler>
+    void poll(Stream &stream, Handler onLine)
+    {
+        uint8_t chunk[64];
+        int available;
+
+        while ((available = stream.available()) > 0)
+        {
+            size_t toRead = available < (int)sizeof(chunk) ? available : sizeof(chunk);
+            size_t got = stream.readBytes(chunk, toRead);
+            if (got == 0)
+            {
+                break;
+            }
+            feed(chunk, got, onLine);
+        }
+    }
+
+    // Trim whitespace from both ends of a view (the view is not modified)
+    static void trim(const char *&data, size_t &len)
+    {
+        while (len > 0 && isspace(static_cast<unsigned char>(*data)))
+        {
+            data++;
+            len--;
+        }
+        while (len > 0 && isspace(static_cast<unsigned char>(data[len - 1])))
+        {
+            len--;
+        }
+    }
+
+private:
+    template <typename Handler>
+    void feedBinary(uint8_t byte, Handler &onLine)
+    {
+        _buffer[_length++] = static_cast<char>(byte);
+
+        if (_frameLength == 0)
+        {
+            _frameLength = BinaryProtocol::frameLength(reinterpret_cast<const uint8_t *>(_buffer), _length);
+            if (_frameLength > COMMAND_BUFFER_SIZE)
+            {
+                onLine(nullptr, 0);
+                reset();
+                return;
+            }
+        }
+
+        if (_frameLength != 0 && _length >= _frameLength)
+        {
+            onLine(_buffer, _length);
+            reset();
+        }
+    }
+
+    template <typename Handler>
+    void dispatch(Handler &onLine)
+    {
+        const char *line = _buffer;
+        size_t len = _length;
+        trim(line, len);
+
+        if (len == 0)
+        {
+            return;
+        }
+
+        // Terminate in place so the view can also be used as a C string
+        _buffer[(line - _buffer) + len] = '\0';
+        onLine(line, len);
+    }
+
+    char _buffer[COMMAND_BUFFER_SIZE];
+    size_t _length;
+    size_t _frameLength; // Expected binary frame length, 0 while unknown
+    bool _overflow;
+    bool _binary;
+};
+
+#endif // LINE_FRAMER_H
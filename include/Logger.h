@@ -0,0 +1,102 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "Config.h"
+#include "MPSCQueue.h"
+
+/**
+ * Logger - Leveled logging through a lock-free ring buffer
+ *
+ * Features:
+ * - log() formats the line into a queue slot and returns; a low-priority
+ *   task writes queued lines to Serial and, if LOG_SYSLOG_HOST is set, to
+ *   a UDP syslog receiver, so callers never wait on the UART
+ * - Runtime level (LOGLEVEL command), checked before anything is formatted
+ * - Lines logged while the queue is full are dropped and reported as a count
+ * - ENABLE_SERIAL_DEBUG false compiles every LOG_* call out
+ *
+ * Safe from any task, not from ISRs. Tags must be string literals, the
+ * queue keeps only the pointer.
+ */
+
+enum class LogLevel : uint8_t
+{
+    NONE,
+    ERROR,
+    WARNING,
+    INFO,
+    DEBUG
+};
+
+class Logger
+{
+public:
+    Logger();
+
+    // Start the drain task; lines logged earlier wait in the queue
+    void begin();
+
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<uint8_t>(level) <= _level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel level) { _level.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+    LogLevel level() const { return static_cast<LogLevel>(_level.load(std::memory_order_relaxed)); }
+
+    void log(LogLevel level, const char *tag, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+    // Wait (up to timeoutMs) for queued lines to be written, e.g. before a restart
+    void flush(unsigned long timeoutMs = 200);
+
+    // Lines dropped because the queue was full
+    uint32_t dropped() const { return _queue.dropped(); }
+
+    static const char *levelName(LogLevel level);
+
+private:
+    struct Record
+    {
+        uint32_t timeMs;
+        LogLevel level;
+        const char *tag;
+        char text[LOG_LINE_LENGTH];
+    };
+
+    static void taskEntry(void *arg);
+
+    // Write every queued line, true if there was any
+    bool drain();
+
+    void write(const Record &record);
+
+    MPSCQueue<Record, LOG_QUEUE_SIZE> _queue;
+    std::atomic<uint8_t> _level;
+    std::atomic<bool> _running; // Drain task started
+    uint32_t _reportedDrops;
+};
+
+#if ENABLE_SERIAL_DEBUG
+#define LOG_AT(level, tag, ...)                    \
+    do                                             \
+    {                                              \
+        if (logger.enabled(level))                 \
+        {                                          \
+            logger.log(level, tag, __VA_ARGS__);   \
+        }                                          \
+    } while (0)
+#else
+#define LOG_AT(level, tag, ...) \
+    do                          \
+    {                           \
+    } while (0)
+#endif
+
+#define LOG_ERROR(tag, ...) LOG_AT(LogLevel::ERROR, tag, __VA_ARGS__)
+#define LOG_WARNING(tag, ...) LOG_AT(LogLevel::WARNING, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...) LOG_AT(LogLevel::INFO, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_AT(LogLevel::DEBUG, tag, __VA_ARGS__)
+
+#endif // LOGGER_H
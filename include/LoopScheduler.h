@@ -0,0 +1,119 @@
+#ifndef LOOP_SCHEDULER_H
+#define LOOP_SCHEDULER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "Config.h"
+#include "JsonWriter.h"
+
+class WatchdogManager;
+
+enum class LoopPriority : uint8_t
+{
+    COMMAND,     // Runs first, and again before every lower priority task
+    IO,          // Pins, servers and streams
+    HOUSEKEEPING // WiFi, status, LED and the like
+};
+
+/**
+ * LoopScheduler - Cooperative scheduler for the main loop task
+ *
+ * Features:
+ * - Subsystems register work with a priority, a period and a time budget
+ *   instead of being called in a fixed order
+ * - Period 0 runs on every pass; ON_TRIGGER runs only after trigger(), which
+ *   also runs a periodic task early. trigger() is safe from any task and
+ *   wakes the loop.
+ * - COMMAND tasks run again before every IO and HOUSEKEEPING task, so a
+ *   command that arrives during a pass waits for at most one task rather
+ *   than for the rest of the pass
+ * - Every run is timed; a run over its budget is an overrun, counted per
+ *   task and reported to WatchdogManager
+ * - idleTimeMs() is how long the loop may block: until the next periodic
+ *   task is due or a task's idle function says it has work, capped by the
+ *   power profile's wait, 0 once something was triggered. The wait blocks on
+ *   the loop task's notification (see CommandDispatcher::waitForWork), which
+ *   queued commands and trigger() both give.
+ *
+ * Tasks are never interrupted mid-run; one that blocks still holds up
+ * everything after it, the budget only makes that visible.
+ */
+
+class LoopScheduler
+{
+public:
+    typedef void (*TaskFunction)();
+
+    // How long a task can go without running, at most maxMs
+    typedef uint32_t (*IdleFunction)(uint32_t maxMs);
+
+    // Period of a task that only runs when triggered
+    static const uint32_t ON_TRIGGER = 0xFFFFFFFF;
+
+    explicit LoopScheduler(WatchdogManager &watchdog);
+
+    // Make the calling task the one trigger() wakes - call from setup()
+    void begin();
+
+    // Register a task; budgetUs 0 uses the priority's default budget.
+    // Returns an id for trigger(), or -1 if LOOP_MAX_TASKS are registered.
+    int add(const char *name, TaskFunction function, LoopPriority priority,
+            uint32_t periodMs = 0, uint32_t budgetUs = 0);
+
+    // Let idleTimeMs() ask a task when it next has work, for tasks whose
+    // deadlines do not follow their period (fades, timers)
+    void setIdleFunction(int id, IdleFunction idle);
+
+    // Run a task on the next pass and wake the loop
+    void trigger(int id);
+
+    // Run every due task once, in priority order
+    void runOnce();
+
+    // How long the loop may wait for the next pass, at most maxMs
+    uint32_t idleTimeMs(uint32_t maxMs) const;
+
+    // Overruns since boot, all tasks
+    uint32_t getOverruns() const { return _overruns; }
+
+    // Write each task's budget, longest run and overruns as a JSON array
+    void writeTasks(JsonWriter &json) const;
+
+private:
+    struct Task
+    {
+        const char *name;
+        TaskFunction function;
+        IdleFunction idle;      // nullptr: only the period counts
+        LoopPriority priority;
+        uint8_t id;             // Bit in _triggered
+        uint32_t periodMs;
+        uint32_t budgetUs;
+        unsigned long lastRun;  // millis() at the start of the last run
+        uint32_t maxUs;         // Longest run
+        uint32_t overruns;
+    };
+
+    // Due now, given the triggers taken for this pass
+    bool isDue(const Task &task, uint32_t triggered) const;
+
+    // Run one task, timing it against its budget
+    void run(Task &task);
+
+    // Run the due COMMAND tasks
+    void runCommands(uint32_t &triggered);
+
+    WatchdogManager &_watchdog;
+    TaskHandle_t _owner;
+
+    // Sorted by priority, then registration order
+    Task _tasks[LOOP_MAX_TASKS];
+    size_t _taskCount;
+
+    std::atomic<uint32_t> _triggered; // Bit per task id
+    uint32_t _overruns;
+};
+
+#endif // LOOP_SCHEDULER_H
@@ -0,0 +1,108 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * MPSCQueue - Lock-free multi-producer/single-consumer ring buffer
+ *
+ * Features:
+ * - Fixed capacity (power of two), no heap allocation
+ * - push() may be called from any number of tasks at once, pop() from one
+ * - Each cell carries a sequence number, so producers claim a cell with one
+ *   compare-and-swap and publish it without blocking each other
+ * - Items that do not fit are dropped and counted
+ *
+ * Not for ISRs: a producer preempted between claiming and publishing a cell
+ * holds up the consumer until it runs again.
+ */
+
+template <typename T, size_t Capacity>
+class MPSCQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "MPSCQueue capacity must be a power of two");
+
+public:
+    MPSCQueue() : _head(0), _tail(0), _dropped(0)
+    {
+        for (uint32_t i = 0; i < Capacity; i++)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer side, returns false (and counts a drop) if the queue is full
+    bool push(const T &item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = _cells[head & (Capacity - 1)];
+            uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+            int32_t diff = static_cast<int32_t>(sequence - head);
+
+            if (diff == 0)
+            {
+                // Cell is free for this lap, try to claim it
+                if (_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                {
+                    cell.item = item;
+                    cell.sequence.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Consumer has not freed this cell yet
+                _dropped++;
+                return false;
+            }
+            else
+            {
+                // Another producer claimed it first
+                head = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        Cell &cell = _cells[tail & (Capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != tail + 1)
+        {
+            return false;
+        }
+
+        item = cell.item;
+        cell.sequence.store(tail + Capacity, std::memory_order_release);
+        _tail.store(tail + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool empty() const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        return _cells[tail & (Capacity - 1)].sequence.load(std::memory_order_acquire) != tail + 1;
+    }
+
+    // Number of items dropped because the queue was full
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<uint32_t> sequence; // == index while free, index + 1 once published
+        T item;
+    };
+
+    Cell _cells[Capacity];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,83 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "esp_timer.h"
+#include "Config.h"
+#include "JsonWriter.h"
+#include "LatencyHistogram.h"
+
+/**
+ * Metrics - Latency histograms for the main loop, commands and WiFi
+ *
+ * Features:
+ * - Main loop pass time (work only, not the idle wait)
+ * - Command parse and execute time per front-end; execute time from another
+ *   task includes the wait for the main loop
+ * - WiFi time from losing the link (or boot) to having an address
+ * - Free heap, minimum free heap and largest free block
+ * - Written as Prometheus text (/api/metrics) or JSON (METRICS command)
+ *
+ * record() is safe from any task; every histogram is guarded by one
+ * spinlock that is held for a few instructions.
+ */
+
+// Front-end a command came from
+enum class CommandSource : uint8_t
+{
+    TCP,
+    UDP,
+    SERIAL_CONSOLE,
+    WEB,
+    TELEGRAM,
+    INTERNAL, // Timers, scheduled commands
+    COUNT
+};
+
+class Metrics
+{
+public:
+    enum Histogram : uint8_t
+    {
+        LOOP,
+        WIFI_CONNECT,
+        PARSE_FIRST,                                                          // Parse time, one per CommandSource
+        EXECUTE_FIRST = PARSE_FIRST + static_cast<uint8_t>(CommandSource::COUNT), // Execute time, one per CommandSource
+        HISTOGRAM_COUNT = EXECUTE_FIRST + static_cast<uint8_t>(CommandSource::COUNT)
+    };
+
+    Metrics();
+
+    // Microseconds since boot, the time base for record()
+    static int64_t now() { return esp_timer_get_time(); }
+
+    void record(Histogram histogram, int64_t durationUs);
+
+    void recordParse(CommandSource source, int64_t startUs)
+    {
+        record(static_cast<Histogram>(PARSE_FIRST + static_cast<uint8_t>(source)), now() - startUs);
+    }
+
+    void recordExecute(CommandSource source, int64_t startUs)
+    {
+        record(static_cast<Histogram>(EXECUTE_FIRST + static_cast<uint8_t>(source)), now() - startUs);
+    }
+
+    // Consistent copy of one histogram
+    LatencyHistogram get(Histogram histogram) const;
+
+    // Prometheus text exposition format
+    void writePrometheus(Print &out) const;
+
+    // "histograms" and "heap" objects into the object currently open on json
+    void writeJsonFields(JsonWriter &json) const;
+
+private:
+    static const char *sourceName(int source);
+
+    LatencyHistogram _histograms[HISTOGRAM_COUNT];
+    mutable portMUX_TYPE _lock;
+};
+
+#endif // METRICS_H
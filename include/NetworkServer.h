@@ -3,10 +3,14 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
+#include <AsyncUDP.h>
 #include "Config.h"
-#include "CommandParser.h"
+#include "CommandDispatcher.h"
 #include "PinController.h"
+#include "AsyncCommandServer.h"
+#include "LineFramer.h"
+#include "SequenceFilter.h"
+#include "SPSCQueue.h"
 
 /**
  * NetworkServer - Handles TCP and UDP servers for receiving commands
@@ -15,20 +19,44 @@
  * - TCP server for reliable command delivery
  * - UDP server for fast, connectionless commands
  * - Multiple simultaneous TCP client support
+ * - Event-driven AsyncTCP server (polled WiFiServer as fallback)
+ * - JSON, text and binary command formats on the same ports
  * - Command processing and response generation
+ * - Input change events pushed to subscribed TCP clients and UDP endpoints
+ * - UDP is received with AsyncUDP: each datagram is copied onto a queue and
+ *   the packet-ready handler wakes the main loop, which runs up to
+ *   UDP_MAX_PACKETS_PER_LOOP per pass, drops stale sequenced commands per
+ *   pin and skips the reply for fire-and-forget commands
+ * - Fleet control: joins the UDP multicast group of UDP_MULTICAST_GROUP_ID,
+ *   so one datagram drives every board in the group
+ * - UDP commands with an apply time are held until the SNTP clock reaches
+ *   it, so boards switch together
+ * - ANALOG sample blocks go to subscribed UDP endpoints as binary datagrams
+ *   (first byte 0xA7, JSON events start with '{')
  */
 
 class NetworkServer
 {
 public:
-    NetworkServer(CommandParser &parser, PinController &pinController);
+    NetworkServer(CommandDispatcher &dispatcher, PinController &pinController);
+    ~NetworkServer();
 
-    // Initialize servers
+    // Initialize servers; may be called before WiFi is connected
     void begin();
 
+    // Call each time WiFi (re)connects
+    void onNetworkUp();
+
     // Main loop - call regularly to handle clients and commands
     void loop();
 
+    // Run queued datagrams - main loop only, when the packet-ready handler
+    // has fired
+    void handleUDP();
+
+    // Called from the AsyncUDP task for every datagram queued
+    void setPacketReadyHandler(void (*handler)()) { _packetReady = handler; }
+
     // Get server status
     String getStatus();
 
@@ -36,24 +64,91 @@ public:
     int getConnectedClients();
 
 private:
-    // Handle TCP clients
+    // Handle TCP clients (polled server only)
     void handleTCPClients();
 
-    // Handle UDP packets
-    void handleUDP();
+    // Handle one complete line from a polled TCP client
+    void handleTCPLine(int slot, const char *command, size_t length);
+
+    // A received datagram, copied out of lwIP's buffer
+    struct Datagram
+    {
+        IPAddress ip;
+        uint16_t port;
+        uint16_t length;
+        bool multicast;
+        char data[COMMAND_BUFFER_SIZE];
+    };
+
+    // Copy a datagram onto the queue - AsyncUDP task
+    void queuePacket(AsyncUDPPacket &packet, bool multicast);
+
+    // Handle one queued datagram. Multicast commands never get a reply and
+    // cannot subscribe.
+    void handleUDPPacket(const Datagram &datagram);
+
+    // Send a datagram from the unicast socket
+    void sendUDP(const IPAddress &ip, uint16_t port, const void *data, size_t length);
+
+    // Take a command with an apply time. Returns false if it is already due
+    // (applyAt is cleared and it should run now); otherwise it was held, or
+    // rejected with error set.
+    bool schedule(Command &cmd, const char *&error);
 
-    // Process a command and generate response
-    String processCommand(const String &commandStr);
+    // Run held commands whose apply time has come, oldest first
+    void runScheduled();
 
-    // Generate status response
-    String generateStatusResponse();
 
-    CommandParser &_parser;
+    // Track SUBSCRIBE/UNSUBSCRIBE from a UDP endpoint
+    void updateUDPSubscriber(const IPAddress &ip, uint16_t port, int subscriber, bool subscribed);
+
+    // Push an input change to all subscribers
+    void handleInputEvent(const InputEvent &event);
+
+    // Send an analog block frame to the UDP subscribers
+    void handleAnalogBlock(const uint8_t *frame, size_t length);
+
+    // Index of a UDP subscriber, or -1
+    int findUDPSubscriber(const IPAddress &ip, uint16_t port);
+
+    struct UDPSubscriber
+    {
+        IPAddress ip;
+        uint16_t port;
+        bool active;
+    };
+
+    struct ScheduledCommand
+    {
+        Command cmd;
+        bool active;
+    };
+
+    CommandDispatcher &_dispatcher;
     PinController &_pinController;
 
+    AsyncCommandServer *_asyncServer;
     WiFiServer _tcpServer;
     WiFiClient _tcpClients[MAX_TCP_CLIENTS];
-    WiFiUDP _udp;
+    LineFramer _tcpFramers[MAX_TCP_CLIENTS];
+    bool _tcpSubscribed[MAX_TCP_CLIENTS];
+    AsyncUDP _udp;
+    UDPSubscriber _udpSubscribers[UDP_MAX_SUBSCRIBERS];
+    int _nextUDPSubscriber; // Slot replaced when the table is full
+    SequenceFilter _udpSequences;
+    AsyncUDP _multicast;
+
+    // AsyncUDP runs every socket's callbacks in its one task, so both
+    // sockets share a single-producer queue
+    SPSCQueue<Datagram, UDP_RX_QUEUE_SIZE> _datagrams;
+    void (*_packetReady)();
+
+    ScheduledCommand _scheduled[UDP_SCHEDULE_SLOTS];
+    int _inputListenerId;
+    int _analogListenerId;
+
+    // Response buffer for the polled TCP and UDP paths (main loop only)
+    char _response[RESPONSE_BUFFER_SIZE];
 
     unsigned long _lastClientCheck;
     static const unsigned long CLIENT_CHECK_INTERVAL = 1000;
@@ -0,0 +1,63 @@
+#ifndef PWM_CHANNEL_POOL_H
+#define PWM_CHANNEL_POOL_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * PWMChannelPool - Allocates ESP32 LEDC channels and timers
+ *
+ * Features:
+ * - 16 LEDC channels, freed again when a pin stops using PWM
+ * - Channels 2k and 2k+1 are driven by the same LEDC timer, so a channel is
+ *   only handed out if its timer is unused or already runs at the requested
+ *   frequency and resolution
+ * - Pins with the same frequency/resolution are packed onto shared timers
+ *   to keep timers free for other configurations
+ *
+ * The pool only tracks ownership and configures the channel; attaching the
+ * pin and writing the duty is left to the caller.
+ */
+
+class PWMChannelPool
+{
+public:
+    static const int CHANNEL_COUNT = 16;
+
+    PWMChannelPool();
+
+    // Reserve and configure a channel, returns the channel or -1
+    int acquire(uint32_t frequency, uint8_t resolution);
+
+    // Return a channel to the pool
+    void release(int channel);
+
+    // Return every channel to the pool
+    void releaseAll();
+
+    // Number of channels that could currently be acquired with this configuration
+    int available(uint32_t frequency, uint8_t resolution) const;
+
+    // True if the LEDC timer can produce this frequency at this resolution
+    static bool isSupported(uint32_t frequency, uint8_t resolution);
+
+private:
+    static const int TIMER_COUNT = CHANNEL_COUNT / 2;
+
+    struct TimerSlot
+    {
+        uint32_t frequency;
+        uint8_t resolution;
+        uint8_t users; // Channels currently using this timer (0-2)
+    };
+
+    static int timerFor(int channel) { return channel / 2; }
+
+    // True if the timer is unused or already configured this way
+    bool timerMatches(int timer, uint32_t frequency, uint8_t resolution) const;
+
+    TimerSlot _timers[TIMER_COUNT];
+    uint16_t _usedChannels; // Bit n set while channel n is allocated
+};
+
+#endif // PWM_CHANNEL_POOL_H
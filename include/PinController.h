@@ -2,18 +2,45 @@
 #define PIN_CONTROLLER_H
 
 #include <Arduino.h>
-#include <map>
 #include "Config.h"
+#include "PWMChannelPool.h"
+#include "PinStateStore.h"
+#include "SceneStore.h"
+#include "SPSCQueue.h"
+#include "TimerWheel.h"
+#include "esp_timer.h"
+#include <functional>
+#include <atomic>
+#include "JsonWriter.h"
 
 /**
  * PinController - Manages GPIO pin states and operations
  *
  * Features:
  * - Digital pin control (HIGH/LOW)
- * - PWM support for compatible pins
+ * - PWM support for compatible pins, with per-pin frequency and resolution
+ *   and LEDC channels reclaimed when a pin returns to digital
+ * - On-device PWM fades: linear fades use the LEDC hardware fade engine,
+ *   curved fades are stepped from loop()
+ * - Interrupt-driven digital inputs with debounce; edges are queued by the
+ *   GPIO ISR and reported to listeners from loop()
+ * - Digital pulses whose end edge is written by an esp_timer callback, so the
+ *   width is accurate to microseconds rather than to the main loop
+ * - Delayed and periodic pin ops on a hierarchical timer wheel (O(1) add and
+ *   cancel, TIMER_MAX_EVENTS pending), run from loop()
  * - Pin state tracking and validation
  * - Safe pin configuration
- * - State persistence support
+ * - Output states saved to NVS and restored by begin(), so outputs come
+ *   back within milliseconds of a restart. Changes are coalesced: a save
+ *   waits until pins have been quiet for PIN_STATE_SAVE_DELAY_MS, or at
+ *   most PIN_STATE_SAVE_INTERVAL while they keep changing.
+ * - Named pin groups and scenes, kept in NVS in compiled form: a group is a
+ *   pin mask, a scene a set/clear mask pair plus a PWM duty vector, so a
+ *   recall is one GPIO register write and an LEDC write per PWM pin
+ *
+ * Pin tables are flat arrays indexed by GPIO number and pin validity is a
+ * bit test against masks built from SAFE_PINS at compile time, so the
+ * command hot path does no searching and no heap allocation.
  */
 
 enum class PinMode
@@ -27,20 +54,123 @@ enum class PinMode
 struct PinState
 {
     PinMode mode;
-    int value; // Digital: 0/1, PWM: 0-255
+    int value; // Digital: 0/1, PWM: 0 to 2^pwmResolution - 1
     bool isInitialized;
 
-    PinState() : mode(PinMode::NOT_CONFIGURED), value(0), isInitialized(false) {}
+    // PWM only: LEDC configuration of the pin
+    uint32_t pwmFrequency;
+    uint8_t pwmResolution;
+
+    PinState() : mode(PinMode::NOT_CONFIGURED), value(0), isInitialized(false),
+                 pwmFrequency(0), pwmResolution(0) {}
+};
+
+// Shape of a PWM fade
+enum class FadeCurve : uint8_t
+{
+    LINEAR, // Runs on the LEDC hardware fade engine
+    EASE,   // Smoothstep ease-in/ease-out, software ramp
+    GAMMA   // Linear in perceived brightness (gamma 2.2), software ramp
+};
+
+// Input pull resistor
+enum class InputPull : uint8_t
+{
+    NONE,
+    PULLUP,
+    PULLDOWN
+};
+
+// Debounced input change
+struct InputEvent
+{
+    uint8_t pin;
+    uint8_t value;       // New level, 0/1
+    int64_t timestampUs; // Time of the edge, microseconds since boot
+};
+
+// Single pin update inside a batch
+enum class PinOpType : uint8_t
+{
+    SET,    // Digital write, value 0/1
+    PWM,    // PWM duty at the pin's current resolution
+    TOGGLE, // Invert digital state, value ignored
+    PULSE   // Timers only: invert for value ms, then restore
+};
+
+struct PinOp
+{
+    PinOpType type;
+    uint8_t pin;
+    uint16_t value;
 };
 
+namespace PinMasks
+{
+    // Bit n set for every GPIO n listed in SAFE_PINS
+    constexpr uint64_t fromSafePins(int index)
+    {
+        return index >= SAFE_PIN_COUNT ? 0 : ((1ULL << SAFE_PINS[index]) | fromSafePins(index + 1));
+    }
+
+    constexpr bool safePinsInRange(int index)
+    {
+        return index >= SAFE_PIN_COUNT ||
+               (SAFE_PINS[index] >= 0 && SAFE_PINS[index] < GPIO_PIN_COUNT && safePinsInRange(index + 1));
+    }
+
+    static_assert(safePinsInRange(0), "SAFE_PINS entries must be GPIO numbers below GPIO_PIN_COUNT");
+
+    constexpr uint64_t SAFE = fromSafePins(0);
+
+    // GPIO 34-39 are input only and cannot drive LEDC
+    constexpr uint64_t INPUT_ONLY = 0x3FULL << 34;
+
+    constexpr uint64_t PWM = SAFE & ~INPUT_ONLY;
+
+    // Bit n set for every GPIO n listed in ANALOG_PINS
+    constexpr uint64_t fromAnalogPins(int index)
+    {
+        return index >= ANALOG_PIN_COUNT ? 0 : ((1ULL << ANALOG_PINS[index]) | fromAnalogPins(index + 1));
+    }
+
+    // ADC1 is on GPIO 32-39; ADC2 is unusable while WiFi is on
+    constexpr bool analogPinsOnAdc1(int index)
+    {
+        return index >= ANALOG_PIN_COUNT ||
+               (ANALOG_PINS[index] >= 32 && ANALOG_PINS[index] <= 39 && analogPinsOnAdc1(index + 1));
+    }
+
+    static_assert(analogPinsOnAdc1(0), "ANALOG_PINS entries must be ADC1 pins (GPIO 32-39)");
+
+    constexpr uint64_t ANALOG = fromAnalogPins(0);
+
+    static_assert((ANALOG & SAFE) == 0, "ANALOG_PINS must not be in SAFE_PINS");
+}
+
 class PinController
 {
 public:
+    // Called from loop() for every debounced input change
+    typedef std::function<void(const InputEvent &event)> InputListener;
+
     PinController();
 
-    // Initialize the controller
+    // Initialize the controller and restore the saved output states
     void begin();
 
+    // Advance running software fades, report input changes and save changed
+    // outputs, call from the main loop
+    void loop();
+
+    // How long loop() can wait before the next fade step, timer or debounced
+    // input is due, at most maxMs
+    uint32_t idleTimeMs(uint32_t maxMs) const;
+
+    // Write pending output changes to NVS now, ignoring the save spacing
+    // (before a restart)
+    void flushState();
+
     // Set pin to digital HIGH (1) or LOW (0)
     bool setDigital(int pin, int value);
 
@@ -50,17 +180,65 @@ public:
     // Toggle digital pin state
     bool toggle(int pin);
 
-    // Set PWM value (0-255) on pin
-    bool setPWM(int pin, int value);
+    // Set PWM duty on pin. frequency/resolution of 0 keep the pin's current
+    // configuration (or the defaults for a pin that is not PWM yet).
+    // Duty range is 0 to 2^resolution - 1.
+    bool setPWM(int pin, int value, uint32_t frequency = 0, uint8_t resolution = 0);
 
     // Get current PWM value
     int getPWM(int pin);
 
+    // Fade the PWM duty from its current value to target over durationMs.
+    // Any later write to the pin cancels the fade.
+    bool fadePWM(int pin, int target, uint32_t durationMs, FadeCurve curve = FadeCurve::LINEAR);
+
+    // True while a fade is running on the pin
+    bool isFading(int pin) const;
+
+    // Invert the digital output for durationUs, then restore it. Starting a
+    // pulse on a pin that is already pulsing extends it. Any later write to
+    // the pin cancels the pulse.
+    bool pulse(int pin, uint32_t durationUs);
+
+    // True while a pulse runs on the pin
+    bool isPulsing(int pin) const;
+
+    // Run op (SET, PWM, TOGGLE or PULSE) after delayMs, then every intervalMs
+    // if that is non-zero. Returns the timer id, or -1 if the op is invalid,
+    // the delay is out of range or all TIMER_MAX_EVENTS timers are in use.
+    int scheduleOp(const PinOp &op, uint32_t delayMs, uint32_t intervalMs = 0);
+
+    // Cancel a timer from scheduleOp(), false if it is not pending
+    bool cancelTimer(int id);
+
+    // Cancel every pending timer
+    void cancelAllTimers();
+
+    // Number of pending timers
+    size_t getPendingTimers() const { return _timers.size(); }
+
+    // Configure pin as an interrupt-driven input. Changes that are stable
+    // for debounceMs are reported to the input listeners.
+    bool configureInput(int pin, InputPull pull = InputPull::NONE,
+                        uint16_t debounceMs = INPUT_DEFAULT_DEBOUNCE_MS);
+
+    // Register an input listener, returns its id or -1 if all slots are used
+    int addInputListener(InputListener listener);
+
+    // Remove a listener registered with addInputListener
+    void removeInputListener(int id);
+
+    // Raw edges lost because the ISR queue was full
+    uint32_t getDroppedInputEdges() const { return _inputEdges.dropped(); }
+
     // Get pin mode
     PinMode getPinMode(int pin);
 
     // Check if pin is valid for control
-    bool isValidPin(int pin);
+    static bool isValidPin(int pin)
+    {
+        return pin >= 0 && pin < GPIO_PIN_COUNT && ((PinMasks::SAFE >> pin) & 1) != 0;
+    }
 
     // Check if pin is configured
     bool isPinConfigured(int pin);
@@ -68,31 +246,239 @@ public:
     // Get all configured pins and their states
     String getAllPinStates();
 
+    // Validate every operation, then apply them all in one pass.
+    // Nothing is changed if any operation is invalid.
+    bool applyBatch(const PinOp *ops, size_t count);
+
+    // Drive every pin in setMask HIGH and every pin in clearMask LOW (bit n =
+    // GPIO n) with direct GPIO register writes. All pins must be safe pins
+    // and a pin may not be in both masks.
+    bool setDigitalMask(uint64_t setMask, uint64_t clearMask);
+
+    // Named groups and scenes are loaded by begin() and saved to NVS on every
+    // change; names match case-insensitively. define*() and saveScene()
+    // replace an entry with the same name and fail only when the table is
+    // full or the content is invalid.
+
+    // Create or replace a group of safe pins
+    bool defineGroup(const char *name, uint64_t mask);
+
+    // Drive every pin of a group: value 0/1 with one register write or, with
+    // pwm, value as the duty of each pin
+    bool applyGroup(const char *name, int value, bool pwm);
+
+    // Create or replace a scene from SET and PWM ops
+    bool defineScene(const char *name, const PinOp *ops, size_t count);
+
+    // Create or replace a scene holding the current outputs
+    bool saveScene(const char *name);
+
+    // Apply a scene: its digital outputs with one register write, then its
+    // PWM duties
+    bool recallScene(const char *name);
+
+    bool deleteGroup(const char *name);
+    bool deleteScene(const char *name);
+
+    bool hasGroup(const char *name) const { return findGroup(name) >= 0; }
+    bool hasScene(const char *name) const { return findScene(name) >= 0; }
+
+    // Write every group / scene as a JSON array value
+    void writeGroups(JsonWriter &json) const;
+    void writeScenes(JsonWriter &json) const;
+
     // Reset all pins to default state
     bool resetAllPins();
 
-    // Get state as JSON string
-    String getStateJSON();
+    // Bitmask of pins that are currently configured (bit n = GPIO n)
+    uint64_t getConfiguredPins() const;
+
+    // Write the state of every pin in mask as a JSON array value; unconfigured
+    // pins are included with mode "none"
+    void writePinStates(JsonWriter &json, uint64_t mask) const;
+
+    // Bitmask of pins whose mode or value changed since the last call, and
+    // clear it (bit n = GPIO n)
+    uint64_t takeChangedPins() { return _changedPins.exchange(0); }
 
 private:
+    // Raw edge captured by the GPIO ISR
+    struct InputEdge
+    {
+        uint8_t pin;
+        uint8_t level;
+        int64_t timestampUs;
+    };
+
+    // Per-pin debounce state (main loop only)
+    struct InputDebounce
+    {
+        uint32_t debounceUs;
+        int64_t firstEdgeUs; // First edge of the current bounce burst
+        int64_t lastEdgeUs;  // Most recent edge
+        bool pending;        // Edges seen since the last report
+    };
+
+    // ISR and timer argument, binds the controller to a pin
+    struct PinContext
+    {
+        PinController *owner;
+        uint8_t pin;
+    };
+
+    struct Fade
+    {
+        unsigned long startTime;
+        uint32_t duration;
+        int from;
+        int to;
+        FadeCurve curve;
+        bool hardware;
+    };
+
     // Configure pin for digital output
     bool configureDigitalOutput(int pin);
 
-    // Configure pin for PWM output
-    bool configurePWMOutput(int pin);
+    // Configure pin for PWM output (replaces any channel it already has)
+    bool configurePWMOutput(int pin, uint32_t frequency, uint8_t resolution);
+
+    // Detach the pin from LEDC and return its channel to the pool
+    void releasePWM(int pin);
+
+    // Resolution a PWM op on this pin will use
+    uint8_t effectiveResolution(int pin) const;
+
+    // Record a state change for takeChangedPins() and the NVS save
+    void markChanged(int pin) { markChangedMask(1ULL << pin); }
+    void markChangedMask(uint64_t mask)
+    {
+        _changedPins.fetch_or(mask);
+        _unsavedPins.fetch_or(mask);
+    }
+
+    // Apply the outputs saved in NVS
+    void restoreState();
+
+    // Save outputs once changes have settled
+    void servicePersistence();
+
+    // Fill pins with every output's settled state, returns the count
+    size_t snapshotOutputs(SavedPin *pins) const;
+
+    // Load groups and scenes from NVS, dropping pins the pin map no longer allows
+    void loadScenes();
+
+    // Index of a named group / scene, or -1
+    int findGroup(const char *name) const;
+    int findScene(const char *name) const;
+
+    // Store a compiled scene under name, false if the table is full
+    bool storeScene(const char *name, const PinScene &scene);
+
+    // Write the pins in mask as a named JSON array
+    static void writePinList(JsonWriter &json, const char *name, uint64_t mask);
+
+    // GPIO interrupt handler for configured inputs
+    static void IRAM_ATTR handleInputISR(void *arg);
+
+    // Detach the input interrupt if the pin is an input
+    void releaseInput(int pin);
+
+    // Debounce queued edges and notify listeners
+    void serviceInputs();
+
+    // Step software fades
+    void serviceFades();
+
+    // esp_timer callback that ends a pulse
+    static void handlePulseTimer(void *arg);
+
+    // Record the restored level of pulses that ended since the last call
+    void servicePulses();
+
+    // Stop a running pulse, leaving the pin where it is
+    void cancelPulse(int pin);
+
+    // Run due timer wheel ops
+    void serviceTimers();
+
+    // Apply one op from the timer wheel
+    void runTimedOp(const PinOp &op);
+
+    // Report a debounced change to every listener
+    void notifyInput(uint8_t pin, uint8_t value, int64_t timestampUs);
+
+    // Start a fade on the LEDC fade engine, false if the hardware cannot do it
+    bool startHardwareFade(int pin, int target, uint32_t durationMs);
+
+    // Stop tracking a fade (the next duty write overrides the hardware)
+    void cancelFade(int pin);
+
+    // Duty of a curved fade at elapsed/duration
+    static int fadeValueAt(const Fade &fade, uint32_t elapsed);
+
+    // Configure every pin in mask for digital output
+    void configureDigitalOutputs(uint64_t mask);
+
+    // Write W1TS/W1TC for both GPIO banks (pins must already be outputs)
+    static void writeOutputMask(uint64_t setMask, uint64_t clearMask);
 
     // Check if pin supports PWM
-    bool supportsPWM(int pin);
+    static bool supportsPWM(int pin)
+    {
+        return pin >= 0 && pin < GPIO_PIN_COUNT && ((PinMasks::PWM >> pin) & 1) != 0;
+    }
 
-    // Pin state storage
-    std::map<int, PinState> _pinStates;
+    // Pin state storage, indexed by GPIO number
+    PinState _pinStates[GPIO_PIN_COUNT];
 
     // PWM channel management (ESP32 has 16 PWM channels)
-    int _nextPWMChannel;
-    std::map<int, int> _pinToPWMChannel;
+    PWMChannelPool _pwmPool;
+    int8_t _pinToPWMChannel[GPIO_PIN_COUNT]; // -1 when no channel is attached
+
+    // Running fades, indexed by GPIO number
+    Fade _fades[GPIO_PIN_COUNT];
+    uint64_t _fadingPins; // Bit n set while a fade runs on GPIO n
+    unsigned long _lastFadeUpdate;
+    bool _fadeEngineInstalled;
+
+    // Input handling
+    SPSCQueue<InputEdge, INPUT_EVENT_QUEUE_SIZE> _inputEdges;
+    PinContext _pinContexts[GPIO_PIN_COUNT];
+    InputDebounce _inputDebounce[GPIO_PIN_COUNT];
+    uint64_t _pendingInputs; // Bit n set while GPIO n has unreported edges
+    InputListener _inputListeners[INPUT_MAX_LISTENERS];
+
+    // Pulses: one-shot timer per pin, created on first use. _pulseArmed and
+    // _pulseEnded are shared with the esp_timer task under _pulseLock.
+    esp_timer_handle_t _pulseTimers[GPIO_PIN_COUNT];
+    portMUX_TYPE _pulseLock;
+    uint64_t _pulsingPins;  // Main loop view, bit n set while GPIO n pulses
+    uint64_t _pulseRestore; // Level bit n returns to when its pulse ends
+    uint64_t _pulseArmed;   // Timer running and allowed to write the end edge
+    uint64_t _pulseEnded;   // End edge written, state not yet updated
+
+    // Delayed and periodic ops
+    TimerWheel<PinOp, TIMER_MAX_EVENTS> _timers;
+
+    // Pins changed since the last takeChangedPins(), written from any task
+    std::atomic<uint64_t> _changedPins;
+
+    // NVS persistence: changes not yet folded into a pending save
+    PinStateStore _store;
+    std::atomic<uint64_t> _unsavedPins;
+    bool _saveDue;
+    unsigned long _firstUnsaved; // First change since the last save
+    unsigned long _lastUnsaved;  // Most recent change
+    bool _saved;                 // Saved at least once since boot
+    unsigned long _lastSave;
 
-    static const int PWM_FREQUENCY = 5000;
-    static const int PWM_RESOLUTION = 8; // 8-bit (0-255)
+    // Named groups and scenes (main loop only)
+    SceneStore _sceneStore;
+    PinGroup _groups[GROUP_MAX_COUNT];
+    size_t _groupCount;
+    PinScene _scenes[SCENE_MAX_COUNT];
+    size_t _sceneCount;
 };
 
 #endif // PIN_CONTROLLER_H
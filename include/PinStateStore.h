@@ -0,0 +1,55 @@
+#ifndef PIN_STATE_STORE_H
+#define PIN_STATE_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "Config.h"
+
+/**
+ * PinStateStore - Keeps the output pin states in NVS across restarts
+ *
+ * Features:
+ * - All outputs are stored as one versioned blob, so a save is a single
+ *   NVS write however many pins changed
+ * - A save whose contents match the last stored blob is skipped, sparing
+ *   flash when pins return to a state that is already saved
+ *
+ * When to save (coalescing) is up to the caller; see PinController.
+ */
+
+// One saved output pin
+struct SavedPin
+{
+    uint8_t pin;
+    uint8_t pwm; // 0 = digital output, 1 = PWM output
+    uint8_t resolution;
+    uint8_t reserved;
+    uint16_t value;
+    uint16_t reserved2;
+    uint32_t frequency;
+};
+
+class PinStateStore
+{
+public:
+    PinStateStore();
+
+    // Read the saved pins into pins (at most maxCount), returns how many
+    size_t load(SavedPin *pins, size_t maxCount);
+
+    // Store pins, unless they match what is already stored. Returns false
+    // if the NVS write failed.
+    bool save(const SavedPin *pins, size_t count);
+
+    // Number of NVS writes since boot
+    uint32_t getWriteCount() const { return _writes; }
+
+private:
+    static uint32_t checksum(const SavedPin *pins, size_t count);
+
+    uint32_t _storedChecksum;
+    bool _storedKnown; // _storedChecksum reflects NVS
+    uint32_t _writes;
+};
+
+#endif // PIN_STATE_STORE_H
@@ -0,0 +1,63 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+class WiFiManager;
+
+enum class PowerProfile : uint8_t
+{
+    LOW_LATENCY, // Radio always on, fastest CPU, shortest loop wait
+    BALANCED,    // Modem sleep between DTIM beacons
+    LOW_POWER    // Deepest modem sleep, slowest CPU, longest loop wait
+};
+
+static const size_t POWER_PROFILE_COUNT = static_cast<size_t>(PowerProfile::LOW_POWER) + 1;
+
+/**
+ * PowerManager - Latency/power profiles (PROFILE command)
+ *
+ * Features:
+ * - Each profile sets WiFi modem sleep, listen interval and TX power, the
+ *   CPU frequency and the main loop's idle wait:
+ *
+ *   profile       sleep   listen  TX        CPU      loop wait
+ *   low-latency   none    1       19.5 dBm  240 MHz  1 ms
+ *   balanced      min     3       19.5 dBm  160 MHz  10 ms
+ *   low-power     max     10      15 dBm    80 MHz   50 ms
+ *
+ * - The profile is kept in NVS, so one firmware image serves battery and
+ *   real-time units; POWER_PROFILE_DEFAULT applies until one is set
+ *
+ * Modem sleep adds up to a beacon interval (~100 ms, times the listen
+ * interval with max sleep) to incoming packets; the loop wait bounds how
+ * late polled UDP, software fades and timers run.
+ */
+
+class PowerManager
+{
+public:
+    explicit PowerManager(WiFiManager &wifi);
+
+    // Load the saved profile and apply it; call before WiFiManager::begin()
+    void begin();
+
+    // Apply a profile and save it
+    void setProfile(PowerProfile profile);
+
+    PowerProfile getProfile() const { return _profile; }
+
+    // Longest wait for work at the end of a main loop pass (milliseconds)
+    uint32_t getLoopIdleMs() const;
+
+    static const char *profileName(PowerProfile profile);
+
+private:
+    void apply();
+
+    WiFiManager &_wifi;
+    PowerProfile _profile;
+};
+
+#endif // POWER_MANAGER_H
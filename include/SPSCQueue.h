@@ -0,0 +1,71 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * SPSCQueue - Lock-free single-producer/single-consumer ring buffer
+ *
+ * Features:
+ * - Fixed capacity (power of two), no heap allocation
+ * - push() is safe to call from an ISR, pop() from one task
+ * - Items that do not fit are dropped and counted
+ *
+ * Exactly one context may push and exactly one context may pop.
+ */
+
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SPSCQueue capacity must be a power of two");
+
+public:
+    SPSCQueue() : _head(0), _tail(0), _dropped(0) {}
+
+    // Producer side, returns false (and counts a drop) if the queue is full
+    inline bool push(const T &item)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity)
+        {
+            _dropped++;
+            return false;
+        }
+
+        _items[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    inline bool pop(T &item)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+    }
+
+    // Number of items dropped because the queue was full
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    T _items[Capacity];
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    volatile uint32_t _dropped;
+};
+
+#endif // SPSC_QUEUE_H
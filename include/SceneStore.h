@@ -0,0 +1,64 @@
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * SceneStore - Keeps named pin groups and scenes in NVS
+ *
+ * Features:
+ * - Groups and scenes are stored in their compiled form (masks and PWM
+ *   vectors), one versioned blob each, so recalling never parses anything
+ * - Only the entries in use are written
+ *
+ * Validation against the current pin map is up to the caller; see
+ * PinController.
+ */
+
+// A named set of pins, switched together by GROUP
+struct PinGroup
+{
+    char name[SCENE_NAME_LENGTH];
+    uint64_t mask; // Bit n = GPIO n
+};
+
+// One PWM output of a scene. Frequency and resolution 0 keep the pin's
+// current configuration.
+struct ScenePWM
+{
+    uint8_t pin;
+    uint8_t resolution;
+    uint16_t duty;
+    uint32_t frequency;
+};
+
+// A named output state: digital outputs as one set/clear mask pair, PWM
+// outputs as a vector of duties
+struct PinScene
+{
+    char name[SCENE_NAME_LENGTH];
+    uint64_t setMask;
+    uint64_t clearMask;
+    uint8_t pwmCount;
+    uint8_t reserved[7];
+    ScenePWM pwm[SCENE_MAX_PWM_PINS];
+};
+
+class SceneStore
+{
+public:
+    // Read the saved entries (at most maxCount), returns how many
+    size_t loadGroups(PinGroup *groups, size_t maxCount);
+    size_t loadScenes(PinScene *scenes, size_t maxCount);
+
+    // Replace the saved entries, returns false if the NVS write failed
+    bool saveGroups(const PinGroup *groups, size_t count);
+    bool saveScenes(const PinScene *scenes, size_t count);
+
+private:
+    static size_t load(const char *key, void *data, size_t entrySize, size_t maxCount);
+    static bool save(const char *key, const void *data, size_t entrySize, size_t count);
+};
+
+#endif // SCENE_STORE_H
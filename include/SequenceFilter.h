@@ -0,0 +1,177 @@
+#ifndef SEQUENCE_FILTER_H
+#define SEQUENCE_FILTER_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "CommandParser.h"
+
+/**
+ * SequenceFilter - Last-writer-wins ordering of sequenced UDP commands
+ *
+ * Features:
+ * - Remembers the newest sequence number applied to each pin
+ * - Commands for a pin that are not newer (reordered or duplicated datagrams)
+ *   are dropped; SETMASK and BATCH keep only their pins that are still fresh
+ * - 16-bit sequence numbers compared with wraparound
+ * - A pin that has seen no sequenced command for UDP_SEQUENCE_RESET_MS
+ *   accepts any sequence number, so restarted senders are not locked out
+ *
+ * Only commands that change a pin are filtered; GET, STATUS and the like
+ * always pass. Main loop only.
+ */
+
+class SequenceFilter
+{
+public:
+    SequenceFilter()
+    {
+        memset(_pins, 0, sizeof(_pins));
+    }
+
+    // Drop the stale parts of a sequenced command. Returns false if nothing
+    // is left to run. Nothing is recorded until commit().
+    bool check(Command &cmd, unsigned long now) const
+    {
+        switch (cmd.type)
+        {
+        case CommandType::SET:
+        case CommandType::TOGGLE:
+        case CommandType::PWM:
+        case CommandType::FADE:
+        case CommandType::SET_INPUT:
+        case CommandType::PULSE:
+            return isFresh(cmd.pin, cmd.sequence, now);
+
+        case CommandType::SETMASK:
+        {
+            uint64_t pins = cmd.setMask | cmd.clearMask;
+            while (pins != 0)
+            {
+                int pin = __builtin_ctzll(pins);
+                pins &= pins - 1;
+                if (!isFresh(pin, cmd.sequence, now))
+                {
+                    cmd.setMask &= ~(1ULL << pin);
+                    cmd.clearMask &= ~(1ULL << pin);
+                }
+            }
+            return (cmd.setMask | cmd.clearMask) != 0;
+        }
+
+        case CommandType::BATCH:
+        {
+            // Per distinct pin, so several ops on one pin all pass or all go
+            uint64_t fresh = 0;
+            for (uint8_t i = 0; i < cmd.batchCount; i++)
+            {
+                if (isFresh(cmd.batch[i].pin, cmd.sequence, now))
+                {
+                    fresh |= pinBit(cmd.batch[i].pin);
+                }
+            }
+
+            uint8_t kept = 0;
+            for (uint8_t i = 0; i < cmd.batchCount; i++)
+            {
+                if (fresh & pinBit(cmd.batch[i].pin))
+                {
+                    cmd.batch[kept++] = cmd.batch[i];
+                }
+            }
+            cmd.batchCount = kept;
+            return kept > 0;
+        }
+
+        default:
+            return true;
+        }
+    }
+
+    // Record a checked command's sequence number for the pins it still
+    // touches. Call once it has been run or queued, so a command that
+    // failed before that does not make a retry look like a duplicate.
+    void commit(const Command &cmd, unsigned long now)
+    {
+        uint64_t pins = 0;
+        switch (cmd.type)
+        {
+        case CommandType::SET:
+        case CommandType::TOGGLE:
+        case CommandType::PWM:
+        case CommandType::FADE:
+        case CommandType::SET_INPUT:
+        case CommandType::PULSE:
+            pins = pinBit(cmd.pin);
+            break;
+
+        case CommandType::SETMASK:
+            pins = cmd.setMask | cmd.clearMask;
+            break;
+
+        case CommandType::BATCH:
+            for (uint8_t i = 0; i < cmd.batchCount; i++)
+            {
+                pins |= pinBit(cmd.batch[i].pin);
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        while (pins != 0)
+        {
+            int pin = __builtin_ctzll(pins);
+            pins &= pins - 1;
+            markApplied(pin, cmd.sequence, now);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        uint16_t sequence;
+        bool valid;
+        unsigned long appliedAt;
+    };
+
+    static bool tracked(int pin)
+    {
+        return pin >= 0 && pin < GPIO_PIN_COUNT;
+    }
+
+    // Bit for a tracked pin; untracked pins share bit 63, which is never a GPIO
+    static uint64_t pinBit(int pin)
+    {
+        return tracked(pin) ? 1ULL << pin : 1ULL << 63;
+    }
+
+    bool isFresh(int pin, uint16_t sequence, unsigned long now) const
+    {
+        if (!tracked(pin))
+        {
+            return true;
+        }
+
+        const Entry &entry = _pins[pin];
+        bool expired = now - entry.appliedAt >= UDP_SEQUENCE_RESET_MS;
+        return !entry.valid || expired || static_cast<int16_t>(sequence - entry.sequence) > 0;
+    }
+
+    void markApplied(int pin, uint16_t sequence, unsigned long now)
+    {
+        if (!tracked(pin))
+        {
+            return;
+        }
+
+        Entry &entry = _pins[pin];
+        entry.sequence = sequence;
+        entry.valid = true;
+        entry.appliedAt = now;
+    }
+
+    Entry _pins[GPIO_PIN_COUNT];
+};
+
+#endif // SEQUENCE_FILTER_H
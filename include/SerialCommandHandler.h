@@ -8,15 +8,16 @@
 #define SERIAL_COMMAND_HANDLER_H
 
 #include <Arduino.h>
-#include "CommandParser.h"
+#include "CommandDispatcher.h"
 #include "PinController.h"
 #include "WiFiManager.h"
 #include "WatchdogManager.h"
+#include "LineFramer.h"
 
 class SerialCommandHandler
 {
 public:
-    SerialCommandHandler(CommandParser &parser,
+    SerialCommandHandler(CommandDispatcher &dispatcher,
                          PinController &pinCtrl,
                          WiFiManager &wifiMgr,
                          WatchdogManager &wdMgr);
@@ -24,19 +25,23 @@ public:
     // Process available serial commands
     void processSerialCommands();
 
-    // Set restart callback (called when RESET command is received)
-    void setRestartCallback(void (*callback)(unsigned long delayMs));
-
 private:
-    CommandParser &_commandParser;
+    CommandDispatcher &_dispatcher;
     PinController &_pinController;
     WiFiManager &_wifiManager;
     WatchdogManager &_watchdogManager;
 
-    void (*_restartCallback)(unsigned long) = nullptr;
+    // Print input events after SUBSCRIBE
+    bool _subscribed = false;
+
+    // Buffers partial lines between calls
+    LineFramer _framer;
+
+    // Parse and execute one complete line
+    void processLine(const char *command, size_t length);
 
-    // Execute a parsed command
-    void executeCommand(const Command &cmd);
+    // Print the human-readable STATUS report
+    void printStatus();
 };
 
 #endif // SERIAL_COMMAND_HANDLER_H
@@ -0,0 +1,44 @@
+#ifndef SERVICE_ADVERTISER_H
+#define SERVICE_ADVERTISER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * ServiceAdvertiser - mDNS hostname and DNS-SD service records
+ *
+ * Features:
+ * - Answers DEVICE_HOSTNAME.local
+ * - _esp32ctl._tcp (TCP_SERVER_PORT), _esp32ctl._udp (UDP_SERVER_PORT) and
+ *   _http._tcp (WEB_SERVER_PORT), so one PTR query for _esp32ctl._tcp finds
+ *   every board on the link
+ * - Instance names carry the last three MAC bytes, so boards sharing a
+ *   hostname still show up as separate instances
+ * - TXT metadata: firmware version, pin map version, the other ports and
+ *   the multicast group, enough to pick a board without a STATUS round trip
+ *
+ * The responder follows later reconnects by itself; begin() only has to run
+ * once, after the first address.
+ */
+
+class ServiceAdvertiser
+{
+public:
+    ServiceAdvertiser();
+
+    // Start the responder and register the services; repeated calls do nothing
+    void begin();
+
+    bool isRunning() const { return _running; }
+
+    // FNV-1a hash of SAFE_PINS, changes whenever the pin map does
+    static uint32_t pinMapVersion();
+
+private:
+    // TXT records shared by the _esp32ctl services
+    void addControlTxt(const char *proto);
+
+    bool _running;
+};
+
+#endif // SERVICE_ADVERTISER_H
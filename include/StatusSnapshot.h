@@ -0,0 +1,73 @@
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+#include "JsonWriter.h"
+
+class WiFiManager;
+class WatchdogManager;
+
+/**
+ * StatusSnapshot - System status captured once per interval for all front-ends
+ *
+ * Features:
+ * - Refreshed from the main loop every STATUS_SNAPSHOT_INTERVAL_MS
+ * - Fixed-size fields, refreshing does not allocate in the steady state
+ *   (SSID and last error are only re-read when they can have changed)
+ * - Safe to read from any task (AsyncTCP callbacks, main loop)
+ * - Writes the shared "system", "wifi" and "watchdog" JSON objects
+ */
+
+class StatusSnapshot
+{
+public:
+    struct Data
+    {
+        unsigned long uptime; // Seconds
+        uint32_t freeHeap;
+        uint32_t minFreeHeap;
+        uint32_t maxAllocHeap;
+        const char *chipModel;
+        uint8_t chipCores;
+        uint32_t cpuFreq; // MHz
+
+        bool wifiConnected;
+        char ssid[33];
+        char ip[16];
+        int rssi;
+
+        int errorCount;
+        char lastError[64];
+
+        int tcpClients;
+    };
+
+    StatusSnapshot();
+    ~StatusSnapshot();
+
+    // Refresh if the interval has elapsed (or force is set) - main loop only
+    void update(WiFiManager &wifi, WatchdogManager &watchdog, int tcpClients, bool force = false);
+
+    // Consistent copy of the latest snapshot
+    Data get() const;
+
+    // Write "system", "wifi" and "watchdog" as keyed objects into the
+    // object currently open on json
+    static void writeSystem(JsonWriter &json, const Data &data);
+    static void writeWiFi(JsonWriter &json, const Data &data);
+    static void writeWatchdog(JsonWriter &json, const Data &data);
+
+private:
+    Data _data;
+    uint32_t _cachedIP; // IP the SSID was read for
+    unsigned long _lastUpdate;
+    bool _valid;
+
+    // Guards _data against readers in other tasks
+    SemaphoreHandle_t _lock;
+};
+
+#endif // STATUS_SNAPSHOT_H
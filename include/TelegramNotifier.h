@@ -4,37 +4,45 @@
 #include <Arduino.h>
 #include <WiFiClientSecure.h>
 #include <UniversalTelegramBot.h>
+#include <atomic>
 #include "Config.h"
-
-// Forward declaration
-class WatchdogManager;
+#include "CommandDispatcher.h"
 
 /**
  * TelegramNotifier - Handles Telegram notifications
  *
  * Features:
  * - Send IP address notifications when ESP32 connects to WiFi
- * - Receive and respond to Telegram commands
+ * - Receive and respond to Telegram commands; any other text from the
+ *   configured chat runs as a pin command through the CommandDispatcher
  * - Automatic notification on WiFi connection
+ *
+ * - Long polling (getUpdates with TELEGRAM_LONG_POLL_SEC) over its own
+ *   kept-alive TLS connection, so chat commands are answered at once and a
+ *   handshake is only needed when the connection drops
+ * - Notifications go out over a second kept-alive connection, so they never
+ *   wait for an open long poll
+ * - Text notifications queued within TELEGRAM_COALESCE_MS are joined into
+ *   one message
+ *
+ * All Telegram traffic runs in two FreeRTOS tasks pinned to
+ * TELEGRAM_TASK_CORE: the worker drains the outbound queue, the poll task
+ * reads chat messages and replies to them. Public methods only post to the
+ * outbound queue and never block, so they are safe to call from the main
+ * loop.
  */
 class TelegramNotifier
 {
 public:
     TelegramNotifier();
 
-    // Initialize Telegram notifier with watchdog
-    void begin(WatchdogManager *wdt = nullptr);
+    // Initialize Telegram notifier and start the worker task
+    void begin();
 
-    // Main loop - call regularly to check for messages
-    void loop();
-
-    // Queue IP address notification to be sent in loop (non-blocking)
+    // Queue IP address notification (non-blocking)
     void queueIPNotification(const String &ipAddress, const String &ssid);
 
-    // Send IP address notification (blocking - only use if watchdog is fed externally)
-    void sendIPAddress(const String &ipAddress, const String &ssid);
-
-    // Send a custom message
+    // Queue a custom message (non-blocking, dropped if the queue is full)
     void sendMessage(const String &message);
 
     // Check if notification was already sent for current connection
@@ -46,25 +54,88 @@ public:
     // Reset notification flag (for new connections)
     void resetNotificationFlag();
 
+    // Run pin commands received from the chat (call before begin())
+    void setCommandDispatcher(CommandDispatcher *dispatcher);
+
 private:
+    // Outbound work items, processed in order by the worker task
+    enum class OutboundType : uint8_t
+    {
+        IP_NOTIFICATION,
+        TEXT,
+        RESET_NOTIFICATION
+    };
+
+    struct OutboundMessage
+    {
+        OutboundType type;
+        char ip[16];
+        char ssid[33];
+        char text[TELEGRAM_MAX_MESSAGE_LENGTH];
+    };
+
+    // Notifications (worker task only)
     WiFiClientSecure client;
     UniversalTelegramBot *bot;
-    WatchdogManager *watchdog;
+
+    // getUpdates and chat replies (poll task only)
+    WiFiClientSecure pollClient;
+    UniversalTelegramBot *pollBot;
+
+    QueueHandle_t outboundQueue;
+    TaskHandle_t taskHandle;
+    TaskHandle_t pollTaskHandle;
     unsigned long lastMessageCheck;
-    bool connectionNotified;
+    volatile bool connectionNotified;
     String lastNotifiedIP;
+    CommandDispatcher *commandDispatcher;
+
+    // Command responses are built here (poll task only)
+    char responseBuffer[RESPONSE_BUFFER_SIZE];
+
+    // Text notifications waiting to be sent together (worker task only)
+    static const size_t BATCH_LENGTH = 2048;
+    char batch[BATCH_LENGTH];
+    size_t batchLength;
+    unsigned long batchStarted;
 
-    // Deferred notification support
-    bool pendingNotification;
-    String pendingIP;
-    String pendingSSID;
-    unsigned long notificationQueuedTime;
+    // TLS connections opened since boot, on both connections
+    std::atomic<uint32_t> handshakes;
+
+    // Worker task entry point and body
+    static void taskEntry(void *param);
+    void run();
+
+    // Poll task entry point and body
+    static void pollTaskEntry(void *param);
+    void runPoll();
+
+    // Post an item to the outbound queue without blocking
+    bool enqueue(const OutboundMessage &msg);
+
+    // Process one outbound item (worker task only)
+    void handleOutbound(const OutboundMessage &msg);
+
+    // Add a text notification to the batch, sending the batch first if full
+    void addToBatch(const char *text);
+
+    // Send the batched notifications as one message
+    void flushBatch();
+
+    // Poll Telegram for new messages (poll task only)
+    void pollUpdates();
+
+    // Count the TLS handshake the next request on connection will need, if any
+    void noteConnection(WiFiClientSecure &connection);
+
+    // Send IP address notification (blocking, worker task only)
+    void sendIPAddress(const String &ipAddress, const String &ssid);
 
-    // Handle incoming messages
+    // Handle incoming messages (poll task only)
     void handleNewMessages(int numNewMessages);
 
-    // Send the pending notification
-    void sendPendingNotification();
+    // Run a chat message as a command and reply with the response
+    void runCommand(const String &chatId, const char *text, size_t length);
 };
 
 #endif // TELEGRAM_NOTIFIER_H
@@ -0,0 +1,288 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <Arduino.h>
+
+/**
+ * TimerWheel - Hierarchical timing wheel for one-shot and periodic timers
+ *
+ * Features:
+ * - Fixed pool of Capacity timers, no heap allocation
+ * - O(1) add and cancel; advancing costs O(1) per tick plus the timers that
+ *   fire or cascade
+ * - 1 ms ticks; four levels (256 + 3 x 64 slots) cover delays up to
+ *   MAX_DELAY (about 18 hours)
+ * - Timer ids carry a generation, so a stale id never cancels a reused slot
+ *
+ * Single task only. The fire callback must not add or cancel timers.
+ */
+
+template <typename T, size_t Capacity>
+class TimerWheel
+{
+    static_assert(Capacity > 0 && Capacity <= 32767, "TimerWheel capacity must be 1-32767");
+
+public:
+    // Longest accepted delay or interval (ms); leaves room for advance() to lag
+    static const uint32_t MAX_DELAY = (1UL << 26) - (1UL << 20);
+
+    TimerWheel() : _now(0), _size(0)
+    {
+        for (size_t i = 0; i < SLOT_COUNT; i++)
+        {
+            _heads[i] = -1;
+        }
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            _nodes[i].slot = -1;
+            _nodes[i].generation = 1;
+            _nodes[i].next = i + 1 < Capacity ? static_cast<int16_t>(i + 1) : -1;
+        }
+        _free = 0;
+    }
+
+    // Fire payload delayMs after now, then every intervalMs if non-zero.
+    // Returns the timer id (> 0), or -1 if the delay is out of range or no
+    // timer is free.
+    int add(uint32_t now, uint32_t delayMs, uint32_t intervalMs, const T &payload)
+    {
+        if (delayMs > MAX_DELAY || intervalMs > MAX_DELAY || _free < 0)
+        {
+            return -1;
+        }
+
+        if (_size == 0)
+        {
+            _now = now;
+        }
+
+        int16_t index = _free;
+        Node &node = _nodes[index];
+        _free = node.next;
+
+        // Never schedule into a tick that has already been processed
+        uint32_t expires = now + delayMs;
+        node.expires = static_cast<int32_t>(expires - _now) < 0 ? _now : expires;
+        node.interval = intervalMs;
+        node.payload = payload;
+        link(index);
+        _size++;
+
+        return (static_cast<int>(node.generation) << 16) | index;
+    }
+
+    // Cancel a pending timer, false if the id is not (or no longer) pending
+    bool cancel(int id)
+    {
+        if (id <= 0)
+        {
+            return false;
+        }
+
+        size_t index = id & 0xFFFF;
+        if (index >= Capacity || _nodes[index].slot < 0 || _nodes[index].generation != (id >> 16))
+        {
+            return false;
+        }
+
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            if (_nodes[i].slot >= 0)
+            {
+                unlink(i);
+                release(i);
+            }
+        }
+    }
+
+    // Process every tick up to and including now, calling fire(payload) for
+    // each timer that expires
+    template <typename Fire>
+    void advance(uint32_t now, Fire fire)
+    {
+        if (_size == 0)
+        {
+            _now = now + 1;
+            return;
+        }
+
+        while (static_cast<int32_t>(now - _now) >= 0)
+        {
+            uint32_t tick = _now;
+
+            // Pull the next span of each higher level down as its turn comes
+            if ((tick & LEVEL0_MASK) == 0)
+            {
+                cascade(LEVEL1 + ((tick >> 8) & LEVELN_MASK));
+                if (((tick >> 8) & LEVELN_MASK) == 0)
+                {
+                    cascade(LEVEL2 + ((tick >> 14) & LEVELN_MASK));
+                    if (((tick >> 14) & LEVELN_MASK) == 0)
+                    {
+                        cascade(LEVEL3 + ((tick >> 20) & LEVELN_MASK));
+                    }
+                }
+            }
+
+            int16_t index = _heads[tick & LEVEL0_MASK];
+            _heads[tick & LEVEL0_MASK] = -1;
+            while (index >= 0)
+            {
+                Node &node = _nodes[index];
+                int16_t next = node.next;
+                T payload = node.payload;
+
+                node.slot = -1;
+                if (node.interval != 0)
+                {
+                    node.expires = tick + node.interval;
+                    link(index);
+                }
+                else
+                {
+                    release(index);
+                }
+
+                fire(payload);
+                index = next;
+            }
+
+            _now++;
+        }
+    }
+
+    // Number of pending timers
+    size_t size() const { return _size; }
+
+    // Earliest tick a pending timer fires on, false if none is pending.
+    // Scans every node, so call it once per idle wait rather than per tick.
+    bool nextExpiry(uint32_t &tick) const
+    {
+        if (_size == 0)
+        {
+            return false;
+        }
+
+        uint32_t soonest = 0xFFFFFFFF;
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            const Node &node = _nodes[i];
+            if (node.slot >= 0 && node.expires - _now < soonest)
+            {
+                soonest = node.expires - _now;
+            }
+        }
+        tick = _now + soonest;
+        return true;
+    }
+
+private:
+    static const size_t LEVEL0_SLOTS = 256;
+    static const size_t LEVELN_SLOTS = 64;
+    static const uint32_t LEVEL0_MASK = LEVEL0_SLOTS - 1;
+    static const uint32_t LEVELN_MASK = LEVELN_SLOTS - 1;
+    static const size_t LEVEL1 = LEVEL0_SLOTS;
+    static const size_t LEVEL2 = LEVEL1 + LEVELN_SLOTS;
+    static const size_t LEVEL3 = LEVEL2 + LEVELN_SLOTS;
+    static const size_t SLOT_COUNT = LEVEL3 + LEVELN_SLOTS;
+
+    struct Node
+    {
+        uint32_t expires; // Tick the timer fires on
+        uint32_t interval;
+        T payload;
+        int16_t next; // Slot list, or free list while unused
+        int16_t prev;
+        int16_t slot; // -1 while not pending
+        uint16_t generation;
+    };
+
+    // Put a node in the slot for its expiry, relative to the current tick
+    void link(int16_t index)
+    {
+        Node &node = _nodes[index];
+        uint32_t delta = node.expires - _now;
+
+        int16_t slot;
+        if (delta < (1UL << 8))
+        {
+            slot = node.expires & LEVEL0_MASK;
+        }
+        else if (delta < (1UL << 14))
+        {
+            slot = LEVEL1 + ((node.expires >> 8) & LEVELN_MASK);
+        }
+        else if (delta < (1UL << 20))
+        {
+            slot = LEVEL2 + ((node.expires >> 14) & LEVELN_MASK);
+        }
+        else
+        {
+            slot = LEVEL3 + ((node.expires >> 20) & LEVELN_MASK);
+        }
+
+        node.slot = slot;
+        node.prev = -1;
+        node.next = _heads[slot];
+        if (node.next >= 0)
+        {
+            _nodes[node.next].prev = index;
+        }
+        _heads[slot] = index;
+    }
+
+    void unlink(int16_t index)
+    {
+        Node &node = _nodes[index];
+        if (node.prev >= 0)
+        {
+            _nodes[node.prev].next = node.next;
+        }
+        else
+        {
+            _heads[node.slot] = node.next;
+        }
+        if (node.next >= 0)
+        {
+            _nodes[node.next].prev = node.prev;
+        }
+        node.slot = -1;
+    }
+
+    void release(int16_t index)
+    {
+        Node &node = _nodes[index];
+        node.generation = node.generation >= 0x7FFF ? 1 : node.generation + 1;
+        node.next = _free;
+        _free = index;
+        _size--;
+    }
+
+    // Re-link every node of a higher-level slot, now that it is close
+    void cascade(size_t slot)
+    {
+        int16_t index = _heads[slot];
+        _heads[slot] = -1;
+        while (index >= 0)
+        {
+            int16_t next = _nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    Node _nodes[Capacity];
+    int16_t _heads[SLOT_COUNT];
+    int16_t _free;
+    uint32_t _now; // Next tick to process
+    size_t _size;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,35 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+/**
+ * WallClock - SNTP-synchronized Unix time in milliseconds
+ *
+ * Used by scheduled UDP commands and AT timers, which name an absolute
+ * apply time. Before SNTP has set the clock the time is reported as
+ * unavailable rather than as a date in 1970.
+ */
+
+namespace WallClock
+{
+    // Earliest time accepted as SNTP-synchronized (2021-01-01)
+    static const time_t VALID_AFTER = 1609459200;
+
+    // Current Unix time in ms, false if the clock is not synchronized yet
+    inline bool nowMs(uint64_t &nowMs)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        if (tv.tv_sec < VALID_AFTER)
+        {
+            return false;
+        }
+
+        nowMs = static_cast<uint64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+        return true;
+    }
+}
+
+#endif // WALL_CLOCK_H
@@ -38,6 +38,14 @@ public:
     // Check if system should restart
     bool shouldRestart();
 
+    // A main loop task ran past its time budget. Counted and logged (at most
+    // every LOOP_OVERRUN_LOG_INTERVAL_MS), not an error: the hardware
+    // watchdog still catches a task that never returns.
+    void reportOverrun(const char *task, uint32_t elapsedUs, uint32_t budgetUs);
+
+    // Budget overruns since boot
+    uint32_t getOverrunCount() const { return _overrunCount; }
+
     // Perform system restart
     void restart(const String &reason);
 
@@ -64,6 +72,10 @@ private:
     String _lastError;
     unsigned long _lastErrorTime;
 
+    uint32_t _overrunCount;
+    uint32_t _loggedOverruns; // _overrunCount at the last overrun warning
+    unsigned long _lastOverrunLog;
+
     bool _hwWatchdogEnabled;
     bool _taskWatchdogEnabled;
 
@@ -3,28 +3,49 @@
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "PinController.h"
+#include "CommandDispatcher.h"
+#include "StatusSnapshot.h"
+#include "JsonWriter.h"
+#include "SPSCQueue.h"
 #include "Config.h"
 
 /**
  * WebServer - Provides HTTP web interface for ESP32 control
  *
  * Features:
- * - Modern responsive web UI
- * - RESTful API endpoints
+ * - Modern responsive web UI, served gzip-compressed from flash with ETag
+ *   revalidation (generated from web/index.html by scripts/embed_web.py)
+ * - RESTful API endpoints, executed through the shared CommandDispatcher
  * - Real-time pin control
  * - System status monitoring
+ * - Input changes pushed to the browser over Server-Sent Events (/events)
+ * - WebSocket channel (/ws) streaming pin state deltas and accepting the
+ *   same JSON, text and binary commands as the TCP server
+ * - Binary WebSocket (/analog) carrying ANALOG sample block frames, kept
+ *   apart so /ws stays JSON only
  * - Works on desktop and mobile
+ *
+ * Route and WebSocket callbacks run in the AsyncTCP task, pushes in the main
+ * loop. The library adds and frees /ws, /analog and /events clients in the
+ * AsyncTCP task, so every push from loop() holds _clientsLock, and so does
+ * each client's disconnect handler while it unlinks and frees the client.
  */
 
 class WebServer
 {
 public:
-    WebServer(PinController &pinController, uint16_t port = 80);
+    WebServer(PinController &pinController, CommandDispatcher &dispatcher, uint16_t port = 80);
+    ~WebServer();
 
     // Initialize and start the web server
     void begin();
 
+    // Push pin changes and status to WebSocket clients - call regularly
+    void loop();
+
     // Check if server is running
     bool isRunning() const { return _running; }
 
@@ -42,19 +63,72 @@ private:
     void handleGetPin(AsyncWebServerRequest *request);
     void handleTogglePin(AsyncWebServerRequest *request);
     void handleSetPWM(AsyncWebServerRequest *request);
+    void handleSetInput(AsyncWebServerRequest *request);
     void handleGetStatus(AsyncWebServerRequest *request);
+    void handleMetrics(AsyncWebServerRequest *request);
     void handleResetPins(AsyncWebServerRequest *request);
     void handleNotFound(AsyncWebServerRequest *request);
 
     // Helper functions
-    String getHTMLPage();
-    String generatePinControlsHTML();
-    void sendJSONResponse(AsyncWebServerRequest *request, int code, bool success, const String &message, const String &data = "");
+    void sendJSONResponse(AsyncWebServerRequest *request, int code, bool success, const char *message, const char *data = nullptr);
+    void sendCommandResult(AsyncWebServerRequest *request, const CommandResult &result);
+
+    // Push an input change to connected event clients
+    void handleInputEvent(const InputEvent &event);
+
+    // Send an analog block frame to /analog clients
+    void handleAnalogBlock(const uint8_t *frame, size_t length);
+
+    // WebSocket event callback (runs in the AsyncTCP task)
+    void handleWebSocketEvent(AsyncWebSocketClient *client, AwsEventType type,
+                              void *arg, uint8_t *data, size_t len);
+
+    // Run one complete WebSocket message and reply to its sender
+    void handleWebSocketMessage(AsyncWebSocketClient *client, bool binary,
+                                const uint8_t *data, size_t len);
+
+    // Send a text reply to one WebSocket client (AsyncTCP task)
+    void sendReply(AsyncWebSocketClient *client, const char *text, size_t length);
+    void sendReply(AsyncWebSocketClient *client, const char *text) { sendReply(client, text, strlen(text)); }
+
+    // Send the pins in mask as a {"type":..., "pins":[...]} message, to one
+    // client or (clientId == 0) to all of them - loop() only
+    void sendPinStates(uint32_t clientId, const char *type, uint64_t mask);
+
+    // Replace the library's disconnect handler of a new WebSocket or event
+    // client with one that frees it under _clientsLock (AsyncTCP task)
+    template <typename Client>
+    void lockDisconnect(Client *client);
+
+    // Write the system status fields shared by /api/status and the WebSocket
+    // into the open object
+    void writeStatusFields(JsonWriter &json);
 
     AsyncWebServer _server;
+    AsyncEventSource _events;
+    AsyncWebSocket _ws;
+    AsyncWebSocket _analogWs;
     PinController &_pinController;
+    CommandDispatcher &_dispatcher;
+    int _inputListenerId;
+    int _analogListenerId;
     uint16_t _port;
     bool _running;
+
+    unsigned long _lastPinUpdate;
+    unsigned long _lastStatusUpdate;
+
+    // Newly connected WebSocket clients waiting for their snapshot, pushed
+    // by the AsyncTCP task and drained by loop()
+    SPSCQueue<uint32_t, 8> _snapshotClients;
+
+    // Response buffers: WebSocket replies run in the AsyncTCP task, pushes
+    // from loop() in the main task
+    char _wsResponse[RESPONSE_BUFFER_SIZE];
+    char _pushBuffer[RESPONSE_BUFFER_SIZE];
+
+    // Guards the library's client lists against pushes from loop()
+    SemaphoreHandle_t _clientsLock;
 };
 
 #endif // WEB_SERVER_H
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <atomic>
 #include "Config.h"
 
 /**
@@ -13,13 +14,35 @@
  * - Automatic reconnection on connection loss
  * - Connection status monitoring
  * - Smart network switching based on signal strength
+ *
+ * - Never blocks: a state machine advanced by loop() and driven by WiFi
+ *   events. Scans run asynchronously, each connection attempt ends on
+ *   GOT_IP, on a disconnect event or after WIFI_CONNECT_TIMEOUT, and the
+ *   next network is tried from the following loop pass.
+ * - Fast reconnect: the BSSID and channel of the last good connection are
+ *   kept in NVS, and the first attempt after boot or a lost link goes
+ *   straight to that access point without scanning. Scanning takes over
+ *   if it fails.
+ * - Radio power settings (modem sleep, listen interval, TX power) from the
+ *   power profile, see PowerManager
+ *
+ * WiFi events arrive on the system event task; the handler only records
+ * them, loop() acts on them in the main loop.
  */
 class WiFiManager
 {
 public:
+    enum class State
+    {
+        SCANNING,   // Async scan for configured networks
+        CONNECTING, // Waiting for an IP from the current candidate
+        CONNECTED,
+        WAITING     // Every candidate failed, retry after WIFI_RECONNECT_INTERVAL
+    };
+
     WiFiManager();
 
-    // Initialize WiFi manager
+    // Initialize WiFi manager and start the first scan
     void begin();
 
     // Main loop - call regularly to maintain connection
@@ -28,6 +51,11 @@ public:
     // Check if connected to WiFi
     bool isConnected();
 
+    // True while scanning or connecting
+    bool isConnecting() const;
+
+    State getState() const { return _state; }
+
     // Get current SSID
     String getCurrentSSID();
 
@@ -46,25 +74,79 @@ public:
     // Get current network index
     int getCurrentNetworkIndex();
 
+    // Modem sleep and TX power apply at once; the listen interval from the
+    // next association (it is part of the association request)
+    void setPowerSave(wifi_ps_type_t sleep, uint16_t listenInterval, wifi_power_t txPower);
+
 private:
-    // Try to connect to a specific network
-    bool connectToNetwork(int networkIndex);
+    // Pending WiFi events, set by handleEvent()
+    enum : uint32_t
+    {
+        EVENT_GOT_IP = 1 << 0,
+        EVENT_DISCONNECTED = 1 << 1,
+        EVENT_SCAN_DONE = 1 << 2
+    };
+
+    static void handleEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+
+    // Access point of the last good connection
+    struct CachedAP
+    {
+        char ssid[33];
+        uint8_t bssid[6];
+        uint8_t channel;
+    };
+
+    // Reconnect: cached access point first, otherwise scan
+    void startConnecting();
+
+    // Connect to the cached access point, false if there is none
+    bool connectToCachedAP();
 
-    // Try to connect to next available network
-    bool connectToNextNetwork();
+    // Remember the current access point in NVS if it changed
+    void updateCachedAP();
 
-    // Scan and find best available network
-    int findBestNetwork();
+    // Start an async scan, or go straight to connecting if it cannot start
+    void startScan();
 
-    // Check connection health
+    // Order the candidates by scan results (strongest first, then unseen)
+    void buildCandidates(int scanCount);
+
+    // Begin connecting to the next candidate, or wait if none is left
+    void connectToNextCandidate();
+
+    void enterState(State state);
+
+    // Check connection health (catches a missed disconnect event)
     void checkConnection();
 
+    // Start connecting with the power settings applied
+    void beginConnection(const char *ssid, const char *password, int32_t channel = 0,
+                         const uint8_t *bssid = nullptr);
+
+    static WiFiManager *_instance;
+
+    State _state;
+    unsigned long _stateSince;
+    int64_t _outageStartUs; // Link lost (or boot), for the reconnect histogram
+    std::atomic<uint32_t> _events;
+
+    int _candidates[MAX_WIFI_NETWORKS];
+    int _candidateCount;
+    int _nextCandidate;
+
+    CachedAP _cachedAP;
+    bool _cachedAPValid;
+    bool _fastConnect; // Current attempt uses the cached access point
+
     int _currentNetworkIndex;
-    unsigned long _lastConnectionAttempt;
     unsigned long _lastConnectionCheck;
-    bool _isConnected;
     int _consecutiveFailures;
 
+    wifi_ps_type_t _sleepMode;
+    uint16_t _listenInterval; // Beacon intervals between wake-ups in modem sleep
+    wifi_power_t _txPower;
+
     static const unsigned long CONNECTION_CHECK_INTERVAL = 5000; // 5 seconds
 };
 
@@ -0,0 +1,201 @@
+/**
+ * Dispatcher and pin controller benchmark (env:native), run after the parser
+ * cases by parser_bench.cpp
+ *
+ * - dispatch_*: CommandDispatcher::process on the owner task, parse through
+ *   response
+ * - queued_*: the same command from another task, through the job queue to
+ *   an owner waiting in waitForWork() as the main loop does; the time is the
+ *   caller's round trip
+ * - pins_*: PinController calls on their own
+ *
+ * GPIO and LEDC writes go to the shim, so the pin figures are the
+ * controller's own bookkeeping, not the cost of the hardware.
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include "CommandDispatcher.h"
+#include "BufferPrint.h"
+
+namespace
+{
+    // Keeps the optimizer from dropping the work
+    volatile unsigned long dispatchSink = 0;
+
+    double nsSince(std::chrono::steady_clock::time_point start, unsigned long iterations)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+
+    void report(const char *name, double ns, bool csv)
+    {
+        if (csv)
+        {
+            printf("%s,%.1f,%.0f\n", name, ns, 1e9 / ns);
+        }
+        else
+        {
+            printf("%-18s %10.1f %14.0f\n", name, ns, 1e9 / ns);
+        }
+    }
+
+    double timeProcess(CommandDispatcher &dispatcher, const char *text, unsigned long iterations)
+    {
+        size_t length = strlen(text);
+        char response[256];
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; i++)
+        {
+            BufferPrint out(response, sizeof(response));
+            dispatcher.process(text, length, out);
+            dispatchSink += out.length();
+        }
+        return nsSince(start, iterations);
+    }
+
+    // Owner task for the queued cases
+    struct Owner
+    {
+        CommandDispatcher *dispatcher;
+        std::atomic<bool> running;
+        std::atomic<bool> stopped;
+    };
+
+    void runOwner(void *arg)
+    {
+        Owner *owner = static_cast<Owner *>(arg);
+        owner->dispatcher->begin();
+        owner->running = true;
+        while (owner->running)
+        {
+            owner->dispatcher->waitForWork(10);
+        }
+        owner->stopped = true;
+    }
+
+    // Caller task for the queued cases
+    struct Caller
+    {
+        CommandDispatcher *dispatcher;
+        const char *text;
+        unsigned long iterations;
+        double ns;
+        std::atomic<bool> done;
+    };
+
+    void runCaller(void *arg)
+    {
+        Caller *caller = static_cast<Caller *>(arg);
+        caller->ns = timeProcess(*caller->dispatcher, caller->text, caller->iterations);
+        caller->done = true;
+    }
+
+    double timeQueued(CommandDispatcher &dispatcher, const char *text, unsigned long iterations)
+    {
+        Caller caller;
+        caller.dispatcher = &dispatcher;
+        caller.text = text;
+        caller.iterations = iterations;
+        caller.done = false;
+        xTaskCreatePinnedToCore(runCaller, "caller", 4096, &caller, 1, nullptr, 0);
+        while (!caller.done)
+        {
+            delay(1);
+        }
+        return caller.ns;
+    }
+}
+
+void runDispatchBenchmarks(unsigned long iterations, bool csv)
+{
+    CommandParser parser;
+    PinController pins;
+    pins.begin();
+
+    if (csv)
+    {
+        printf("\ncase,ns,calls_per_sec\n");
+    }
+    else
+    {
+        printf("\n%-18s %10s %14s\n", "case", "ns", "calls/s");
+    }
+
+    // Owner is the benchmark's own task
+    {
+        CommandDispatcher dispatcher(parser, pins);
+        dispatcher.begin();
+        report("dispatch_set", timeProcess(dispatcher, "SET 13 1", iterations), csv);
+        report("dispatch_batch", timeProcess(dispatcher, "BATCH SET 13 1; PWM 12 128; TOGGLE 14; SET 15 0", iterations),
+               csv);
+        report("dispatch_json", timeProcess(dispatcher, "{\"cmd\":\"PWM\",\"pin\":25,\"value\":128}", iterations), csv);
+    }
+
+    // Owner in its own task; a round trip is two task wake-ups, so fewer runs
+    {
+        CommandDispatcher dispatcher(parser, pins);
+        Owner owner;
+        owner.dispatcher = &dispatcher;
+        owner.running = false;
+        owner.stopped = false;
+        TaskHandle_t ownerTask = nullptr;
+        xTaskCreatePinnedToCore(runOwner, "owner", 4096, &owner, 1, &ownerTask, 1);
+        while (!owner.running)
+        {
+            delay(1);
+        }
+
+        unsigned long queuedIterations = iterations / 20 > 0 ? iterations / 20 : 1;
+        report("queued_set", timeQueued(dispatcher, "SET 13 1", queuedIterations), csv);
+        report("queued_batch", timeQueued(dispatcher, "BATCH SET 13 1; PWM 12 128; TOGGLE 14; SET 15 0",
+                                          queuedIterations),
+               csv);
+
+        owner.running = false;
+        xTaskNotifyGive(ownerTask);
+        while (!owner.stopped)
+        {
+            delay(1);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        pins.setDigital(13, static_cast<int>(i & 1));
+    }
+    report("pins_set", nsSince(start, iterations), csv);
+
+    PinOp ops[] = {{PinOpType::SET, 13, 1}, {PinOpType::PWM, 12, 128},
+                   {PinOpType::TOGGLE, 14, 0}, {PinOpType::SET, 15, 0}};
+    start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        dispatchSink += pins.applyBatch(ops, sizeof(ops) / sizeof(ops[0]));
+    }
+    report("pins_batch", nsSince(start, iterations), csv);
+
+    uint64_t mask = (1ULL << 4) | (1ULL << 5) | (1ULL << 16) | (1ULL << 17) | (1ULL << 32) | (1ULL << 33);
+    start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        dispatchSink += (i & 1) ? pins.setDigitalMask(mask, 0) : pins.setDigitalMask(0, mask);
+    }
+    report("pins_mask", nsSince(start, iterations), csv);
+
+    PinOp scene[] = {{PinOpType::SET, 13, 1}, {PinOpType::SET, 14, 0}, {PinOpType::PWM, 12, 64},
+                     {PinOpType::PWM, 25, 200}};
+    pins.defineScene("bench", scene, sizeof(scene) / sizeof(scene[0]));
+    start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        dispatchSink += pins.recallScene("bench");
+    }
+    report("pins_scene", nsSince(start, iterations), csv);
+}
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,235 @@
+/**
+ * Command parser benchmark (env:native)
+ *
+ * Runs each command through CommandParser::parse and the matching response
+ * writer (writeResponse into a fixed buffer, or generateBinaryResponse) and
+ * reports time and heap allocations per command, so changes to the hot path
+ * can be compared across commits on the same machine:
+ *
+ *   pio run -e native && .pio/build/native/program [iterations] [--csv]
+ *
+ * Allocations are counted by interposing malloc/realloc/calloc, which needs
+ * glibc; elsewhere the allocation columns read -1.
+ *
+ * Left out of `pio test -e native`, whose suites bring their own main().
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+#include <chrono>
+#include "CommandParser.h"
+#include "BufferPrint.h"
+
+#if defined(__GLIBC__)
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+}
+#define COUNT_ALLOCATIONS 1
+#else
+#define COUNT_ALLOCATIONS 0
+#endif
+
+// Dispatcher and pin controller cases, in dispatch_bench.cpp
+void runDispatchBenchmarks(unsigned long iterations, bool csv);
+
+namespace
+{
+    // Heap calls and bytes requested while counting is on
+    bool counting = false;
+    unsigned long allocations = 0;
+    unsigned long allocatedBytes = 0;
+
+    void noteAllocation(size_t size)
+    {
+        if (counting)
+        {
+            allocations++;
+            allocatedBytes += size;
+        }
+    }
+}
+
+#if COUNT_ALLOCATIONS
+extern "C" void *malloc(size_t size)
+{
+    noteAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    noteAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    noteAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+#endif
+
+namespace
+{
+    struct Case
+    {
+        const char *name;
+        const char *data;
+        size_t length; // 0 = strlen(data)
+    };
+
+    const uint8_t BINARY_SET[] = {0xA5, 0x01, 0x00, 13, 0x01, 0x00, 0x01, 0x00};
+    const uint8_t BINARY_PWM[] = {0xA5, 0x04, 0x00, 25, 0x80, 0x00, 0x02, 0x00};
+    const uint8_t BINARY_BATCH[] = {0xA5, 0x10, 0x00, 0, 0x04, 0x00, 0x03, 0x00,
+                                    0x01, 13, 0x01, 0x00,
+                                    0x04, 12, 0x80, 0x00,
+                                    0x03, 14, 0x00, 0x00,
+                                    0x01, 15, 0x00, 0x00};
+
+    const Case CASES[] = {
+        {"json_set", "{\"cmd\":\"SET\",\"pin\":13,\"value\":1}", 0},
+        {"json_pwm", "{\"cmd\":\"PWM\",\"pin\":25,\"value\":128,\"freq\":5000}", 0},
+        {"json_batch", "{\"cmd\":\"BATCH\",\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":1},"
+                       "{\"cmd\":\"PWM\",\"pin\":12,\"value\":128},{\"cmd\":\"TOGGLE\",\"pin\":14},"
+                       "{\"cmd\":\"SET\",\"pin\":15,\"value\":0}]}",
+         0},
+        {"json_invalid_pin", "{\"cmd\":\"SET\",\"pin\":6,\"value\":1}", 0},
+        {"text_set", "SET 13 1", 0},
+        {"text_pwm", "PWM 25 128", 0},
+        {"text_batch", "BATCH SET 13 1; PWM 12 128; TOGGLE 14; SET 15 0", 0},
+        {"text_invalid_pin", "SET 6 1", 0},
+        {"binary_set", reinterpret_cast<const char *>(BINARY_SET), sizeof(BINARY_SET)},
+        {"binary_pwm", reinterpret_cast<const char *>(BINARY_PWM), sizeof(BINARY_PWM)},
+        {"binary_batch", reinterpret_cast<const char *>(BINARY_BATCH), sizeof(BINARY_BATCH)},
+    };
+
+    struct Result
+    {
+        double parseNs;
+        double responseNs;
+        long allocations; // Per command, -1 if not counted
+        long bytes;
+    };
+
+    // Keeps the optimizer from dropping the work
+    volatile unsigned long sink = 0;
+
+    double nsPerOp(std::chrono::steady_clock::time_point start, unsigned long iterations)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+
+    Result run(CommandParser &parser, const Case &c, unsigned long iterations)
+    {
+        size_t length = c.length != 0 ? c.length : strlen(c.data);
+        char response[512];
+        uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+        Result result;
+
+        // Parse only
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; i++)
+        {
+            Command cmd = parser.parse(c.data, length);
+            sink += static_cast<unsigned long>(cmd.type) + cmd.pin;
+        }
+        result.parseNs = nsPerOp(start, iterations);
+
+        // Response only, for one parsed command
+        Command cmd = parser.parse(c.data, length);
+        start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; i++)
+        {
+            if (cmd.format == CommandFormat::BINARY)
+            {
+                sink += parser.generateBinaryResponse(cmd, cmd.isValid(), cmd.value, reply);
+            }
+            else
+            {
+                BufferPrint out(response, sizeof(response));
+                parser.writeResponse(out, cmd, cmd.isValid(), "", cmd.value);
+                sink += out.length();
+            }
+        }
+        result.responseNs = nsPerOp(start, iterations);
+
+        // Heap use of one full round trip
+        allocations = 0;
+        allocatedBytes = 0;
+        counting = true;
+        {
+            Command counted = parser.parse(c.data, length);
+            if (counted.format == CommandFormat::BINARY)
+            {
+                sink += parser.generateBinaryResponse(counted, counted.isValid(), counted.value, reply);
+            }
+            else
+            {
+                BufferPrint out(response, sizeof(response));
+                parser.writeResponse(out, counted, counted.isValid(), "", counted.value);
+                sink += out.length();
+            }
+        }
+        counting = false;
+        result.allocations = COUNT_ALLOCATIONS ? static_cast<long>(allocations) : -1;
+        result.bytes = COUNT_ALLOCATIONS ? static_cast<long>(allocatedBytes) : -1;
+
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = 200000;
+    bool csv = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv = true;
+        }
+        else if (atol(argv[i]) > 0)
+        {
+            iterations = static_cast<unsigned long>(atol(argv[i]));
+        }
+    }
+
+    CommandParser parser;
+
+    if (csv)
+    {
+        printf("case,parse_ns,response_ns,commands_per_sec,allocations,alloc_bytes\n");
+    }
+    else
+    {
+        printf("%lu iterations per case\n\n", iterations);
+        printf("%-18s %10s %12s %14s %8s %8s\n", "case", "parse ns", "response ns", "commands/s", "allocs", "bytes");
+    }
+
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++)
+    {
+        Result r = run(parser, CASES[i], iterations);
+        double perSecond = 1e9 / (r.parseNs + r.responseNs);
+
+        if (csv)
+        {
+            printf("%s,%.1f,%.1f,%.0f,%ld,%ld\n", CASES[i].name, r.parseNs, r.responseNs, perSecond,
+                   r.allocations, r.bytes);
+        }
+        else
+        {
+            printf("%-18s %10.1f %12.1f %14.0f %8ld %8ld\n", CASES[i].name, r.parseNs, r.responseNs, perSecond,
+                   r.allocations, r.bytes);
+        }
+    }
+
+    runDispatchBenchmarks(iterations, csv);
+
+    return sink == 0 ? 1 : 0;
+}
+
+#endif // PIO_UNIT_TESTING
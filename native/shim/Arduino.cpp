@@ -0,0 +1,195 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "driver/ledc.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace
+{
+    const int PIN_COUNT = 40;
+    const int CHANNEL_COUNT = 16;
+
+    // Output level of each pin (bit n = GPIO n), read back as its input
+    uint64_t pinLevels = 0;
+    uint32_t regWrites = 0;
+
+    // Last duty written to each LEDC channel
+    uint32_t channelDuty[CHANNEL_COUNT];
+
+    uint32_t cpuMhz = 240;
+
+    const std::chrono::steady_clock::time_point START = std::chrono::steady_clock::now();
+
+    int64_t elapsedUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START).count();
+    }
+}
+
+unsigned long millis()
+{
+    return static_cast<unsigned long>(elapsedUs() / 1000);
+}
+
+unsigned long micros()
+{
+    return static_cast<unsigned long>(elapsedUs());
+}
+
+int64_t esp_timer_get_time()
+{
+    return elapsedUs();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    if (pin < PIN_COUNT)
+    {
+        if (level != LOW)
+        {
+            pinLevels |= 1ULL << pin;
+        }
+        else
+        {
+            pinLevels &= ~(1ULL << pin);
+        }
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < PIN_COUNT ? static_cast<int>((pinLevels >> pin) & 1) : LOW;
+}
+
+uint32_t nativeRegRead(uint32_t reg)
+{
+    switch (reg)
+    {
+    case GPIO_OUT_REG:
+    case GPIO_IN_REG:
+        return static_cast<uint32_t>(pinLevels);
+    case GPIO_OUT1_REG:
+    case GPIO_IN1_REG:
+        return static_cast<uint32_t>(pinLevels >> 32);
+    default:
+        return 0;
+    }
+}
+
+void nativeRegWrite(uint32_t reg, uint32_t value)
+{
+    regWrites++;
+    switch (reg)
+    {
+    case GPIO_OUT_REG:
+        pinLevels = (pinLevels & ~0xFFFFFFFFULL) | value;
+        break;
+    case GPIO_OUT_W1TS_REG:
+        pinLevels |= value;
+        break;
+    case GPIO_OUT_W1TC_REG:
+        pinLevels &= ~static_cast<uint64_t>(value);
+        break;
+    case GPIO_OUT1_REG:
+        pinLevels = (pinLevels & 0xFFFFFFFFULL) | (static_cast<uint64_t>(value) << 32);
+        break;
+    case GPIO_OUT1_W1TS_REG:
+        pinLevels |= static_cast<uint64_t>(value) << 32;
+        break;
+    case GPIO_OUT1_W1TC_REG:
+        pinLevels &= ~(static_cast<uint64_t>(value) << 32);
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t nativeRegWriteCount()
+{
+    return regWrites;
+}
+
+void nativeResetRegWriteCount()
+{
+    regWrites = 0;
+}
+
+void attachInterruptArg(uint8_t, void (*)(void *), void *, int)
+{
+}
+
+void detachInterrupt(uint8_t)
+{
+}
+
+uint32_t ledcSetup(uint8_t, uint32_t frequency, uint8_t)
+{
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t, uint8_t)
+{
+}
+
+void ledcDetachPin(uint8_t)
+{
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty)
+{
+    if (channel < CHANNEL_COUNT)
+    {
+        channelDuty[channel] = duty;
+    }
+}
+
+uint32_t ledcRead(uint8_t channel)
+{
+    return channel < CHANNEL_COUNT ? channelDuty[channel] : 0;
+}
+
+esp_err_t ledc_set_duty_and_update(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty, uint32_t)
+{
+    ledcWrite(static_cast<uint8_t>(mode * 8 + channel), duty);
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    return ledcRead(static_cast<uint8_t>(mode * 8 + channel));
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz)
+{
+    cpuMhz = mhz;
+    return true;
+}
+
+uint32_t EspClass::getCpuFreqMHz()
+{
+    return cpuMhz;
+}
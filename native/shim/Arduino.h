@@ -0,0 +1,347 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/**
+ * Arduino shim for the host-native build (env:native)
+ *
+ * Features:
+ * - String with the ESP32 core's heap behaviour (up to 11 characters kept
+ *   inline, longer ones in a realloc'd buffer), so allocation counts match
+ *   the firmware's
+ * - Print with the print/println/printf overloads the firmware uses
+ * - Serial writes to stdout; millis()/micros() from the host clock
+ * - GPIO levels live in the register file behind soc/soc.h, so
+ *   digitalWrite() and direct register writes see each other; LEDC calls
+ *   remember the last duty; interrupts attach but never fire
+ *
+ * Just enough of the core for CommandParser, CommandDispatcher, PinController
+ * and the other hardware-independent code; not a general-purpose Arduino
+ * emulation.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define PROGMEM
+#define F(text) (text)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Not in glibc before 2.38
+inline size_t nativeStrlcpy(char *dst, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size > 0)
+    {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return length;
+}
+#define strlcpy nativeStrlcpy
+
+class String
+{
+public:
+    String(const char *text = "") { init(); concat(text); }
+    String(const String &other) { init(); concat(other); }
+    String(String &&other) { init(); move(other); }
+    explicit String(char c) { init(); concat(&c, 1); }
+    explicit String(int value) : String(static_cast<long>(value)) {}
+    explicit String(unsigned int value) : String(static_cast<unsigned long>(value)) {}
+    explicit String(long value) { init(); format("%ld", value); }
+    explicit String(unsigned long value) { init(); format("%lu", value); }
+    ~String() { free(_heap); }
+
+    String &operator=(const String &other)
+    {
+        if (this != &other)
+        {
+            _length = 0;
+            concat(other);
+        }
+        return *this;
+    }
+    String &operator=(String &&other)
+    {
+        if (this != &other)
+        {
+            move(other);
+        }
+        return *this;
+    }
+    String &operator=(const char *text)
+    {
+        _length = 0;
+        concat(text);
+        return *this;
+    }
+
+    bool reserve(unsigned int size) { return grow(size); }
+    bool concat(const char *data, unsigned int length)
+    {
+        if (!grow(_length + length))
+        {
+            return false;
+        }
+        char *target = buffer();
+        memmove(target + _length, data, length);
+        _length += length;
+        target[_length] = '\0';
+        return true;
+    }
+    bool concat(const String &other) { return concat(other.c_str(), other._length); }
+    bool concat(const char *text) { return concat(text, strlen(text)); }
+
+    String &operator+=(const String &other) { concat(other); return *this; }
+    String &operator+=(const char *text) { concat(text); return *this; }
+    String &operator+=(char c) { concat(&c, 1); return *this; }
+
+    bool operator==(const String &other) const { return _length == other._length && strcmp(c_str(), other.c_str()) == 0; }
+    bool operator==(const char *text) const { return strcmp(c_str(), text) == 0; }
+    bool operator!=(const String &other) const { return !(*this == other); }
+    bool operator!=(const char *text) const { return !(*this == text); }
+    char operator[](unsigned int index) const { return index < _length ? c_str()[index] : '\0'; }
+
+    const char *c_str() const { return _heap != nullptr ? _heap : _inline; }
+    unsigned int length() const { return _length; }
+    bool isEmpty() const { return _length == 0; }
+
+private:
+    // Strings this short stay inside the object, as in the ESP32 core
+    static const unsigned int INLINE_CAPACITY = 11;
+
+    void init()
+    {
+        _heap = nullptr;
+        _length = 0;
+        _capacity = INLINE_CAPACITY;
+        _inline[0] = '\0';
+    }
+
+    char *buffer() { return _heap != nullptr ? _heap : _inline; }
+
+    void move(String &other)
+    {
+        free(_heap);
+        memcpy(_inline, other._inline, sizeof(_inline));
+        _heap = other._heap;
+        _length = other._length;
+        _capacity = other._capacity;
+        other.init();
+    }
+
+    void format(const char *fmt, ...)
+    {
+        char digits[24];
+        va_list args;
+        va_start(args, fmt);
+        int length = vsnprintf(digits, sizeof(digits), fmt, args);
+        va_end(args);
+        concat(digits, length);
+    }
+
+    bool grow(unsigned int size)
+    {
+        if (_capacity >= size)
+        {
+            return true;
+        }
+        char *buffer = static_cast<char *>(realloc(_heap, size + 1));
+        if (buffer == nullptr)
+        {
+            return false;
+        }
+        if (_heap == nullptr)
+        {
+            memcpy(buffer, _inline, _length + 1);
+        }
+        _heap = buffer;
+        _capacity = size;
+        return true;
+    }
+
+    char *_heap; // nullptr while the contents fit in _inline
+    unsigned int _length;
+    unsigned int _capacity;
+    char _inline[INLINE_CAPACITY + 1];
+};
+
+inline String operator+(const String &a, const String &b)
+{
+    String result(a);
+    result += b;
+    return result;
+}
+inline String operator+(const String &a, const char *b)
+{
+    String result(a);
+    result += b;
+    return result;
+}
+inline String operator+(const char *a, const String &b)
+{
+    String result(a);
+    result += b;
+    return result;
+}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t size)
+    {
+        size_t n = 0;
+        while (size-- > 0 && write(*data++) == 1)
+        {
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char *data, size_t size) { return write(reinterpret_cast<const uint8_t *>(data), size); }
+    size_t write(const char *text) { return write(text, strlen(text)); }
+    virtual void flush() {}
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(const String &text) { return write(text.c_str(), text.length()); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+
+    // Formats into a stack buffer, or a heap one for long output (as the core does)
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char stackBuffer[64];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+        va_end(args);
+        if (length < 0)
+        {
+            return 0;
+        }
+        if (static_cast<size_t>(length) < sizeof(stackBuffer))
+        {
+            return write(stackBuffer, length);
+        }
+
+        char *heapBuffer = static_cast<char *>(malloc(length + 1));
+        if (heapBuffer == nullptr)
+        {
+            return 0;
+        }
+        va_start(args, format);
+        vsnprintf(heapBuffer, length + 1, format, args);
+        va_end(args);
+        size_t n = write(heapBuffer, length);
+        free(heapBuffer);
+        return n;
+    }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t *data, size_t size) override { return fwrite(data, 1, size, stdout); }
+    using Print::write;
+    int available() { return 0; }
+    int read() { return -1; }
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress
+{
+public:
+    IPAddress() : IPAddress(0, 0, 0, 0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        _octets[0] = a;
+        _octets[1] = b;
+        _octets[2] = c;
+        _octets[3] = d;
+    }
+    uint8_t operator[](int index) const { return _octets[index]; }
+    operator uint32_t() const
+    {
+        uint32_t address;
+        memcpy(&address, _octets, sizeof(address));
+        return address;
+    }
+
+private:
+    uint8_t _octets[4];
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+uint32_t ledcSetup(uint8_t channel, uint32_t frequency, uint8_t resolution);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+    const char *getChipModel() { return "native"; }
+    uint8_t getChipCores() { return 1; }
+    uint32_t getCpuFreqMHz();
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+#endif // NATIVE_ARDUINO_H
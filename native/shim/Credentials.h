@@ -0,0 +1,16 @@
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+// Placeholder credentials for the host-native build, used when
+// include/Credentials.h does not exist. Nothing in env:native connects.
+
+const WiFiCredentials WIFI_NETWORKS[] = {
+    {"native", ""},
+};
+
+const int WIFI_NETWORK_COUNT = sizeof(WIFI_NETWORKS) / sizeof(WiFiCredentials);
+
+#define TELEGRAM_BOT_TOKEN ""
+#define TELEGRAM_CHAT_ID ""
+
+#endif // CREDENTIALS_H
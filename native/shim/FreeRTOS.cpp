@@ -0,0 +1,143 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct NativeTask
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+};
+
+struct NativeSemaphore
+{
+    std::timed_mutex mutex;
+};
+
+namespace
+{
+    // Tasks live as long as the program, as the firmware's do; threads that
+    // were not created by xTaskCreate get theirs on first use
+    thread_local NativeTask *currentTask = nullptr;
+
+    void notify(TaskHandle_t task)
+    {
+        if (task == nullptr)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(task->lock);
+            task->notifications++;
+        }
+        task->wake.notify_one();
+    }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    NativeTask *task = new NativeTask();
+    if (handle != nullptr)
+    {
+        *handle = task;
+    }
+    std::thread([function, arg, task]()
+                {
+                    currentTask = task;
+                    function(arg);
+                })
+        .detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stackDepth, arg, priority, handle, 0);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    if (currentTask == nullptr)
+    {
+        currentTask = new NativeTask();
+    }
+    return currentTask;
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(millis());
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    NativeTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> guard(task->lock);
+
+    auto notified = [task]() { return task->notifications != 0; };
+    if (ticks == portMAX_DELAY)
+    {
+        task->wake.wait(guard, notified);
+    }
+    else if (!task->wake.wait_for(guard, std::chrono::milliseconds(ticks), notified))
+    {
+        return 0;
+    }
+
+    uint32_t count = task->notifications;
+    task->notifications = clearOnExit != pdFALSE ? 0 : count - 1;
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    notify(task);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    notify(task);
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new NativeSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
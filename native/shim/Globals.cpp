@@ -0,0 +1,21 @@
+// The shared instances src/main.cpp defines on the board, for the host-native
+// build (main.cpp is left out of env:native). Benchmarks and tests create
+// their own PinController and CommandDispatcher.
+
+#include "Logger.h"
+#include "WiFiManager.h"
+#include "WatchdogManager.h"
+#include "StatusSnapshot.h"
+#include "Metrics.h"
+#include "PowerManager.h"
+#include "AnalogSampler.h"
+#include "LoopScheduler.h"
+
+Logger logger;
+WiFiManager wifiManager;
+WatchdogManager watchdogManager;
+StatusSnapshot statusSnapshot;
+Metrics metrics;
+PowerManager powerManager(wifiManager);
+AnalogSampler analogSampler;
+LoopScheduler loopScheduler(watchdogManager);
@@ -0,0 +1,24 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+// NVS shim for the host-native build: nothing is stored, begin() fails as
+// it does on a board with an unformatted NVS partition
+
+#include <Arduino.h>
+
+class Preferences
+{
+public:
+    bool begin(const char *, bool = false, const char * = nullptr) { return false; }
+    void end() {}
+    bool clear() { return false; }
+    bool remove(const char *) { return false; }
+    size_t putBytes(const char *, const void *, size_t) { return 0; }
+    size_t getBytes(const char *, void *, size_t) { return 0; }
+    size_t getBytesLength(const char *) { return 0; }
+    size_t putUChar(const char *, uint8_t) { return 0; }
+    uint8_t getUChar(const char *, uint8_t defaultValue = 0) { return defaultValue; }
+    bool isKey(const char *) { return false; }
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,54 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// WiFi shim for the host-native build: the types WiFiManager's interface
+// uses and a radio that is never connected
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+typedef enum
+{
+    WIFI_POWER_19_5dBm = 78,
+    WIFI_POWER_15dBm = 60,
+    WIFI_POWER_11dBm = 44,
+    WIFI_POWER_8_5dBm = 34
+} wifi_power_t;
+
+typedef int WiFiEvent_t;
+
+typedef struct
+{
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union
+{
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} WiFiEventInfo_t;
+
+class WiFiClass
+{
+public:
+    wl_status_t status() { return WL_DISCONNECTED; }
+    IPAddress localIP() { return IPAddress(); }
+    String SSID() { return String(); }
+    int32_t RSSI() { return 0; }
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
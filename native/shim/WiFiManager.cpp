@@ -0,0 +1,82 @@
+// WiFiManager for the host-native build: there is no radio, so the manager
+// stays WAITING and reports itself disconnected. src/WiFiManager.cpp is left
+// out of env:native.
+
+#include "WiFiManager.h"
+
+WiFiClass WiFi;
+
+WiFiManager *WiFiManager::_instance = nullptr;
+
+WiFiManager::WiFiManager()
+    : _state(State::WAITING),
+      _stateSince(0),
+      _outageStartUs(0),
+      _events(0),
+      _candidateCount(0),
+      _nextCandidate(0),
+      _cachedAPValid(false),
+      _fastConnect(false),
+      _currentNetworkIndex(-1),
+      _lastConnectionCheck(0),
+      _consecutiveFailures(0),
+      _sleepMode(WIFI_PS_MIN_MODEM),
+      _listenInterval(3),
+      _txPower(WIFI_POWER_19_5dBm)
+{
+}
+
+void WiFiManager::begin()
+{
+    _instance = this;
+}
+
+void WiFiManager::loop()
+{
+}
+
+bool WiFiManager::isConnected()
+{
+    return false;
+}
+
+bool WiFiManager::isConnecting() const
+{
+    return false;
+}
+
+String WiFiManager::getCurrentSSID()
+{
+    return "Not connected";
+}
+
+String WiFiManager::getIPAddress()
+{
+    return "0.0.0.0";
+}
+
+int WiFiManager::getSignalStrength()
+{
+    return -100;
+}
+
+void WiFiManager::reconnect()
+{
+}
+
+String WiFiManager::getStatusString()
+{
+    return "Disconnected";
+}
+
+int WiFiManager::getCurrentNetworkIndex()
+{
+    return _currentNetworkIndex;
+}
+
+void WiFiManager::setPowerSave(wifi_ps_type_t sleep, uint16_t listenInterval, wifi_power_t txPower)
+{
+    _sleepMode = sleep;
+    _listenInterval = listenInterval;
+    _txPower = txPower;
+}
@@ -0,0 +1,18 @@
+#ifndef NATIVE_WIFI_UDP_H
+#define NATIVE_WIFI_UDP_H
+
+// UDP socket shim for the host-native build: packets go nowhere
+
+#include <WiFi.h>
+
+class WiFiUDP : public Print
+{
+public:
+    int beginPacket(const char *, uint16_t) { return 0; }
+    int endPacket() { return 0; }
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+    using Print::write;
+};
+
+#endif // NATIVE_WIFI_UDP_H
@@ -0,0 +1,73 @@
+#ifndef NATIVE_DRIVER_ADC_H
+#define NATIVE_DRIVER_ADC_H
+
+// ADC DMA driver shim for the host-native build: initialisation fails, so
+// AnalogSampler reports that streaming is unavailable
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+
+typedef struct
+{
+    uint8_t atten;
+    uint8_t channel;
+    uint8_t unit;
+    uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef enum
+{
+    ADC_CONV_SINGLE_UNIT_1 = 1
+} adc_digi_convert_mode_t;
+
+typedef enum
+{
+    ADC_DIGI_OUTPUT_FORMAT_TYPE1
+} adc_digi_output_format_t;
+
+typedef struct
+{
+    bool conv_limit_en;
+    uint32_t conv_limit_num;
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t *adc_pattern;
+    uint32_t sample_freq_hz;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_digi_configuration_t;
+
+typedef struct
+{
+    uint32_t max_store_buf_size;
+    uint32_t conv_num_each_intr;
+    uint32_t adc1_chan_mask;
+    uint32_t adc2_chan_mask;
+} adc_digi_init_config_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint16_t data : 12;
+            uint16_t channel : 4;
+        } type1;
+        uint16_t val;
+    };
+} adc_digi_output_data_t;
+
+inline esp_err_t adc_digi_initialize(const adc_digi_init_config_t *) { return ESP_FAIL; }
+inline esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t *) { return ESP_FAIL; }
+inline esp_err_t adc_digi_start() { return ESP_FAIL; }
+inline esp_err_t adc_digi_stop() { return ESP_OK; }
+inline esp_err_t adc_digi_deinitialize() { return ESP_OK; }
+inline esp_err_t adc_digi_read_bytes(uint8_t *, uint32_t, uint32_t *length, uint32_t)
+{
+    *length = 0;
+    return ESP_ERR_TIMEOUT;
+}
+
+#endif // NATIVE_DRIVER_ADC_H
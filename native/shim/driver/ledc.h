@@ -0,0 +1,37 @@
+#ifndef NATIVE_DRIVER_LEDC_H
+#define NATIVE_DRIVER_LEDC_H
+
+// LEDC driver shim for the host-native build: the fade engine is missing,
+// as on a build without it, so every fade is stepped in software
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    LEDC_HIGH_SPEED_MODE = 0,
+    LEDC_LOW_SPEED_MODE,
+    LEDC_SPEED_MODE_MAX
+} ledc_mode_t;
+
+typedef enum
+{
+    LEDC_CHANNEL_0 = 0,
+    LEDC_CHANNEL_MAX = 8
+} ledc_channel_t;
+
+typedef enum
+{
+    LEDC_FADE_NO_WAIT = 0,
+    LEDC_FADE_WAIT_DONE
+} ledc_fade_mode_t;
+
+inline esp_err_t ledc_fade_func_install(int) { return ESP_FAIL; }
+inline esp_err_t ledc_set_fade_with_time(ledc_mode_t, ledc_channel_t, uint32_t, int) { return ESP_FAIL; }
+inline esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t, ledc_fade_mode_t) { return ESP_FAIL; }
+
+// Same duty as ledcWrite() on channel mode * 8 + channel
+esp_err_t ledc_set_duty_and_update(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty, uint32_t hpoint);
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t channel);
+
+#endif // NATIVE_DRIVER_LEDC_H
@@ -0,0 +1,21 @@
+#ifndef NATIVE_SOC_H
+#define NATIVE_SOC_H
+
+// Register access for the host-native build: REG_READ/REG_WRITE go to a
+// register file that models the GPIO output and input registers (an output
+// pin reads back the level it drives), shared with digitalWrite/digitalRead
+
+#include <stdint.h>
+
+uint32_t nativeRegRead(uint32_t reg);
+void nativeRegWrite(uint32_t reg, uint32_t value);
+
+// Register writes since the last reset, for tests that check a mask update
+// is a single write per bank
+uint32_t nativeRegWriteCount();
+void nativeResetRegWriteCount();
+
+#define REG_READ(reg) nativeRegRead(reg)
+#define REG_WRITE(reg, value) nativeRegWrite((reg), (value))
+
+#endif // NATIVE_SOC_H
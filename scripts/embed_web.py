@@ -0,0 +1,67 @@
+"""
+PlatformIO pre-build script: embed the web UI as a gzip-compressed PROGMEM array
+
+Reads web/index.html, gzips it and writes include/WebPageData.h with:
+  WEB_PAGE_GZ[]     compressed page (PROGMEM)
+  WEB_PAGE_GZ_LEN   its length in bytes
+  WEB_PAGE_ETAG     quoted ETag derived from the page content
+
+The header is only rewritten when the page changes, so unchanged builds are
+not recompiled. Can also be run standalone: python scripts/embed_web.py
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE = os.path.join(PROJECT_DIR, "web", "index.html")
+OUTPUT = os.path.join(PROJECT_DIR, "include", "WebPageData.h")
+
+
+def render(data, etag):
+    lines = [
+        "// Generated by scripts/embed_web.py from web/index.html - do not edit",
+        "#ifndef WEB_PAGE_DATA_H",
+        "#define WEB_PAGE_DATA_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        'static const char WEB_PAGE_ETAG[] = "\\"%s\\"";' % etag,
+        "static const size_t WEB_PAGE_GZ_LEN = %d;" % len(data),
+        "static const uint8_t WEB_PAGE_GZ[] PROGMEM = {",
+    ]
+    for i in range(0, len(data), 16):
+        chunk = data[i:i + 16]
+        lines.append("    " + ", ".join("0x%02x" % b for b in chunk) + ",")
+    lines += ["};", "", "#endif // WEB_PAGE_DATA_H", ""]
+    return "\n".join(lines)
+
+
+def main():
+    with open(SOURCE, "rb") as f:
+        html = f.read()
+
+    # mtime=0 keeps the output stable so the ETag only changes with the page
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = hashlib.sha1(html).hexdigest()[:16]
+    header = render(data, etag)
+
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT, "r") as f:
+            if f.read() == header:
+                return
+
+    with open(OUTPUT, "w") as f:
+        f.write(header)
+    print("embed_web: %s -> %s (%d -> %d bytes)" %
+          (os.path.relpath(SOURCE, PROJECT_DIR), os.path.relpath(OUTPUT, PROJECT_DIR),
+           len(html), len(data)))
+
+
+main()
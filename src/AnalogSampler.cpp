@@ -0,0 +1,381 @@
+#include "AnalogSampler.h"
+#include "PinController.h"
+#include "Logger.h"
+#include <driver/adc.h>
+#include <esp_timer.h>
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+static_assert(ANALOG_ATTENUATION >= 0 && ANALOG_ATTENUATION <= 3, "ANALOG_ATTENUATION must be 0-3");
+static_assert(ANALOG_DMA_FRAME_BYTES % sizeof(adc_digi_output_data_t) == 0,
+              "ANALOG_DMA_FRAME_BYTES must hold whole conversions");
+
+namespace
+{
+    // Longest a driver read waits, bounds how late a new start()/stop() applies
+    const uint32_t READ_TIMEOUT_MS = 20;
+
+    // The ESP32 needs the conversion limit enabled in single unit mode
+    const uint32_t CONVERSION_LIMIT = 250;
+
+    // ADC1 channel of GPIO 32-39
+    uint8_t adcChannel(int pin)
+    {
+        static const uint8_t CHANNELS[] = {4, 5, 6, 7, 0, 1, 2, 3};
+        return CHANNELS[pin - 32];
+    }
+}
+
+AnalogSampler::AnalogSampler()
+    : _settings{0, 0, 0},
+      _request{0, 0, 0},
+      _mux(portMUX_INITIALIZER_UNLOCKED),
+      _generation(0),
+      _task(nullptr),
+      _blockReady(nullptr),
+      _active{0, 0, 0},
+      _channels(0),
+      _rowFilled(0),
+      _samplesPerBlock(1),
+      _sequence(0),
+      _emitted(0),
+      _startUs(0),
+      _reportedDrops(0)
+{
+}
+
+void AnalogSampler::begin()
+{
+    BaseType_t created = xTaskCreatePinnedToCore(taskEntry, "analog", ANALOG_TASK_STACK_SIZE, this,
+                                                 ANALOG_TASK_PRIORITY, &_task, ANALOG_TASK_CORE);
+    if (created != pdPASS)
+    {
+        _task = nullptr;
+        LOG_ERROR("Analog", "Failed to start sampler task");
+    }
+}
+
+bool AnalogSampler::start(uint64_t mask, uint32_t rate, uint32_t average, const char *&error)
+{
+    if (_task == nullptr)
+    {
+        error = "Analog sampler not available";
+        return false;
+    }
+
+    if (mask == 0 || (mask & ~PinMasks::ANALOG) != 0)
+    {
+        error = "Pins must be analog pins";
+        return false;
+    }
+
+    if (rate == 0 || rate > ANALOG_MAX_RATE_HZ)
+    {
+        error = "Rate out of range";
+        return false;
+    }
+
+    // Conversions per second for each conversion averaged
+    uint64_t perAverage = static_cast<uint64_t>(rate) * __builtin_popcountll(mask);
+    uint32_t minimum = (ANALOG_MIN_CONVERSION_HZ + perAverage - 1) / perAverage;
+    if (average < minimum)
+    {
+        average = minimum;
+    }
+
+    if (perAverage * average > ANALOG_MAX_CONVERSION_HZ)
+    {
+        error = "Conversion rate too high, lower the rate or average";
+        return false;
+    }
+
+    _settings.mask = mask;
+    _settings.rate = rate;
+    _settings.average = average;
+    post(_settings);
+    return true;
+}
+
+void AnalogSampler::stop()
+{
+    if (_settings.mask == 0)
+    {
+        return;
+    }
+
+    _settings.mask = 0;
+    post(_settings);
+}
+
+void AnalogSampler::loop()
+{
+    while (_blocks.pop(_outgoing))
+    {
+        size_t length = encode(_outgoing);
+        for (int i = 0; i < ANALOG_MAX_LISTENERS; i++)
+        {
+            if (_listeners[i])
+            {
+                _listeners[i](_frame, length);
+            }
+        }
+    }
+
+    uint32_t dropped = _blocks.dropped();
+    if (dropped != _reportedDrops)
+    {
+        LOG_WARNING("Analog", "%u blocks dropped, queue full", static_cast<unsigned>(dropped - _reportedDrops));
+        _reportedDrops = dropped;
+    }
+}
+
+int AnalogSampler::addBlockListener(BlockListener listener)
+{
+    for (int i = 0; i < ANALOG_MAX_LISTENERS; i++)
+    {
+        if (!_listeners[i])
+        {
+            _listeners[i] = listener;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AnalogSampler::removeBlockListener(int id)
+{
+    if (id >= 0 && id < ANALOG_MAX_LISTENERS)
+    {
+        _listeners[id] = nullptr;
+    }
+}
+
+void AnalogSampler::post(const Settings &settings)
+{
+    portENTER_CRITICAL(&_mux);
+    _request = settings;
+    portEXIT_CRITICAL(&_mux);
+
+    _generation.fetch_add(1, std::memory_order_release);
+    xTaskNotifyGive(_task);
+}
+
+void AnalogSampler::taskEntry(void *arg)
+{
+    static_cast<AnalogSampler *>(arg)->run();
+}
+
+void AnalogSampler::run()
+{
+    uint32_t applied = _generation.load(std::memory_order_acquire);
+    bool running = false;
+    bool overrunReported = false;
+
+    for (;;)
+    {
+        uint32_t generation = _generation.load(std::memory_order_acquire);
+        if (generation != applied)
+        {
+            applied = generation;
+
+            Settings request;
+            portENTER_CRITICAL(&_mux);
+            request = _request;
+            portEXIT_CRITICAL(&_mux);
+
+            if (running)
+            {
+                stopDriver();
+                running = false;
+            }
+            if (request.mask != 0)
+            {
+                running = startDriver(request);
+                overrunReported = false;
+            }
+        }
+
+        if (!running)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(_readBuffer, sizeof(_readBuffer), &length, READ_TIMEOUT_MS);
+        if (err == ESP_ERR_INVALID_STATE && !overrunReported)
+        {
+            // The driver's buffer overflowed and conversions were lost; once
+            // per stream, it repeats for as long as the task falls behind
+            LOG_WARNING("Analog", "DMA buffer overrun");
+            overrunReported = true;
+        }
+        if (length > 0)
+        {
+            collect(_readBuffer, length);
+        }
+    }
+}
+
+bool AnalogSampler::startDriver(const Settings &settings)
+{
+    adc_digi_pattern_config_t patterns[8];
+    uint32_t channelMask = 0;
+
+    // Slots in GPIO order, the order pins are listed in a frame
+    _channels = 0;
+    for (int channel = 0; channel < 8; channel++)
+    {
+        _slotOfChannel[channel] = -1;
+        _sums[channel] = 0;
+        _counts[channel] = 0;
+    }
+    for (int pin = 32; pin <= 39; pin++)
+    {
+        if ((settings.mask & (1ULL << pin)) == 0)
+        {
+            continue;
+        }
+
+        uint8_t channel = adcChannel(pin);
+        channelMask |= 1UL << channel;
+        patterns[_channels].atten = ANALOG_ATTENUATION;
+        patterns[_channels].channel = channel;
+        patterns[_channels].unit = 0; // ADC1
+        patterns[_channels].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        _slotOfChannel[channel] = _channels;
+        _channels++;
+    }
+
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = ANALOG_DMA_BUFFER_BYTES;
+    init.conv_num_each_intr = ANALOG_DMA_FRAME_BYTES;
+    init.adc1_chan_mask = channelMask;
+    init.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&init) != ESP_OK)
+    {
+        LOG_ERROR("Analog", "Failed to initialize ADC DMA driver");
+        return false;
+    }
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true;
+    config.conv_limit_num = CONVERSION_LIMIT;
+    config.pattern_num = _channels;
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = settings.rate * settings.average * _channels;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&config) != ESP_OK)
+    {
+        adc_digi_deinitialize();
+        LOG_ERROR("Analog", "Failed to configure ADC DMA driver");
+        return false;
+    }
+
+    uint32_t samples = settings.rate * ANALOG_BLOCK_INTERVAL_MS / 1000;
+    uint32_t capacity = ANALOG_BLOCK_VALUES / _channels;
+    _samplesPerBlock = samples < 1 ? 1 : (samples > capacity ? capacity : samples);
+
+    _active = settings;
+    _rowFilled = 0;
+    _sequence = 0;
+    _emitted = 0;
+    _block.samples = 0;
+
+    _startUs = esp_timer_get_time();
+    adc_digi_start();
+
+    LOG_INFO("Analog", "Sampling %u pins at %lu Hz, %lu conversions per value", _channels,
+             static_cast<unsigned long>(settings.rate), static_cast<unsigned long>(settings.average));
+    return true;
+}
+
+void AnalogSampler::stopDriver()
+{
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    LOG_INFO("Analog", "Sampling stopped");
+}
+
+void AnalogSampler::collect(const uint8_t *data, size_t length)
+{
+    const uint8_t complete = static_cast<uint8_t>((1U << _channels) - 1);
+
+    for (size_t offset = 0; offset + sizeof(adc_digi_output_data_t) <= length;
+         offset += sizeof(adc_digi_output_data_t))
+    {
+        const adc_digi_output_data_t *result = reinterpret_cast<const adc_digi_output_data_t *>(data + offset);
+        uint8_t channel = result->type1.channel;
+        if (channel >= 8 || _slotOfChannel[channel] < 0)
+        {
+            continue;
+        }
+
+        uint8_t slot = _slotOfChannel[channel];
+        _sums[slot] += result->type1.data;
+        if (++_counts[slot] < _active.average)
+        {
+            continue;
+        }
+
+        // Rounded mean of the averaged conversions
+        _block.values[_block.samples * _channels + slot] =
+            static_cast<uint16_t>((_sums[slot] + _counts[slot] / 2) / _counts[slot]);
+        _sums[slot] = 0;
+        _counts[slot] = 0;
+
+        _rowFilled |= 1U << slot;
+        if (_rowFilled != complete)
+        {
+            continue;
+        }
+        _rowFilled = 0;
+
+        if (++_block.samples < _samplesPerBlock)
+        {
+            continue;
+        }
+
+        _block.mask = _active.mask;
+        _block.rate = _active.rate;
+        _block.sequence = _sequence++;
+        _block.timeUs = _startUs + static_cast<int64_t>(_emitted * 1000000ULL / _active.rate);
+        _emitted += _block.samples;
+        _blocks.push(_block);
+        _block.samples = 0;
+        if (_blockReady != nullptr)
+        {
+            _blockReady();
+        }
+    }
+}
+
+size_t AnalogSampler::encode(const Block &block)
+{
+    uint8_t *pins = _frame + BinaryProtocol::ANALOG_HEADER_SIZE;
+    uint8_t channels = 0;
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        if ((block.mask & (1ULL << pin)) != 0)
+        {
+            pins[channels++] = static_cast<uint8_t>(pin);
+        }
+    }
+
+    _frame[0] = BinaryProtocol::ANALOG_MAGIC;
+    _frame[1] = channels;
+    BinaryProtocol::writeU16(_frame + 2, block.samples);
+    BinaryProtocol::writeU32(_frame + 4, block.rate);
+    BinaryProtocol::writeU32(_frame + 8, block.sequence);
+    BinaryProtocol::writeU64(_frame + 12, static_cast<uint64_t>(block.timeUs));
+
+    uint8_t *values = pins + channels;
+    size_t count = static_cast<size_t>(block.samples) * channels;
+    for (size_t i = 0; i < count; i++)
+    {
+        BinaryProtocol::writeU16(values + i * 2, block.values[i]);
+    }
+    return (values + count * 2) - _frame;
+}
@@ -0,0 +1,192 @@
+#include "AsyncCommandServer.h"
+#include "Logger.h"
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+AsyncCommandServer::AsyncCommandServer(uint16_t port, CommandHandler handler,
+                                       BinaryHandler binaryHandler)
+    : _server(port),
+      _handler(handler),
+      _binaryHandler(binaryHandler),
+      _port(port),
+      _clientCount(0),
+      _lock(xSemaphoreCreateMutex())
+{
+    for (int i = 0; i < ASYNC_TCP_MAX_CLIENTS; i++)
+    {
+        _connections[i].client = nullptr;
+        _connections[i].subscribed = false;
+    }
+}
+
+AsyncCommandServer::~AsyncCommandServer()
+{
+    _server.end();
+
+    for (int i = 0; i < ASYNC_TCP_MAX_CLIENTS; i++)
+    {
+        AsyncClient *client = _connections[i].client;
+        if (client != nullptr)
+        {
+            // Detach callbacks first so nothing calls back into this object
+            client->onData(nullptr, nullptr);
+            client->onDisconnect(nullptr, nullptr);
+            client->onError(nullptr, nullptr);
+            client->onTimeout(nullptr, nullptr);
+            _connections[i].client = nullptr;
+            client->close(true);
+            delete client;
+        }
+    }
+
+    vSemaphoreDelete(_lock);
+}
+
+void AsyncCommandServer::begin()
+{
+    _server.onClient([](void *arg, AsyncClient *client)
+                     { static_cast<AsyncCommandServer *>(arg)->handleNewClient(client); },
+                     this);
+    _server.setNoDelay(true);
+    _server.begin();
+
+    LOG_INFO("AsyncTCP", "Command server started on port %d (max %d clients)",
+             _port, ASYNC_TCP_MAX_CLIENTS);
+}
+
+void AsyncCommandServer::handleNewClient(AsyncClient *client)
+{
+    // Find a free slot
+    Connection *conn = nullptr;
+    int slot = -1;
+    for (int i = 0; i < ASYNC_TCP_MAX_CLIENTS; i++)
+    {
+        if (_connections[i].client == nullptr)
+        {
+            conn = &_connections[i];
+            slot = i;
+            break;
+        }
+    }
+
+    if (conn == nullptr)
+    {
+        // No free slots, reject the connection
+        client->onDisconnect([](void *, AsyncClient *c)
+                             { delete c; });
+        sendLine(client, "ERROR: Server full");
+        client->close();
+
+        LOG_WARNING("AsyncTCP", "Rejected client (no free slots)");
+        return;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    conn->client = client;
+    conn->framer.reset();
+    conn->subscribed = false;
+    _clientCount++;
+    xSemaphoreGive(_lock);
+
+    client->setNoDelay(true);
+    client->onData([this, conn](void *, AsyncClient *, void *data, size_t len)
+                   { this->handleData(*conn, static_cast<const uint8_t *>(data), len); });
+    client->onDisconnect([this, conn](void *, AsyncClient *)
+                         { this->handleDisconnect(*conn); });
+    client->onError([](void *, AsyncClient *c, int8_t error)
+                    {
+                        LOG_WARNING("AsyncTCP", "Client error: %d", error);
+                    });
+
+    LOG_DEBUG("AsyncTCP", "New client connected (slot %d)", slot);
+
+    // Send welcome message
+    sendLine(client, "ESP32 Pin Controller Ready");
+    sendLine(client, "Type HELP for command list");
+}
+
+void AsyncCommandServer::handleData(Connection &conn, const uint8_t *data, size_t len)
+{
+    conn.framer.feed(data, len, [this, &conn](const char *line, size_t length)
+                     { this->handleLine(conn, line, length); });
+}
+
+void AsyncCommandServer::handleLine(Connection &conn, const char *line, size_t length)
+{
+    if (line == nullptr)
+    {
+        sendLine(conn.client, "{\"success\":false,\"message\":\"Command too long\"}");
+        return;
+    }
+
+    const uint8_t *frame = reinterpret_cast<const uint8_t *>(line);
+    if (BinaryProtocol::isFrame(frame, length))
+    {
+        uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+        size_t replyLength = _binaryHandler(frame, length, reply);
+        if (conn.client->connected())
+        {
+            conn.client->write(reinterpret_cast<const char *>(reply), replyLength);
+        }
+        return;
+    }
+
+    LOG_DEBUG("AsyncTCP", "Command: %s", line);
+
+    BufferPrint response(_response, sizeof(_response));
+    _handler(line, length, response, conn.subscribed);
+    if (response.overflowed())
+    {
+        sendLine(conn.client, "{\"success\":false,\"message\":\"Response too large\"}");
+        return;
+    }
+    sendLine(conn.client, response.c_str(), response.length());
+}
+
+void AsyncCommandServer::broadcast(const char *line, size_t length)
+{
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int i = 0; i < ASYNC_TCP_MAX_CLIENTS; i++)
+    {
+        if (_connections[i].client != nullptr && _connections[i].subscribed)
+        {
+            sendLine(_connections[i].client, line, length);
+        }
+    }
+    xSemaphoreGive(_lock);
+}
+
+void AsyncCommandServer::handleDisconnect(Connection &conn)
+{
+    AsyncClient *client = conn.client;
+    if (client == nullptr)
+    {
+        return;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    conn.client = nullptr;
+    conn.framer.reset();
+    conn.subscribed = false;
+    _clientCount--;
+    xSemaphoreGive(_lock);
+
+    LOG_DEBUG("AsyncTCP", "Client disconnected (slot %d)",
+              static_cast<int>(&conn - _connections));
+
+    // AsyncTCP leaves ownership of accepted clients to the application
+    delete client;
+}
+
+void AsyncCommandServer::sendLine(AsyncClient *client, const char *line, size_t length)
+{
+    if (client == nullptr || !client->connected())
+    {
+        return;
+    }
+
+    client->add(line, length);
+    client->add("\r\n", 2);
+    client->send();
+}
@@ -0,0 +1,613 @@
+#include "CommandDispatcher.h"
+#include "StatusSnapshot.h"
+#include "JsonWriter.h"
+#include "WallClock.h"
+#include "Logger.h"
+#include "PowerManager.h"
+#include "AnalogSampler.h"
+#include "LoopScheduler.h"
+
+// Shared status snapshot, refreshed by the main loop
+extern StatusSnapshot statusSnapshot;
+
+// Shared latency metrics
+extern Metrics metrics;
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// Power profile, defined in main.cpp
+extern PowerManager powerManager;
+
+// DMA ADC sampler, defined in main.cpp
+extern AnalogSampler analogSampler;
+
+// Main loop scheduler, defined in main.cpp
+extern LoopScheduler loopScheduler;
+
+namespace
+{
+    // True if table[i].type == i for every entry, so the table can be indexed
+    // by the enum value
+    template <typename Entry>
+    constexpr bool tableInOrder(const Entry *table, size_t count, size_t index = 0)
+    {
+        return index >= count ||
+               (static_cast<size_t>(table[index].type) == index && tableInOrder(table, count, index + 1));
+    }
+
+    CommandResult result(bool success, const char *message, int value = -1)
+    {
+        CommandResult r;
+        r.success = success;
+        r.message = message;
+        r.value = value;
+        r.written = false;
+        r.mode = PinMode::NOT_CONFIGURED;
+        return r;
+    }
+
+    // A loop task within its budget must not make AsyncTCP callers give up
+    static_assert(PIN_COMMAND_ASYNC_TIMEOUT_MS * 1000 > LOOP_COMMAND_BUDGET_US &&
+                      PIN_COMMAND_ASYNC_TIMEOUT_MS * 1000 > LOOP_IO_BUDGET_US &&
+                      PIN_COMMAND_ASYNC_TIMEOUT_MS * 1000 > LOOP_HOUSEKEEPING_BUDGET_US,
+                  "PIN_COMMAND_ASYNC_TIMEOUT_MS must exceed every loop task budget");
+
+    // How long a command from another task may wait for the owner
+    uint32_t pickupTimeoutMs(CommandSource source)
+    {
+        return source == CommandSource::TCP || source == CommandSource::WEB ? PIN_COMMAND_ASYNC_TIMEOUT_MS
+                                                                              : PIN_COMMAND_TIMEOUT_MS;
+    }
+}
+
+CommandDispatcher::CommandDispatcher(CommandParser &parser, PinController &pinController)
+    : _parser(parser),
+      _pinController(pinController),
+      _restartHandler(nullptr),
+      _owner(nullptr)
+{
+    for (size_t i = 0; i < PIN_COMMAND_QUEUE_SIZE; i++)
+    {
+        _jobs[i].state.store(JOB_FREE, std::memory_order_relaxed);
+    }
+}
+
+void CommandDispatcher::begin()
+{
+    _owner = xTaskGetCurrentTaskHandle();
+}
+
+void CommandDispatcher::loop()
+{
+    uint8_t index;
+    while (_queue.pop(index))
+    {
+        Job &job = _jobs[index];
+
+        uint8_t expected = JOB_QUEUED;
+        if (!job.state.compare_exchange_strong(expected, JOB_RUNNING, std::memory_order_acquire))
+        {
+            // Caller gave up while it was queued
+            job.state.store(JOB_FREE, std::memory_order_release);
+            continue;
+        }
+
+        job.result = run(*job.cmd, job.out, job.subscribed);
+
+        // The caller may reuse the slot as soon as it sees DONE
+        TaskHandle_t caller = job.caller;
+        job.state.store(JOB_DONE, std::memory_order_release);
+        xTaskNotifyGive(caller);
+    }
+}
+
+void CommandDispatcher::waitForWork(uint32_t timeoutMs)
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    loop();
+}
+
+void CommandDispatcher::setRestartHandler(void (*handler)(unsigned long delayMs))
+{
+    _restartHandler = handler;
+}
+
+void CommandDispatcher::process(const char *command, size_t length, Print &out, bool *subscribed,
+                                CommandSource source)
+{
+    Command cmd = parse(command, length, source);
+    dispatch(cmd, out, subscribed, source);
+}
+
+size_t CommandDispatcher::processBinary(const uint8_t *frame, size_t length, uint8_t *reply,
+                                        CommandSource source)
+{
+    Command cmd = parse(reinterpret_cast<const char *>(frame), length, source);
+    return executeBinary(cmd, reply, source);
+}
+
+Command CommandDispatcher::parse(const char *command, size_t length, CommandSource source)
+{
+    int64_t start = Metrics::now();
+    Command cmd = _parser.parse(command, length);
+    metrics.recordParse(source, start);
+    return cmd;
+}
+
+size_t CommandDispatcher::executeBinary(const Command &cmd, uint8_t *reply, CommandSource source)
+{
+    CommandResult r = result(false, "");
+    if (cmd.isValid())
+    {
+        r = execute(cmd, nullptr, nullptr, source);
+    }
+
+    return _parser.generateBinaryResponse(cmd, r.success, r.value, reply);
+}
+
+void CommandDispatcher::dispatch(const Command &cmd, Print &out, bool *subscribed, CommandSource source)
+{
+    if (!cmd.isValid())
+    {
+        _parser.writeResponse(out, cmd, false);
+        return;
+    }
+
+    CommandResult r = execute(cmd, &out, subscribed, source);
+    if (!r.written)
+    {
+        _parser.writeResponse(out, cmd, r.success, r.message, r.value);
+    }
+}
+
+CommandResult CommandDispatcher::execute(const Command &cmd, Print *out, bool *subscribed, CommandSource source)
+{
+    int64_t start = Metrics::now();
+    CommandResult r = _owner == nullptr || xTaskGetCurrentTaskHandle() == _owner
+                          ? run(cmd, out, subscribed)
+                          : submit(cmd, out, subscribed, pickupTimeoutMs(source));
+    metrics.recordExecute(source, start);
+    return r;
+}
+
+CommandResult CommandDispatcher::submit(const Command &cmd, Print *out, bool *subscribed, uint32_t timeoutMs)
+{
+    Job *job = nullptr;
+    for (size_t i = 0; i < PIN_COMMAND_QUEUE_SIZE && job == nullptr; i++)
+    {
+        uint8_t expected = JOB_FREE;
+        if (_jobs[i].state.compare_exchange_strong(expected, JOB_CLAIMED, std::memory_order_acquire))
+        {
+            job = &_jobs[i];
+        }
+    }
+    if (job == nullptr)
+    {
+        return result(false, "Command queue full");
+    }
+
+    job->cmd = &cmd;
+    job->out = out;
+    job->subscribed = subscribed;
+    job->caller = xTaskGetCurrentTaskHandle();
+    job->state.store(JOB_QUEUED, std::memory_order_release);
+
+    // Never full: there are as many cells as jobs
+    _queue.push(static_cast<uint8_t>(job - _jobs));
+    xTaskNotifyGive(_owner);
+
+    // At least one tick, or a short limit would give up without waiting
+    TickType_t timeout = pdMS_TO_TICKS(timeoutMs) > 0 ? pdMS_TO_TICKS(timeoutMs) : 1;
+    while (job->state.load(std::memory_order_acquire) != JOB_DONE)
+    {
+        if (ulTaskNotifyTake(pdTRUE, timeout) != 0)
+        {
+            continue;
+        }
+
+        uint8_t expected = JOB_QUEUED;
+        if (job->state.compare_exchange_strong(expected, JOB_ABANDONED, std::memory_order_acq_rel))
+        {
+            LOG_WARNING("Dispatcher", "Command %d timed out waiting for the main loop",
+                        static_cast<int>(cmd.type));
+            return result(false, "Pin controller busy");
+        }
+
+        // Already running; it finishes without further delay
+        timeout = portMAX_DELAY;
+    }
+
+    CommandResult r = job->result;
+    job->state.store(JOB_FREE, std::memory_order_release);
+    return r;
+}
+
+CommandResult CommandDispatcher::run(const Command &cmd, Print *out, bool *subscribed)
+{
+    // Indexed by CommandType; keep in enum order
+    static constexpr Entry HANDLERS[] = {
+        {CommandType::INVALID, &CommandDispatcher::handleInvalid},
+        {CommandType::SET, &CommandDispatcher::handleSet},
+        {CommandType::GET, &CommandDispatcher::handleGet},
+        {CommandType::TOGGLE, &CommandDispatcher::handleToggle},
+        {CommandType::PWM, &CommandDispatcher::handlePWM},
+        {CommandType::STATUS, &CommandDispatcher::handleStatus},
+        {CommandType::RESET, &CommandDispatcher::handleReset},
+        {CommandType::RESET_PINS, &CommandDispatcher::handleResetPins},
+        {CommandType::HELP, &CommandDispatcher::handleHelp},
+        {CommandType::BATCH, &CommandDispatcher::handleBatch},
+        {CommandType::SETMASK, &CommandDispatcher::handleSetMask},
+        {CommandType::FADE, &CommandDispatcher::handleFade},
+        {CommandType::SET_INPUT, &CommandDispatcher::handleInput},
+        {CommandType::SUBSCRIBE, &CommandDispatcher::handleSubscribe},
+        {CommandType::UNSUBSCRIBE, &CommandDispatcher::handleSubscribe},
+        {CommandType::PULSE, &CommandDispatcher::handlePulse},
+        {CommandType::AT, &CommandDispatcher::handleAt},
+        {CommandType::EVERY, &CommandDispatcher::handleEvery},
+        {CommandType::CANCEL, &CommandDispatcher::handleCancel},
+        {CommandType::METRICS, &CommandDispatcher::handleMetrics},
+        {CommandType::LOG_LEVEL, &CommandDispatcher::handleLogLevel},
+        {CommandType::PROFILE, &CommandDispatcher::handleProfile},
+        {CommandType::ANALOG, &CommandDispatcher::handleAnalog},
+        {CommandType::GROUP, &CommandDispatcher::handleGroup},
+        {CommandType::SCENE, &CommandDispatcher::handleScene},
+    };
+    static const size_t HANDLER_COUNT = sizeof(HANDLERS) / sizeof(HANDLERS[0]);
+
+    static_assert(HANDLER_COUNT == COMMAND_TYPE_COUNT, "Every CommandType needs a handler");
+    static_assert(tableInOrder(HANDLERS, HANDLER_COUNT), "Handler table must be in CommandType order");
+
+    // Only the UDP server holds commands until their apply time
+    if (cmd.applyAt != 0)
+    {
+        return result(false, "Scheduled apply is only supported over UDP");
+    }
+
+    size_t index = static_cast<size_t>(cmd.type);
+    if (index >= HANDLER_COUNT)
+    {
+        return result(false, "Unknown command");
+    }
+
+    return (this->*HANDLERS[index].handler)(cmd, out, subscribed);
+}
+
+CommandResult CommandDispatcher::handleInvalid(const Command &cmd, Print *out, bool *subscribed)
+{
+    return result(false, "Unknown command");
+}
+
+CommandResult CommandDispatcher::handleSet(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.setDigital(cmd.pin, cmd.value);
+    return result(success, success ? "Pin set successfully" : "Failed to set pin", cmd.value);
+}
+
+CommandResult CommandDispatcher::handleGet(const Command &cmd, Print *out, bool *subscribed)
+{
+    // Taken before the read, which sets up an unconfigured pin as an input.
+    // Callers in other tasks get the mode from here, not from PinController.
+    PinMode mode = _pinController.isPinConfigured(cmd.pin) ? _pinController.getPinMode(cmd.pin)
+                                                            : PinMode::NOT_CONFIGURED;
+
+    // Reading a PWM pin digitally would reconfigure it as an input
+    int value = mode == PinMode::PWM_OUTPUT ? _pinController.getPWM(cmd.pin) : _pinController.getDigital(cmd.pin);
+    bool success = value >= 0;
+    CommandResult r = result(success, success ? "Pin value retrieved" : "Failed to get pin value", value);
+    r.mode = mode;
+    return r;
+}
+
+CommandResult CommandDispatcher::handleToggle(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (!_pinController.toggle(cmd.pin))
+    {
+        return result(false, "Failed to toggle pin");
+    }
+    return result(true, "Pin toggled successfully", _pinController.getDigital(cmd.pin));
+}
+
+CommandResult CommandDispatcher::handlePWM(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.setPWM(cmd.pin, cmd.value, cmd.frequency, cmd.resolution);
+    return result(success, success ? "PWM set successfully" : "Failed to set PWM", cmd.value);
+}
+
+CommandResult CommandDispatcher::handleStatus(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (out == nullptr)
+    {
+        return result(false, "Status not available here");
+    }
+
+    writeStatus(*out);
+    CommandResult r = result(true, "");
+    r.written = true;
+    return r;
+}
+
+CommandResult CommandDispatcher::handleReset(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (_restartHandler == nullptr)
+    {
+        return result(false, "Restart not available");
+    }
+
+    // Delayed so the response still reaches the sender
+    _restartHandler(2000);
+    return result(true, "System will restart in 2 seconds");
+}
+
+CommandResult CommandDispatcher::handleResetPins(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.resetAllPins();
+    return result(success, success ? "All pins reset to LOW" : "Failed to reset pins");
+}
+
+CommandResult CommandDispatcher::handleHelp(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (out == nullptr)
+    {
+        return result(false, "Help not available here");
+    }
+
+    _parser.writeHelpText(*out);
+    CommandResult r = result(true, "");
+    r.written = true;
+    return r;
+}
+
+CommandResult CommandDispatcher::handleBatch(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.applyBatch(cmd.batch, cmd.batchCount);
+    return result(success, success ? "Batch applied successfully" : "Batch rejected, no pins changed",
+                  cmd.batchCount);
+}
+
+CommandResult CommandDispatcher::handleSetMask(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.setDigitalMask(cmd.setMask, cmd.clearMask);
+    return result(success, success ? "Pin mask applied successfully" : "Failed to apply pin mask",
+                  __builtin_popcountll(cmd.setMask | cmd.clearMask));
+}
+
+CommandResult CommandDispatcher::handleFade(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.fadePWM(cmd.pin, cmd.value, cmd.duration, cmd.curve);
+    return result(success, success ? "Fade started" : "Failed to start fade", cmd.value);
+}
+
+CommandResult CommandDispatcher::handleInput(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.configureInput(cmd.pin, cmd.pull, cmd.debounceMs);
+    return result(success, success ? "Input configured" : "Failed to configure input",
+                  success ? _pinController.getDigital(cmd.pin) : -1);
+}
+
+CommandResult CommandDispatcher::handleSubscribe(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (subscribed == nullptr)
+    {
+        return result(false, "Subscriptions not supported here");
+    }
+
+    *subscribed = cmd.type == CommandType::SUBSCRIBE;
+    return result(true, *subscribed ? "Subscribed to input events" : "Unsubscribed from input events");
+}
+
+CommandResult CommandDispatcher::handlePulse(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success = _pinController.pulse(cmd.pin, cmd.duration * 1000);
+    return result(success, success ? "Pulse started" : "Failed to start pulse", cmd.duration);
+}
+
+CommandResult CommandDispatcher::handleAt(const Command &cmd, Print *out, bool *subscribed)
+{
+    uint32_t delayMs = cmd.timerMs;
+    if (cmd.atTime != 0)
+    {
+        uint64_t now;
+        if (!WallClock::nowMs(now))
+        {
+            return result(false, "Clock not synchronized");
+        }
+        if (cmd.atTime > now + TIMER_MAX_DELAY_MS)
+        {
+            return result(false, "AT time too far ahead");
+        }
+
+        // A time already passed runs on the next loop pass
+        delayMs = cmd.atTime > now ? static_cast<uint32_t>(cmd.atTime - now) : 0;
+    }
+
+    int id = _pinController.scheduleOp(cmd.batch[0], delayMs);
+    return result(id > 0, id > 0 ? "Timer scheduled" : "Failed to schedule timer", id);
+}
+
+CommandResult CommandDispatcher::handleEvery(const Command &cmd, Print *out, bool *subscribed)
+{
+    int id = _pinController.scheduleOp(cmd.batch[0], cmd.timerMs, cmd.timerMs);
+    return result(id > 0, id > 0 ? "Timer scheduled" : "Failed to schedule timer", id);
+}
+
+CommandResult CommandDispatcher::handleCancel(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (cmd.value < 0)
+    {
+        int pending = static_cast<int>(_pinController.getPendingTimers());
+        _pinController.cancelAllTimers();
+        return result(true, "All timers cancelled", pending);
+    }
+
+    bool success = _pinController.cancelTimer(cmd.value);
+    return result(success, success ? "Timer cancelled" : "No such timer", cmd.value);
+}
+
+CommandResult CommandDispatcher::handleMetrics(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (out == nullptr)
+    {
+        return result(false, "Metrics not available here");
+    }
+
+    JsonWriter json(*out);
+    json.beginObject().field("success", true).field("command", "METRICS");
+    metrics.writeJsonFields(json);
+    json.key("loopTasks");
+    loopScheduler.writeTasks(json);
+    json.endObject();
+
+    CommandResult r = result(true, "");
+    r.written = true;
+    return r;
+}
+
+CommandResult CommandDispatcher::handleLogLevel(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (cmd.value >= 0)
+    {
+        logger.setLevel(static_cast<LogLevel>(cmd.value));
+    }
+
+    LogLevel level = logger.level();
+    return result(true, Logger::levelName(level), static_cast<int>(level));
+}
+
+CommandResult CommandDispatcher::handleProfile(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (cmd.value >= 0)
+    {
+        powerManager.setProfile(static_cast<PowerProfile>(cmd.value));
+    }
+
+    PowerProfile profile = powerManager.getProfile();
+    return result(true, PowerManager::profileName(profile), static_cast<int>(profile));
+}
+
+CommandResult CommandDispatcher::handleAnalog(const Command &cmd, Print *out, bool *subscribed)
+{
+    if (cmd.frequency == 0)
+    {
+        analogSampler.stop();
+        return result(true, "Analog sampling stopped");
+    }
+
+    // ANALOG_PINS and SAFE_PINS are disjoint, so no pin mode can conflict
+    const char *error = "";
+    if (!analogSampler.start(cmd.setMask, cmd.frequency, static_cast<uint32_t>(cmd.value), error))
+    {
+        return result(false, error);
+    }
+    return result(true, "Analog sampling started", static_cast<int>(analogSampler.getAverage()));
+}
+
+CommandResult CommandDispatcher::handleGroup(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success;
+    switch (cmd.action)
+    {
+    case SceneAction::LIST:
+    {
+        if (out == nullptr)
+        {
+            return result(false, "Group list not available here");
+        }
+
+        JsonWriter json(*out);
+        json.beginObject().field("success", true).field("command", "GROUP").key("groups");
+        _pinController.writeGroups(json);
+        json.endObject();
+
+        CommandResult r = result(true, "");
+        r.written = true;
+        return r;
+    }
+
+    case SceneAction::DEFINE:
+        success = _pinController.defineGroup(cmd.name, cmd.setMask);
+        return result(success, success ? "Group defined" : "Group table full",
+                      __builtin_popcountll(cmd.setMask));
+
+    case SceneAction::DELETE:
+        success = _pinController.deleteGroup(cmd.name);
+        return result(success, success ? "Group deleted" : "Unknown group");
+
+    default:
+        if (!_pinController.hasGroup(cmd.name))
+        {
+            return result(false, "Unknown group");
+        }
+        success = _pinController.applyGroup(cmd.name, cmd.value, cmd.groupPWM);
+        return result(success, success ? "Group applied" : "Failed to apply group", cmd.value);
+    }
+}
+
+CommandResult CommandDispatcher::handleScene(const Command &cmd, Print *out, bool *subscribed)
+{
+    bool success;
+    switch (cmd.action)
+    {
+    case SceneAction::LIST:
+    {
+        if (out == nullptr)
+        {
+            return result(false, "Scene list not available here");
+        }
+
+        JsonWriter json(*out);
+        json.beginObject().field("success", true).field("command", "SCENE").key("scenes");
+        _pinController.writeScenes(json);
+        json.endObject();
+
+        CommandResult r = result(true, "");
+        r.written = true;
+        return r;
+    }
+
+    case SceneAction::DEFINE:
+        success = _pinController.defineScene(cmd.name, cmd.batch, cmd.batchCount);
+        return result(success, success ? "Scene defined" : "Failed to define scene", cmd.batchCount);
+
+    case SceneAction::SAVE:
+        success = _pinController.saveScene(cmd.name);
+        return result(success, success ? "Scene saved" : "Failed to save scene");
+
+    case SceneAction::DELETE:
+        success = _pinController.deleteScene(cmd.name);
+        return result(success, success ? "Scene deleted" : "Unknown scene");
+
+    default:
+        if (!_pinController.hasScene(cmd.name))
+        {
+            return result(false, "Unknown scene");
+        }
+        success = _pinController.recallScene(cmd.name);
+        return result(success, success ? "Scene recalled" : "Failed to recall scene");
+    }
+}
+
+void CommandDispatcher::writeStatus(Print &out)
+{
+    StatusSnapshot::Data status = statusSnapshot.get();
+    JsonWriter json(out);
+
+    json.beginObject();
+    json.field("success", true).field("command", "STATUS");
+
+    StatusSnapshot::writeSystem(json, status);
+    StatusSnapshot::writeWiFi(json, status);
+
+    json.beginObject("server")
+        .field("tcpPort", TCP_SERVER_PORT)
+        .field("udpPort", UDP_SERVER_PORT)
+        .field("tcpClients", status.tcpClients)
+        .endObject();
+
+    json.key("pinStates");
+    _pinController.writePinStates(json, _pinController.getConfiguredPins());
+
+    StatusSnapshot::writeWatchdog(json, status);
+
+    json.endObject();
+}
@@ -1,40 +1,359 @@
 #include "CommandParser.h"
+#include "JsonWriter.h"
+#include "WallClock.h"
+#include "Logger.h"
+#include "PowerManager.h"
+
+namespace
+{
+    // Skip whitespace and return the next whitespace-delimited token
+    bool nextToken(const char *&cursor, const char *end, const char *&token, size_t &tokenLength)
+    {
+        while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+        {
+            cursor++;
+        }
+
+        if (cursor >= end)
+        {
+            return false;
+        }
+
+        token = cursor;
+        while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+        {
+            cursor++;
+        }
+        tokenLength = cursor - token;
+        return true;
+    }
+
+    // Parse a whole token as a decimal integer
+    bool parseInteger(const char *token, size_t length, int &out)
+    {
+        char buffer[16];
+        if (length == 0 || length >= sizeof(buffer))
+        {
+            return false;
+        }
+
+        memcpy(buffer, token, length);
+        buffer[length] = '\0';
+
+        char *endPtr;
+        long value = strtol(buffer, &endPtr, 10);
+        if (*endPtr != '\0')
+        {
+            return false;
+        }
+
+        out = static_cast<int>(value);
+        return true;
+    }
+
+    // Parse a whole token as an unsigned 64-bit mask (decimal, or hex with 0x)
+    bool parseMask(const char *token, size_t length, uint64_t &out)
+    {
+        char buffer[24];
+        if (length == 0 || length >= sizeof(buffer) || token[0] == '-')
+        {
+            return false;
+        }
+
+        memcpy(buffer, token, length);
+        buffer[length] = '\0';
+
+        char *endPtr;
+        unsigned long long value = strtoull(buffer, &endPtr, 0);
+        if (*endPtr != '\0')
+        {
+            return false;
+        }
+
+        out = value;
+        return true;
+    }
+
+    // Read a mask given as a JSON number or a numeric string
+    bool jsonToMask(JsonVariantConst field, uint64_t &out)
+    {
+        if (field.is<const char *>())
+        {
+            const char *str = field.as<const char *>();
+            return parseMask(str, strlen(str), out);
+        }
+        if (field.is<uint64_t>())
+        {
+            out = field.as<uint64_t>();
+            return true;
+        }
+        return false;
+    }
+
+    // Parse a fade curve name (case-insensitive)
+    bool parseCurve(const char *token, size_t length, FadeCurve &out)
+    {
+        struct Entry
+        {
+            const char *name;
+            FadeCurve curve;
+        };
+        static const Entry CURVES[] = {
+            {"LINEAR", FadeCurve::LINEAR},
+            {"EASE", FadeCurve::EASE},
+            {"GAMMA", FadeCurve::GAMMA},
+        };
+
+        for (const Entry &entry : CURVES)
+        {
+            if (strlen(entry.name) == length && strncasecmp(entry.name, token, length) == 0)
+            {
+                out = entry.curve;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parse an input pull mode name (case-insensitive)
+    bool parsePull(const char *token, size_t length, InputPull &out)
+    {
+        struct Entry
+        {
+            const char *name;
+            InputPull pull;
+        };
+        static const Entry PULLS[] = {
+            {"NONE", InputPull::NONE},
+            {"PULLUP", InputPull::PULLUP},
+            {"PULLDOWN", InputPull::PULLDOWN},
+        };
+
+        for (const Entry &entry : PULLS)
+        {
+            if (strlen(entry.name) == length && strncasecmp(entry.name, token, length) == 0)
+            {
+                out = entry.pull;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parse a log level name (case-insensitive)
+    bool parseLogLevel(const char *token, size_t length, LogLevel &out)
+    {
+        struct Entry
+        {
+            const char *name;
+            LogLevel level;
+        };
+        static const Entry LEVELS[] = {
+            {"NONE", LogLevel::NONE},
+            {"ERROR", LogLevel::ERROR},
+            {"WARNING", LogLevel::WARNING},
+            {"INFO", LogLevel::INFO},
+            {"DEBUG", LogLevel::DEBUG},
+        };
+
+        for (const Entry &entry : LEVELS)
+        {
+            if (strlen(entry.name) == length && strncasecmp(entry.name, token, length) == 0)
+            {
+                out = entry.level;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parse a power profile name (case-insensitive)
+    bool parseProfile(const char *token, size_t length, PowerProfile &out)
+    {
+        struct Entry
+        {
+            const char *name;
+            PowerProfile profile;
+        };
+        static const Entry PROFILES[] = {
+            {"low-latency", PowerProfile::LOW_LATENCY},
+            {"balanced", PowerProfile::BALANCED},
+            {"low-power", PowerProfile::LOW_POWER},
+        };
+
+        for (const Entry &entry : PROFILES)
+        {
+            if (strlen(entry.name) == length && strncasecmp(entry.name, token, length) == 0)
+            {
+                out = entry.profile;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Parse a comma-separated pin list ("34,35") into a mask
+    bool parsePinList(const char *token, size_t length, uint64_t &out)
+    {
+        out = 0;
+        const char *end = token + length;
+        while (token < end)
+        {
+            const char *comma = static_cast<const char *>(memchr(token, ',', end - token));
+            const char *itemEnd = comma != nullptr ? comma : end;
+
+            int pin;
+            if (!parseInteger(token, itemEnd - token, pin) || pin < 0 || pin >= GPIO_PIN_COUNT)
+            {
+                return false;
+            }
+            out |= 1ULL << pin;
+
+            token = comma != nullptr ? comma + 1 : end;
+        }
+        return out != 0;
+    }
+
+    // Parse a GROUP / SCENE action keyword (case-insensitive)
+    bool parseSceneAction(const char *token, size_t length, SceneAction &out)
+    {
+        struct Entry
+        {
+            const char *name;
+            SceneAction action;
+        };
+        static const Entry ACTIONS[] = {
+            {"DEFINE", SceneAction::DEFINE},
+            {"SAVE", SceneAction::SAVE},
+            {"DELETE", SceneAction::DELETE},
+        };
+
+        for (const Entry &entry : ACTIONS)
+        {
+            if (strlen(entry.name) == length && strncasecmp(entry.name, token, length) == 0)
+            {
+                out = entry.action;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copy a group / scene name into out: letters, digits, '_' and '-', not
+    // an action keyword or PWM
+    bool parseSceneName(const char *token, size_t length, char *out)
+    {
+        if (length == 0 || length >= SCENE_NAME_LENGTH)
+        {
+            return false;
+        }
+
+        SceneAction action;
+        if (parseSceneAction(token, length, action) ||
+            (length == 3 && strncasecmp(token, "PWM", 3) == 0))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            char c = token[i];
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-')
+            {
+                return false;
+            }
+        }
+        memcpy(out, token, length);
+        out[length] = '\0';
+        return true;
+    }
+
+    // Collect a JSON pin array into a mask
+    bool jsonToPinMask(JsonArrayConst pins, uint64_t &out)
+    {
+        out = 0;
+        for (JsonVariantConst pinVar : pins)
+        {
+            int pin = pinVar | -1;
+            if (pin < 0 || pin >= GPIO_PIN_COUNT)
+            {
+                return false;
+            }
+            out |= 1ULL << pin;
+        }
+        return true;
+    }
+
+    // Build a String from a view (error paths only)
+    String viewToString(const char *data, size_t length)
+    {
+        String result;
+        result.concat(data, length);
+        return result;
+    }
+}
 
 CommandParser::CommandParser()
 {
 }
 
 Command CommandParser::parse(const String &commandString)
+{
+    return parse(commandString.c_str(), commandString.length());
+}
+
+Command CommandParser::parse(const char *data, size_t length)
 {
     Command cmd;
 
-    if (commandString.length() == 0)
+    if (data == nullptr || length == 0)
     {
         cmd.errorMessage = "Empty command";
         return cmd;
     }
 
+    // Binary frames must be detected before trimming, payload bytes may look
+    // like whitespace
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    if (BinaryProtocol::isFrame(bytes, length))
+    {
+        return parseBinary(bytes, length);
+    }
+
     // Trim whitespace
-    String trimmed = commandString;
-    trimmed.trim();
+    while (length > 0 && isspace(static_cast<unsigned char>(*data)))
+    {
+        data++;
+        length--;
+    }
+    while (length > 0 && isspace(static_cast<unsigned char>(data[length - 1])))
+    {
+        length--;
+    }
+
+    if (length == 0)
+    {
+        cmd.errorMessage = "Empty command";
+        return cmd;
+    }
 
     // Auto-detect format (JSON starts with '{')
-    if (trimmed.startsWith("{"))
+    if (data[0] == '{')
     {
-        return parseJSON(trimmed);
+        return parseJSON(data, length);
     }
     else
     {
-        return parseText(trimmed);
+        return parseText(data, length);
     }
 }
 
-Command CommandParser::parseJSON(const String &jsonString)
+Command CommandParser::parseJSON(const char *data, size_t length)
 {
     Command cmd;
 
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonString);
+    DeserializationError error = deserializeJson(doc, data, length);
 
     if (error)
     {
@@ -43,22 +362,32 @@ Command CommandParser::parseJSON(const String &jsonString)
     }
 
     // Get command type
-    if (!doc.containsKey("cmd"))
+    const char *cmdStr = doc["cmd"].as<const char *>();
+    if (cmdStr == nullptr)
     {
         cmd.errorMessage = "Missing 'cmd' field";
         return cmd;
     }
 
-    String cmdStr = doc["cmd"].as<String>();
-    cmdStr.toUpperCase();
-    cmd.type = stringToCommandType(cmdStr);
+    cmd.type = stringToCommandType(cmdStr, strlen(cmdStr));
 
     if (cmd.type == CommandType::INVALID)
     {
-        cmd.errorMessage = "Invalid command type: " + cmdStr;
+        cmd.errorMessage = "Invalid command type: " + String(cmdStr);
         return cmd;
     }
 
+    cmd.format = CommandFormat::JSON;
+
+    // Optional UDP sequencing and fire-and-forget
+    if (doc["seq"].is<unsigned int>())
+    {
+        cmd.sequence = static_cast<uint16_t>(doc["seq"].as<unsigned int>());
+        cmd.sequenced = true;
+    }
+    cmd.noReply = doc["ack"].is<bool>() && !doc["ack"].as<bool>();
+    cmd.applyAt = doc["at"] | 0ULL;
+
     // Parse parameters based on command type
     switch (cmd.type)
     {
@@ -74,13 +403,6 @@ Command CommandParser::parseJSON(const String &jsonString)
         }
         cmd.pin = doc["pin"];
 
-        if (!isValidPin(cmd.pin))
-        {
-            cmd.errorMessage = "Invalid pin number: " + String(cmd.pin);
-            cmd.type = CommandType::INVALID;
-            return cmd;
-        }
-
         // SET and PWM require value
         if (cmd.type == CommandType::SET || cmd.type == CommandType::PWM)
         {
@@ -91,250 +413,1549 @@ Command CommandParser::parseJSON(const String &jsonString)
                 return cmd;
             }
             cmd.value = doc["value"];
+        }
 
-            // Validate value range
-            if (cmd.type == CommandType::SET && (cmd.value != 0 && cmd.value != 1))
-            {
-                cmd.errorMessage = "SET value must be 0 or 1";
-                cmd.type = CommandType::INVALID;
-                return cmd;
-            }
-            if (cmd.type == CommandType::PWM && (cmd.value < 0 || cmd.value > 255))
+        if (cmd.type == CommandType::PWM)
+        {
+            cmd.frequency = doc["freq"] | 0;
+            cmd.resolution = doc["resolution"] | 0;
+        }
+
+        validatePinCommand(cmd);
+        break;
+
+    case CommandType::BATCH:
+    {
+        JsonArray ops = doc["ops"].as<JsonArray>();
+        if (ops.isNull())
+        {
+            cmd.errorMessage = "Missing 'ops' array";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        for (JsonObject opObj : ops)
+        {
+            Command op = parseJSONOp(opObj);
+            if (!addBatchOp(cmd, op))
             {
-                cmd.errorMessage = "PWM value must be 0-255";
-                cmd.type = CommandType::INVALID;
                 return cmd;
             }
         }
-        break;
-
-    case CommandType::STATUS:
-    case CommandType::RESET:
-    case CommandType::RESET_PINS:
-    case CommandType::HELP:
-        // These commands don't require parameters
-        break;
 
-    default:
-        cmd.errorMessage = "Unknown command type";
-        cmd.type = CommandType::INVALID;
+        if (cmd.batchCount == 0)
+        {
+            cmd.errorMessage = "BATCH requires at least one op";
+            cmd.type = CommandType::INVALID;
+        }
         break;
     }
 
-    return cmd;
-}
-
-Command CommandParser::parseText(const String &textString)
-{
-    Command cmd;
-
-    // Split command into tokens
-    String text = textString;
-    text.toUpperCase();
-
-    int firstSpace = text.indexOf(' ');
-    String cmdStr;
-    String params;
-
-    if (firstSpace == -1)
-    {
-        cmdStr = text;
-        params = "";
-    }
-    else
+    case CommandType::FADE:
     {
-        cmdStr = text.substring(0, firstSpace);
-        params = text.substring(firstSpace + 1);
-    }
-
-    cmdStr.trim();
-    params.trim();
+        if (!doc.containsKey("pin") || !doc.containsKey("value") || !doc.containsKey("duration"))
+        {
+            cmd.errorMessage = "Missing 'pin', 'value' or 'duration' field";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.pin = doc["pin"];
+        cmd.value = doc["value"];
+        cmd.duration = doc["duration"];
 
-    cmd.type = stringToCommandType(cmdStr);
+        const char *curveStr = doc["curve"] | "LINEAR";
+        if (!parseCurve(curveStr, strlen(curveStr), cmd.curve))
+        {
+            cmd.errorMessage = "Invalid curve: " + String(curveStr);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
 
-    if (cmd.type == CommandType::INVALID)
-    {
-        cmd.errorMessage = "Invalid command: " + cmdStr;
-        return cmd;
+        validatePinCommand(cmd);
+        break;
     }
 
-    // Parse parameters based on command type
-    switch (cmd.type)
-    {
-    case CommandType::SET:
-    case CommandType::PWM:
+    case CommandType::SET_INPUT:
     {
-        // Format: SET pin value  or  PWM pin value
-        int spacePos = params.indexOf(' ');
-        if (spacePos == -1)
+        if (!doc.containsKey("pin"))
         {
-            cmd.errorMessage = "Missing parameters (expected: pin value)";
+            cmd.errorMessage = "Missing 'pin' field";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
+        cmd.pin = doc["pin"];
 
-        String pinStr = params.substring(0, spacePos);
-        String valueStr = params.substring(spacePos + 1);
-        pinStr.trim();
-        valueStr.trim();
-
-        cmd.pin = pinStr.toInt();
-        cmd.value = valueStr.toInt();
+        const char *pullStr = doc["pull"] | "NONE";
+        if (!parsePull(pullStr, strlen(pullStr), cmd.pull))
+        {
+            cmd.errorMessage = "Invalid pull: " + String(pullStr);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
 
-        if (!isValidPin(cmd.pin))
+        int debounce = doc["debounce"] | INPUT_DEFAULT_DEBOUNCE_MS;
+        if (debounce < 0 || debounce > 65535)
         {
-            cmd.errorMessage = "Invalid pin number: " + String(cmd.pin);
+            cmd.errorMessage = "Invalid debounce time";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
+        cmd.debounceMs = debounce;
 
-        if (cmd.type == CommandType::SET && (cmd.value != 0 && cmd.value != 1))
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::SETMASK:
+        if (!doc["set"].isNull() && !jsonToMask(doc["set"], cmd.setMask))
         {
-            cmd.errorMessage = "SET value must be 0 or 1";
+            cmd.errorMessage = "Invalid 'set' mask";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
-        if (cmd.type == CommandType::PWM && (cmd.value < 0 || cmd.value > 255))
+        if (!doc["clear"].isNull() && !jsonToMask(doc["clear"], cmd.clearMask))
         {
-            cmd.errorMessage = "PWM value must be 0-255";
+            cmd.errorMessage = "Invalid 'clear' mask";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
+
+        validateMaskCommand(cmd);
         break;
-    }
 
-    case CommandType::GET:
-    case CommandType::TOGGLE:
-    {
-        // Format: GET pin  or  TOGGLE pin
-        if (params.length() == 0)
+    case CommandType::PULSE:
+        if (!doc.containsKey("pin") || !doc.containsKey("duration"))
         {
-            cmd.errorMessage = "Missing pin parameter";
+            cmd.errorMessage = "Missing 'pin' or 'duration' field";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
+        cmd.pin = doc["pin"];
+        cmd.duration = doc["duration"];
 
-        cmd.pin = params.toInt();
+        validatePinCommand(cmd);
+        break;
 
-        if (!isValidPin(cmd.pin))
+    case CommandType::AT:
+    case CommandType::EVERY:
+    {
+        JsonObjectConst opObj = doc["do"].as<JsonObjectConst>();
+        if (opObj.isNull())
         {
-            cmd.errorMessage = "Invalid pin number: " + String(cmd.pin);
+            cmd.errorMessage = "Missing 'do' object";
             cmd.type = CommandType::INVALID;
             return cmd;
         }
-        break;
-    }
 
-    case CommandType::STATUS:
-    case CommandType::RESET:
-    case CommandType::RESET_PINS:
-    case CommandType::HELP:
-        // No parameters needed
-        break;
+        const char *timeField = "interval";
+        if (cmd.type == CommandType::AT)
+        {
+            timeField = doc.containsKey("time") ? "time" : "delay";
+        }
+        if (!doc[timeField].is<uint64_t>())
+        {
+            cmd.errorMessage = cmd.type == CommandType::EVERY ? "Missing 'interval' field"
+                                                              : "Missing 'delay' or 'time' field";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        uint64_t time = doc[timeField].as<uint64_t>();
+        if (timeField[0] == 't')
+        {
+            cmd.atTime = time;
+        }
+        else
+        {
+            cmd.timerMs = time > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : static_cast<uint32_t>(time);
+        }
 
-    default:
-        cmd.errorMessage = "Unknown command";
-        cmd.type = CommandType::INVALID;
+        if (validateTimerCommand(cmd))
+        {
+            setTimedOp(cmd, parseJSONOp(opObj));
+        }
         break;
     }
 
-    return cmd;
-}
-
-String CommandParser::generateResponse(const Command &cmd, bool success,
-                                       const String &message, int resultValue)
-{
-    JsonDocument doc;
+    case CommandType::CANCEL:
+        if (doc["id"].is<int>() && doc["id"].as<int>() > 0)
+        {
+            cmd.value = doc["id"];
+        }
+        else if (doc["id"].is<const char *>() && strcasecmp(doc["id"].as<const char *>(), "ALL") == 0)
+        {
+            cmd.value = -1;
+        }
+        else
+        {
+            cmd.errorMessage = "Missing 'id' field (timer id or \"ALL\")";
+            cmd.type = CommandType::INVALID;
+        }
+        break;
+
+    case CommandType::LOG_LEVEL:
+    {
+        // value -1 = query
+        cmd.value = -1;
+        if (doc.containsKey("level"))
+        {
+            const char *levelStr = doc["level"] | "";
+            LogLevel level;
+            if (!parseLogLevel(levelStr, strlen(levelStr), level))
+            {
+                cmd.errorMessage = "Invalid level: " + String(levelStr);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.value = static_cast<int>(level);
+        }
+        break;
+    }
+
+    case CommandType::PROFILE:
+    {
+        // value -1 = query
+        cmd.value = -1;
+        if (doc.containsKey("profile"))
+        {
+            const char *profileStr = doc["profile"] | "";
+            PowerProfile profile;
+            if (!parseProfile(profileStr, strlen(profileStr), profile))
+            {
+                cmd.errorMessage = "Invalid profile: " + String(profileStr);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.value = static_cast<int>(profile);
+        }
+        break;
+    }
+
+    case CommandType::ANALOG:
+    {
+        if (!doc.containsKey("rate"))
+        {
+            cmd.errorMessage = "Missing 'rate' field (0 to stop)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        long rate = doc["rate"] | -1L;
+        if (rate < 0)
+        {
+            cmd.errorMessage = "Invalid rate";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.frequency = static_cast<uint32_t>(rate);
+        cmd.value = doc["average"] | 0;
+
+        if (!jsonToPinMask(doc["pins"].as<JsonArrayConst>(), cmd.setMask))
+        {
+            cmd.errorMessage = "Invalid pin in 'pins'";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        validateAnalogCommand(cmd);
+        break;
+    }
+
+    case CommandType::GROUP:
+    case CommandType::SCENE:
+    {
+        // The action is the key holding the name; no name lists
+        struct Entry
+        {
+            const char *key;
+            SceneAction action;
+        };
+        static const Entry KEYS[] = {
+            {"name", SceneAction::RECALL},
+            {"define", SceneAction::DEFINE},
+            {"save", SceneAction::SAVE},
+            {"delete", SceneAction::DELETE},
+        };
+
+        for (const Entry &entry : KEYS)
+        {
+            if (!doc.containsKey(entry.key))
+            {
+                continue;
+            }
+
+            const char *name = doc[entry.key] | "";
+            if (!parseSceneName(name, strlen(name), cmd.name))
+            {
+                cmd.errorMessage = "Invalid name: " + String(name);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.action = entry.action;
+            break;
+        }
+
+        if (cmd.type == CommandType::GROUP && cmd.action == SceneAction::DEFINE &&
+            !jsonToPinMask(doc["pins"].as<JsonArrayConst>(), cmd.setMask))
+        {
+            cmd.errorMessage = "Invalid pin in 'pins'";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (cmd.type == CommandType::GROUP && cmd.action == SceneAction::RECALL)
+        {
+            if (!doc.containsKey("value"))
+            {
+                cmd.errorMessage = "Missing 'value' field";
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.value = doc["value"];
+            cmd.groupPWM = doc["pwm"] | false;
+        }
+
+        if (cmd.type == CommandType::SCENE && cmd.action == SceneAction::DEFINE)
+        {
+            for (JsonObjectConst opObj : doc["ops"].as<JsonArrayConst>())
+            {
+                Command op = parseJSONOp(opObj);
+                if (!addBatchOp(cmd, op))
+                {
+                    return cmd;
+                }
+            }
+        }
+
+        validateSceneCommand(cmd);
+        break;
+    }
+
+    case CommandType::STATUS:
+    case CommandType::RESET:
+    case CommandType::RESET_PINS:
+    case CommandType::HELP:
+    case CommandType::SUBSCRIBE:
+    case CommandType::UNSUBSCRIBE:
+    case CommandType::METRICS:
+        // These commands don't require parameters
+        break;
+
+    default:
+        cmd.errorMessage = "Unknown command type";
+        cmd.type = CommandType::INVALID;
+        break;
+    }
+
+    return cmd;
+}
+
+Command CommandParser::parseText(const char *data, size_t length)
+{
+    Command cmd;
+
+    // Split command into tokens
+    const char *cursor = data;
+    const char *end = data + length;
+    const char *cmdStr;
+    size_t cmdLength;
+
+    if (!nextToken(cursor, end, cmdStr, cmdLength))
+    {
+        cmd.errorMessage = "Empty command";
+        return cmd;
+    }
+
+    cmd.type = stringToCommandType(cmdStr, cmdLength);
+
+    if (cmd.type == CommandType::INVALID)
+    {
+        cmd.errorMessage = "Invalid command: " + viewToString(cmdStr, cmdLength);
+        return cmd;
+    }
+
+    const char *token;
+    size_t tokenLength;
+
+    // Parse parameters based on command type
+    switch (cmd.type)
+    {
+    case CommandType::SET:
+    case CommandType::PWM:
+    {
+        // Format: SET pin value  or  PWM pin value
+        const char *pinStr;
+        size_t pinLength;
+        if (!nextToken(cursor, end, pinStr, pinLength) ||
+            !nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: pin value)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseInteger(pinStr, pinLength, cmd.pin))
+        {
+            cmd.errorMessage = "Invalid pin number: " + viewToString(pinStr, pinLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseInteger(token, tokenLength, cmd.value))
+        {
+            cmd.errorMessage = "Invalid value: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        // Optional for PWM: frequency [resolution]
+        if (cmd.type == CommandType::PWM && nextToken(cursor, end, token, tokenLength))
+        {
+            int frequency;
+            if (!parseInteger(token, tokenLength, frequency) || frequency <= 0)
+            {
+                cmd.errorMessage = "Invalid frequency: " + viewToString(token, tokenLength);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.frequency = frequency;
+
+            if (nextToken(cursor, end, token, tokenLength))
+            {
+                int resolution;
+                if (!parseInteger(token, tokenLength, resolution) || resolution <= 0 || resolution > 255)
+                {
+                    cmd.errorMessage = "Invalid resolution: " + viewToString(token, tokenLength);
+                    cmd.type = CommandType::INVALID;
+                    return cmd;
+                }
+                cmd.resolution = resolution;
+            }
+        }
+
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::GET:
+    case CommandType::TOGGLE:
+    {
+        // Format: GET pin  or  TOGGLE pin
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing pin parameter";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseInteger(token, tokenLength, cmd.pin))
+        {
+            cmd.errorMessage = "Invalid pin number: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::BATCH:
+        // Format: BATCH op; op; ...
+        parseTextBatch(cmd, cursor, end - cursor);
+        break;
+
+    case CommandType::FADE:
+    {
+        // Format: FADE pin target duration [curve]
+        const char *pinStr;
+        size_t pinLength;
+        const char *targetStr;
+        size_t targetLength;
+        if (!nextToken(cursor, end, pinStr, pinLength) ||
+            !nextToken(cursor, end, targetStr, targetLength) ||
+            !nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: pin target duration [curve])";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        int duration;
+        if (!parseInteger(pinStr, pinLength, cmd.pin) ||
+            !parseInteger(targetStr, targetLength, cmd.value) ||
+            !parseInteger(token, tokenLength, duration) || duration < 0)
+        {
+            cmd.errorMessage = "Invalid FADE parameters";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.duration = duration;
+
+        if (nextToken(cursor, end, token, tokenLength) && !parseCurve(token, tokenLength, cmd.curve))
+        {
+            cmd.errorMessage = "Invalid curve: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::SET_INPUT:
+    {
+        // Format: INPUT pin [pull] [debounce_ms]
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing pin parameter";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseInteger(token, tokenLength, cmd.pin))
+        {
+            cmd.errorMessage = "Invalid pin number: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (nextToken(cursor, end, token, tokenLength) && !parsePull(token, tokenLength, cmd.pull))
+        {
+            cmd.errorMessage = "Invalid pull: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (nextToken(cursor, end, token, tokenLength))
+        {
+            int debounce;
+            if (!parseInteger(token, tokenLength, debounce) || debounce < 0 || debounce > 65535)
+            {
+                cmd.errorMessage = "Invalid debounce time: " + viewToString(token, tokenLength);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.debounceMs = debounce;
+        }
+
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::SETMASK:
+    {
+        // Format: SETMASK setMask [clearMask]
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: setMask [clearMask])";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseMask(token, tokenLength, cmd.setMask))
+        {
+            cmd.errorMessage = "Invalid set mask: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (nextToken(cursor, end, token, tokenLength) &&
+            !parseMask(token, tokenLength, cmd.clearMask))
+        {
+            cmd.errorMessage = "Invalid clear mask: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        validateMaskCommand(cmd);
+        break;
+    }
+
+    case CommandType::PULSE:
+    {
+        // Format: PULSE pin duration_ms
+        const char *pinStr;
+        size_t pinLength;
+        int duration;
+        if (!nextToken(cursor, end, pinStr, pinLength) ||
+            !nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: pin duration_ms)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseInteger(pinStr, pinLength, cmd.pin) ||
+            !parseInteger(token, tokenLength, duration) || duration < 0)
+        {
+            cmd.errorMessage = "Invalid PULSE parameters";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.duration = duration;
+
+        validatePinCommand(cmd);
+        break;
+    }
+
+    case CommandType::AT:
+    case CommandType::EVERY:
+    {
+        // Format: AT +delay_ms op  /  AT unix_ms op  /  EVERY interval_ms op
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: time op)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        bool relative = cmd.type == CommandType::EVERY || token[0] == '+';
+        if (token[0] == '+')
+        {
+            token++;
+            tokenLength--;
+        }
+
+        uint64_t time;
+        if (!parseMask(token, tokenLength, time) ||
+            (!relative && time < static_cast<uint64_t>(WallClock::VALID_AFTER) * 1000))
+        {
+            cmd.errorMessage = cmd.type == CommandType::EVERY ? "Invalid interval: " + viewToString(token, tokenLength)
+                                                              : "AT time must be +delay_ms or Unix time in ms";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (relative)
+        {
+            cmd.timerMs = time > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : static_cast<uint32_t>(time);
+        }
+        else
+        {
+            cmd.atTime = time;
+        }
+
+        if (validateTimerCommand(cmd))
+        {
+            setTimedOp(cmd, parseText(cursor, end - cursor));
+        }
+        break;
+    }
+
+    case CommandType::CANCEL:
+    {
+        // Format: CANCEL id  or  CANCEL ALL
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing timer id (or ALL)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (tokenLength == 3 && strncasecmp(token, "ALL", 3) == 0)
+        {
+            cmd.value = -1;
+        }
+        else if (!parseInteger(token, tokenLength, cmd.value) || cmd.value <= 0)
+        {
+            cmd.errorMessage = "Invalid timer id: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+        }
+        break;
+    }
+
+    case CommandType::LOG_LEVEL:
+    {
+        // Format: LOGLEVEL [level], no level = query
+        cmd.value = -1;
+        if (nextToken(cursor, end, token, tokenLength))
+        {
+            LogLevel level;
+            if (!parseLogLevel(token, tokenLength, level))
+            {
+                cmd.errorMessage = "Invalid level: " + viewToString(token, tokenLength);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.value = static_cast<int>(level);
+        }
+        break;
+    }
+
+    case CommandType::PROFILE:
+    {
+        // Format: PROFILE [profile], no profile = query
+        cmd.value = -1;
+        if (nextToken(cursor, end, token, tokenLength))
+        {
+            PowerProfile profile;
+            if (!parseProfile(token, tokenLength, profile))
+            {
+                cmd.errorMessage = "Invalid profile: " + viewToString(token, tokenLength);
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+            cmd.value = static_cast<int>(profile);
+        }
+        break;
+    }
+
+    case CommandType::ANALOG:
+    {
+        // Format: ANALOG pin,pin,... rate [average] / ANALOG OFF
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing parameters (expected: pins rate [average], or OFF)";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (tokenLength == 3 && strncasecmp(token, "OFF", 3) == 0)
+        {
+            cmd.frequency = 0;
+            cmd.value = 0;
+            break;
+        }
+
+        if (!parsePinList(token, tokenLength, cmd.setMask))
+        {
+            cmd.errorMessage = "Invalid pin list: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        int rate;
+        if (!nextToken(cursor, end, token, tokenLength) ||
+            !parseInteger(token, tokenLength, rate) || rate <= 0)
+        {
+            cmd.errorMessage = "Missing or invalid rate";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.frequency = static_cast<uint32_t>(rate);
+
+        cmd.value = 0;
+        if (nextToken(cursor, end, token, tokenLength) && !parseInteger(token, tokenLength, cmd.value))
+        {
+            cmd.errorMessage = "Invalid average: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        validateAnalogCommand(cmd);
+        break;
+    }
+
+    case CommandType::GROUP:
+    case CommandType::SCENE:
+    {
+        // Format: GROUP / GROUP name [PWM] value / GROUP DEFINE name pin,pin,... /
+        // GROUP DELETE name, and SCENE / SCENE name / SCENE SAVE name /
+        // SCENE DELETE name / SCENE DEFINE name op; op; ...
+        if (!nextToken(cursor, end, token, tokenLength))
+        {
+            break; // List
+        }
+
+        SceneAction action = SceneAction::RECALL;
+        if (parseSceneAction(token, tokenLength, action) &&
+            !nextToken(cursor, end, token, tokenLength))
+        {
+            cmd.errorMessage = "Missing name";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (!parseSceneName(token, tokenLength, cmd.name))
+        {
+            cmd.errorMessage = "Invalid name: " + viewToString(token, tokenLength);
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+        cmd.action = action;
+
+        if (cmd.type == CommandType::GROUP && action == SceneAction::DEFINE &&
+            (!nextToken(cursor, end, token, tokenLength) ||
+             !parsePinList(token, tokenLength, cmd.setMask)))
+        {
+            cmd.errorMessage = "Missing or invalid pin list";
+            cmd.type = CommandType::INVALID;
+            return cmd;
+        }
+
+        if (cmd.type == CommandType::GROUP && action == SceneAction::RECALL)
+        {
+            bool haveValue = nextToken(cursor, end, token, tokenLength);
+            if (haveValue && tokenLength == 3 && strncasecmp(token, "PWM", 3) == 0)
+            {
+                cmd.groupPWM = true;
+                haveValue = nextToken(cursor, end, token, tokenLength);
+            }
+            if (!haveValue || !parseInteger(token, tokenLength, cmd.value))
+            {
+                cmd.errorMessage = "Missing or invalid value";
+                cmd.type = CommandType::INVALID;
+                return cmd;
+            }
+        }
+
+        if (cmd.type == CommandType::SCENE && action == SceneAction::DEFINE)
+        {
+            parseTextBatch(cmd, cursor, end - cursor);
+            if (!cmd.isValid())
+            {
+                return cmd;
+            }
+        }
+
+        validateSceneCommand(cmd);
+        break;
+    }
+
+    case CommandType::STATUS:
+    case CommandType::RESET:
+    case CommandType::RESET_PINS:
+    case CommandType::HELP:
+    case CommandType::SUBSCRIBE:
+    case CommandType::UNSUBSCRIBE:
+    case CommandType::METRICS:
+        // No parameters needed
+        break;
+
+    default:
+        cmd.errorMessage = "Unknown command";
+        cmd.type = CommandType::INVALID;
+        break;
+    }
+
+    return cmd;
+}
+
+void CommandParser::parseTextBatch(Command &cmd, const char *data, size_t length)
+{
+    const char *cursor = data;
+    const char *end = data + length;
+
+    while (cursor < end)
+    {
+        const char *separator = static_cast<const char *>(memchr(cursor, ';', end - cursor));
+        const char *segmentEnd = separator != nullptr ? separator : end;
+
+        const char *segment = cursor;
+        size_t segmentLength = segmentEnd - cursor;
+        cursor = separator != nullptr ? separator + 1 : end;
+
+        // Allow empty segments, e.g. a trailing ';'
+        const char *token;
+        size_t tokenLength;
+        const char *probe = segment;
+        if (!nextToken(probe, segmentEnd, token, tokenLength))
+        {
+            continue;
+        }
+
+        Command op = parseText(segment, segmentLength);
+        if (!addBatchOp(cmd, op))
+        {
+            return;
+        }
+    }
+
+    if (cmd.batchCount == 0)
+    {
+        cmd.errorMessage = String(commandTypeToString(cmd.type)) + " requires at least one op";
+        cmd.type = CommandType::INVALID;
+    }
+}
+
+Command CommandParser::parseJSONOp(JsonObjectConst obj)
+{
+    Command op;
+    const char *opStr = obj["cmd"].as<const char *>();
+    op.type = opStr != nullptr ? stringToCommandType(opStr, strlen(opStr)) : CommandType::INVALID;
+    op.pin = obj["pin"] | -1;
+    op.value = obj["value"] | 0;
+    op.duration = obj["duration"] | 0;
+
+    if (op.type == CommandType::INVALID)
+    {
+        op.errorMessage = "Invalid command type";
+    }
+    else
+    {
+        validatePinCommand(op);
+    }
+    return op;
+}
+
+bool CommandParser::setTimedOp(Command &timed, const Command &op)
+{
+    if (!op.isValid())
+    {
+        timed.errorMessage = "Timed op: " + op.errorMessage;
+        timed.type = CommandType::INVALID;
+        return false;
+    }
+
+    PinOp &entry = timed.batch[0];
+    switch (op.type)
+    {
+    case CommandType::SET:
+        entry.type = PinOpType::SET;
+        break;
+    case CommandType::PWM:
+        entry.type = PinOpType::PWM;
+        break;
+    case CommandType::TOGGLE:
+        entry.type = PinOpType::TOGGLE;
+        break;
+    case CommandType::PULSE:
+        entry.type = PinOpType::PULSE;
+        break;
+    default:
+        timed.errorMessage = "Timed op: only SET, PWM, TOGGLE and PULSE are allowed";
+        timed.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (op.frequency != 0 || op.resolution != 0)
+    {
+        timed.errorMessage = "Timed op: frequency/resolution cannot be changed by a timer";
+        timed.type = CommandType::INVALID;
+        return false;
+    }
+
+    entry.pin = static_cast<uint8_t>(op.pin);
+    entry.value = op.type == CommandType::PULSE    ? static_cast<uint16_t>(op.duration)
+                  : op.type == CommandType::TOGGLE ? 0
+                                                   : static_cast<uint16_t>(op.value);
+    timed.batchCount = 1;
+    timed.pin = op.pin;
+    return true;
+}
+
+bool CommandParser::validateTimerCommand(Command &cmd)
+{
+    if (cmd.atTime == 0 && cmd.timerMs > TIMER_MAX_DELAY_MS)
+    {
+        cmd.errorMessage = "Timer delay must be at most " + String(TIMER_MAX_DELAY_MS) + " ms";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.type == CommandType::EVERY && cmd.timerMs < TIMER_MIN_INTERVAL_MS)
+    {
+        cmd.errorMessage = "EVERY interval must be at least " + String(TIMER_MIN_INTERVAL_MS) + " ms";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    return true;
+}
+
+bool CommandParser::addBatchOp(Command &batch, const Command &op)
+{
+    if (batch.batchCount >= MAX_BATCH_OPS)
+    {
+        batch.errorMessage = "Too many batch ops (max " + String(MAX_BATCH_OPS) + ")";
+        batch.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (!op.isValid())
+    {
+        batch.errorMessage = "Batch op " + String(batch.batchCount + 1) + ": " + op.errorMessage;
+        batch.type = CommandType::INVALID;
+        return false;
+    }
+
+    PinOp &entry = batch.batch[batch.batchCount];
+    switch (op.type)
+    {
+    case CommandType::SET:
+        entry.type = PinOpType::SET;
+        break;
+    case CommandType::PWM:
+        entry.type = PinOpType::PWM;
+        break;
+    case CommandType::TOGGLE:
+        entry.type = PinOpType::TOGGLE;
+        break;
+    default:
+        batch.errorMessage = "Batch op " + String(batch.batchCount + 1) +
+                             ": only SET, PWM and TOGGLE are allowed";
+        batch.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (op.frequency != 0 || op.resolution != 0)
+    {
+        batch.errorMessage = "Batch op " + String(batch.batchCount + 1) +
+                             ": frequency/resolution cannot be changed in a batch";
+        batch.type = CommandType::INVALID;
+        return false;
+    }
+
+    entry.pin = static_cast<uint8_t>(op.pin);
+    entry.value = op.type == CommandType::TOGGLE ? 0 : static_cast<uint16_t>(op.value);
+    batch.batchCount++;
+    return true;
+}
+
+Command CommandParser::parseBinary(const uint8_t *data, size_t length)
+{
+    Command cmd;
+    cmd.format = CommandFormat::BINARY;
+
+    if (length < BinaryProtocol::HEADER_SIZE)
+    {
+        cmd.errorMessage = "Truncated binary frame";
+        cmd.binaryStatus = BinaryProtocol::STATUS_BAD_FRAME;
+        return cmd;
+    }
+
+    cmd.opcode = data[1];
+    cmd.pin = data[3];
+    cmd.value = BinaryProtocol::readU16(data + 4);
+    cmd.sequence = BinaryProtocol::readU16(data + 6);
+    cmd.sequenced = (data[2] & BinaryProtocol::FLAG_SEQUENCED) != 0;
+    cmd.noReply = (data[2] & BinaryProtocol::FLAG_NO_REPLY) != 0;
+
+    // Apply time trailer sits after the payload, strip it before decoding
+    if ((data[2] & BinaryProtocol::FLAG_SCHEDULED) != 0)
+    {
+        if (length < BinaryProtocol::HEADER_SIZE + BinaryProtocol::SCHEDULE_TRAILER_SIZE)
+        {
+            cmd.errorMessage = "Truncated schedule trailer";
+            cmd.binaryStatus = BinaryProtocol::STATUS_BAD_FRAME;
+            return cmd;
+        }
+        length -= BinaryProtocol::SCHEDULE_TRAILER_SIZE;
+        cmd.applyAt = BinaryProtocol::readU64(data + length);
+    }
+
+    switch (cmd.opcode)
+    {
+    case BinaryProtocol::OP_SET:
+        cmd.type = CommandType::SET;
+        break;
+    case BinaryProtocol::OP_GET:
+        cmd.type = CommandType::GET;
+        break;
+    case BinaryProtocol::OP_TOGGLE:
+        cmd.type = CommandType::TOGGLE;
+        break;
+    case BinaryProtocol::OP_PWM:
+        cmd.type = CommandType::PWM;
+        break;
+    case BinaryProtocol::OP_RESET_PINS:
+        cmd.type = CommandType::RESET_PINS;
+        cmd.pin = -1;
+        return cmd;
+    case BinaryProtocol::OP_SETMASK:
+        cmd.type = CommandType::SETMASK;
+        cmd.pin = -1;
+        if (length < BinaryProtocol::HEADER_SIZE + BinaryProtocol::SETMASK_PAYLOAD_SIZE)
+        {
+            cmd.type = CommandType::INVALID;
+            cmd.errorMessage = "Invalid frame length";
+            cmd.binaryStatus = BinaryProtocol::STATUS_BAD_FRAME;
+            return cmd;
+        }
+        cmd.setMask = BinaryProtocol::readU64(data + BinaryProtocol::HEADER_SIZE);
+        cmd.clearMask = BinaryProtocol::readU64(data + BinaryProtocol::HEADER_SIZE + 8);
+        if (!validateMaskCommand(cmd))
+        {
+            cmd.binaryStatus = BinaryProtocol::STATUS_INVALID_PIN;
+        }
+        return cmd;
+    case BinaryProtocol::OP_FADE:
+        cmd.type = CommandType::FADE;
+        if (length < BinaryProtocol::HEADER_SIZE + BinaryProtocol::FADE_PAYLOAD_SIZE ||
+            (data[2] & BinaryProtocol::FLAG_CURVE_MASK) > static_cast<uint8_t>(FadeCurve::GAMMA))
+        {
+            cmd.type = CommandType::INVALID;
+            cmd.errorMessage = "Invalid FADE frame";
+            cmd.binaryStatus = BinaryProtocol::STATUS_BAD_FRAME;
+            return cmd;
+        }
+        cmd.curve = static_cast<FadeCurve>(data[2] & BinaryProtocol::FLAG_CURVE_MASK);
+        cmd.duration = BinaryProtocol::readU32(data + BinaryProtocol::HEADER_SIZE);
+        break;
+    case BinaryProtocol::OP_PULSE:
+        cmd.type = CommandType::PULSE;
+        cmd.duration = cmd.value;
+        break;
+    case BinaryProtocol::OP_BATCH:
+        return parseBinaryBatch(cmd, data, length);
+    default:
+        cmd.errorMessage = "Unknown binary opcode";
+        cmd.binaryStatus = BinaryProtocol::STATUS_UNKNOWN_OPCODE;
+        return cmd;
+    }
+
+    if (!isValidPin(cmd.pin))
+    {
+        cmd.type = CommandType::INVALID;
+        cmd.errorMessage = "Invalid pin number";
+        cmd.binaryStatus = BinaryProtocol::STATUS_INVALID_PIN;
+        return cmd;
+    }
+
+    if (!validatePinCommand(cmd))
+    {
+        cmd.binaryStatus = BinaryProtocol::STATUS_INVALID_VALUE;
+    }
+
+    return cmd;
+}
+
+Command CommandParser::parseBinaryBatch(Command &cmd, const uint8_t *data, size_t length)
+{
+    cmd.type = CommandType::BATCH;
+    cmd.pin = -1;
+    size_t count = cmd.value;
+
+    if (count == 0 || count > MAX_BATCH_OPS ||
+        length < BinaryProtocol::HEADER_SIZE + count * BinaryProtocol::BATCH_OP_SIZE)
+    {
+        cmd.type = CommandType::INVALID;
+        cmd.errorMessage = "Invalid batch length";
+        cmd.binaryStatus = BinaryProtocol::STATUS_BAD_FRAME;
+        return cmd;
+    }
+
+    const uint8_t *record = data + BinaryProtocol::HEADER_SIZE;
+    for (size_t i = 0; i < count; i++, record += BinaryProtocol::BATCH_OP_SIZE)
+    {
+        PinOp &op = cmd.batch[i];
+        op.pin = record[1];
+        op.value = BinaryProtocol::readU16(record + 2);
+
+        switch (record[0])
+        {
+        case BinaryProtocol::OP_SET:
+            op.type = PinOpType::SET;
+            break;
+        case BinaryProtocol::OP_PWM:
+            op.type = PinOpType::PWM;
+            break;
+        case BinaryProtocol::OP_TOGGLE:
+            op.type = PinOpType::TOGGLE;
+            break;
+        default:
+            cmd.type = CommandType::INVALID;
+            cmd.errorMessage = "Unknown batch opcode";
+            cmd.binaryStatus = BinaryProtocol::STATUS_UNKNOWN_OPCODE;
+            return cmd;
+        }
+
+        if (!isValidPin(op.pin))
+        {
+            cmd.type = CommandType::INVALID;
+            cmd.errorMessage = "Invalid pin number";
+            cmd.binaryStatus = BinaryProtocol::STATUS_INVALID_PIN;
+            return cmd;
+        }
+
+        // PWM duty is checked against the pin's resolution when applied
+        if (op.type == PinOpType::SET && op.value > 1)
+        {
+            cmd.type = CommandType::INVALID;
+            cmd.errorMessage = "Invalid batch value";
+            cmd.binaryStatus = BinaryProtocol::STATUS_INVALID_VALUE;
+            return cmd;
+        }
+    }
+
+    cmd.batchCount = count;
+    return cmd;
+}
+
+bool CommandParser::validatePinCommand(Command &cmd)
+{
+    if (!isValidPin(cmd.pin))
+    {
+        cmd.errorMessage = "Invalid pin number: " + String(cmd.pin);
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    // Validate value range
+    if (cmd.type == CommandType::SET && (cmd.value != 0 && cmd.value != 1))
+    {
+        cmd.errorMessage = "SET value must be 0 or 1";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+    if (cmd.type == CommandType::PWM)
+    {
+        if ((cmd.frequency != 0 || cmd.resolution != 0) &&
+            !PWMChannelPool::isSupported(cmd.frequency != 0 ? cmd.frequency : PWM_DEFAULT_FREQUENCY,
+                                         cmd.resolution != 0 ? cmd.resolution : PWM_DEFAULT_RESOLUTION))
+        {
+            cmd.errorMessage = "Unsupported PWM frequency/resolution (resolution 1-" +
+                               String(PWM_MAX_RESOLUTION) + " bit, frequency * 2^resolution <= 80 MHz)";
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+
+        // Without an explicit resolution the pin's current one applies, which
+        // PinController checks
+        int maxDuty = (1 << (cmd.resolution != 0 ? cmd.resolution : PWM_MAX_RESOLUTION)) - 1;
+        if (cmd.value < 0 || cmd.value > maxDuty)
+        {
+            cmd.errorMessage = "PWM value must be 0-" + String(maxDuty);
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+    }
+
+    if (cmd.type == CommandType::PULSE && (cmd.duration == 0 || cmd.duration > PULSE_MAX_DURATION_MS))
+    {
+        cmd.errorMessage = "PULSE duration must be 1-" + String(PULSE_MAX_DURATION_MS) + " ms";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.type == CommandType::FADE)
+    {
+        int maxDuty = (1 << PWM_MAX_RESOLUTION) - 1;
+        if (cmd.value < 0 || cmd.value > maxDuty)
+        {
+            cmd.errorMessage = "FADE target must be 0-" + String(maxDuty);
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+        if (cmd.duration > FADE_MAX_DURATION_MS)
+        {
+            cmd.errorMessage = "FADE duration must be at most " + String(FADE_MAX_DURATION_MS) + " ms";
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CommandParser::validateMaskCommand(Command &cmd)
+{
+    if ((cmd.setMask | cmd.clearMask) == 0)
+    {
+        cmd.errorMessage = "SETMASK requires a non-empty set or clear mask";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (((cmd.setMask | cmd.clearMask) & ~PinMasks::SAFE) != 0)
+    {
+        cmd.errorMessage = "Mask contains pins that are not controllable";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if ((cmd.setMask & cmd.clearMask) != 0)
+    {
+        cmd.errorMessage = "A pin cannot be in both the set and clear mask";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    return true;
+}
+
+bool CommandParser::validateAnalogCommand(Command &cmd)
+{
+    if (cmd.frequency == 0)
+    {
+        // Stop, pins do not matter
+        cmd.setMask = 0;
+        return true;
+    }
+
+    if (cmd.setMask == 0)
+    {
+        cmd.errorMessage = "ANALOG requires at least one pin";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if ((cmd.setMask & ~PinMasks::ANALOG) != 0)
+    {
+        cmd.errorMessage = "Pins must be analog pins";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.frequency > ANALOG_MAX_RATE_HZ)
+    {
+        cmd.errorMessage = "Rate must be at most " + String(ANALOG_MAX_RATE_HZ) + " Hz";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.value < 0)
+    {
+        cmd.errorMessage = "Invalid average";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    return true;
+}
 
-    doc["success"] = success;
-    doc["command"] = commandTypeToString(cmd.type);
+bool CommandParser::validateSceneCommand(Command &cmd)
+{
+    if (cmd.action == SceneAction::SAVE && cmd.type == CommandType::GROUP)
+    {
+        cmd.errorMessage = "GROUP cannot be saved, use GROUP DEFINE";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.type == CommandType::GROUP && cmd.action == SceneAction::DEFINE &&
+        (cmd.setMask == 0 || (cmd.setMask & ~PinMasks::SAFE) != 0))
+    {
+        cmd.errorMessage = "Group pins must be safe pins";
+        cmd.type = CommandType::INVALID;
+        return false;
+    }
+
+    if (cmd.type == CommandType::GROUP && cmd.action == SceneAction::RECALL)
+    {
+        // As for PWM, the pins' own resolution is checked by PinController
+        int maxValue = cmd.groupPWM ? (1 << PWM_MAX_RESOLUTION) - 1 : 1;
+        if (cmd.value < 0 || cmd.value > maxValue)
+        {
+            cmd.errorMessage = "GROUP value must be 0-" + String(maxValue);
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+    }
+
+    if (cmd.type == CommandType::SCENE && cmd.action == SceneAction::DEFINE)
+    {
+        if (cmd.batchCount == 0)
+        {
+            cmd.errorMessage = "SCENE requires at least one op";
+            cmd.type = CommandType::INVALID;
+            return false;
+        }
+
+        for (uint8_t i = 0; i < cmd.batchCount; i++)
+        {
+            if (cmd.batch[i].type == PinOpType::TOGGLE)
+            {
+                cmd.errorMessage = "Scene op " + String(i + 1) + ": only SET and PWM are allowed";
+                cmd.type = CommandType::INVALID;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+size_t CommandParser::generateBinaryResponse(const Command &cmd, bool success,
+                                             int resultValue, uint8_t *out)
+{
+    uint8_t status = BinaryProtocol::STATUS_OK;
+    if (!cmd.isValid())
+    {
+        status = cmd.binaryStatus != BinaryProtocol::STATUS_OK
+                     ? cmd.binaryStatus
+                     : static_cast<uint8_t>(BinaryProtocol::STATUS_BAD_FRAME);
+    }
+    else if (!success)
+    {
+        status = BinaryProtocol::STATUS_FAILED;
+    }
+
+    uint8_t pin = cmd.pin >= 0 ? static_cast<uint8_t>(cmd.pin) : 0;
+    uint16_t value = resultValue >= 0 ? static_cast<uint16_t>(resultValue) : 0;
+
+    return BinaryProtocol::encodeResponse(out, cmd.opcode, status, pin, value, cmd.sequence);
+}
+
+void CommandParser::writeResponse(Print &out, const Command &cmd, bool success,
+                                  const char *message, int resultValue)
+{
+    JsonWriter json(out);
+
+    json.beginObject();
+    json.field("success", success);
+    json.field("command", commandTypeToString(cmd.type));
 
     if (cmd.pin >= 0)
     {
-        doc["pin"] = cmd.pin;
+        json.field("pin", cmd.pin);
     }
 
     if (resultValue >= 0)
     {
-        doc["value"] = resultValue;
+        json.field("value", resultValue);
     }
 
-    if (message.length() > 0)
+    if (cmd.sequenced)
     {
-        doc["message"] = message;
+        json.field("seq", cmd.sequence);
+    }
+
+    if (message != nullptr && message[0] != '\0')
+    {
+        json.field("message", message);
     }
     else if (!success && cmd.errorMessage.length() > 0)
     {
-        doc["message"] = cmd.errorMessage;
+        json.field("message", cmd.errorMessage.c_str());
     }
 
-    String response;
-    serializeJson(doc, response);
-    return response;
+    json.endObject();
+}
+
+void CommandParser::writeInputEvent(Print &out, const InputEvent &event)
+{
+    JsonWriter json(out);
+
+    json.beginObject()
+        .field("event", "INPUT")
+        .field("pin", event.pin)
+        .field("value", event.value)
+        .field("timestamp_us", static_cast<long long>(event.timestampUs))
+        .endObject();
 }
 
-String CommandParser::getHelpText()
+static const char HELP_TEXT[] PROGMEM =
+    "ESP32 Pin Controller - Command Reference\n\n"
+    "JSON Format:\n"
+    "  Set pin:    {\"cmd\":\"SET\",\"pin\":13,\"value\":1}\n"
+    "  Get pin:    {\"cmd\":\"GET\",\"pin\":13}\n"
+    "  Toggle pin: {\"cmd\":\"TOGGLE\",\"pin\":13}\n"
+    "  PWM:        {\"cmd\":\"PWM\",\"pin\":13,\"value\":128}\n"
+    "  PWM config: {\"cmd\":\"PWM\",\"pin\":13,\"value\":4915,\"freq\":50,\"resolution\":16}\n"
+    "  Status:     {\"cmd\":\"STATUS\"}\n"
+    "  Reset:      {\"cmd\":\"RESET\"}\n"
+    "  Batch:      {\"cmd\":\"BATCH\",\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":1}]}\n"
+    "  Set mask:   {\"cmd\":\"SETMASK\",\"set\":\"0x3000\",\"clear\":\"0x4000\"}\n"
+    "  Fade:       {\"cmd\":\"FADE\",\"pin\":13,\"value\":255,\"duration\":1000,\"curve\":\"EASE\"}\n"
+    "  Input:      {\"cmd\":\"INPUT\",\"pin\":4,\"pull\":\"PULLUP\",\"debounce\":20}\n"
+    "  Subscribe:  {\"cmd\":\"SUBSCRIBE\"}\n"
+    "  Pulse:      {\"cmd\":\"PULSE\",\"pin\":13,\"duration\":200}\n"
+    "  At:         {\"cmd\":\"AT\",\"delay\":30000,\"do\":{\"cmd\":\"SET\",\"pin\":13,\"value\":0}}\n"
+    "  Every:      {\"cmd\":\"EVERY\",\"interval\":1000,\"do\":{\"cmd\":\"TOGGLE\",\"pin\":13}}\n"
+    "  Cancel:     {\"cmd\":\"CANCEL\",\"id\":65537}\n"
+    "  Metrics:    {\"cmd\":\"METRICS\"}\n"
+    "  Log level:  {\"cmd\":\"LOGLEVEL\",\"level\":\"DEBUG\"}\n"
+    "  Profile:    {\"cmd\":\"PROFILE\",\"profile\":\"low-power\"}\n"
+    "  Analog:     {\"cmd\":\"ANALOG\",\"pins\":[34,35],\"rate\":1000,\"average\":16}\n"
+    "  Group:      {\"cmd\":\"GROUP\",\"define\":\"relays\",\"pins\":[12,13,14]}\n"
+    "              {\"cmd\":\"GROUP\",\"name\":\"relays\",\"value\":1[,\"pwm\":true]}\n"
+    "  Scene:      {\"cmd\":\"SCENE\",\"define\":\"evening\",\"ops\":[...]}\n"
+    "              {\"cmd\":\"SCENE\",\"save\":\"evening\"} / {\"cmd\":\"SCENE\",\"name\":\"evening\"}\n"
+    "              (\"delete\":name removes, no name lists)\n"
+    "  UDP:        add \"seq\":N to drop stale commands, \"ack\":false for no reply,\n"
+    "              \"at\":<unix ms> to apply at a synchronized time\n\n"
+    "Text Format:\n"
+    "  Set pin:    SET 13 1\n"
+    "  Get pin:    GET 13\n"
+    "  Toggle pin: TOGGLE 13\n"
+    "  PWM:        PWM 13 128 [freq] [resolution]\n"
+    "  Status:     STATUS\n"
+    "  Reset:      RESET\n"
+    "  Batch:      BATCH SET 13 1; PWM 12 128; TOGGLE 14\n"
+    "  Set mask:   SETMASK 0x3000 0x4000  (bit n = GPIO n)\n"
+    "  Fade:       FADE 13 255 1000 [LINEAR|EASE|GAMMA]\n"
+    "  Input:      INPUT 4 [NONE|PULLUP|PULLDOWN] [debounce_ms]\n"
+    "  Subscribe:  SUBSCRIBE / UNSUBSCRIBE  (push input events)\n"
+    "  Pulse:      PULSE 13 200  (invert for 200 ms, then restore)\n"
+    "  At:         AT +30000 SET 13 0  (or AT <unix_ms> ...)\n"
+    "  Every:      EVERY 1000 TOGGLE 13\n"
+    "  Cancel:     CANCEL <id> / CANCEL ALL\n"
+    "  Metrics:    METRICS  (latency histograms, heap)\n"
+    "  Log level:  LOGLEVEL [NONE|ERROR|WARNING|INFO|DEBUG]\n"
+    "  Profile:    PROFILE [low-latency|balanced|low-power]\n"
+    "  Analog:     ANALOG 34,35 1000 [average] / ANALOG OFF  (binary blocks\n"
+    "              to UDP subscribers and the /analog WebSocket)\n"
+    "  Group:      GROUP DEFINE relays 12,13,14 / GROUP relays 1 /\n"
+    "              GROUP dimmers PWM 128 / GROUP DELETE relays / GROUP\n"
+    "  Scene:      SCENE DEFINE evening SET 13 1; PWM 12 64 / SCENE SAVE evening /\n"
+    "              SCENE evening / SCENE DELETE evening / SCENE\n\n"
+    "Binary Format:\n"
+    "  8-byte frames starting with 0xA5 (see BinaryProtocol.h)\n\n";
+
+void CommandParser::writeHelpText(Print &out)
 {
-    String help = "ESP32 Pin Controller - Command Reference\n\n";
-    help += "JSON Format:\n";
-    help += "  Set pin:    {\"cmd\":\"SET\",\"pin\":13,\"value\":1}\n";
-    help += "  Get pin:    {\"cmd\":\"GET\",\"pin\":13}\n";
-    help += "  Toggle pin: {\"cmd\":\"TOGGLE\",\"pin\":13}\n";
-    help += "  PWM:        {\"cmd\":\"PWM\",\"pin\":13,\"value\":128}\n";
-    help += "  Status:     {\"cmd\":\"STATUS\"}\n";
-    help += "  Reset:      {\"cmd\":\"RESET\"}\n\n";
-    help += "Text Format:\n";
-    help += "  Set pin:    SET 13 1\n";
-    help += "  Get pin:    GET 13\n";
-    help += "  Toggle pin: TOGGLE 13\n";
-    help += "  PWM:        PWM 13 128\n";
-    help += "  Status:     STATUS\n";
-    help += "  Reset:      RESET\n\n";
-    help += "Available pins: ";
+    out.write(HELP_TEXT, sizeof(HELP_TEXT) - 1);
+
+    out.print("Available pins: ");
     for (int i = 0; i < SAFE_PIN_COUNT; i++)
     {
         if (i > 0)
-            help += ", ";
-        help += String(SAFE_PINS[i]);
+            out.print(", ");
+        out.print(SAFE_PINS[i]);
+    }
+    out.print("\n");
+
+    out.print("Analog pins: ");
+    for (int i = 0; i < ANALOG_PIN_COUNT; i++)
+    {
+        if (i > 0)
+            out.print(", ");
+        out.print(ANALOG_PINS[i]);
     }
-    help += "\n";
-    return help;
+    out.print("\n");
 }
 
 bool CommandParser::isValidPin(int pin)
 {
-    for (int i = 0; i < SAFE_PIN_COUNT; i++)
+    return PinController::isValidPin(pin);
+}
+
+CommandType CommandParser::stringToCommandType(const char *cmdStr, size_t length)
+{
+    struct Entry
+    {
+        const char *name;
+        CommandType type;
+    };
+
+    static const Entry COMMANDS[] = {
+        {"SET", CommandType::SET},
+        {"GET", CommandType::GET},
+        {"TOGGLE", CommandType::TOGGLE},
+        {"PWM", CommandType::PWM},
+        {"STATUS", CommandType::STATUS},
+        {"RESET", CommandType::RESET},
+        {"RESET_PINS", CommandType::RESET_PINS},
+        {"HELP", CommandType::HELP},
+        {"BATCH", CommandType::BATCH},
+        {"SETMASK", CommandType::SETMASK},
+        {"FADE", CommandType::FADE},
+        {"INPUT", CommandType::SET_INPUT},
+        {"SUBSCRIBE", CommandType::SUBSCRIBE},
+        {"UNSUBSCRIBE", CommandType::UNSUBSCRIBE},
+        {"PULSE", CommandType::PULSE},
+        {"AT", CommandType::AT},
+        {"EVERY", CommandType::EVERY},
+        {"CANCEL", CommandType::CANCEL},
+        {"METRICS", CommandType::METRICS},
+        {"LOGLEVEL", CommandType::LOG_LEVEL},
+        {"PROFILE", CommandType::PROFILE},
+        {"ANALOG", CommandType::ANALOG},
+        {"GROUP", CommandType::GROUP},
+        {"SCENE", CommandType::SCENE},
+    };
+
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++)
     {
-        if (SAFE_PINS[i] == pin)
+        if (strlen(COMMANDS[i].name) == length &&
+            strncasecmp(COMMANDS[i].name, cmdStr, length) == 0)
         {
-            return true;
+            return COMMANDS[i].type;
         }
     }
-    return false;
-}
-
-CommandType CommandParser::stringToCommandType(const String &cmdStr)
-{
-    if (cmdStr == "SET")
-        return CommandType::SET;
-    if (cmdStr == "GET")
-        return CommandType::GET;
-    if (cmdStr == "TOGGLE")
-        return CommandType::TOGGLE;
-    if (cmdStr == "PWM")
-        return CommandType::PWM;
-    if (cmdStr == "STATUS")
-        return CommandType::STATUS;
-    if (cmdStr == "RESET")
-        return CommandType::RESET;
-    if (cmdStr == "RESET_PINS")
-        return CommandType::RESET_PINS;
-    if (cmdStr == "HELP")
-        return CommandType::HELP;
     return CommandType::INVALID;
 }
 
-String CommandParser::commandTypeToString(CommandType type)
+const char *CommandParser::commandTypeToString(CommandType type)
 {
     switch (type)
     {
@@ -354,6 +1975,38 @@ String CommandParser::commandTypeToString(CommandType type)
         return "RESET_PINS";
     case CommandType::HELP:
         return "HELP";
+    case CommandType::BATCH:
+        return "BATCH";
+    case CommandType::SETMASK:
+        return "SETMASK";
+    case CommandType::FADE:
+        return "FADE";
+    case CommandType::SET_INPUT:
+        return "INPUT";
+    case CommandType::SUBSCRIBE:
+        return "SUBSCRIBE";
+    case CommandType::UNSUBSCRIBE:
+        return "UNSUBSCRIBE";
+    case CommandType::PULSE:
+        return "PULSE";
+    case CommandType::AT:
+        return "AT";
+    case CommandType::EVERY:
+        return "EVERY";
+    case CommandType::CANCEL:
+        return "CANCEL";
+    case CommandType::METRICS:
+        return "METRICS";
+    case CommandType::LOG_LEVEL:
+        return "LOGLEVEL";
+    case CommandType::PROFILE:
+        return "PROFILE";
+    case CommandType::ANALOG:
+        return "ANALOG";
+    case CommandType::GROUP:
+        return "GROUP";
+    case CommandType::SCENE:
+        return "SCENE";
     default:
         return "INVALID";
     }
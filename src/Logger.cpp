@@ -0,0 +1,138 @@
+#include "Logger.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+namespace
+{
+    // Only used by the drain task
+    WiFiUDP syslogSocket;
+
+    // RFC 3164 severity of each level
+    uint8_t syslogSeverity(LogLevel level)
+    {
+        static const uint8_t SEVERITIES[] = {7, 3, 4, 6, 7};
+        return SEVERITIES[static_cast<uint8_t>(level)];
+    }
+
+    // Facility local0
+    const uint8_t SYSLOG_FACILITY = 16;
+
+    // Length snprintf wrote into a buffer of this size (it reports the untruncated length)
+    size_t fitted(int length, size_t size)
+    {
+        return static_cast<size_t>(length) < size ? length : size - 1;
+    }
+}
+
+Logger::Logger() : _level(LOG_DEFAULT_LEVEL), _running(false), _reportedDrops(0)
+{
+}
+
+void Logger::begin()
+{
+    BaseType_t created = xTaskCreatePinnedToCore(taskEntry, "log", LOG_TASK_STACK_SIZE, this,
+                                                 LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE);
+    _running.store(created == pdPASS);
+}
+
+void Logger::log(LogLevel level, const char *tag, const char *format, ...)
+{
+    Record record;
+    record.timeMs = millis();
+    record.level = level;
+    record.tag = tag;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+
+    _queue.push(record);
+}
+
+void Logger::flush(unsigned long timeoutMs)
+{
+    if (!_running.load())
+    {
+        // No drain task, so this is the only consumer
+        drain();
+        return;
+    }
+
+    unsigned long start = millis();
+    while (!_queue.empty() && millis() - start < timeoutMs)
+    {
+        delay(1);
+    }
+}
+
+const char *Logger::levelName(LogLevel level)
+{
+    static const char *const NAMES[] = {"NONE", "ERROR", "WARNING", "INFO", "DEBUG"};
+    return NAMES[static_cast<uint8_t>(level)];
+}
+
+void Logger::taskEntry(void *arg)
+{
+    Logger *self = static_cast<Logger *>(arg);
+    for (;;)
+    {
+        if (!self->drain())
+        {
+            vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+}
+
+bool Logger::drain()
+{
+    bool any = false;
+    Record record;
+    while (_queue.pop(record))
+    {
+        write(record);
+        any = true;
+    }
+
+    uint32_t dropped = _queue.dropped();
+    if (dropped != _reportedDrops)
+    {
+        record.timeMs = millis();
+        record.level = LogLevel::WARNING;
+        record.tag = "Log";
+        snprintf(record.text, sizeof(record.text), "%u lines dropped, queue full",
+                 static_cast<unsigned>(dropped - _reportedDrops));
+        _reportedDrops = dropped;
+        write(record);
+        any = true;
+    }
+
+    return any;
+}
+
+void Logger::write(const Record &record)
+{
+    // One write per line, so lines from other Serial writers never split it
+    char line[LOG_LINE_LENGTH + 32];
+    int length = snprintf(line, sizeof(line), "%c [%s] %s\r\n", levelName(record.level)[0], record.tag, record.text);
+    if (length <= 0)
+    {
+        return;
+    }
+    Serial.write(reinterpret_cast<const uint8_t *>(line), fitted(length, sizeof(line)));
+
+    if (LOG_SYSLOG_HOST[0] != '\0' && WiFi.status() == WL_CONNECTED)
+    {
+        // <PRI>HOSTNAME TAG: text (uptime instead of a timestamp, the
+        // receiver stamps arrival time)
+        length = snprintf(line, sizeof(line), "<%u>%s %s: %lu.%03lu %s",
+                          SYSLOG_FACILITY * 8 + syslogSeverity(record.level), DEVICE_HOSTNAME, record.tag,
+                          static_cast<unsigned long>(record.timeMs / 1000),
+                          static_cast<unsigned long>(record.timeMs % 1000), record.text);
+        if (length > 0 && syslogSocket.beginPacket(LOG_SYSLOG_HOST, LOG_SYSLOG_PORT))
+        {
+            syslogSocket.write(reinterpret_cast<const uint8_t *>(line), fitted(length, sizeof(line)));
+            syslogSocket.endPacket();
+        }
+    }
+}
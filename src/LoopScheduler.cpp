@@ -0,0 +1,210 @@
+#include "LoopScheduler.h"
+#include "WatchdogManager.h"
+#include <esp_timer.h>
+
+static_assert(LOOP_MAX_TASKS <= 32, "LOOP_MAX_TASKS must fit the trigger bitmask");
+
+namespace
+{
+    uint32_t defaultBudget(LoopPriority priority)
+    {
+        switch (priority)
+        {
+        case LoopPriority::COMMAND:
+            return LOOP_COMMAND_BUDGET_US;
+        case LoopPriority::IO:
+            return LOOP_IO_BUDGET_US;
+        default:
+            return LOOP_HOUSEKEEPING_BUDGET_US;
+        }
+    }
+}
+
+LoopScheduler::LoopScheduler(WatchdogManager &watchdog)
+    : _watchdog(watchdog),
+      _owner(nullptr),
+      _taskCount(0),
+      _triggered(0),
+      _overruns(0)
+{
+}
+
+void LoopScheduler::begin()
+{
+    _owner = xTaskGetCurrentTaskHandle();
+}
+
+int LoopScheduler::add(const char *name, TaskFunction function, LoopPriority priority,
+                       uint32_t periodMs, uint32_t budgetUs)
+{
+    if (_taskCount >= LOOP_MAX_TASKS)
+    {
+        return -1;
+    }
+
+    // After every task of the same or a higher priority
+    size_t index = _taskCount;
+    while (index > 0 && _tasks[index - 1].priority > priority)
+    {
+        _tasks[index] = _tasks[index - 1];
+        index--;
+    }
+
+    Task &task = _tasks[index];
+    task.name = name;
+    task.function = function;
+    task.idle = nullptr;
+    task.priority = priority;
+    task.id = static_cast<uint8_t>(_taskCount);
+    task.periodMs = periodMs;
+    task.budgetUs = budgetUs != 0 ? budgetUs : defaultBudget(priority);
+    task.lastRun = millis() - (periodMs != ON_TRIGGER ? periodMs : 0); // Periodic tasks are due at once
+    task.maxUs = 0;
+    task.overruns = 0;
+
+    _taskCount++;
+    return task.id;
+}
+
+void LoopScheduler::setIdleFunction(int id, IdleFunction idle)
+{
+    for (size_t i = 0; i < _taskCount; i++)
+    {
+        if (_tasks[i].id == id)
+        {
+            _tasks[i].idle = idle;
+            return;
+        }
+    }
+}
+
+void LoopScheduler::trigger(int id)
+{
+    if (id < 0 || id >= LOOP_MAX_TASKS)
+    {
+        return;
+    }
+
+    _triggered.fetch_or(1UL << id, std::memory_order_release);
+    if (_owner != nullptr)
+    {
+        xTaskNotifyGive(_owner);
+    }
+}
+
+void LoopScheduler::runOnce()
+{
+    uint32_t triggered = _triggered.exchange(0, std::memory_order_acquire);
+
+    runCommands(triggered);
+    for (size_t i = 0; i < _taskCount; i++)
+    {
+        Task &task = _tasks[i];
+        if (task.priority == LoopPriority::COMMAND || !isDue(task, triggered))
+        {
+            continue;
+        }
+
+        triggered &= ~(1UL << task.id);
+        run(task);
+
+        // Commands that arrived meanwhile go before the next task
+        triggered |= _triggered.exchange(0, std::memory_order_acquire);
+        runCommands(triggered);
+    }
+
+    // Triggers that came in for tasks this pass had already passed
+    if (triggered != 0)
+    {
+        _triggered.fetch_or(triggered, std::memory_order_release);
+    }
+}
+
+uint32_t LoopScheduler::idleTimeMs(uint32_t maxMs) const
+{
+    if (_triggered.load(std::memory_order_acquire) != 0)
+    {
+        return 0;
+    }
+
+    unsigned long now = millis();
+    uint32_t wait = maxMs;
+    for (size_t i = 0; i < _taskCount; i++)
+    {
+        const Task &task = _tasks[i];
+        if (task.idle != nullptr)
+        {
+            wait = task.idle(wait);
+        }
+        if (task.periodMs == 0 || task.periodMs == ON_TRIGGER)
+        {
+            continue;
+        }
+
+        unsigned long elapsed = now - task.lastRun;
+        uint32_t remaining = elapsed >= task.periodMs ? 0 : task.periodMs - elapsed;
+        if (remaining < wait)
+        {
+            wait = remaining;
+        }
+    }
+    return wait;
+}
+
+bool LoopScheduler::isDue(const Task &task, uint32_t triggered) const
+{
+    if ((triggered & (1UL << task.id)) != 0 || task.periodMs == 0)
+    {
+        return true;
+    }
+    return task.periodMs != ON_TRIGGER && millis() - task.lastRun >= task.periodMs;
+}
+
+void LoopScheduler::run(Task &task)
+{
+    task.lastRun = millis();
+    int64_t start = esp_timer_get_time();
+    task.function();
+    uint32_t elapsed = static_cast<uint32_t>(esp_timer_get_time() - start);
+
+    if (elapsed > task.maxUs)
+    {
+        task.maxUs = elapsed;
+    }
+    if (elapsed > task.budgetUs)
+    {
+        task.overruns++;
+        _overruns++;
+        _watchdog.reportOverrun(task.name, elapsed, task.budgetUs);
+    }
+}
+
+void LoopScheduler::writeTasks(JsonWriter &json) const
+{
+    json.beginArray();
+    for (size_t i = 0; i < _taskCount; i++)
+    {
+        const Task &task = _tasks[i];
+        json.beginObject()
+            .field("name", task.name)
+            .field("budgetUs", task.budgetUs)
+            .field("maxUs", task.maxUs)
+            .field("overruns", task.overruns)
+            .endObject();
+    }
+    json.endArray();
+}
+
+void LoopScheduler::runCommands(uint32_t &triggered)
+{
+    // COMMAND tasks sort first
+    for (size_t i = 0; i < _taskCount && _tasks[i].priority == LoopPriority::COMMAND; i++)
+    {
+        Task &task = _tasks[i];
+        if (isDue(task, triggered))
+        {
+            triggered &= ~(1UL << task.id);
+            run(task);
+        }
+    }
+}
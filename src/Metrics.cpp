@@ -0,0 +1,153 @@
+#include "Metrics.h"
+
+namespace
+{
+    // Prometheus buckets: every other histogram bucket (8 us * 4^n), which
+    // keeps the exposition short while staying exact
+    const int PROMETHEUS_BUCKET_STEP = 2;
+
+    void writeHistogram(Print &out, const char *name, const char *source, const LatencyHistogram &h)
+    {
+        // Label set without braces, e.g. source="tcp", empty for none
+        char labels[32] = "";
+        if (source != nullptr)
+        {
+            snprintf(labels, sizeof(labels), "source=\"%s\"", source);
+        }
+        const char *separator = labels[0] != '\0' ? "," : "";
+
+        uint32_t cumulative = 0;
+        for (int i = 0; i < LatencyHistogram::BUCKET_COUNT - 1; i++)
+        {
+            cumulative += h.bucket(i);
+            if (i % PROMETHEUS_BUCKET_STEP == 0)
+            {
+                out.printf("%s_bucket{%s%sle=\"%g\"} %u\n", name, labels, separator,
+                           LatencyHistogram::upperBound(i) / 1e6, static_cast<unsigned>(cumulative));
+            }
+        }
+        out.printf("%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, separator, static_cast<unsigned>(h.count()));
+        const char *open = labels[0] != '\0' ? "{" : "";
+        const char *close = labels[0] != '\0' ? "}" : "";
+        out.printf("%s_sum%s%s%s %.6f\n", name, open, labels, close, h.sum() / 1e6);
+        out.printf("%s_count%s%s%s %u\n", name, open, labels, close, static_cast<unsigned>(h.count()));
+    }
+
+    void writeJsonHistogram(JsonWriter &json, const char *name, const LatencyHistogram &h)
+    {
+        json.beginObject(name)
+            .field("count", h.count())
+            .field("avg_us", static_cast<unsigned long>(h.count() > 0 ? h.sum() / h.count() : 0))
+            .field("p50_us", h.quantile(0.5f))
+            .field("p99_us", h.quantile(0.99f))
+            .field("max_us", h.max())
+            .endObject();
+    }
+}
+
+Metrics::Metrics() : _lock(portMUX_INITIALIZER_UNLOCKED)
+{
+}
+
+void Metrics::record(Histogram histogram, int64_t durationUs)
+{
+    uint32_t us = durationUs < 0 ? 0 : durationUs > 0xFFFFFFFFLL ? 0xFFFFFFFFUL : static_cast<uint32_t>(durationUs);
+
+    portENTER_CRITICAL(&_lock);
+    _histograms[histogram].record(us);
+    portEXIT_CRITICAL(&_lock);
+}
+
+LatencyHistogram Metrics::get(Histogram histogram) const
+{
+    portENTER_CRITICAL(&_lock);
+    LatencyHistogram copy = _histograms[histogram];
+    portEXIT_CRITICAL(&_lock);
+    return copy;
+}
+
+const char *Metrics::sourceName(int source)
+{
+    static const char *const NAMES[] = {"tcp", "udp", "serial", "web", "telegram", "internal"};
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == static_cast<size_t>(CommandSource::COUNT),
+                  "Every CommandSource needs a name");
+    return NAMES[source];
+}
+
+void Metrics::writePrometheus(Print &out) const
+{
+    out.print("# HELP esp32_loop_duration_seconds Main loop pass time, excluding the idle wait\n"
+              "# TYPE esp32_loop_duration_seconds histogram\n");
+    writeHistogram(out, "esp32_loop_duration_seconds", nullptr, get(LOOP));
+
+    out.print("# HELP esp32_wifi_connect_seconds Time from losing WiFi (or boot) to having an address\n"
+              "# TYPE esp32_wifi_connect_seconds histogram\n");
+    writeHistogram(out, "esp32_wifi_connect_seconds", nullptr, get(WIFI_CONNECT));
+
+    out.print("# HELP esp32_command_parse_seconds Command parse time by front-end\n"
+              "# TYPE esp32_command_parse_seconds histogram\n");
+    for (int i = 0; i < static_cast<int>(CommandSource::COUNT); i++)
+    {
+        LatencyHistogram h = get(static_cast<Histogram>(PARSE_FIRST + i));
+        if (h.count() > 0)
+        {
+            writeHistogram(out, "esp32_command_parse_seconds", sourceName(i), h);
+        }
+    }
+
+    out.print("# HELP esp32_command_execute_seconds Command execute time by front-end, including the wait for the main loop\n"
+              "# TYPE esp32_command_execute_seconds histogram\n");
+    for (int i = 0; i < static_cast<int>(CommandSource::COUNT); i++)
+    {
+        LatencyHistogram h = get(static_cast<Histogram>(EXECUTE_FIRST + i));
+        if (h.count() > 0)
+        {
+            writeHistogram(out, "esp32_command_execute_seconds", sourceName(i), h);
+        }
+    }
+
+    out.printf("# HELP esp32_heap_free_bytes Free heap\n"
+               "# TYPE esp32_heap_free_bytes gauge\n"
+               "esp32_heap_free_bytes %u\n"
+               "# HELP esp32_heap_min_free_bytes Lowest free heap since boot\n"
+               "# TYPE esp32_heap_min_free_bytes gauge\n"
+               "esp32_heap_min_free_bytes %u\n"
+               "# HELP esp32_heap_largest_free_block_bytes Largest allocatable block\n"
+               "# TYPE esp32_heap_largest_free_block_bytes gauge\n"
+               "esp32_heap_largest_free_block_bytes %u\n"
+               "# HELP esp32_uptime_seconds Time since boot\n"
+               "# TYPE esp32_uptime_seconds counter\n"
+               "esp32_uptime_seconds %llu\n",
+               static_cast<unsigned>(ESP.getFreeHeap()), static_cast<unsigned>(ESP.getMinFreeHeap()),
+               static_cast<unsigned>(ESP.getMaxAllocHeap()), static_cast<unsigned long long>(now() / 1000000));
+}
+
+void Metrics::writeJsonFields(JsonWriter &json) const
+{
+    json.beginObject("histograms");
+    writeJsonHistogram(json, "loop", get(LOOP));
+    writeJsonHistogram(json, "wifi_connect", get(WIFI_CONNECT));
+
+    const char *const GROUPS[] = {"parse", "execute"};
+    const uint8_t FIRST[] = {PARSE_FIRST, EXECUTE_FIRST};
+    for (int group = 0; group < 2; group++)
+    {
+        json.beginObject(GROUPS[group]);
+        for (int i = 0; i < static_cast<int>(CommandSource::COUNT); i++)
+        {
+            LatencyHistogram h = get(static_cast<Histogram>(FIRST[group] + i));
+            if (h.count() > 0)
+            {
+                writeJsonHistogram(json, sourceName(i), h);
+            }
+        }
+        json.endObject();
+    }
+    json.endObject();
+
+    json.beginObject("heap")
+        .field("free", ESP.getFreeHeap())
+        .field("min_free", ESP.getMinFreeHeap())
+        .field("largest_block", ESP.getMaxAllocHeap())
+        .endObject();
+}
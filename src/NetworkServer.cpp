@@ -1,49 +1,120 @@
 #include "NetworkServer.h"
 #include "WiFiManager.h"
 #include "WatchdogManager.h"
-#include <ArduinoJson.h>
+#include "BufferPrint.h"
+#include "WallClock.h"
+#include "Logger.h"
+#include "AnalogSampler.h"
 
-// External references to global instances
-extern WiFiManager wifiManager;
-extern WatchdogManager watchdogManager;
+// Log queue, defined in main.cpp
+extern Logger logger;
 
-NetworkServer::NetworkServer(CommandParser &parser, PinController &pinController)
-    : _parser(parser),
+// DMA ADC sampler, defined in main.cpp
+extern AnalogSampler analogSampler;
+
+static_assert(UDP_MULTICAST_GROUP_ID >= 1 && UDP_MULTICAST_GROUP_ID <= 254,
+              "UDP_MULTICAST_GROUP_ID must be 1-254");
+
+NetworkServer::NetworkServer(CommandDispatcher &dispatcher, PinController &pinController)
+    : _dispatcher(dispatcher),
       _pinController(pinController),
+      _asyncServer(nullptr),
       _tcpServer(TCP_SERVER_PORT),
+      _nextUDPSubscriber(0),
+      _packetReady(nullptr),
+      _inputListenerId(-1),
+      _analogListenerId(-1),
       _lastClientCheck(0)
 {
+    for (int i = 0; i < MAX_TCP_CLIENTS; i++)
+    {
+        _tcpSubscribed[i] = false;
+    }
+    for (int i = 0; i < UDP_MAX_SUBSCRIBERS; i++)
+    {
+        _udpSubscribers[i].active = false;
+    }
+    for (int i = 0; i < UDP_SCHEDULE_SLOTS; i++)
+    {
+        _scheduled[i].active = false;
+    }
+}
+
+NetworkServer::~NetworkServer()
+{
+    _pinController.removeInputListener(_inputListenerId);
+    analogSampler.removeBlockListener(_analogListenerId);
+    delete _asyncServer;
 }
 
 void NetworkServer::begin()
 {
     // Start TCP server
+#if ENABLE_ASYNC_TCP_SERVER
+    _asyncServer = new AsyncCommandServer(
+        TCP_SERVER_PORT,
+        [this](const char *command, size_t length, Print &out, bool &subscribed)
+        { this->_dispatcher.process(command, length, out, &subscribed, CommandSource::TCP); },
+        [this](const uint8_t *frame, size_t length, uint8_t *reply)
+        { return this->_dispatcher.processBinary(frame, length, reply, CommandSource::TCP); });
+    _asyncServer->begin();
+#else
     _tcpServer.begin();
     _tcpServer.setNoDelay(true);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[Server] TCP server started on port %d\n", TCP_SERVER_PORT);
+    LOG_INFO("Server", "TCP server started on port %d", TCP_SERVER_PORT);
 #endif
 
+    // Push input changes to subscribers
+    _inputListenerId = _pinController.addInputListener([this](const InputEvent &event)
+                                                       { this->handleInputEvent(event); });
+    _analogListenerId = analogSampler.addBlockListener([this](const uint8_t *frame, size_t length)
+                                                       { this->handleAnalogBlock(frame, length); });
+
     // Start UDP server
-    if (_udp.begin(UDP_SERVER_PORT))
+    _udp.onPacket([this](AsyncUDPPacket &packet)
+                  { this->queuePacket(packet, false); });
+    if (_udp.listen(UDP_SERVER_PORT))
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[Server] UDP server started on port %d\n", UDP_SERVER_PORT);
-#endif
+        LOG_INFO("Server", "UDP server started on port %d", UDP_SERVER_PORT);
     }
     else
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Server] Failed to start UDP server");
-#endif
+        LOG_ERROR("Server", "Failed to start UDP server");
     }
+
+    // Wall clock for scheduled commands, UTC
+    configTime(0, 0, NTP_SERVER);
+}
+
+void NetworkServer::onNetworkUp()
+{
+    // Group membership is per interface address, so join again on every
+    // (re)connect
+#if ENABLE_UDP_MULTICAST
+    _multicast.close();
+    _multicast.onPacket([this](AsyncUDPPacket &packet)
+                        { this->queuePacket(packet, true); });
+    IPAddress group(239, 255, 42, UDP_MULTICAST_GROUP_ID);
+    if (_multicast.listenMulticast(group, UDP_MULTICAST_PORT))
+    {
+        LOG_INFO("Server", "Joined multicast group %s:%d", group.toString().c_str(), UDP_MULTICAST_PORT);
+    }
+    else
+    {
+        LOG_ERROR("Server", "Failed to join multicast group");
+    }
+#endif
 }
 
 void NetworkServer::loop()
 {
-    handleTCPClients();
-    handleUDP();
+    // The async server handles TCP from its own callbacks
+    if (_asyncServer == nullptr)
+    {
+        handleTCPClients();
+    }
+    runScheduled();
 }
 
 void NetworkServer::handleTCPClients()
@@ -64,10 +135,10 @@ void NetworkServer::handleTCPClients()
                     _tcpClients[i].stop();
                 }
                 _tcpClients[i] = _tcpServer.available();
+                _tcpFramers[i].reset();
+                _tcpSubscribed[i] = false;
 
-#if ENABLE_SERIAL_DEBUG
-                Serial.printf("[Server] New TCP client connected (slot %d)\n", i);
-#endif
+                LOG_DEBUG("Server", "New TCP client connected (slot %d)", i);
 
                 // Send welcome message
                 _tcpClients[i].println("ESP32 Pin Controller Ready");
@@ -85,9 +156,7 @@ void NetworkServer::handleTCPClients()
             client.println("ERROR: Server full");
             client.stop();
 
-#if ENABLE_SERIAL_DEBUG
-            Serial.println("[Server] Rejected TCP client (no free slots)");
-#endif
+            LOG_WARNING("Server", "Rejected TCP client (no free slots)");
         }
     }
 
@@ -96,176 +165,351 @@ void NetworkServer::handleTCPClients()
     {
         if (_tcpClients[i] && _tcpClients[i].connected())
         {
-            // Check if data is available
-            if (_tcpClients[i].available())
-            {
-                String command = _tcpClients[i].readStringUntil('\n');
-                command.trim();
-
-                if (command.length() > 0)
-                {
-#if ENABLE_SERIAL_DEBUG
-                    Serial.printf("[Server] TCP command from client %d: %s\n", i, command.c_str());
-#endif
-
-                    String response = processCommand(command);
-                    _tcpClients[i].println(response);
-                }
-            }
+            // Consume whatever has arrived; partial lines stay buffered
+            _tcpFramers[i].poll(_tcpClients[i], [this, i](const char *command, size_t length)
+                                { this->handleTCPLine(i, command, length); });
         }
         else if (_tcpClients[i])
         {
             // Client disconnected
             _tcpClients[i].stop();
 
-#if ENABLE_SERIAL_DEBUG
-            Serial.printf("[Server] TCP client %d disconnected\n", i);
-#endif
+            LOG_DEBUG("Server", "TCP client %d disconnected", i);
         }
     }
 }
 
-void NetworkServer::handleUDP()
+void NetworkServer::handleTCPLine(int slot, const char *command, size_t length)
 {
-    int packetSize = _udp.parsePacket();
+    if (command == nullptr)
+    {
+        _tcpClients[slot].println("{\"success\":false,\"message\":\"Command too long\"}");
+        return;
+    }
 
-    if (packetSize > 0)
+    const uint8_t *frame = reinterpret_cast<const uint8_t *>(command);
+    if (BinaryProtocol::isFrame(frame, length))
     {
-        char packet[COMMAND_BUFFER_SIZE];
-        int len = _udp.read(packet, COMMAND_BUFFER_SIZE - 1);
-        packet[len] = '\0';
+        uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+        size_t replyLength = _dispatcher.processBinary(frame, length, reply, CommandSource::TCP);
+        _tcpClients[slot].write(reply, replyLength);
+        return;
+    }
 
-        String command = String(packet);
-        command.trim();
+    LOG_DEBUG("Server", "TCP command from client %d: %s", slot, command);
 
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[Server] UDP command from %s:%d: %s\n",
-                      _udp.remoteIP().toString().c_str(),
-                      _udp.remotePort(),
-                      command.c_str());
-#endif
+    BufferPrint response(_response, sizeof(_response));
+    _dispatcher.process(command, length, response, &_tcpSubscribed[slot], CommandSource::TCP);
+    if (response.overflowed())
+    {
+        _tcpClients[slot].println("{\"success\":false,\"message\":\"Response too large\"}");
+        return;
+    }
 
-        String response = processCommand(command);
+    // One write per response instead of one per token
+    response.print("\r\n");
+    _tcpClients[slot].write(response.data(), response.length());
+}
 
-        // Send response back to sender
-        _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-        _udp.print(response);
-        _udp.endPacket();
+void NetworkServer::queuePacket(AsyncUDPPacket &packet, bool multicast)
+{
+    Datagram datagram;
+    size_t length = packet.length() < COMMAND_BUFFER_SIZE - 1 ? packet.length() : COMMAND_BUFFER_SIZE - 1;
+    memcpy(datagram.data, packet.data(), length);
+    datagram.data[length] = '\0';
+    datagram.length = static_cast<uint16_t>(length);
+    datagram.ip = packet.remoteIP();
+    datagram.port = packet.remotePort();
+    datagram.multicast = multicast;
+
+    // A full queue drops the datagram, as lwIP would
+    _datagrams.push(datagram);
+    if (_packetReady != nullptr)
+    {
+        _packetReady();
     }
 }
 
-String NetworkServer::processCommand(const String &commandStr)
+void NetworkServer::handleUDP()
 {
-    // Parse the command
-    Command cmd = _parser.parse(commandStr);
+    Datagram datagram;
+    for (int i = 0; i < UDP_MAX_PACKETS_PER_LOOP; i++)
+    {
+        if (!_datagrams.pop(datagram))
+        {
+            return;
+        }
+        handleUDPPacket(datagram);
+    }
 
-    if (!cmd.isValid())
+    // The rest wait for the next pass, so the loop keeps feeding the watchdog
+    if (!_datagrams.empty() && _packetReady != nullptr)
     {
-        return _parser.generateResponse(cmd, false);
+        _packetReady();
     }
+}
+
+void NetworkServer::sendUDP(const IPAddress &ip, uint16_t port, const void *data, size_t length)
+{
+    _udp.writeTo(static_cast<const uint8_t *>(data), length, ip, port);
+}
+
+void NetworkServer::handleUDPPacket(const Datagram &datagram)
+{
+    const char *packet = datagram.data;
+    size_t length = datagram.length;
+    bool multicast = datagram.multicast;
 
-    // Execute the command
-    bool success = false;
-    String message = "";
-    int resultValue = -1;
+    const uint8_t *frame = reinterpret_cast<const uint8_t *>(packet);
+    bool binary = BinaryProtocol::isFrame(frame, length);
 
-    switch (cmd.type)
+    if (!binary && logger.enabled(LogLevel::DEBUG))
     {
-    case CommandType::SET:
-        success = _pinController.setDigital(cmd.pin, cmd.value);
-        message = success ? "Pin set successfully" : "Failed to set pin";
-        resultValue = cmd.value;
-        break;
+        LOG_DEBUG("Server", "%s command from %s:%d: %s",
+                  multicast ? "Multicast" : "UDP",
+                  datagram.ip.toString().c_str(),
+                  datagram.port,
+                  packet);
+    }
+
+    Command cmd = _dispatcher.parse(packet, length, CommandSource::UDP);
+    if (multicast)
+    {
+        // A whole fleet answering one datagram would only cause a burst
+        cmd.noReply = true;
+    }
 
-    case CommandType::GET:
-        resultValue = _pinController.getDigital(cmd.pin);
-        success = (resultValue >= 0);
-        message = success ? "Pin value retrieved" : "Failed to get pin value";
-        break;
+    unsigned long now = millis();
+    bool sequenced = cmd.isValid() && cmd.sequenced;
+    bool fresh = !sequenced || _udpSequences.check(cmd, now);
 
-    case CommandType::TOGGLE:
-        success = _pinController.toggle(cmd.pin);
-        if (success)
+    const char *scheduleError = nullptr;
+    bool held = fresh && cmd.isValid() && cmd.applyAt != 0 && schedule(cmd, scheduleError);
+
+    // Recorded once the command is held or about to run on this task; one
+    // schedule() rejected can be retried with the same sequence number
+    if (fresh && sequenced && !(held && scheduleError != nullptr))
+    {
+        _udpSequences.commit(cmd, now);
+    }
+
+    if (binary)
+    {
+        uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+        uint8_t pin = cmd.pin >= 0 ? cmd.pin : 0;
+        size_t replyLength;
+        if (!fresh)
         {
-            resultValue = _pinController.getDigital(cmd.pin);
-            message = "Pin toggled successfully";
+            replyLength = BinaryProtocol::encodeResponse(reply, cmd.opcode, BinaryProtocol::STATUS_STALE,
+                                                         pin, 0, cmd.sequence);
+        }
+        else if (held)
+        {
+            uint8_t status = scheduleError == nullptr ? BinaryProtocol::STATUS_OK : BinaryProtocol::STATUS_FAILED;
+            replyLength = BinaryProtocol::encodeResponse(reply, cmd.opcode, status, pin, 0, cmd.sequence);
         }
         else
         {
-            message = "Failed to toggle pin";
+            replyLength = _dispatcher.executeBinary(cmd, reply, CommandSource::UDP);
+        }
+
+        if (!cmd.noReply)
+        {
+            sendUDP(datagram.ip, datagram.port, reply, replyLength);
+        }
+        return;
+    }
+
+    const IPAddress &remoteIP = datagram.ip;
+    uint16_t remotePort = datagram.port;
+
+    BufferPrint response(_response, sizeof(_response));
+    if (!fresh)
+    {
+        _dispatcher.parser().writeResponse(response, cmd, false, "Stale or duplicate sequence, ignored");
+    }
+    else if (held)
+    {
+        _dispatcher.parser().writeResponse(response, cmd, scheduleError == nullptr,
+                                           scheduleError != nullptr ? scheduleError : "Scheduled");
+    }
+    else if (multicast)
+    {
+        _dispatcher.dispatch(cmd, response, nullptr, CommandSource::UDP);
+    }
+    else
+    {
+        int subscriber = findUDPSubscriber(remoteIP, remotePort);
+        bool subscribed = subscriber >= 0;
+        _dispatcher.dispatch(cmd, response, &subscribed, CommandSource::UDP);
+        updateUDPSubscriber(remoteIP, remotePort, subscriber, subscribed);
+    }
+
+    if (cmd.noReply)
+    {
+        return;
+    }
+
+    // Send response back to sender
+    if (response.overflowed())
+    {
+        static const char TOO_LARGE[] = "{\"success\":false,\"message\":\"Response too large\"}";
+        sendUDP(remoteIP, remotePort, TOO_LARGE, sizeof(TOO_LARGE) - 1);
+    }
+    else
+    {
+        sendUDP(remoteIP, remotePort, response.data(), response.length());
+    }
+}
+
+bool NetworkServer::schedule(Command &cmd, const char *&error)
+{
+    uint64_t now;
+    if (!WallClock::nowMs(now))
+    {
+        error = "Clock not synchronized";
+        return true;
+    }
+
+    if (cmd.applyAt <= now)
+    {
+        // Late arrival, apply as soon as possible
+        cmd.applyAt = 0;
+        return false;
+    }
+
+    if (cmd.applyAt - now > UDP_SCHEDULE_MAX_AHEAD_MS)
+    {
+        error = "Apply time too far ahead";
+        return true;
+    }
+
+    for (int i = 0; i < UDP_SCHEDULE_SLOTS; i++)
+    {
+        if (!_scheduled[i].active)
+        {
+            _scheduled[i].cmd = cmd;
+            _scheduled[i].active = true;
+            error = nullptr;
+            return true;
         }
-        break;
+    }
+
+    error = "Schedule full";
+    return true;
+}
+
+void NetworkServer::runScheduled()
+{
+    uint64_t now;
+    if (!WallClock::nowMs(now))
+    {
+        return;
+    }
 
-    case CommandType::PWM:
-        success = _pinController.setPWM(cmd.pin, cmd.value);
-        message = success ? "PWM set successfully" : "Failed to set PWM";
-        resultValue = cmd.value;
-        break;
+    for (;;)
+    {
+        int due = -1;
+        for (int i = 0; i < UDP_SCHEDULE_SLOTS; i++)
+        {
+            if (_scheduled[i].active && _scheduled[i].cmd.applyAt <= now &&
+                (due < 0 || _scheduled[i].cmd.applyAt < _scheduled[due].cmd.applyAt))
+            {
+                due = i;
+            }
+        }
+        if (due < 0)
+        {
+            return;
+        }
 
-    case CommandType::STATUS:
-        return generateStatusResponse();
+        Command &cmd = _scheduled[due].cmd;
+        cmd.applyAt = 0;
+        _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::UDP);
+        _scheduled[due].active = false;
+    }
+}
 
-    case CommandType::RESET:
-        message = "System will restart in 2 seconds";
-        success = true;
-        // Note: Actual restart will be handled in main loop
-        break;
+void NetworkServer::updateUDPSubscriber(const IPAddress &ip, uint16_t port, int subscriber, bool subscribed)
+{
+    if (subscribed && subscriber < 0)
+    {
+        // Reuse a free slot, or replace the oldest subscriber
+        int slot = -1;
+        for (int i = 0; i < UDP_MAX_SUBSCRIBERS && slot < 0; i++)
+        {
+            if (!_udpSubscribers[i].active)
+            {
+                slot = i;
+            }
+        }
+        if (slot < 0)
+        {
+            slot = _nextUDPSubscriber;
+            _nextUDPSubscriber = (_nextUDPSubscriber + 1) % UDP_MAX_SUBSCRIBERS;
+        }
+        _udpSubscribers[slot].ip = ip;
+        _udpSubscribers[slot].port = port;
+        _udpSubscribers[slot].active = true;
+    }
+    else if (!subscribed && subscriber >= 0)
+    {
+        _udpSubscribers[subscriber].active = false;
+    }
+}
 
-    case CommandType::RESET_PINS:
-        success = _pinController.resetAllPins();
-        message = success ? "All pins reset to LOW" : "Failed to reset pins";
-        break;
+void NetworkServer::handleInputEvent(const InputEvent &event)
+{
+    char buffer[128];
+    BufferPrint line(buffer, sizeof(buffer));
+    _dispatcher.parser().writeInputEvent(line, event);
 
-    case CommandType::HELP:
-        return _parser.getHelpText();
+    if (_asyncServer != nullptr)
+    {
+        _asyncServer->broadcast(line.c_str(), line.length());
+    }
+    else
+    {
+        for (int i = 0; i < MAX_TCP_CLIENTS; i++)
+        {
+            if (_tcpSubscribed[i] && _tcpClients[i] && _tcpClients[i].connected())
+            {
+                _tcpClients[i].println(line.c_str());
+            }
+        }
+    }
 
-    default:
-        message = "Unknown command";
-        success = false;
-        break;
+    for (int i = 0; i < UDP_MAX_SUBSCRIBERS; i++)
+    {
+        if (_udpSubscribers[i].active)
+        {
+            sendUDP(_udpSubscribers[i].ip, _udpSubscribers[i].port, line.data(), line.length());
+        }
     }
+}
 
-    return _parser.generateResponse(cmd, success, message, resultValue);
+void NetworkServer::handleAnalogBlock(const uint8_t *frame, size_t length)
+{
+    for (int i = 0; i < UDP_MAX_SUBSCRIBERS; i++)
+    {
+        if (_udpSubscribers[i].active)
+        {
+            sendUDP(_udpSubscribers[i].ip, _udpSubscribers[i].port, frame, length);
+        }
+    }
 }
 
-String NetworkServer::generateStatusResponse()
+int NetworkServer::findUDPSubscriber(const IPAddress &ip, uint16_t port)
 {
-    JsonDocument doc;
-
-    doc["success"] = true;
-    doc["command"] = "STATUS";
-
-    // System info
-    JsonObject system = doc["system"].to<JsonObject>();
-    system["uptime"] = watchdogManager.getUptimeSeconds();
-    system["freeHeap"] = ESP.getFreeHeap();
-    system["chipModel"] = ESP.getChipModel();
-    system["cpuFreq"] = ESP.getCpuFreqMHz();
-
-    // WiFi info
-    JsonObject wifi = doc["wifi"].to<JsonObject>();
-    wifi["connected"] = wifiManager.isConnected();
-    wifi["ssid"] = wifiManager.getCurrentSSID();
-    wifi["ip"] = wifiManager.getIPAddress();
-    wifi["rssi"] = wifiManager.getSignalStrength();
-
-    // Server info
-    JsonObject server = doc["server"].to<JsonObject>();
-    server["tcpPort"] = TCP_SERVER_PORT;
-    server["udpPort"] = UDP_SERVER_PORT;
-    server["tcpClients"] = getConnectedClients();
-
-    // Pin states
-    doc["pinStates"] = _pinController.getStateJSON();
-
-    // Watchdog info
-    JsonObject wdt = doc["watchdog"].to<JsonObject>();
-    wdt["errorCount"] = watchdogManager.getErrorCount();
-    wdt["lastError"] = watchdogManager.getLastError();
-
-    String response;
-    serializeJson(doc, response); // Use compact format for network transmission
-    return response;
+    for (int i = 0; i < UDP_MAX_SUBSCRIBERS; i++)
+    {
+        const UDPSubscriber &sub = _udpSubscribers[i];
+        if (sub.active && sub.ip == ip && sub.port == port)
+        {
+            return i;
+        }
+    }
+    return -1;
 }
 
 String NetworkServer::getStatus()
@@ -273,12 +517,21 @@ String NetworkServer::getStatus()
     String status = "Network Server Status:\n";
     status += "  TCP Server: Port " + String(TCP_SERVER_PORT) + "\n";
     status += "  UDP Server: Port " + String(UDP_SERVER_PORT) + "\n";
+#if ENABLE_UDP_MULTICAST
+    status += "  Multicast Group: 239.255.42." + String(UDP_MULTICAST_GROUP_ID) + ":" +
+              String(UDP_MULTICAST_PORT) + "\n";
+#endif
     status += "  Connected TCP Clients: " + String(getConnectedClients()) + "\n";
     return status;
 }
 
 int NetworkServer::getConnectedClients()
 {
+    if (_asyncServer != nullptr)
+    {
+        return _asyncServer->getConnectedClients();
+    }
+
     int count = 0;
     for (int i = 0; i < MAX_TCP_CLIENTS; i++)
     {
@@ -0,0 +1,124 @@
+#include "PWMChannelPool.h"
+#include "Logger.h"
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// LEDC timers are clocked from the 80 MHz APB clock
+static const uint32_t LEDC_SOURCE_CLOCK = 80000000;
+
+PWMChannelPool::PWMChannelPool()
+{
+    releaseAll();
+}
+
+int PWMChannelPool::acquire(uint32_t frequency, uint8_t resolution)
+{
+    if (!isSupported(frequency, resolution))
+    {
+        return -1;
+    }
+
+    // Prefer a timer that is already running this configuration, then a
+    // completely idle timer
+    int channel = -1;
+    for (int pass = 0; pass < 2 && channel < 0; pass++)
+    {
+        for (int c = 0; c < CHANNEL_COUNT; c++)
+        {
+            if (_usedChannels & (1u << c))
+            {
+                continue;
+            }
+
+            const TimerSlot &timer = _timers[timerFor(c)];
+            bool shared = timer.users > 0 && timerMatches(timerFor(c), frequency, resolution);
+            bool idle = timer.users == 0;
+
+            if ((pass == 0 && shared) || (pass == 1 && idle))
+            {
+                channel = c;
+                break;
+            }
+        }
+    }
+
+    if (channel < 0)
+    {
+        LOG_ERROR("PWMPool", "No channel available for %lu Hz / %d bit",
+                  (unsigned long)frequency, resolution);
+        return -1;
+    }
+
+    TimerSlot &timer = _timers[timerFor(channel)];
+    timer.frequency = frequency;
+    timer.resolution = resolution;
+    timer.users++;
+    _usedChannels |= (1u << channel);
+
+    // ledcSetup also records the channel's resolution used by ledcWrite, so it
+    // is needed even when the timer is already configured
+    ledcSetup(channel, frequency, resolution);
+
+    LOG_DEBUG("PWMPool", "Channel %d (timer %d) at %lu Hz / %d bit",
+              channel, timerFor(channel), (unsigned long)frequency, resolution);
+
+    return channel;
+}
+
+void PWMChannelPool::release(int channel)
+{
+    if (channel < 0 || channel >= CHANNEL_COUNT || !(_usedChannels & (1u << channel)))
+    {
+        return;
+    }
+
+    _usedChannels &= ~(1u << channel);
+    _timers[timerFor(channel)].users--;
+}
+
+void PWMChannelPool::releaseAll()
+{
+    _usedChannels = 0;
+    for (int t = 0; t < TIMER_COUNT; t++)
+    {
+        _timers[t].frequency = 0;
+        _timers[t].resolution = 0;
+        _timers[t].users = 0;
+    }
+}
+
+int PWMChannelPool::available(uint32_t frequency, uint8_t resolution) const
+{
+    if (!isSupported(frequency, resolution))
+    {
+        return 0;
+    }
+
+    int count = 0;
+    for (int c = 0; c < CHANNEL_COUNT; c++)
+    {
+        if (!(_usedChannels & (1u << c)) && timerMatches(timerFor(c), frequency, resolution))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool PWMChannelPool::isSupported(uint32_t frequency, uint8_t resolution)
+{
+    if (frequency == 0 || resolution < 1 || resolution > PWM_MAX_RESOLUTION)
+    {
+        return false;
+    }
+
+    // The timer counts 2^resolution ticks per period
+    return (static_cast<uint64_t>(frequency) << resolution) <= LEDC_SOURCE_CLOCK;
+}
+
+bool PWMChannelPool::timerMatches(int timer, uint32_t frequency, uint8_t resolution) const
+{
+    const TimerSlot &slot = _timers[timer];
+    return slot.users == 0 || (slot.frequency == frequency && slot.resolution == resolution);
+}
@@ -1,33 +1,301 @@
 #include "PinController.h"
-#include <ArduinoJson.h>
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "Logger.h"
 
-PinController::PinController() : _nextPWMChannel(0)
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// Each hardware fade step may last at most this many PWM periods
+static const uint32_t LEDC_FADE_MAX_CYCLES_PER_STEP = 1023;
+
+static_assert(TIMER_MAX_DELAY_MS <= TimerWheel<PinOp, 1>::MAX_DELAY,
+              "TIMER_MAX_DELAY_MS exceeds the timer wheel range");
+static_assert(PULSE_MAX_DURATION_MS <= 0xFFFF, "PULSE_MAX_DURATION_MS must fit a 16-bit pin op value");
+static_assert(SCENE_MAX_PWM_PINS <= 0xFF, "SCENE_MAX_PWM_PINS must fit PinScene::pwmCount");
+
+namespace
+{
+    // Copy a name into a fixed buffer, cutting it to fit
+    void copyName(char *dest, const char *name)
+    {
+        strncpy(dest, name, SCENE_NAME_LENGTH - 1);
+        dest[SCENE_NAME_LENGTH - 1] = '\0';
+    }
+
+    // Remove the PWM entry of a pin from a scene, if it has one
+    void removeScenePWM(PinScene &scene, uint8_t pin)
+    {
+        for (uint8_t i = 0; i < scene.pwmCount; i++)
+        {
+            if (scene.pwm[i].pin == pin)
+            {
+                scene.pwm[i] = scene.pwm[--scene.pwmCount];
+                return;
+            }
+        }
+    }
+}
+
+PinController::PinController()
+    : _fadingPins(0), _lastFadeUpdate(0), _fadeEngineInstalled(false), _pendingInputs(0),
+      _pulseLock(portMUX_INITIALIZER_UNLOCKED), _pulsingPins(0), _pulseRestore(0),
+      _pulseArmed(0), _pulseEnded(0), _changedPins(0), _unsavedPins(0), _saveDue(false),
+      _firstUnsaved(0), _lastUnsaved(0), _saved(false), _lastSave(0), _groupCount(0), _sceneCount(0)
 {
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        _pinToPWMChannel[pin] = -1;
+        _pinContexts[pin].owner = this;
+        _pinContexts[pin].pin = pin;
+        _inputDebounce[pin].pending = false;
+        _pulseTimers[pin] = nullptr;
+    }
 }
 
 void PinController::begin()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[PinCtrl] Pin Controller initialized");
-    Serial.printf("[PinCtrl] %d safe pins available\n", SAFE_PIN_COUNT);
+    LOG_INFO("PinCtrl", "Pin Controller initialized");
+    LOG_INFO("PinCtrl", "%d safe pins available", SAFE_PIN_COUNT);
+
+#if PIN_STATE_SAVE_INTERVAL > 0
+    restoreState();
+#endif
+
+    loadScenes();
+}
+
+void PinController::loop()
+{
+    serviceInputs();
+    servicePulses();
+    serviceTimers();
+    serviceFades();
+#if PIN_STATE_SAVE_INTERVAL > 0
+    servicePersistence();
+#endif
+}
+
+uint32_t PinController::idleTimeMs(uint32_t maxMs) const
+{
+    unsigned long now = millis();
+    uint32_t wait = maxMs;
+
+    if (_fadingPins != 0)
+    {
+        unsigned long elapsed = now - _lastFadeUpdate;
+        uint32_t remaining = elapsed >= FADE_UPDATE_INTERVAL_MS ? 0 : FADE_UPDATE_INTERVAL_MS - elapsed;
+        if (remaining < wait)
+        {
+            wait = remaining;
+        }
+    }
+
+    // advance() catches up to millis(), so a tick already passed is due now
+    uint32_t tick;
+    if (_timers.nextExpiry(tick))
+    {
+        int32_t ahead = static_cast<int32_t>(tick - static_cast<uint32_t>(now));
+        uint32_t remaining = ahead <= 0 ? 0 : static_cast<uint32_t>(ahead);
+        if (remaining < wait)
+        {
+            wait = remaining;
+        }
+    }
+
+    if (_pendingInputs != 0)
+    {
+        int64_t nowUs = esp_timer_get_time();
+        uint64_t pending = _pendingInputs;
+        while (pending != 0)
+        {
+            int pin = __builtin_ctzll(pending);
+            pending &= pending - 1;
+
+            const InputDebounce &debounce = _inputDebounce[pin];
+            int64_t aheadUs = debounce.lastEdgeUs + debounce.debounceUs - nowUs;
+            uint32_t remaining = aheadUs <= 0 ? 0 : static_cast<uint32_t>((aheadUs + 999) / 1000);
+            if (remaining < wait)
+            {
+                wait = remaining;
+            }
+        }
+    }
+    return wait;
+}
+
+void PinController::restoreState()
+{
+    SavedPin saved[GPIO_PIN_COUNT];
+    size_t count = _store.load(saved, GPIO_PIN_COUNT);
+    size_t restored = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const SavedPin &entry = saved[i];
+        bool success = entry.pwm ? setPWM(entry.pin, entry.value, entry.frequency, entry.resolution)
+                                 : setDigital(entry.pin, entry.value);
+        if (success)
+        {
+            restored++;
+        }
+    }
+
+    // What was just restored is what NVS already holds
+    _unsavedPins.store(0);
+
+    LOG_INFO("PinCtrl", "Restored %u of %u saved pins", static_cast<unsigned>(restored),
+             static_cast<unsigned>(count));
+}
+
+void PinController::servicePersistence()
+{
+    unsigned long now = millis();
+    if (_unsavedPins.exchange(0) != 0)
+    {
+        if (!_saveDue)
+        {
+            _saveDue = true;
+            _firstUnsaved = now;
+        }
+        _lastUnsaved = now;
+    }
+
+    if (!_saveDue)
+    {
+        return;
+    }
+
+    // After the first save, at most one per PIN_STATE_SAVE_INTERVAL, so pins
+    // that never settle cannot wear out the flash; a restart still flushes
+    if (_saved && now - _lastSave < PIN_STATE_SAVE_INTERVAL)
+    {
+        return;
+    }
+
+    if (now - _lastUnsaved >= PIN_STATE_SAVE_DELAY_MS || now - _firstUnsaved >= PIN_STATE_SAVE_INTERVAL)
+    {
+        flushState();
+    }
+}
+
+void PinController::flushState()
+{
+#if PIN_STATE_SAVE_INTERVAL > 0
+    SavedPin pins[GPIO_PIN_COUNT];
+    size_t count = snapshotOutputs(pins);
+    _store.save(pins, count);
+    _saveDue = false;
+    _saved = true;
+    _lastSave = millis();
 #endif
 }
 
+size_t PinController::snapshotOutputs(SavedPin *pins) const
+{
+    size_t count = 0;
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        const PinState &state = _pinStates[pin];
+        if (!state.isInitialized ||
+            (state.mode != PinMode::DIGITAL_OUTPUT && state.mode != PinMode::PWM_OUTPUT))
+        {
+            continue;
+        }
+
+        // Save where a running fade or pulse settles, not where it is now
+        int value = state.value;
+        if ((_fadingPins >> pin) & 1)
+        {
+            value = _fades[pin].to;
+        }
+        else if ((_pulsingPins >> pin) & 1)
+        {
+            value = (_pulseRestore >> pin) & 1;
+        }
+
+        SavedPin &entry = pins[count++];
+        memset(&entry, 0, sizeof(entry));
+        entry.pin = pin;
+        entry.pwm = state.mode == PinMode::PWM_OUTPUT;
+        entry.value = value;
+        if (entry.pwm)
+        {
+            entry.frequency = state.pwmFrequency;
+            entry.resolution = state.pwmResolution;
+        }
+    }
+    return count;
+}
+
+void PinController::serviceFades()
+{
+    if (_fadingPins == 0)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (now - _lastFadeUpdate < FADE_UPDATE_INTERVAL_MS)
+    {
+        return;
+    }
+    _lastFadeUpdate = now;
+
+    uint64_t pending = _fadingPins;
+    while (pending != 0)
+    {
+        int pin = __builtin_ctzll(pending);
+        pending &= pending - 1;
+
+        const Fade &fade = _fades[pin];
+        PinState &state = _pinStates[pin];
+        int channel = _pinToPWMChannel[pin];
+        unsigned long elapsed = now - fade.startTime;
+
+        if (elapsed >= fade.duration)
+        {
+            if (!fade.hardware)
+            {
+                ledcWrite(channel, fade.to);
+            }
+            state.value = fade.to;
+            markChanged(pin);
+            _fadingPins &= ~(1ULL << pin);
+            continue;
+        }
+
+        if (fade.hardware)
+        {
+            // The fade engine drives the duty, just keep the state current
+            state.value = ledcRead(channel);
+            markChanged(pin);
+            continue;
+        }
+
+        int value = fadeValueAt(fade, elapsed);
+        if (value != state.value)
+        {
+            ledcWrite(channel, value);
+            state.value = value;
+            markChanged(pin);
+        }
+    }
+}
+
 bool PinController::setDigital(int pin, int value)
 {
     if (!isValidPin(pin))
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[PinCtrl] Invalid pin: %d\n", pin);
-#endif
+        LOG_WARNING("PinCtrl", "Invalid pin: %d", pin);
         return false;
     }
 
     if (value != 0 && value != 1)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[PinCtrl] Invalid digital value: %d (must be 0 or 1)\n", value);
-#endif
+        LOG_WARNING("PinCtrl", "Invalid digital value: %d (must be 0 or 1)", value);
         return false;
     }
 
@@ -42,12 +310,12 @@ bool PinController::setDigital(int pin, int value)
     }
 
     // Set the pin value
+    cancelPulse(pin);
     digitalWrite(pin, value);
     state.value = value;
+    markChanged(pin);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[PinCtrl] Set pin %d to %d\n", pin, value);
-#endif
+    LOG_DEBUG("PinCtrl", "Set pin %d to %d", pin, value);
 
     return true;
 }
@@ -60,13 +328,16 @@ int PinController::getDigital(int pin)
     }
 
     // If pin is configured, return stored state
-    if (_pinStates.find(pin) != _pinStates.end())
+    const PinState &state = _pinStates[pin];
+    if (state.isInitialized && state.mode == PinMode::DIGITAL_OUTPUT)
     {
-        PinState &state = _pinStates[pin];
-        if (state.isInitialized && state.mode == PinMode::DIGITAL_OUTPUT)
-        {
-            return state.value;
-        }
+        return state.value;
+    }
+
+    // Configured inputs keep their pull setting
+    if (state.isInitialized && state.mode == PinMode::DIGITAL_INPUT)
+    {
+        return digitalRead(pin);
     }
 
     // Otherwise, configure as input and read current value
@@ -90,42 +361,63 @@ bool PinController::toggle(int pin)
     return setDigital(pin, currentValue == 0 ? 1 : 0);
 }
 
-bool PinController::setPWM(int pin, int value)
+bool PinController::setPWM(int pin, int value, uint32_t frequency, uint8_t resolution)
 {
     if (!isValidPin(pin))
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[PinCtrl] Invalid pin: %d\n", pin);
-#endif
+        LOG_WARNING("PinCtrl", "Invalid pin: %d", pin);
         return false;
     }
 
-    if (value < 0 || value > 255)
+    if (!supportsPWM(pin))
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[PinCtrl] Invalid PWM value: %d (must be 0-255)\n", value);
-#endif
+        LOG_WARNING("PinCtrl", "Pin %d does not support PWM", pin);
         return false;
     }
 
-    // Configure pin for PWM if needed
+    // Unspecified settings keep the pin's current configuration
     PinState &state = _pinStates[pin];
-    if (!state.isInitialized || state.mode != PinMode::PWM_OUTPUT)
+    bool isPWM = state.isInitialized && state.mode == PinMode::PWM_OUTPUT;
+    if (frequency == 0)
+    {
+        frequency = isPWM ? state.pwmFrequency : PWM_DEFAULT_FREQUENCY;
+    }
+    if (resolution == 0)
+    {
+        resolution = isPWM ? state.pwmResolution : PWM_DEFAULT_RESOLUTION;
+    }
+
+    if (!PWMChannelPool::isSupported(frequency, resolution))
+    {
+        LOG_WARNING("PinCtrl", "Unsupported PWM config: %lu Hz / %d bit",
+                    (unsigned long)frequency, resolution);
+        return false;
+    }
+
+    int maxDuty = (1 << resolution) - 1;
+    if (value < 0 || value > maxDuty)
+    {
+        LOG_WARNING("PinCtrl", "Invalid PWM value: %d (must be 0-%d)", value, maxDuty);
+        return false;
+    }
+
+    // Configure pin for PWM if needed, or move it to a timer with the new settings
+    if (!isPWM || state.pwmFrequency != frequency || state.pwmResolution != resolution)
     {
-        if (!configurePWMOutput(pin))
+        if (!configurePWMOutput(pin, frequency, resolution))
         {
             return false;
         }
     }
 
     // Set PWM duty cycle
+    cancelFade(pin);
     int channel = _pinToPWMChannel[pin];
     ledcWrite(channel, value);
     state.value = value;
+    markChanged(pin);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[PinCtrl] Set PWM on pin %d to %d (channel %d)\n", pin, value, channel);
-#endif
+    LOG_DEBUG("PinCtrl", "Set PWM on pin %d to %d (channel %d)", pin, value, channel);
 
     return true;
 }
@@ -137,204 +429,1266 @@ int PinController::getPWM(int pin)
         return -1;
     }
 
-    if (_pinStates.find(pin) != _pinStates.end())
+    const PinState &state = _pinStates[pin];
+    if (state.isInitialized && state.mode == PinMode::PWM_OUTPUT)
     {
-        PinState &state = _pinStates[pin];
-        if (state.isInitialized && state.mode == PinMode::PWM_OUTPUT)
-        {
-            return state.value;
-        }
+        return state.value;
     }
 
     return -1;
 }
 
-PinMode PinController::getPinMode(int pin)
+bool PinController::fadePWM(int pin, int target, uint32_t durationMs, FadeCurve curve)
 {
-    if (_pinStates.find(pin) != _pinStates.end())
+    if (!isValidPin(pin) || !supportsPWM(pin))
     {
-        return _pinStates[pin].mode;
+        LOG_WARNING("PinCtrl", "Pin %d cannot fade", pin);
+        return false;
     }
-    return PinMode::NOT_CONFIGURED;
-}
 
-bool PinController::isValidPin(int pin)
-{
-    for (int i = 0; i < SAFE_PIN_COUNT; i++)
+    if (durationMs > FADE_MAX_DURATION_MS)
     {
-        if (SAFE_PINS[i] == pin)
-        {
-            return true;
-        }
+        LOG_WARNING("PinCtrl", "Fade duration %lu ms too long", (unsigned long)durationMs);
+        return false;
     }
-    return false;
-}
 
-bool PinController::isPinConfigured(int pin)
-{
-    if (_pinStates.find(pin) != _pinStates.end())
+    PinState &state = _pinStates[pin];
+    if (state.mode != PinMode::PWM_OUTPUT &&
+        !configurePWMOutput(pin, PWM_DEFAULT_FREQUENCY, PWM_DEFAULT_RESOLUTION))
     {
-        return _pinStates[pin].isInitialized;
+        return false;
     }
-    return false;
-}
-
-String PinController::getAllPinStates()
-{
-    String result = "Configured Pins:\n";
 
-    if (_pinStates.empty())
+    int maxDuty = (1 << state.pwmResolution) - 1;
+    if (target < 0 || target > maxDuty)
     {
-        result += "  None\n";
-        return result;
+        LOG_WARNING("PinCtrl", "Invalid fade target: %d (must be 0-%d)", target, maxDuty);
+        return false;
     }
 
-    for (auto &pair : _pinStates)
+    // Restart from wherever a running fade has got to
+    cancelFade(pin);
+
+    if (durationMs == 0 || state.value == target)
     {
-        int pin = pair.first;
-        PinState &state = pair.second;
+        ledcWrite(_pinToPWMChannel[pin], target);
+        state.value = target;
+        markChanged(pin);
+        return true;
+    }
 
-        if (state.isInitialized)
-        {
-            result += "  Pin " + String(pin) + ": ";
+    Fade &fade = _fades[pin];
+    fade.startTime = millis();
+    fade.duration = durationMs;
+    fade.from = state.value;
+    fade.to = target;
+    fade.curve = curve;
+    fade.hardware = curve == FadeCurve::LINEAR && startHardwareFade(pin, target, durationMs);
+    _fadingPins |= 1ULL << pin;
 
-            switch (state.mode)
-            {
-            case PinMode::DIGITAL_OUTPUT:
-                result += "DIGITAL = " + String(state.value);
-                break;
-            case PinMode::PWM_OUTPUT:
-                result += "PWM = " + String(state.value);
-                break;
-            default:
-                result += "UNKNOWN";
-                break;
-            }
+    LOG_DEBUG("PinCtrl", "Fade pin %d %d -> %d over %lu ms (%s)", pin, fade.from, target,
+              (unsigned long)durationMs, fade.hardware ? "hardware" : "software");
 
-            result += "\n";
-        }
-    }
+    return true;
+}
 
-    return result;
+bool PinController::isFading(int pin) const
+{
+    return pin >= 0 && pin < GPIO_PIN_COUNT && ((_fadingPins >> pin) & 1) != 0;
 }
 
-bool PinController::resetAllPins()
+bool PinController::pulse(int pin, uint32_t durationUs)
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[PinCtrl] Resetting all pins");
-#endif
+    if (!isValidPin(pin) || durationUs == 0)
+    {
+        LOG_WARNING("PinCtrl", "Invalid pulse on pin %d (%lu us)", pin, (unsigned long)durationUs);
+        return false;
+    }
 
-    // Set all configured pins to LOW
-    for (auto &pair : _pinStates)
+    PinState &state = _pinStates[pin];
+    if (!state.isInitialized || state.mode != PinMode::DIGITAL_OUTPUT)
     {
-        int pin = pair.first;
-        PinState &state = pair.second;
+        if (!configureDigitalOutput(pin))
+        {
+            return false;
+        }
+    }
 
-        if (state.isInitialized)
+    if (_pulseTimers[pin] == nullptr)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = handlePulseTimer;
+        args.arg = &_pinContexts[pin];
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "pulse";
+        if (esp_timer_create(&args, &_pulseTimers[pin]) != ESP_OK)
         {
-            if (state.mode == PinMode::DIGITAL_OUTPUT)
-            {
-                digitalWrite(pin, LOW);
-            }
-            else if (state.mode == PinMode::PWM_OUTPUT)
-            {
-                int channel = _pinToPWMChannel[pin];
-                ledcWrite(channel, 0);
-            }
+            return false;
         }
     }
 
-    // Clear state
-    _pinStates.clear();
-    _pinToPWMChannel.clear();
-    _nextPWMChannel = 0;
+    // A running pulse is extended and keeps its original restore level
+    uint64_t bit = 1ULL << pin;
+    bool running = (_pulsingPins & bit) != 0;
+    if (running)
+    {
+        cancelPulse(pin);
+        running = state.value != static_cast<int>((_pulseRestore >> pin) & 1);
+    }
+
+    if (!running)
+    {
+        int level = state.value == 0 ? 1 : 0;
+        writeOutputMask(level ? bit : 0, level ? 0 : bit);
+        state.value = level;
+        markChanged(pin);
+    }
+
+    portENTER_CRITICAL(&_pulseLock);
+    _pulseRestore = state.value ? _pulseRestore & ~bit : _pulseRestore | bit;
+    _pulseArmed |= bit;
+    portEXIT_CRITICAL(&_pulseLock);
+    _pulsingPins |= bit;
+
+    esp_timer_start_once(_pulseTimers[pin], durationUs);
+
+    LOG_DEBUG("PinCtrl", "Pulse pin %d to %d for %lu us", pin, state.value, (unsigned long)durationUs);
 
     return true;
 }
 
-String PinController::getStateJSON()
+bool PinController::isPulsing(int pin) const
 {
-    JsonDocument doc;
-    JsonArray pins = doc["pins"].to<JsonArray>();
-
-    for (auto &pair : _pinStates)
-    {
-        int pin = pair.first;
-        PinState &state = pair.second;
+    return pin >= 0 && pin < GPIO_PIN_COUNT && ((_pulsingPins >> pin) & 1) != 0;
+}
 
-        if (state.isInitialized)
-        {
-            JsonObject pinObj = pins.add<JsonObject>();
-            pinObj["pin"] = pin;
-            pinObj["value"] = state.value;
+void PinController::handlePulseTimer(void *arg)
+{
+    PinContext *context = static_cast<PinContext *>(arg);
+    PinController *self = context->owner;
+    uint64_t bit = 1ULL << context->pin;
 
-            if (state.mode == PinMode::DIGITAL_OUTPUT)
-            {
-                pinObj["mode"] = "digital";
-            }
-            else if (state.mode == PinMode::PWM_OUTPUT)
-            {
-                pinObj["mode"] = "pwm";
-            }
-        }
+    // Checked and written under the lock, so a write from the main loop
+    // after cancelPulse() is never overtaken by a late end edge
+    portENTER_CRITICAL(&self->_pulseLock);
+    if (self->_pulseArmed & bit)
+    {
+        bool high = (self->_pulseRestore & bit) != 0;
+        writeOutputMask(high ? bit : 0, high ? 0 : bit);
+        self->_pulseArmed &= ~bit;
+        self->_pulseEnded |= bit;
     }
-
-    String result;
-    serializeJson(doc, result);
-    return result;
+    portEXIT_CRITICAL(&self->_pulseLock);
 }
 
-bool PinController::configureDigitalOutput(int pin)
+void PinController::servicePulses()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[PinCtrl] Configuring pin %d for digital output\n", pin);
-#endif
-
-    pinMode(pin, OUTPUT);
-    digitalWrite(pin, LOW);
+    if (_pulsingPins == 0)
+    {
+        return;
+    }
 
-    PinState &state = _pinStates[pin];
-    state.mode = PinMode::DIGITAL_OUTPUT;
-    state.value = 0;
-    state.isInitialized = true;
+    portENTER_CRITICAL(&_pulseLock);
+    uint64_t ended = _pulseEnded;
+    _pulseEnded = 0;
+    portEXIT_CRITICAL(&_pulseLock);
 
-    return true;
+    _pulsingPins &= ~ended;
+    for (; ended != 0; ended &= ended - 1)
+    {
+        int pin = __builtin_ctzll(ended);
+        _pinStates[pin].value = (_pulseRestore >> pin) & 1;
+        markChanged(pin);
+    }
 }
 
-bool PinController::configurePWMOutput(int pin)
+void PinController::cancelPulse(int pin)
 {
-    if (_nextPWMChannel >= 16)
+    uint64_t bit = 1ULL << pin;
+    if (!(_pulsingPins & bit))
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[PinCtrl] No PWM channels available");
-#endif
-        return false;
+        return;
     }
+    _pulsingPins &= ~bit;
 
-    int channel = _nextPWMChannel++;
+    portENTER_CRITICAL(&_pulseLock);
+    bool ended = (_pulseEnded & bit) != 0;
+    _pulseArmed &= ~bit;
+    _pulseEnded &= ~bit;
+    portEXIT_CRITICAL(&_pulseLock);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[PinCtrl] Configuring pin %d for PWM output (channel %d)\n", pin, channel);
-#endif
+    esp_timer_stop(_pulseTimers[pin]);
 
-    // Configure LED PWM channel
-    ledcSetup(channel, PWM_FREQUENCY, PWM_RESOLUTION);
-    ledcAttachPin(pin, channel);
-    ledcWrite(channel, 0);
+    if (ended)
+    {
+        _pinStates[pin].value = (_pulseRestore >> pin) & 1;
+        markChanged(pin);
+    }
+}
 
-    PinState &state = _pinStates[pin];
-    state.mode = PinMode::PWM_OUTPUT;
-    state.value = 0;
+int PinController::scheduleOp(const PinOp &op, uint32_t delayMs, uint32_t intervalMs)
+{
+    bool valid = isValidPin(op.pin);
+    if (op.type == PinOpType::SET)
+    {
+        valid = valid && op.value <= 1;
+    }
+    else if (op.type == PinOpType::PWM)
+    {
+        valid = valid && supportsPWM(op.pin);
+    }
+    else if (op.type == PinOpType::PULSE)
+    {
+        valid = valid && op.value > 0;
+    }
+
+    if (!valid)
+    {
+        LOG_WARNING("PinCtrl", "Invalid timed op on pin %d", op.pin);
+        return -1;
+    }
+
+    return _timers.add(millis(), delayMs, intervalMs, op);
+}
+
+bool PinController::cancelTimer(int id)
+{
+    return _timers.cancel(id);
+}
+
+void PinController::cancelAllTimers()
+{
+    _timers.clear();
+}
+
+void PinController::serviceTimers()
+{
+    _timers.advance(millis(), [this](const PinOp &op)
+                    { this->runTimedOp(op); });
+}
+
+void PinController::runTimedOp(const PinOp &op)
+{
+    if (op.type == PinOpType::PULSE)
+    {
+        pulse(op.pin, static_cast<uint32_t>(op.value) * 1000);
+        return;
+    }
+
+    // Single-op batch: same validation and register writes as BATCH
+    applyBatch(&op, 1);
+}
+
+bool PinController::configureInput(int pin, InputPull pull, uint16_t debounceMs)
+{
+    if (!isValidPin(pin))
+    {
+        LOG_WARNING("PinCtrl", "Invalid pin: %d", pin);
+        return false;
+    }
+
+    releasePWM(pin);
+    releaseInput(pin);
+    cancelPulse(pin);
+
+    uint8_t mode = pull == InputPull::PULLUP ? INPUT_PULLUP : pull == InputPull::PULLDOWN ? INPUT_PULLDOWN
+                                                                                          : INPUT;
+    pinMode(pin, mode);
+
+    PinState &state = _pinStates[pin];
+    state.mode = PinMode::DIGITAL_INPUT;
+    state.value = digitalRead(pin);
+    markChanged(pin);
+    state.isInitialized = true;
+
+    InputDebounce &debounce = _inputDebounce[pin];
+    debounce.debounceUs = static_cast<uint32_t>(debounceMs) * 1000;
+    debounce.pending = false;
+
+    attachInterruptArg(pin, handleInputISR, &_pinContexts[pin], CHANGE);
+
+    LOG_INFO("PinCtrl", "Configured pin %d as input (pull %d, debounce %d ms)",
+             pin, static_cast<int>(pull), debounceMs);
+
+    return true;
+}
+
+int PinController::addInputListener(InputListener listener)
+{
+    for (int i = 0; i < INPUT_MAX_LISTENERS; i++)
+    {
+        if (!_inputListeners[i])
+        {
+            _inputListeners[i] = listener;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PinController::removeInputListener(int id)
+{
+    if (id >= 0 && id < INPUT_MAX_LISTENERS)
+    {
+        _inputListeners[id] = nullptr;
+    }
+}
+
+void IRAM_ATTR PinController::handleInputISR(void *arg)
+{
+    PinContext *context = static_cast<PinContext *>(arg);
+
+    // Read the level straight from the input registers, digitalRead is not
+    // guaranteed to be in IRAM
+    uint8_t pin = context->pin;
+    uint32_t levels = pin < 32 ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+
+    InputEdge edge;
+    edge.pin = pin;
+    edge.level = (levels >> (pin & 31)) & 1;
+    edge.timestampUs = esp_timer_get_time();
+    context->owner->_inputEdges.push(edge);
+}
+
+void PinController::serviceInputs()
+{
+    InputEdge edge;
+    while (_inputEdges.pop(edge))
+    {
+        // Edges can still be queued for a pin that was reconfigured since
+        if (_pinStates[edge.pin].mode != PinMode::DIGITAL_INPUT)
+        {
+            continue;
+        }
+
+        InputDebounce &debounce = _inputDebounce[edge.pin];
+        if (debounce.debounceUs == 0)
+        {
+            // No debounce: report every edge with its own level
+            if (edge.level != _pinStates[edge.pin].value)
+            {
+                notifyInput(edge.pin, edge.level, edge.timestampUs);
+            }
+            continue;
+        }
+
+        if (!debounce.pending)
+        {
+            debounce.pending = true;
+            debounce.firstEdgeUs = edge.timestampUs;
+            _pendingInputs |= 1ULL << edge.pin;
+        }
+        debounce.lastEdgeUs = edge.timestampUs;
+    }
+
+    if (_pendingInputs == 0)
+    {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint64_t pending = _pendingInputs;
+    while (pending != 0)
+    {
+        int pin = __builtin_ctzll(pending);
+        pending &= pending - 1;
+
+        InputDebounce &debounce = _inputDebounce[pin];
+        if (now - debounce.lastEdgeUs < debounce.debounceUs)
+        {
+            continue;
+        }
+
+        // Quiet for the debounce time, the current level is the settled one
+        debounce.pending = false;
+        _pendingInputs &= ~(1ULL << pin);
+
+        uint8_t level = digitalRead(pin);
+        if (level != _pinStates[pin].value)
+        {
+            notifyInput(pin, level, debounce.firstEdgeUs);
+        }
+    }
+}
+
+void PinController::notifyInput(uint8_t pin, uint8_t value, int64_t timestampUs)
+{
+    _pinStates[pin].value = value;
+    markChanged(pin);
+
+    InputEvent event;
+    event.pin = pin;
+    event.value = value;
+    event.timestampUs = timestampUs;
+
+    LOG_DEBUG("PinCtrl", "Input pin %d changed to %d", pin, value);
+
+    for (int i = 0; i < INPUT_MAX_LISTENERS; i++)
+    {
+        if (_inputListeners[i])
+        {
+            _inputListeners[i](event);
+        }
+    }
+}
+
+void PinController::releaseInput(int pin)
+{
+    if (_pinStates[pin].mode != PinMode::DIGITAL_INPUT)
+    {
+        return;
+    }
+
+    detachInterrupt(pin);
+    _inputDebounce[pin].pending = false;
+    _pendingInputs &= ~(1ULL << pin);
+}
+
+PinMode PinController::getPinMode(int pin)
+{
+    if (pin < 0 || pin >= GPIO_PIN_COUNT)
+    {
+        return PinMode::NOT_CONFIGURED;
+    }
+    return _pinStates[pin].mode;
+}
+
+bool PinController::isPinConfigured(int pin)
+{
+    if (pin < 0 || pin >= GPIO_PIN_COUNT)
+    {
+        return false;
+    }
+    return _pinStates[pin].isInitialized;
+}
+
+String PinController::getAllPinStates()
+{
+    String result = "Configured Pins:\n";
+    bool anyConfigured = false;
+
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        const PinState &state = _pinStates[pin];
+
+        if (state.isInitialized)
+        {
+            anyConfigured = true;
+            result += "  Pin " + String(pin) + ": ";
+
+            switch (state.mode)
+            {
+            case PinMode::DIGITAL_OUTPUT:
+                result += "DIGITAL = " + String(state.value);
+                break;
+            case PinMode::DIGITAL_INPUT:
+                result += "INPUT = " + String(state.value);
+                break;
+            case PinMode::PWM_OUTPUT:
+                result += "PWM = " + String(state.value) + " (" + String(state.pwmFrequency) +
+                          " Hz, " + String(state.pwmResolution) + " bit)";
+                break;
+            default:
+                result += "UNKNOWN";
+                break;
+            }
+
+            result += "\n";
+        }
+    }
+
+    if (!anyConfigured)
+    {
+        result += "  None\n";
+    }
+
+    return result;
+}
+
+bool PinController::applyBatch(const PinOp *ops, size_t count)
+{
+    // Validate everything up front so a bad op cannot leave a half-applied scene
+    uint64_t newPWMPins = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const PinOp &op = ops[i];
+
+        if (!isValidPin(op.pin) || op.type == PinOpType::PULSE)
+        {
+            LOG_WARNING("PinCtrl", "Batch op %d: invalid pin %d or op", (int)i, op.pin);
+            return false;
+        }
+
+        if (op.type == PinOpType::PWM && !supportsPWM(op.pin))
+        {
+            LOG_WARNING("PinCtrl", "Batch op %d: pin %d does not support PWM", (int)i, op.pin);
+            return false;
+        }
+
+        if ((op.type == PinOpType::SET && op.value > 1) ||
+            (op.type == PinOpType::PWM && op.value > (1 << effectiveResolution(op.pin)) - 1))
+        {
+            LOG_WARNING("PinCtrl", "Batch op %d: invalid value %d", (int)i, op.value);
+            return false;
+        }
+
+        if (op.type == PinOpType::PWM && getPinMode(op.pin) != PinMode::PWM_OUTPUT)
+        {
+            newPWMPins |= 1ULL << op.pin;
+        }
+    }
+
+    // New PWM pins in a batch use the default configuration
+    if (__builtin_popcountll(newPWMPins) > _pwmPool.available(PWM_DEFAULT_FREQUENCY, PWM_DEFAULT_RESOLUTION))
+    {
+        LOG_ERROR("PinCtrl", "Batch needs more PWM channels than available");
+        return false;
+    }
+
+    // Configure pins first so the value pass below is just output writes
+    for (size_t i = 0; i < count; i++)
+    {
+        const PinOp &op = ops[i];
+        PinMode mode = getPinMode(op.pin);
+
+        if (op.type == PinOpType::PWM && mode != PinMode::PWM_OUTPUT)
+        {
+            configurePWMOutput(op.pin, PWM_DEFAULT_FREQUENCY, PWM_DEFAULT_RESOLUTION);
+        }
+        else if (op.type != PinOpType::PWM && mode != PinMode::DIGITAL_OUTPUT)
+        {
+            configureDigitalOutput(op.pin);
+        }
+    }
+
+    // Digital ops are collected and written with one register write per
+    // bank, so all digital outputs in the batch change together
+    uint64_t setMask = 0;
+    uint64_t clearMask = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const PinOp &op = ops[i];
+        PinState &state = _pinStates[op.pin];
+
+        switch (op.type)
+        {
+        case PinOpType::SET:
+        case PinOpType::TOGGLE:
+        {
+            cancelPulse(op.pin);
+            state.value = op.type == PinOpType::SET ? op.value : (state.value == 0 ? 1 : 0);
+            markChanged(op.pin);
+
+            // A later op on the same pin overrides an earlier one
+            uint64_t bit = 1ULL << op.pin;
+            if (state.value)
+            {
+                setMask |= bit;
+                clearMask &= ~bit;
+            }
+            else
+            {
+                clearMask |= bit;
+                setMask &= ~bit;
+            }
+            break;
+        }
+
+        case PinOpType::PWM:
+            cancelFade(op.pin);
+            state.value = op.value;
+            markChanged(op.pin);
+            ledcWrite(_pinToPWMChannel[op.pin], state.value);
+            break;
+
+        case PinOpType::PULSE:
+            break;
+        }
+    }
+
+    writeOutputMask(setMask, clearMask);
+
+    LOG_DEBUG("PinCtrl", "Applied batch of %d ops", (int)count);
+
+    return true;
+}
+
+bool PinController::setDigitalMask(uint64_t setMask, uint64_t clearMask)
+{
+    uint64_t pins = setMask | clearMask;
+
+    if ((pins & ~PinMasks::SAFE) != 0)
+    {
+        LOG_WARNING("PinCtrl", "Mask contains invalid pins: 0x%010llx",
+                    (unsigned long long)(pins & ~PinMasks::SAFE));
+        return false;
+    }
+
+    if ((setMask & clearMask) != 0)
+    {
+        LOG_WARNING("PinCtrl", "Pin in both set and clear mask");
+        return false;
+    }
+
+    configureDigitalOutputs(pins);
+    for (uint64_t pulsing = pins & _pulsingPins; pulsing != 0; pulsing &= pulsing - 1)
+    {
+        cancelPulse(__builtin_ctzll(pulsing));
+    }
+    writeOutputMask(setMask, clearMask);
+
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        if ((pins >> pin) & 1)
+        {
+            _pinStates[pin].value = (setMask >> pin) & 1 ? 1 : 0;
+            markChanged(pin);
+        }
+    }
+
+    LOG_DEBUG("PinCtrl", "Set mask 0x%010llx, clear mask 0x%010llx",
+              (unsigned long long)setMask, (unsigned long long)clearMask);
+
+    return true;
+}
+
+bool PinController::defineGroup(const char *name, uint64_t mask)
+{
+    if (mask == 0 || (mask & ~PinMasks::SAFE) != 0)
+    {
+        LOG_WARNING("PinCtrl", "Group %s: invalid pins", name);
+        return false;
+    }
+
+    int index = findGroup(name);
+    if (index < 0)
+    {
+        if (_groupCount >= GROUP_MAX_COUNT)
+        {
+            LOG_WARNING("PinCtrl", "Group table full");
+            return false;
+        }
+        index = _groupCount++;
+    }
+
+    copyName(_groups[index].name, name);
+    _groups[index].mask = mask;
+
+    if (!_sceneStore.saveGroups(_groups, _groupCount))
+    {
+        LOG_ERROR("PinCtrl", "Failed to save groups to NVS");
+    }
+    return true;
+}
+
+bool PinController::applyGroup(const char *name, int value, bool pwm)
+{
+    int index = findGroup(name);
+    if (index < 0)
+    {
+        LOG_WARNING("PinCtrl", "Unknown group: %s", name);
+        return false;
+    }
+
+    uint64_t mask = _groups[index].mask;
+    if (!pwm)
+    {
+        if (value != 0 && value != 1)
+        {
+            LOG_WARNING("PinCtrl", "Invalid group value: %d", value);
+            return false;
+        }
+        return setDigitalMask(value ? mask : 0, value ? 0 : mask);
+    }
+
+    if ((mask & ~PinMasks::PWM) != 0)
+    {
+        LOG_WARNING("PinCtrl", "Group %s has pins without PWM", name);
+        return false;
+    }
+
+    bool success = true;
+    for (; mask != 0; mask &= mask - 1)
+    {
+        success = setPWM(__builtin_ctzll(mask), value) && success;
+    }
+    return success;
+}
+
+bool PinController::defineScene(const char *name, const PinOp *ops, size_t count)
+{
+    // Compile the ops: later ops on a pin override earlier ones
+    PinScene scene = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        const PinOp &op = ops[i];
+        if (!isValidPin(op.pin) || (op.type != PinOpType::SET && op.type != PinOpType::PWM))
+        {
+            LOG_WARNING("PinCtrl", "Scene op %d: invalid pin %d or op", (int)i, op.pin);
+            return false;
+        }
+
+        uint64_t bit = 1ULL << op.pin;
+        scene.setMask &= ~bit;
+        scene.clearMask &= ~bit;
+        removeScenePWM(scene, op.pin);
+
+        if (op.type == PinOpType::SET)
+        {
+            if (op.value)
+            {
+                scene.setMask |= bit;
+            }
+            else
+            {
+                scene.clearMask |= bit;
+            }
+            continue;
+        }
+
+        if (!supportsPWM(op.pin) || scene.pwmCount >= SCENE_MAX_PWM_PINS)
+        {
+            LOG_WARNING("PinCtrl", "Scene op %d: no PWM on pin %d or too many PWM pins", (int)i, op.pin);
+            return false;
+        }
+
+        ScenePWM &entry = scene.pwm[scene.pwmCount++];
+        entry.pin = op.pin;
+        entry.duty = op.value;
+        entry.frequency = 0;
+        entry.resolution = 0;
+    }
+
+    return storeScene(name, scene);
+}
+
+bool PinController::saveScene(const char *name)
+{
+    PinScene scene = {};
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        const PinState &state = _pinStates[pin];
+        if (!state.isInitialized)
+        {
+            continue;
+        }
+
+        if (state.mode == PinMode::DIGITAL_OUTPUT)
+        {
+            if (state.value)
+            {
+                scene.setMask |= 1ULL << pin;
+            }
+            else
+            {
+                scene.clearMask |= 1ULL << pin;
+            }
+        }
+        else if (state.mode == PinMode::PWM_OUTPUT && scene.pwmCount < SCENE_MAX_PWM_PINS)
+        {
+            ScenePWM &entry = scene.pwm[scene.pwmCount++];
+            entry.pin = pin;
+            entry.duty = state.value;
+            entry.frequency = state.pwmFrequency;
+            entry.resolution = state.pwmResolution;
+        }
+    }
+
+    return storeScene(name, scene);
+}
+
+bool PinController::recallScene(const char *name)
+{
+    int index = findScene(name);
+    if (index < 0)
+    {
+        LOG_WARNING("PinCtrl", "Unknown scene: %s", name);
+        return false;
+    }
+
+    const PinScene &scene = _scenes[index];
+    if ((scene.setMask | scene.clearMask) != 0 && !setDigitalMask(scene.setMask, scene.clearMask))
+    {
+        return false;
+    }
+
+    // Pins already on PWM with the same settings only take a duty write
+    bool success = true;
+    for (uint8_t i = 0; i < scene.pwmCount; i++)
+    {
+        const ScenePWM &entry = scene.pwm[i];
+        success = setPWM(entry.pin, entry.duty, entry.frequency, entry.resolution) && success;
+    }
+
+    LOG_DEBUG("PinCtrl", "Recalled scene %s", scene.name);
+    return success;
+}
+
+bool PinController::deleteGroup(const char *name)
+{
+    int index = findGroup(name);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    _groups[index] = _groups[--_groupCount];
+    if (!_sceneStore.saveGroups(_groups, _groupCount))
+    {
+        LOG_ERROR("PinCtrl", "Failed to save groups to NVS");
+    }
+    return true;
+}
+
+bool PinController::deleteScene(const char *name)
+{
+    int index = findScene(name);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    _scenes[index] = _scenes[--_sceneCount];
+    if (!_sceneStore.saveScenes(_scenes, _sceneCount))
+    {
+        LOG_ERROR("PinCtrl", "Failed to save scenes to NVS");
+    }
+    return true;
+}
+
+void PinController::writeGroups(JsonWriter &json) const
+{
+    json.beginArray();
+    for (size_t i = 0; i < _groupCount; i++)
+    {
+        json.beginObject().field("name", _groups[i].name);
+        writePinList(json, "pins", _groups[i].mask);
+        json.endObject();
+    }
+    json.endArray();
+}
+
+void PinController::writeScenes(JsonWriter &json) const
+{
+    json.beginArray();
+    for (size_t i = 0; i < _sceneCount; i++)
+    {
+        const PinScene &scene = _scenes[i];
+        json.beginObject().field("name", scene.name);
+        writePinList(json, "high", scene.setMask);
+        writePinList(json, "low", scene.clearMask);
+
+        json.beginArray("pwm");
+        for (uint8_t j = 0; j < scene.pwmCount; j++)
+        {
+            json.beginObject().field("pin", scene.pwm[j].pin).field("value", scene.pwm[j].duty).endObject();
+        }
+        json.endArray();
+
+        json.endObject();
+    }
+    json.endArray();
+}
+
+void PinController::loadScenes()
+{
+    _groupCount = _sceneStore.loadGroups(_groups, GROUP_MAX_COUNT);
+    size_t kept = 0;
+    for (size_t i = 0; i < _groupCount; i++)
+    {
+        PinGroup &group = _groups[i];
+        group.name[SCENE_NAME_LENGTH - 1] = '\0';
+        group.mask &= PinMasks::SAFE;
+        if (group.mask != 0)
+        {
+            _groups[kept++] = group;
+        }
+    }
+    _groupCount = kept;
+
+    _sceneCount = _sceneStore.loadScenes(_scenes, SCENE_MAX_COUNT);
+    for (size_t i = 0; i < _sceneCount; i++)
+    {
+        PinScene &scene = _scenes[i];
+        scene.name[SCENE_NAME_LENGTH - 1] = '\0';
+        scene.setMask &= PinMasks::SAFE;
+        scene.clearMask &= PinMasks::SAFE & ~scene.setMask;
+
+        uint8_t pwmKept = 0;
+        for (uint8_t j = 0; j < scene.pwmCount && j < SCENE_MAX_PWM_PINS; j++)
+        {
+            if (supportsPWM(scene.pwm[j].pin))
+            {
+                scene.pwm[pwmKept++] = scene.pwm[j];
+            }
+        }
+        scene.pwmCount = pwmKept;
+    }
+
+    if (_groupCount > 0 || _sceneCount > 0)
+    {
+        LOG_INFO("PinCtrl", "Loaded %u groups and %u scenes", static_cast<unsigned>(_groupCount),
+                 static_cast<unsigned>(_sceneCount));
+    }
+}
+
+int PinController::findGroup(const char *name) const
+{
+    for (size_t i = 0; i < _groupCount; i++)
+    {
+        if (strncasecmp(_groups[i].name, name, SCENE_NAME_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int PinController::findScene(const char *name) const
+{
+    for (size_t i = 0; i < _sceneCount; i++)
+    {
+        if (strncasecmp(_scenes[i].name, name, SCENE_NAME_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool PinController::storeScene(const char *name, const PinScene &scene)
+{
+    int index = findScene(name);
+    if (index < 0)
+    {
+        if (_sceneCount >= SCENE_MAX_COUNT)
+        {
+            LOG_WARNING("PinCtrl", "Scene table full");
+            return false;
+        }
+        index = _sceneCount++;
+    }
+
+    _scenes[index] = scene;
+    copyName(_scenes[index].name, name);
+
+    if (!_sceneStore.saveScenes(_scenes, _sceneCount))
+    {
+        LOG_ERROR("PinCtrl", "Failed to save scenes to NVS");
+    }
+    return true;
+}
+
+void PinController::writePinList(JsonWriter &json, const char *name, uint64_t mask)
+{
+    json.beginArray(name);
+    for (; mask != 0; mask &= mask - 1)
+    {
+        json.value(__builtin_ctzll(mask));
+    }
+    json.endArray();
+}
+
+bool PinController::resetAllPins()
+{
+    LOG_INFO("PinCtrl", "Resetting all pins");
+
+    // Pending ops would undo the reset
+    _timers.clear();
+
+    // Set all configured pins to LOW
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        PinState &state = _pinStates[pin];
+        cancelPulse(pin);
+
+        if (state.isInitialized)
+        {
+            if (state.mode == PinMode::DIGITAL_OUTPUT)
+            {
+                digitalWrite(pin, LOW);
+            }
+            else if (state.mode == PinMode::DIGITAL_INPUT)
+            {
+                releaseInput(pin);
+            }
+            else if (state.mode == PinMode::PWM_OUTPUT)
+            {
+                cancelFade(pin);
+                ledcWrite(_pinToPWMChannel[pin], 0);
+                ledcDetachPin(pin);
+            }
+        }
+    }
+
+    // Clear state
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        if (_pinStates[pin].isInitialized)
+        {
+            markChanged(pin);
+        }
+        _pinStates[pin] = PinState();
+        _pinToPWMChannel[pin] = -1;
+    }
+    _pwmPool.releaseAll();
+
+    return true;
+}
+
+uint64_t PinController::getConfiguredPins() const
+{
+    uint64_t configured = 0;
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        if (_pinStates[pin].isInitialized)
+        {
+            configured |= 1ULL << pin;
+        }
+    }
+    return configured;
+}
+
+void PinController::writePinStates(JsonWriter &json, uint64_t mask) const
+{
+    json.beginArray();
+
+    while (mask != 0)
+    {
+        int pin = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        if (pin >= GPIO_PIN_COUNT)
+        {
+            break;
+        }
+
+        const PinState &state = _pinStates[pin];
+        json.beginObject().field("pin", pin).field("value", state.value);
+
+        if (!state.isInitialized)
+        {
+            json.field("mode", "none");
+        }
+        else if (state.mode == PinMode::DIGITAL_OUTPUT)
+        {
+            json.field("mode", "digital");
+        }
+        else if (state.mode == PinMode::DIGITAL_INPUT)
+        {
+            json.field("mode", "input");
+        }
+        else if (state.mode == PinMode::PWM_OUTPUT)
+        {
+            json.field("mode", "pwm")
+                .field("frequency", state.pwmFrequency)
+                .field("resolution", state.pwmResolution);
+        }
+
+        json.endObject();
+    }
+
+    json.endArray();
+}
+
+bool PinController::configureDigitalOutput(int pin)
+{
+    LOG_DEBUG("PinCtrl", "Configuring pin %d for digital output", pin);
+
+    // Give the LEDC channel back before the pin becomes a plain GPIO again
+    releasePWM(pin);
+    releaseInput(pin);
+
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+
+    PinState &state = _pinStates[pin];
+    state.mode = PinMode::DIGITAL_OUTPUT;
+    state.value = 0;
+    markChanged(pin);
+    state.isInitialized = true;
+
+    return true;
+}
+
+void PinController::configureDigitalOutputs(uint64_t mask)
+{
+    for (int pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        if ((mask >> pin) & 1)
+        {
+            const PinState &state = _pinStates[pin];
+            if (!state.isInitialized || state.mode != PinMode::DIGITAL_OUTPUT)
+            {
+                configureDigitalOutput(pin);
+            }
+        }
+    }
+}
+
+void PinController::writeOutputMask(uint64_t setMask, uint64_t clearMask)
+{
+    // GPIO 0-31 live in the OUT register, GPIO 32-39 in OUT1
+    uint32_t setLow = static_cast<uint32_t>(setMask);
+    uint32_t clearLow = static_cast<uint32_t>(clearMask);
+    uint32_t setHigh = static_cast<uint32_t>(setMask >> 32);
+    uint32_t clearHigh = static_cast<uint32_t>(clearMask >> 32);
+
+    if (setLow)
+    {
+        REG_WRITE(GPIO_OUT_W1TS_REG, setLow);
+    }
+    if (clearLow)
+    {
+        REG_WRITE(GPIO_OUT_W1TC_REG, clearLow);
+    }
+    if (setHigh)
+    {
+        REG_WRITE(GPIO_OUT1_W1TS_REG, setHigh);
+    }
+    if (clearHigh)
+    {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, clearHigh);
+    }
+}
+
+bool PinController::configurePWMOutput(int pin, uint32_t frequency, uint8_t resolution)
+{
+    // Free the old channel first so a pin alone on its timer can keep it
+    if (_pinStates[pin].mode == PinMode::PWM_OUTPUT)
+    {
+        ledcWrite(_pinToPWMChannel[pin], 0);
+    }
+    releasePWM(pin);
+    releaseInput(pin);
+    cancelPulse(pin);
+
+    int channel = _pwmPool.acquire(frequency, resolution);
+    if (channel < 0)
+    {
+        LOG_ERROR("PinCtrl", "No PWM channels available");
+        // The pin lost its old channel, so it is no longer a PWM output
+        _pinStates[pin] = PinState();
+        markChanged(pin);
+        return false;
+    }
+
+    LOG_DEBUG("PinCtrl", "Configuring pin %d for PWM output (channel %d, %lu Hz, %d bit)",
+              pin, channel, (unsigned long)frequency, resolution);
+
+    ledcAttachPin(pin, channel);
+    ledcWrite(channel, 0);
+
+    PinState &state = _pinStates[pin];
+    state.mode = PinMode::PWM_OUTPUT;
+    state.value = 0;
+    markChanged(pin);
     state.isInitialized = true;
+    state.pwmFrequency = frequency;
+    state.pwmResolution = resolution;
 
     _pinToPWMChannel[pin] = channel;
 
     return true;
 }
 
-bool PinController::supportsPWM(int pin)
+void PinController::releasePWM(int pin)
+{
+    int channel = _pinToPWMChannel[pin];
+    if (channel < 0)
+    {
+        return;
+    }
+
+    cancelFade(pin);
+    ledcDetachPin(pin);
+    _pwmPool.release(channel);
+    _pinToPWMChannel[pin] = -1;
+
+    LOG_DEBUG("PinCtrl", "Released PWM channel %d from pin %d", channel, pin);
+}
+
+uint8_t PinController::effectiveResolution(int pin) const
+{
+    const PinState &state = _pinStates[pin];
+    return state.mode == PinMode::PWM_OUTPUT ? state.pwmResolution : PWM_DEFAULT_RESOLUTION;
+}
+
+bool PinController::startHardwareFade(int pin, int target, uint32_t durationMs)
 {
-    // On ESP32, all GPIO pins can be used for PWM (LEDC)
-    // We just need to check if it's a valid output pin
-    return isValidPin(pin);
+    const PinState &state = _pinStates[pin];
+    int channel = _pinToPWMChannel[pin];
+
+    // Slow fades with few duty steps exceed what one fade step can hold,
+    // those run in software instead
+    uint32_t steps = abs(target - state.value);
+    uint64_t longestMs = (uint64_t)steps * LEDC_FADE_MAX_CYCLES_PER_STEP * 1000 / state.pwmFrequency;
+    if (durationMs > longestMs)
+    {
+        return false;
+    }
+
+    if (!_fadeEngineInstalled)
+    {
+        if (ledc_fade_func_install(0) != ESP_OK)
+        {
+            return false;
+        }
+        _fadeEngineInstalled = true;
+    }
+
+    // Arduino LEDC channels 0-7 are high speed, 8-15 low speed
+    ledc_mode_t mode = static_cast<ledc_mode_t>(channel / 8);
+    ledc_channel_t ledcChannel = static_cast<ledc_channel_t>(channel % 8);
+
+    return ledc_set_fade_with_time(mode, ledcChannel, target, durationMs) == ESP_OK &&
+           ledc_fade_start(mode, ledcChannel, LEDC_FADE_NO_WAIT) == ESP_OK;
+}
+
+void PinController::cancelFade(int pin)
+{
+    uint64_t bit = 1ULL << pin;
+    if (!(_fadingPins & bit))
+    {
+        return;
+    }
+    _fadingPins &= ~bit;
+
+    if (_fades[pin].hardware)
+    {
+        // Hold the duty the engine has reached; the thread-safe update also
+        // takes the channel out of fade mode
+        int channel = _pinToPWMChannel[pin];
+        ledc_mode_t mode = static_cast<ledc_mode_t>(channel / 8);
+        ledc_channel_t ledcChannel = static_cast<ledc_channel_t>(channel % 8);
+        uint32_t duty = ledc_get_duty(mode, ledcChannel);
+        ledc_set_duty_and_update(mode, ledcChannel, duty, 0);
+        _pinStates[pin].value = duty;
+        markChanged(pin);
+    }
+}
+
+int PinController::fadeValueAt(const Fade &fade, uint32_t elapsed)
+{
+    float t = static_cast<float>(elapsed) / fade.duration;
+
+    switch (fade.curve)
+    {
+    case FadeCurve::EASE:
+        t = t * t * (3.0f - 2.0f * t);
+        break;
+
+    case FadeCurve::GAMMA:
+    {
+        // Interpolate in perceived brightness, then convert back to duty
+        float from = powf(fade.from, 1.0f / 2.2f);
+        float to = powf(fade.to, 1.0f / 2.2f);
+        return static_cast<int>(powf(from + (to - from) * t, 2.2f) + 0.5f);
+    }
+
+    case FadeCurve::LINEAR:
+        break;
+    }
+
+    return fade.from + static_cast<int>((fade.to - fade.from) * t + (fade.to >= fade.from ? 0.5f : -0.5f));
 }
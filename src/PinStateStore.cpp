@@ -0,0 +1,77 @@
+#include "PinStateStore.h"
+#include "Logger.h"
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// NVS namespace and key; bump the key when SavedPin changes layout
+static const char *NVS_NAMESPACE = "pinstate";
+static const char *NVS_KEY = "pins1";
+
+PinStateStore::PinStateStore()
+    : _storedChecksum(0), _storedKnown(false), _writes(0)
+{
+}
+
+size_t PinStateStore::load(SavedPin *pins, size_t maxCount)
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+    {
+        return 0;
+    }
+
+    size_t length = prefs.getBytesLength(NVS_KEY);
+    size_t count = 0;
+    if (length % sizeof(SavedPin) == 0 && length <= maxCount * sizeof(SavedPin))
+    {
+        count = prefs.getBytes(NVS_KEY, pins, length) / sizeof(SavedPin);
+    }
+    prefs.end();
+
+    _storedChecksum = checksum(pins, count);
+    _storedKnown = true;
+    return count;
+}
+
+bool PinStateStore::save(const SavedPin *pins, size_t count)
+{
+    uint32_t sum = checksum(pins, count);
+    if (_storedKnown && sum == _storedChecksum)
+    {
+        return true;
+    }
+
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false))
+    {
+        return false;
+    }
+
+    size_t length = count * sizeof(SavedPin);
+    bool success = count == 0 ? (!prefs.isKey(NVS_KEY) || prefs.remove(NVS_KEY))
+                              : prefs.putBytes(NVS_KEY, pins, length) == length;
+    prefs.end();
+
+    _storedKnown = success;
+    _storedChecksum = sum;
+    if (success)
+    {
+        _writes++;
+    }
+
+    LOG_DEBUG("PinStore", "Saved %u pins to NVS%s", static_cast<unsigned>(count), success ? "" : " FAILED");
+    return success;
+}
+
+uint32_t PinStateStore::checksum(const SavedPin *pins, size_t count)
+{
+    // FNV-1a over the blob, count included so an empty set differs from none
+    uint32_t hash = 2166136261UL ^ static_cast<uint32_t>(count);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(pins);
+    for (size_t i = 0; i < count * sizeof(SavedPin); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+}
@@ -0,0 +1,101 @@
+#include "PowerManager.h"
+#include "WiFiManager.h"
+#include "Logger.h"
+#include <Preferences.h>
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+static_assert(POWER_PROFILE_DEFAULT >= 0 && POWER_PROFILE_DEFAULT < static_cast<int>(POWER_PROFILE_COUNT),
+              "POWER_PROFILE_DEFAULT must be 0-2");
+
+namespace
+{
+    // NVS namespace and key of the selected profile
+    const char *const NVS_NAMESPACE = "power";
+    const char *const NVS_KEY = "profile";
+
+    struct Settings
+    {
+        const char *name;
+        wifi_ps_type_t sleep;
+        uint16_t listenInterval; // Beacon intervals, only used by WIFI_PS_MAX_MODEM
+        wifi_power_t txPower;
+        uint32_t cpuMhz; // 80 is the lowest WiFi works at
+        uint32_t loopIdleMs;
+    };
+
+    // Indexed by PowerProfile
+    const Settings PROFILES[] = {
+        {"low-latency", WIFI_PS_NONE, 1, WIFI_POWER_19_5dBm, 240, 1},
+        {"balanced", WIFI_PS_MIN_MODEM, 3, WIFI_POWER_19_5dBm, 160, 10},
+        {"low-power", WIFI_PS_MAX_MODEM, 10, WIFI_POWER_15dBm, 80, 50},
+    };
+    static_assert(sizeof(PROFILES) / sizeof(PROFILES[0]) == POWER_PROFILE_COUNT, "Every PowerProfile needs settings");
+
+    const Settings &settingsFor(PowerProfile profile)
+    {
+        return PROFILES[static_cast<uint8_t>(profile)];
+    }
+}
+
+PowerManager::PowerManager(WiFiManager &wifi)
+    : _wifi(wifi),
+      _profile(static_cast<PowerProfile>(POWER_PROFILE_DEFAULT))
+{
+}
+
+void PowerManager::begin()
+{
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, true))
+    {
+        uint8_t saved = prefs.getUChar(NVS_KEY, POWER_PROFILE_DEFAULT);
+        if (saved < POWER_PROFILE_COUNT)
+        {
+            _profile = static_cast<PowerProfile>(saved);
+        }
+        prefs.end();
+    }
+
+    apply();
+}
+
+void PowerManager::setProfile(PowerProfile profile)
+{
+    if (profile == _profile)
+    {
+        return;
+    }
+
+    _profile = profile;
+    apply();
+
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false))
+    {
+        prefs.putUChar(NVS_KEY, static_cast<uint8_t>(profile));
+        prefs.end();
+    }
+}
+
+uint32_t PowerManager::getLoopIdleMs() const
+{
+    return settingsFor(_profile).loopIdleMs;
+}
+
+const char *PowerManager::profileName(PowerProfile profile)
+{
+    return static_cast<size_t>(profile) < POWER_PROFILE_COUNT ? settingsFor(profile).name : "unknown";
+}
+
+void PowerManager::apply()
+{
+    const Settings &settings = settingsFor(_profile);
+
+    setCpuFrequencyMhz(settings.cpuMhz);
+    _wifi.setPowerSave(settings.sleep, settings.listenInterval, settings.txPower);
+
+    LOG_INFO("Power", "Profile %s (CPU %lu MHz, loop wait %lu ms)", settings.name,
+             static_cast<unsigned long>(settings.cpuMhz), static_cast<unsigned long>(settings.loopIdleMs));
+}
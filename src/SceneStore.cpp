@@ -0,0 +1,66 @@
+#include "SceneStore.h"
+#include "Logger.h"
+#include <Preferences.h>
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// NVS namespace and keys; bump a key when its struct changes layout
+static const char *NVS_NAMESPACE = "scenes";
+static const char *NVS_GROUPS_KEY = "groups1";
+static const char *NVS_SCENES_KEY = "scenes1";
+
+size_t SceneStore::loadGroups(PinGroup *groups, size_t maxCount)
+{
+    return load(NVS_GROUPS_KEY, groups, sizeof(PinGroup), maxCount);
+}
+
+size_t SceneStore::loadScenes(PinScene *scenes, size_t maxCount)
+{
+    return load(NVS_SCENES_KEY, scenes, sizeof(PinScene), maxCount);
+}
+
+bool SceneStore::saveGroups(const PinGroup *groups, size_t count)
+{
+    return save(NVS_GROUPS_KEY, groups, sizeof(PinGroup), count);
+}
+
+bool SceneStore::saveScenes(const PinScene *scenes, size_t count)
+{
+    return save(NVS_SCENES_KEY, scenes, sizeof(PinScene), count);
+}
+
+size_t SceneStore::load(const char *key, void *data, size_t entrySize, size_t maxCount)
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, true))
+    {
+        return 0;
+    }
+
+    size_t length = prefs.getBytesLength(key);
+    size_t count = 0;
+    if (length % entrySize == 0 && length <= maxCount * entrySize)
+    {
+        count = prefs.getBytes(key, data, length) / entrySize;
+    }
+    prefs.end();
+    return count;
+}
+
+bool SceneStore::save(const char *key, const void *data, size_t entrySize, size_t count)
+{
+    Preferences prefs;
+    if (!prefs.begin(NVS_NAMESPACE, false))
+    {
+        return false;
+    }
+
+    size_t length = count * entrySize;
+    bool success = count == 0 ? (!prefs.isKey(key) || prefs.remove(key))
+                              : prefs.putBytes(key, data, length) == length;
+    prefs.end();
+
+    LOG_DEBUG("Scenes", "Saved %u %s to NVS%s", static_cast<unsigned>(count), key, success ? "" : " FAILED");
+    return success;
+}
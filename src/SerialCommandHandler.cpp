@@ -6,143 +6,72 @@
 
 #include "SerialCommandHandler.h"
 #include "Config.h"
+#include "Logger.h"
 
-SerialCommandHandler::SerialCommandHandler(CommandParser &parser,
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+SerialCommandHandler::SerialCommandHandler(CommandDispatcher &dispatcher,
                                            PinController &pinCtrl,
                                            WiFiManager &wifiMgr,
                                            WatchdogManager &wdMgr)
-    : _commandParser(parser),
+    : _dispatcher(dispatcher),
       _pinController(pinCtrl),
       _wifiManager(wifiMgr),
       _watchdogManager(wdMgr)
 {
+    _pinController.addInputListener([this](const InputEvent &event)
+                                    {
+                                        if (_subscribed)
+                                        {
+                                            _dispatcher.parser().writeInputEvent(Serial, event);
+                                            Serial.println();
+                                        } });
 }
 
-void SerialCommandHandler::setRestartCallback(void (*callback)(unsigned long delayMs))
+void SerialCommandHandler::processSerialCommands()
 {
-    _restartCallback = callback;
+    // Never waits for the rest of a line; partial input stays in the framer
+    _framer.poll(Serial, [this](const char *command, size_t length)
+                 { this->processLine(command, length); });
 }
 
-void SerialCommandHandler::processSerialCommands()
+void SerialCommandHandler::processLine(const char *command, size_t length)
 {
-    if (!Serial.available())
+    if (command == nullptr)
     {
+        Serial.println("{\"success\":false,\"message\":\"Command too long\"}");
         return;
     }
 
-    String command = Serial.readStringUntil('\n');
-    command.trim();
-
-    if (command.length() == 0)
-    {
-        return;
-    }
+    LOG_DEBUG("Serial", "Command: %s", command);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[Serial] Command: %s\n", command.c_str());
-#endif
+    Command cmd = _dispatcher.parse(command, length, CommandSource::SERIAL_CONSOLE);
 
-    // Parse command
-    Command cmd = _commandParser.parse(command);
-
-    if (!cmd.isValid())
+    // The serial console keeps its human-readable status report
+    if (cmd.type == CommandType::STATUS)
     {
-        Serial.println(_commandParser.generateResponse(cmd, false));
+        printStatus();
         return;
     }
 
-    // Execute command
-    executeCommand(cmd);
+    _dispatcher.dispatch(cmd, Serial, &_subscribed, CommandSource::SERIAL_CONSOLE);
+    Serial.println();
 }
 
-void SerialCommandHandler::executeCommand(const Command &cmd)
+void SerialCommandHandler::printStatus()
 {
-    bool success = false;
-    String message = "";
-    int resultValue = -1;
-
-    switch (cmd.type)
-    {
-    case CommandType::SET:
-        success = _pinController.setDigital(cmd.pin, cmd.value);
-        message = success ? "Pin set successfully" : "Failed to set pin";
-        resultValue = cmd.value;
-        break;
-
-    case CommandType::GET:
-        resultValue = _pinController.getDigital(cmd.pin);
-        success = (resultValue >= 0);
-        message = success ? "Pin value retrieved" : "Failed to get pin value";
-        break;
-
-    case CommandType::TOGGLE:
-        success = _pinController.toggle(cmd.pin);
-        if (success)
-        {
-            resultValue = _pinController.getDigital(cmd.pin);
-            message = "Pin toggled successfully";
-        }
-        else
-        {
-            message = "Failed to toggle pin";
-        }
-        break;
-
-    case CommandType::PWM:
-        success = _pinController.setPWM(cmd.pin, cmd.value);
-        message = success ? "PWM set successfully" : "Failed to set PWM";
-        resultValue = cmd.value;
-        break;
-
-    case CommandType::STATUS:
-    {
-        Serial.println();
-        Serial.println("========================================");
-        Serial.println("  System Status");
-        Serial.println("========================================");
-        Serial.println(_wifiManager.getStatusString());
-        Serial.println();
-        Serial.println("Pin States:");
-        Serial.println(_pinController.getAllPinStates());
-        Serial.println();
-        Serial.println("Watchdog Status:");
-        Serial.println(_watchdogManager.getErrorStats());
-        Serial.println("========================================");
-        Serial.println();
-        return;
-    }
-
-    case CommandType::RESET:
-        Serial.println();
-        Serial.println("========================================");
-        Serial.println("  RESTART REQUESTED");
-        Serial.println("========================================");
-        Serial.println("Restarting in 2 seconds...");
-        Serial.println("========================================");
-        Serial.println();
-
-        if (_restartCallback)
-        {
-            _restartCallback(2000);
-        }
-        return;
-
-    case CommandType::HELP:
-        Serial.println();
-        Serial.println("========================================");
-        Serial.println("  Command Help");
-        Serial.println("========================================");
-        Serial.println(_commandParser.getHelpText());
-        Serial.println("========================================");
-        Serial.println();
-        return;
-
-    default:
-        message = "Unknown command";
-        success = false;
-        break;
-    }
-
-    // Print response
-    Serial.println(_commandParser.generateResponse(cmd, success, message, resultValue));
+    Serial.println();
+    Serial.println("========================================");
+    Serial.println("  System Status");
+    Serial.println("========================================");
+    Serial.println(_wifiManager.getStatusString());
+    Serial.println();
+    Serial.println("Pin States:");
+    Serial.println(_pinController.getAllPinStates());
+    Serial.println();
+    Serial.println("Watchdog Status:");
+    Serial.println(_watchdogManager.getErrorStats());
+    Serial.println("========================================");
+    Serial.println();
 }
@@ -0,0 +1,86 @@
+#include "ServiceAdvertiser.h"
+#include "Logger.h"
+#include <WiFi.h>
+#include <ESPmDNS.h>
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+namespace
+{
+    // DNS-SD service name of the command ports (at most 15 characters)
+    const char *const CONTROL_SERVICE = "esp32ctl";
+}
+
+ServiceAdvertiser::ServiceAdvertiser() : _running(false)
+{
+}
+
+void ServiceAdvertiser::begin()
+{
+#if ENABLE_MDNS
+    if (_running)
+    {
+        return;
+    }
+
+    if (!MDNS.begin(DEVICE_HOSTNAME))
+    {
+        LOG_ERROR("mDNS", "Failed to start responder");
+        return;
+    }
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    char instance[48];
+    snprintf(instance, sizeof(instance), "%s-%02x%02x%02x", DEVICE_HOSTNAME, mac[3], mac[4], mac[5]);
+    MDNS.setInstanceName(instance);
+
+    MDNS.addService(CONTROL_SERVICE, "tcp", TCP_SERVER_PORT);
+    addControlTxt("tcp");
+    MDNS.addService(CONTROL_SERVICE, "udp", UDP_SERVER_PORT);
+    addControlTxt("udp");
+
+    MDNS.addService("http", "tcp", WEB_SERVER_PORT);
+    MDNS.addServiceTxt("http", "tcp", "path", "/");
+    MDNS.addServiceTxt("http", "tcp", "fw", FIRMWARE_VERSION);
+
+    _running = true;
+    LOG_INFO("mDNS", "Advertising %s.local as %s", DEVICE_HOSTNAME, instance);
+#endif
+}
+
+uint32_t ServiceAdvertiser::pinMapVersion()
+{
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; i < SAFE_PIN_COUNT; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(SAFE_PINS[i])) * 16777619UL;
+    }
+    return hash;
+}
+
+void ServiceAdvertiser::addControlTxt(const char *proto)
+{
+    char value[12];
+
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "fw", FIRMWARE_VERSION);
+
+    snprintf(value, sizeof(value), "%08lx", static_cast<unsigned long>(pinMapVersion()));
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "pinmap", value);
+
+    snprintf(value, sizeof(value), "%d", SAFE_PIN_COUNT);
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "pins", value);
+
+    snprintf(value, sizeof(value), "%d", TCP_SERVER_PORT);
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "tcp", value);
+    snprintf(value, sizeof(value), "%d", UDP_SERVER_PORT);
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "udp", value);
+    snprintf(value, sizeof(value), "%d", WEB_SERVER_PORT);
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "http", value);
+
+#if ENABLE_UDP_MULTICAST
+    snprintf(value, sizeof(value), "%d", UDP_MULTICAST_GROUP_ID);
+    MDNS.addServiceTxt(CONTROL_SERVICE, proto, "group", value);
+#endif
+}
@@ -0,0 +1,105 @@
+#include "StatusSnapshot.h"
+#include "WiFiManager.h"
+#include "WatchdogManager.h"
+
+StatusSnapshot::StatusSnapshot()
+    : _cachedIP(0),
+      _lastUpdate(0),
+      _valid(false),
+      _lock(xSemaphoreCreateMutex())
+{
+    memset(&_data, 0, sizeof(_data));
+    _data.chipModel = "";
+    _data.errorCount = -1; // Forces the first read of the last error
+}
+
+StatusSnapshot::~StatusSnapshot()
+{
+    vSemaphoreDelete(_lock);
+}
+
+void StatusSnapshot::update(WiFiManager &wifi, WatchdogManager &watchdog, int tcpClients, bool force)
+{
+    unsigned long now = millis();
+    if (_valid && !force && now - _lastUpdate < STATUS_SNAPSHOT_INTERVAL_MS)
+    {
+        return;
+    }
+    _lastUpdate = now;
+
+    // Gather outside the lock; only this task writes _data
+    Data next = _data;
+    next.uptime = watchdog.getUptimeSeconds();
+    next.freeHeap = ESP.getFreeHeap();
+    next.minFreeHeap = ESP.getMinFreeHeap();
+    next.maxAllocHeap = ESP.getMaxAllocHeap();
+    next.chipModel = ESP.getChipModel();
+    next.chipCores = ESP.getChipCores();
+    next.cpuFreq = ESP.getCpuFreqMHz();
+    next.tcpClients = tcpClients;
+
+    next.wifiConnected = wifi.isConnected();
+    next.rssi = wifi.getSignalStrength();
+
+    IPAddress ip = next.wifiConnected ? WiFi.localIP() : IPAddress(0, 0, 0, 0);
+    uint32_t ipValue = static_cast<uint32_t>(ip);
+    if (!_valid || ipValue != _cachedIP || next.wifiConnected != _data.wifiConnected)
+    {
+        // SSID comes back as a String, so only read it when the link changed
+        _cachedIP = ipValue;
+        snprintf(next.ip, sizeof(next.ip), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+        strlcpy(next.ssid, wifi.getCurrentSSID().c_str(), sizeof(next.ssid));
+    }
+
+    int errorCount = watchdog.getErrorCount();
+    if (errorCount != _data.errorCount)
+    {
+        next.errorCount = errorCount;
+        strlcpy(next.lastError, watchdog.getLastError().c_str(), sizeof(next.lastError));
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _data = next;
+    xSemaphoreGive(_lock);
+
+    _valid = true;
+}
+
+StatusSnapshot::Data StatusSnapshot::get() const
+{
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    Data copy = _data;
+    xSemaphoreGive(_lock);
+    return copy;
+}
+
+void StatusSnapshot::writeSystem(JsonWriter &json, const Data &data)
+{
+    json.beginObject("system")
+        .field("uptime", data.uptime)
+        .field("freeHeap", data.freeHeap)
+        .field("minFreeHeap", data.minFreeHeap)
+        .field("maxAllocHeap", data.maxAllocHeap)
+        .field("chipModel", data.chipModel)
+        .field("chipCores", data.chipCores)
+        .field("cpuFreq", data.cpuFreq)
+        .endObject();
+}
+
+void StatusSnapshot::writeWiFi(JsonWriter &json, const Data &data)
+{
+    json.beginObject("wifi")
+        .field("connected", data.wifiConnected)
+        .field("ssid", data.ssid)
+        .field("ip", data.ip)
+        .field("rssi", data.rssi)
+        .endObject();
+}
+
+void StatusSnapshot::writeWatchdog(JsonWriter &json, const Data &data)
+{
+    json.beginObject("watchdog")
+        .field("errorCount", data.errorCount)
+        .field("lastError", data.lastError)
+        .endObject();
+}
@@ -1,126 +1,253 @@
 #include "TelegramNotifier.h"
-#include "WatchdogManager.h"
+#include "BufferPrint.h"
+#include "Logger.h"
 
-TelegramNotifier::TelegramNotifier() : lastMessageCheck(0), connectionNotified(false), lastNotifiedIP(""),
-                                       pendingNotification(false), pendingIP(""), pendingSSID(""),
-                                       notificationQueuedTime(0), watchdog(nullptr)
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+TelegramNotifier::TelegramNotifier() : bot(nullptr), pollBot(nullptr), outboundQueue(nullptr), taskHandle(nullptr),
+                                       pollTaskHandle(nullptr), lastMessageCheck(0), connectionNotified(false), lastNotifiedIP(""),
+                                       commandDispatcher(nullptr), batchLength(0), batchStarted(0),
+                                       handshakes(0)
 {
-    bot = nullptr;
 }
 
-void TelegramNotifier::begin(WatchdogManager *wdt)
+void TelegramNotifier::setCommandDispatcher(CommandDispatcher *dispatcher)
+{
+    commandDispatcher = dispatcher;
+}
+
+void TelegramNotifier::begin()
 {
 #if ENABLE_TELEGRAM_NOTIFICATIONS
-    watchdog = wdt;
-
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Initializing Telegram notifier...");
-    Serial.printf("[Telegram] Bot Token: %s\n", TELEGRAM_BOT_TOKEN);
-    Serial.printf("[Telegram] Chat ID: %s\n", TELEGRAM_CHAT_ID);
-    Serial.println("[Telegram]");
-    Serial.println("[Telegram] Test your bot configuration:");
-    Serial.printf("[Telegram]   https://api.telegram.org/bot%s/getMe\n", TELEGRAM_BOT_TOKEN);
-    Serial.println("[Telegram]");
-    Serial.println("[Telegram] If bot is valid, send /start to your bot on Telegram!");
-#endif
+    if (taskHandle != nullptr)
+    {
+        return;
+    }
+
+    LOG_INFO("Telegram", "Initializing Telegram notifier...");
+    LOG_DEBUG("Telegram", "Bot Token: %s", TELEGRAM_BOT_TOKEN);
+    LOG_DEBUG("Telegram", "Chat ID: %s", TELEGRAM_CHAT_ID);
+    LOG_DEBUG("Telegram", "Test your bot configuration:");
+    LOG_DEBUG("Telegram", "  https://api.telegram.org/bot%s/getMe", TELEGRAM_BOT_TOKEN);
+    LOG_DEBUG("Telegram", "If bot is valid, send /start to your bot on Telegram!");
 
     // Configure WiFiClientSecure to skip SSL certificate verification
     // Note: In production, you should verify certificates for better security
     client.setInsecure();
+    pollClient.setInsecure();
 
     // Set connection timeout to 10 seconds
     client.setTimeout(10000);
+    pollClient.setTimeout(10000);
 
-    // Initialize Telegram bot
+    // One bot per connection; getUpdates holds the poll request open this long
     bot = new UniversalTelegramBot(TELEGRAM_BOT_TOKEN, client);
+    pollBot = new UniversalTelegramBot(TELEGRAM_BOT_TOKEN, pollClient);
+    pollBot->longPoll = TELEGRAM_LONG_POLL_SEC;
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Telegram notifier initialized");
-    Serial.println("[Telegram] Testing connection...");
-#endif
+    outboundQueue = xQueueCreate(TELEGRAM_QUEUE_LENGTH, sizeof(OutboundMessage));
+    if (outboundQueue == nullptr)
+    {
+        LOG_ERROR("Telegram", "Failed to create outbound queue");
+        return;
+    }
 
-    // Test connection by getting bot info (optional)
-    // This helps verify credentials early
+    // The worker task is not registered with the task watchdog, so blocking
+    // HTTPS calls no longer require suspending it
+    BaseType_t created = xTaskCreatePinnedToCore(taskEntry, "telegram",
+                                                 TELEGRAM_TASK_STACK_SIZE, this,
+                                                 TELEGRAM_TASK_PRIORITY, &taskHandle,
+                                                 TELEGRAM_TASK_CORE);
+    if (created != pdPASS)
+    {
+        taskHandle = nullptr;
+        LOG_ERROR("Telegram", "Failed to start worker task");
+        return;
+    }
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Ready to send notifications");
-#endif
+    created = xTaskCreatePinnedToCore(pollTaskEntry, "telegram-poll",
+                                      TELEGRAM_TASK_STACK_SIZE, this,
+                                      TELEGRAM_TASK_PRIORITY, &pollTaskHandle,
+                                      TELEGRAM_TASK_CORE);
+    if (created != pdPASS)
+    {
+        pollTaskHandle = nullptr;
+        LOG_ERROR("Telegram", "Failed to start poll task, chat commands are off");
+    }
+
+    LOG_INFO("Telegram", "Worker tasks started on core %d", TELEGRAM_TASK_CORE);
+    LOG_INFO("Telegram", "Ready to send notifications");
 #endif
 }
 
-void TelegramNotifier::loop()
+void TelegramNotifier::taskEntry(void *param)
 {
-#if ENABLE_TELEGRAM_NOTIFICATIONS
-    if (bot == nullptr)
+    static_cast<TelegramNotifier *>(param)->run();
+}
+
+void TelegramNotifier::run()
+{
+    OutboundMessage msg;
+
+    for (;;)
     {
-        return;
+        // Sleep on the queue until a message arrives or the batch is due
+        TickType_t wait = portMAX_DELAY;
+        if (batchLength > 0)
+        {
+            unsigned long age = millis() - batchStarted;
+            wait = age < TELEGRAM_COALESCE_MS ? pdMS_TO_TICKS(TELEGRAM_COALESCE_MS - age) : 0;
+        }
+
+        if (xQueueReceive(outboundQueue, &msg, wait) == pdTRUE)
+        {
+            handleOutbound(msg);
+            continue;
+        }
+
+        flushBatch();
     }
+}
+
+void TelegramNotifier::pollTaskEntry(void *param)
+{
+    static_cast<TelegramNotifier *>(param)->runPoll();
+}
 
-    // Feed watchdog if available
-    if (watchdog != nullptr)
+void TelegramNotifier::runPoll()
+{
+    for (;;)
     {
-        watchdog->feed();
+        // A long poll starts right away; offline it would return at once, so
+        // short-poll timing applies
+        if (TELEGRAM_LONG_POLL_SEC == 0 || WiFi.status() != WL_CONNECTED)
+        {
+            unsigned long elapsed = millis() - lastMessageCheck;
+            if (elapsed < TELEGRAM_CHECK_INTERVAL)
+            {
+                vTaskDelay(pdMS_TO_TICKS(TELEGRAM_CHECK_INTERVAL - elapsed));
+            }
+        }
+
+        pollUpdates();
+        lastMessageCheck = millis();
     }
+}
 
-    // Send pending notification first (if any)
-    if (pendingNotification)
+bool TelegramNotifier::enqueue(const OutboundMessage &msg)
+{
+    if (outboundQueue == nullptr)
     {
-        sendPendingNotification();
+        return false;
     }
 
-    // Check for new messages periodically
-    if (millis() - lastMessageCheck > TELEGRAM_CHECK_INTERVAL)
+    if (xQueueSend(outboundQueue, &msg, 0) != pdTRUE)
     {
-        // Suspend watchdog during network operations
-        if (watchdog != nullptr)
-        {
-            watchdog->suspend();
-        }
+        LOG_WARNING("Telegram", "Outbound queue full, message dropped");
+        return false;
+    }
 
-        int numNewMessages = bot->getUpdates(bot->last_message_received + 1);
+    return true;
+}
 
-        while (numNewMessages)
+void TelegramNotifier::handleOutbound(const OutboundMessage &msg)
+{
+    switch (msg.type)
+    {
+    case OutboundType::IP_NOTIFICATION:
+        if (WiFi.status() == WL_CONNECTED)
         {
-            handleNewMessages(numNewMessages);
-            numNewMessages = bot->getUpdates(bot->last_message_received + 1);
+            sendIPAddress(String(msg.ip), String(msg.ssid));
         }
+        break;
 
-        // Resume watchdog after network operations
-        if (watchdog != nullptr)
+    case OutboundType::TEXT:
+        if (WiFi.status() == WL_CONNECTED)
         {
-            watchdog->resume();
+            addToBatch(msg.text);
         }
+        break;
 
-        lastMessageCheck = millis();
+    case OutboundType::RESET_NOTIFICATION:
+        LOG_DEBUG("Telegram", "Resetting notification flag");
+        connectionNotified = false;
+        lastNotifiedIP = "";
+        break;
     }
-#endif
 }
 
-void TelegramNotifier::queueIPNotification(const String &ipAddress, const String &ssid)
+void TelegramNotifier::addToBatch(const char *text)
 {
-#if ENABLE_TELEGRAM_NOTIFICATIONS
-    if (bot == nullptr)
+    size_t length = strlen(text);
+    if (batchLength > 0 && batchLength + 1 + length >= sizeof(batch))
     {
-        return;
+        flushBatch();
     }
 
-    // Check if we already notified for this IP
-    if (connectionNotified && lastNotifiedIP == ipAddress)
+    if (batchLength == 0)
+    {
+        batchStarted = millis();
+    }
+    else
+    {
+        batch[batchLength++] = '\n';
+    }
+
+    batchLength += strlcpy(batch + batchLength, text, sizeof(batch) - batchLength);
+    if (batchLength >= sizeof(batch))
+    {
+        batchLength = sizeof(batch) - 1;
+    }
+}
+
+void TelegramNotifier::flushBatch()
+{
+    if (batchLength > 0 && WiFi.status() == WL_CONNECTED)
+    {
+        LOG_DEBUG("Telegram", "Sending %u bytes of notifications...", static_cast<unsigned>(batchLength));
+        noteConnection(client);
+        bot->sendMessage(TELEGRAM_CHAT_ID, String(batch), "");
+    }
+    batchLength = 0;
+}
+
+void TelegramNotifier::pollUpdates()
+{
+    if (pollBot == nullptr || WiFi.status() != WL_CONNECTED)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Telegram] Already notified for this connection");
-#endif
         return;
     }
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Queueing IP address notification...");
-#endif
+    noteConnection(pollClient);
+    int numNewMessages = pollBot->getUpdates(pollBot->last_message_received + 1);
+    if (numNewMessages)
+    {
+        handleNewMessages(numNewMessages);
+    }
+}
+
+void TelegramNotifier::noteConnection(WiFiClientSecure &connection)
+{
+    // The bot reuses the connection while it stays open
+    if (!connection.connected())
+    {
+        uint32_t count = ++handshakes;
+        LOG_DEBUG("Telegram", "Opening TLS connection (#%u)", static_cast<unsigned>(count));
+    }
+}
 
-    pendingNotification = true;
-    pendingIP = ipAddress;
-    pendingSSID = ssid;
-    notificationQueuedTime = millis();
+void TelegramNotifier::queueIPNotification(const String &ipAddress, const String &ssid)
+{
+#if ENABLE_TELEGRAM_NOTIFICATIONS
+    LOG_DEBUG("Telegram", "Queueing IP address notification...");
+
+    OutboundMessage msg;
+    msg.type = OutboundType::IP_NOTIFICATION;
+    strlcpy(msg.ip, ipAddress.c_str(), sizeof(msg.ip));
+    strlcpy(msg.ssid, ssid.c_str(), sizeof(msg.ssid));
+    msg.text[0] = '\0';
+    enqueue(msg);
 #endif
 }
 
@@ -135,9 +262,7 @@ void TelegramNotifier::sendIPAddress(const String &ipAddress, const String &ssid
     // Check if we already notified for this IP
     if (connectionNotified && lastNotifiedIP == ipAddress)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Telegram] Already notified for this connection");
-#endif
+        LOG_DEBUG("Telegram", "Already notified for this connection");
         return;
     }
 
@@ -150,49 +275,29 @@ void TelegramNotifier::sendIPAddress(const String &ipAddress, const String &ssid
     message += "• Web Interface: http://" + ipAddress + "/\n";
     message += "• mDNS: http://" + String(DEVICE_HOSTNAME) + ".local/";
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Sending IP address notification...");
-    Serial.printf("[Telegram] Message length: %d bytes\n", message.length());
-    Serial.printf("[Telegram] Target Chat ID: %s\n", TELEGRAM_CHAT_ID);
-#endif
-
-    // Suspend watchdog during long blocking HTTPS operation
-    if (watchdog != nullptr)
-    {
-        watchdog->suspend();
-    }
-
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Connecting to Telegram API...");
-#endif
+    LOG_INFO("Telegram", "Sending IP address notification...");
+    LOG_DEBUG("Telegram", "Message length: %d bytes", message.length());
+    LOG_DEBUG("Telegram", "Target Chat ID: %s", TELEGRAM_CHAT_ID);
+    LOG_DEBUG("Telegram", "Connecting to Telegram API...");
 
+    noteConnection(client);
     bool success = bot->sendMessage(TELEGRAM_CHAT_ID, message, "");
 
-    // Resume watchdog after operation
-    if (watchdog != nullptr)
-    {
-        watchdog->resume();
-    }
-
     if (success)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Telegram] ✓ IP address notification sent successfully!");
-#endif
+        LOG_INFO("Telegram", "✓ IP address notification sent successfully!");
         connectionNotified = true;
         lastNotifiedIP = ipAddress;
     }
     else
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Telegram] ✗ Failed to send IP address notification");
-        Serial.println("[Telegram] Possible issues:");
-        Serial.println("[Telegram]   - Check bot token is correct");
-        Serial.println("[Telegram]   - Check chat ID is correct");
-        Serial.println("[Telegram]   - Verify you've started a chat with the bot");
-        Serial.println("[Telegram]   - Check internet connectivity");
-        Serial.println("[Telegram]   - Try sending /start to your bot on Telegram");
-#endif
+        LOG_ERROR("Telegram", "✗ Failed to send IP address notification");
+        LOG_INFO("Telegram", "Possible issues:");
+        LOG_INFO("Telegram", "  - Check bot token is correct");
+        LOG_INFO("Telegram", "  - Check chat ID is correct");
+        LOG_INFO("Telegram", "  - Verify you've started a chat with the bot");
+        LOG_INFO("Telegram", "  - Check internet connectivity");
+        LOG_INFO("Telegram", "  - Try sending /start to your bot on Telegram");
     }
 #endif
 }
@@ -200,28 +305,12 @@ void TelegramNotifier::sendIPAddress(const String &ipAddress, const String &ssid
 void TelegramNotifier::sendMessage(const String &message)
 {
 #if ENABLE_TELEGRAM_NOTIFICATIONS
-    if (bot == nullptr)
-    {
-        return;
-    }
-
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Sending custom message...");
-#endif
-
-    // Suspend watchdog during send
-    if (watchdog != nullptr)
-    {
-        watchdog->suspend();
-    }
-
-    bot->sendMessage(TELEGRAM_CHAT_ID, message, "");
-
-    // Resume watchdog after send
-    if (watchdog != nullptr)
-    {
-        watchdog->resume();
-    }
+    OutboundMessage msg;
+    msg.type = OutboundType::TEXT;
+    msg.ip[0] = '\0';
+    msg.ssid[0] = '\0';
+    strlcpy(msg.text, message.c_str(), sizeof(msg.text));
+    enqueue(msg);
 #endif
 }
 
@@ -237,53 +326,31 @@ void TelegramNotifier::markConnectionNotified()
 
 void TelegramNotifier::resetNotificationFlag()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Resetting notification flag");
-#endif
-    connectionNotified = false;
-    lastNotifiedIP = "";
-    pendingNotification = false;
-}
-
-void TelegramNotifier::sendPendingNotification()
-{
 #if ENABLE_TELEGRAM_NOTIFICATIONS
-    if (!pendingNotification || bot == nullptr)
-    {
-        return;
-    }
-
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Telegram] Sending pending IP notification...");
-#endif
-
-    // Send the notification
-    sendIPAddress(pendingIP, pendingSSID);
-
-    // Clear the pending flag
-    pendingNotification = false;
-    pendingIP = "";
-    pendingSSID = "";
+    // Processed in order by the worker task, so a reset followed by a new
+    // IP notification behaves as expected
+    OutboundMessage msg;
+    msg.type = OutboundType::RESET_NOTIFICATION;
+    msg.ip[0] = '\0';
+    msg.ssid[0] = '\0';
+    msg.text[0] = '\0';
+    enqueue(msg);
 #endif
 }
 
 void TelegramNotifier::handleNewMessages(int numNewMessages)
 {
 #if ENABLE_TELEGRAM_NOTIFICATIONS
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[Telegram] Handling %d new messages\n", numNewMessages);
-#endif
+    LOG_DEBUG("Telegram", "Handling %d new messages", numNewMessages);
 
     for (int i = 0; i < numNewMessages; i++)
     {
-        String chat_id = String(bot->messages[i].chat_id);
-        String text = bot->messages[i].text;
+        String chat_id = String(pollBot->messages[i].chat_id);
+        String text = pollBot->messages[i].text;
 
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[Telegram] Message from %s: %s\n", chat_id.c_str(), text.c_str());
-#endif
+        LOG_DEBUG("Telegram", "Message from %s: %s", chat_id.c_str(), text.c_str());
 
-        String from_name = bot->messages[i].from_name;
+        String from_name = pollBot->messages[i].from_name;
         if (from_name == "")
         {
             from_name = "Guest";
@@ -292,9 +359,7 @@ void TelegramNotifier::handleNewMessages(int numNewMessages)
         // Only respond to messages from the configured chat ID
         if (chat_id != String(TELEGRAM_CHAT_ID))
         {
-#if ENABLE_SERIAL_DEBUG
-            Serial.println("[Telegram] Message from unauthorized chat ID, ignoring");
-#endif
+            LOG_WARNING("Telegram", "Message from unauthorized chat ID, ignoring");
             continue;
         }
 
@@ -305,15 +370,19 @@ void TelegramNotifier::handleNewMessages(int numNewMessages)
             welcome += "Available commands:\n";
             welcome += "/status - Get current status and IP\n";
             welcome += "/ip - Get IP address\n";
-            welcome += "/help - Show this help message";
-            bot->sendMessage(chat_id, welcome, "");
+            welcome += "/scene [name] - Recall a scene, or list them\n";
+            welcome += "/help - Show this help message\n\n";
+            welcome += "Any other text runs as a pin command, e.g. SET 13 1";
+            pollBot->sendMessage(chat_id, welcome, "");
         }
         else if (text == "/status" || text == "/ip")
         {
-            // This will be sent automatically when connected
-            // But user can request it manually
-            String response = "ℹ️ Use /start to see available commands";
-            bot->sendMessage(chat_id, response, "");
+            runCommand(chat_id, "STATUS", 6);
+        }
+        else if (text == "/scene" || text.startsWith("/scene "))
+        {
+            // "/scene evening" is the text command "scene evening"
+            runCommand(chat_id, text.c_str() + 1, text.length() - 1);
         }
         else if (text == "/help")
         {
@@ -323,9 +392,35 @@ void TelegramNotifier::handleNewMessages(int numNewMessages)
             help += "/start - Show welcome message\n";
             help += "/status - Request current status\n";
             help += "/ip - Request IP address\n";
-            help += "/help - Show this help";
-            bot->sendMessage(chat_id, help, "");
+            help += "/scene [name] - Recall a scene, or list them\n";
+            help += "/help - Show this help\n\n";
+            help += "Pin commands use the TCP text or JSON format, e.g. TOGGLE 13";
+            pollBot->sendMessage(chat_id, help, "");
+        }
+        else if (!text.startsWith("/"))
+        {
+            runCommand(chat_id, text.c_str(), text.length());
         }
     }
 #endif
 }
+
+void TelegramNotifier::runCommand(const String &chatId, const char *text, size_t length)
+{
+#if ENABLE_TELEGRAM_NOTIFICATIONS
+    if (commandDispatcher == nullptr)
+    {
+        pollBot->sendMessage(chatId, "Commands are not enabled", "");
+        return;
+    }
+
+    BufferPrint response(responseBuffer, sizeof(responseBuffer));
+    commandDispatcher->process(text, length, response, nullptr, CommandSource::TELEGRAM);
+    if (response.overflowed())
+    {
+        pollBot->sendMessage(chatId, "Response too large", "");
+        return;
+    }
+    pollBot->sendMessage(chatId, response.c_str(), "");
+#endif
+}
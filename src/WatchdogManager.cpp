@@ -1,4 +1,8 @@
 #include "WatchdogManager.h"
+#include "Logger.h"
+
+// Log queue, defined in main.cpp
+extern Logger logger;
 
 WatchdogManager::WatchdogManager()
     : _lastFeed(0),
@@ -7,6 +11,9 @@ WatchdogManager::WatchdogManager()
       _consecutiveErrors(0),
       _lastError(""),
       _lastErrorTime(0),
+      _overrunCount(0),
+      _loggedOverruns(0),
+      _lastOverrunLog(0),
       _hwWatchdogEnabled(false),
       _taskWatchdogEnabled(false)
 {
@@ -18,9 +25,7 @@ void WatchdogManager::begin()
 
 #if ENABLE_HW_WATCHDOG
 // Enable hardware watchdog
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WDT] Enabling hardware watchdog (%d seconds)\n", HW_WATCHDOG_TIMEOUT_SEC);
-#endif
+    LOG_INFO("WDT", "Enabling hardware watchdog (%d seconds)", HW_WATCHDOG_TIMEOUT_SEC);
 
     esp_task_wdt_init(HW_WATCHDOG_TIMEOUT_SEC, true); // Enable panic
     esp_task_wdt_add(NULL);                           // Add current thread to WDT watch
@@ -28,17 +33,13 @@ void WatchdogManager::begin()
 #endif
 
 #if ENABLE_TASK_WATCHDOG
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WDT] Task watchdog enabled (%d seconds)\n", TASK_WATCHDOG_TIMEOUT_SEC);
-#endif
+    LOG_INFO("WDT", "Task watchdog enabled (%d seconds)", TASK_WATCHDOG_TIMEOUT_SEC);
     _taskWatchdogEnabled = true;
 #endif
 
     _lastFeed = millis();
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[WDT] Watchdog Manager initialized");
-#endif
+    LOG_INFO("WDT", "Watchdog Manager initialized");
 }
 
 void WatchdogManager::feed()
@@ -64,10 +65,8 @@ void WatchdogManager::feed()
     if (_consecutiveErrors > 0 &&
         currentMillis - _lastErrorTime > ERROR_COOLDOWN_PERIOD)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[WDT] Error cooldown complete, clearing %d consecutive errors\n",
-                      _consecutiveErrors);
-#endif
+        LOG_WARNING("WDT", "Error cooldown complete, clearing %d consecutive errors",
+                    _consecutiveErrors);
         _consecutiveErrors = 0;
     }
 }
@@ -79,17 +78,13 @@ void WatchdogManager::registerError(const String &errorMessage)
     _lastError = errorMessage;
     _lastErrorTime = millis();
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WDT] Error registered: %s (Total: %d, Consecutive: %d)\n",
-                  errorMessage.c_str(), _errorCount, _consecutiveErrors);
-#endif
+    LOG_WARNING("WDT", "Error registered: %s (Total: %d, Consecutive: %d)",
+                errorMessage.c_str(), _errorCount, _consecutiveErrors);
 
     // Check if we should restart
     if (_consecutiveErrors >= MAX_CONSECUTIVE_ERRORS)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[WDT] Maximum consecutive errors reached (%d)\n", _consecutiveErrors);
-#endif
+        LOG_ERROR("WDT", "Maximum consecutive errors reached (%d)", _consecutiveErrors);
 
 #if AUTO_RESTART_ON_CRITICAL_ERROR
         restart("Maximum consecutive errors exceeded");
@@ -97,11 +92,26 @@ void WatchdogManager::registerError(const String &errorMessage)
     }
 }
 
+void WatchdogManager::reportOverrun(const char *task, uint32_t elapsedUs, uint32_t budgetUs)
+{
+    _overrunCount++;
+
+    unsigned long now = millis();
+    if (_loggedOverruns != 0 && now - _lastOverrunLog < LOOP_OVERRUN_LOG_INTERVAL_MS)
+    {
+        return;
+    }
+
+    LOG_WARNING("WDT", "Loop task %s ran %lu us, budget %lu us (%lu overruns since last report)", task,
+                static_cast<unsigned long>(elapsedUs), static_cast<unsigned long>(budgetUs),
+                static_cast<unsigned long>(_overrunCount - _loggedOverruns));
+    _loggedOverruns = _overrunCount;
+    _lastOverrunLog = now;
+}
+
 void WatchdogManager::clearErrors()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[WDT] Clearing error count");
-#endif
+    LOG_WARNING("WDT", "Clearing error count");
 
     _consecutiveErrors = 0;
 }
@@ -118,6 +128,10 @@ bool WatchdogManager::shouldRestart()
 
 void WatchdogManager::restart(const String &reason)
 {
+    // Queued lines first; the banner itself is written directly, the drain
+    // task may not get to run again
+    logger.flush();
+
 #if ENABLE_SERIAL_DEBUG
     Serial.println("========================================");
     Serial.printf("[WDT] SYSTEM RESTART INITIATED\n");
@@ -157,6 +171,7 @@ String WatchdogManager::getErrorStats()
         stats += "  Time Since Last Error: " + String(timeSinceError) + " seconds\n";
     }
 
+    stats += "  Loop Task Overruns: " + String(_overrunCount) + "\n";
     stats += "  Uptime: " + String(getUptimeSeconds()) + " seconds\n";
     stats += "  HW Watchdog: " + String(_hwWatchdogEnabled ? "Enabled" : "Disabled") + "\n";
     stats += "  Task Watchdog: " + String(_taskWatchdogEnabled ? "Enabled" : "Disabled") + "\n";
@@ -169,9 +184,7 @@ void WatchdogManager::suspend()
 #if ENABLE_HW_WATCHDOG
     if (_hwWatchdogEnabled)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WDT] Temporarily suspending watchdog monitoring");
-#endif
+        LOG_DEBUG("WDT", "Temporarily suspending watchdog monitoring");
         // Remove current task from watchdog monitoring
         esp_task_wdt_delete(NULL);
     }
@@ -183,9 +196,7 @@ void WatchdogManager::resume()
 #if ENABLE_HW_WATCHDOG
     if (_hwWatchdogEnabled)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WDT] Resuming watchdog monitoring");
-#endif
+        LOG_DEBUG("WDT", "Resuming watchdog monitoring");
         // Re-add current task to watchdog monitoring
         esp_task_wdt_add(NULL);
         esp_task_wdt_reset();
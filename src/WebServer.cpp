@@ -1,24 +1,139 @@
 #include "WebServer.h"
-#include <ArduinoJson.h>
+#include "LineFramer.h"
+#include "BufferPrint.h"
+#include "JsonWriter.h"
+#include "BinaryProtocol.h"
+#include "WebPageData.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "AnalogSampler.h"
+
+// Shared status snapshot, refreshed by the main loop
+extern StatusSnapshot statusSnapshot;
+
+// Latency histograms, defined in main.cpp
+extern Metrics metrics;
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// DMA ADC sampler, defined in main.cpp
+extern AnalogSampler analogSampler;
+
+WebServer::WebServer(PinController &pinController, CommandDispatcher &dispatcher, uint16_t port)
+    : _server(port), _events("/events"), _ws("/ws"), _analogWs("/analog"), _pinController(pinController),
+      _dispatcher(dispatcher), _inputListenerId(-1), _analogListenerId(-1),
+      _port(port), _running(false), _lastPinUpdate(0), _lastStatusUpdate(0),
+      _clientsLock(xSemaphoreCreateMutex())
+{
+}
 
-WebServer::WebServer(PinController &pinController, uint16_t port)
-    : _server(port), _pinController(pinController), _port(port), _running(false)
+WebServer::~WebServer()
 {
+    _pinController.removeInputListener(_inputListenerId);
+    analogSampler.removeBlockListener(_analogListenerId);
+    vSemaphoreDelete(_clientsLock);
+}
+
+template <typename Client>
+void WebServer::lockDisconnect(Client *client)
+{
+    // The library's own handler, with the list change and the delete under
+    // the lock. New clients are appended in one pointer store, which a push
+    // walking the list sees either whole or not at all.
+    client->client()->onDisconnect([this](void *arg, AsyncClient *c)
+                                   {
+                                       xSemaphoreTake(_clientsLock, portMAX_DELAY);
+                                       static_cast<Client *>(arg)->_onDisconnect();
+                                       xSemaphoreGive(_clientsLock);
+                                       delete c;
+                                   },
+                                   client);
 }
 
 void WebServer::begin()
 {
     setupRoutes();
+
+    _ws.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type,
+                       void *arg, uint8_t *data, size_t len)
+                { this->handleWebSocketEvent(client, type, arg, data, len); });
+    _analogWs.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type,
+                             void *, uint8_t *, size_t)
+                      {
+                          if (type == WS_EVT_CONNECT)
+                          {
+                              this->lockDisconnect(client);
+                          }
+                      });
+    _events.onConnect([this](AsyncEventSourceClient *client)
+                      { this->lockDisconnect(client); });
+    _server.addHandler(&_ws);
+    _server.addHandler(&_analogWs);
+    _server.addHandler(&_events);
+    _inputListenerId = _pinController.addInputListener([this](const InputEvent &event)
+                                                       { this->handleInputEvent(event); });
+    _analogListenerId = analogSampler.addBlockListener([this](const uint8_t *frame, size_t length)
+                                                       { this->handleAnalogBlock(frame, length); });
+
     _server.begin();
     _running = true;
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.print("[WebServer] Started on port ");
-    Serial.println(_port);
-    Serial.print("[WebServer] Access at: http://");
-    Serial.print(WiFi.localIP());
-    Serial.println("/");
-#endif
+    LOG_INFO("WebServer", "Started on port %d, access at http://%s/", _port,
+             WiFi.localIP().toString().c_str());
+}
+
+void WebServer::loop()
+{
+    if (!_running)
+    {
+        return;
+    }
+
+    xSemaphoreTake(_clientsLock, portMAX_DELAY);
+    _ws.cleanupClients();
+    _analogWs.cleanupClients();
+    xSemaphoreGive(_clientsLock);
+
+    // Snapshots for new dashboards, queued by the connect callback. Read here
+    // rather than in the AsyncTCP task so pin state is only read by its owner.
+    uint32_t clientId;
+    while (_snapshotClients.pop(clientId))
+    {
+        sendPinStates(clientId, "state", _pinController.getConfiguredPins());
+    }
+
+    unsigned long now = millis();
+
+    if (now - _lastPinUpdate >= WEB_SOCKET_UPDATE_INTERVAL_MS)
+    {
+        _lastPinUpdate = now;
+
+        // Always drain the change set so a dashboard that connects later
+        // does not get a stale backlog on top of its snapshot
+        uint64_t changed = _pinController.takeChangedPins();
+        if (changed != 0)
+        {
+            sendPinStates(0, "pins", changed);
+        }
+    }
+
+    if (now - _lastStatusUpdate >= WEB_SOCKET_STATUS_INTERVAL_MS)
+    {
+        _lastStatusUpdate = now;
+
+        xSemaphoreTake(_clientsLock, portMAX_DELAY);
+        if (_ws.count() > 0)
+        {
+            BufferPrint message(_pushBuffer, sizeof(_pushBuffer));
+            JsonWriter json(message);
+            json.beginObject().field("type", "status");
+            writeStatusFields(json);
+            json.endObject();
+            _ws.textAll(message.c_str(), message.length());
+        }
+        xSemaphoreGive(_clientsLock);
+    }
 }
 
 void WebServer::setupRoutes()
@@ -31,6 +146,9 @@ void WebServer::setupRoutes()
     _server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *request)
                { this->handleGetStatus(request); });
 
+    _server.on("/api/metrics", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { this->handleMetrics(request); });
+
     _server.on("/api/pin/set", HTTP_POST, [this](AsyncWebServerRequest *request)
                { this->handleSetPin(request); });
 
@@ -43,6 +161,9 @@ void WebServer::setupRoutes()
     _server.on("/api/pin/pwm", HTTP_POST, [this](AsyncWebServerRequest *request)
                { this->handleSetPWM(request); });
 
+    _server.on("/api/pin/input", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { this->handleSetInput(request); });
+
     _server.on("/api/reset", HTTP_POST, [this](AsyncWebServerRequest *request)
                { this->handleResetPins(request); });
 
@@ -53,25 +174,59 @@ void WebServer::setupRoutes()
 
 void WebServer::handleRoot(AsyncWebServerRequest *request)
 {
-    request->send(200, "text/html", getHTMLPage());
+    // The page only changes with the firmware, so a matching ETag means the
+    // browser's copy is current
+    if (request->hasHeader("If-None-Match") &&
+        request->getHeader("If-None-Match")->value() == WEB_PAGE_ETAG)
+    {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", WEB_PAGE_ETAG);
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
+        return;
+    }
+
+    // Streamed straight from flash, nothing is copied to the heap
+    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", WEB_PAGE_GZ, WEB_PAGE_GZ_LEN);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", WEB_PAGE_ETAG);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
 }
 
 void WebServer::handleGetStatus(AsyncWebServerRequest *request)
 {
-    JsonDocument doc;
-    doc["success"] = true;
-    doc["freeHeap"] = ESP.getFreeHeap();
-    doc["chipModel"] = ESP.getChipModel();
-    doc["chipCores"] = ESP.getChipCores();
-    doc["cpuFreq"] = ESP.getCpuFreqMHz();
-    doc["uptime"] = millis() / 1000;
-    doc["tcpPort"] = 8888;
-    doc["udpPort"] = 8889;
-    doc["webPort"] = _port;
-
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonWriter json(*response);
+    json.beginObject().field("success", true);
+    writeStatusFields(json);
+    json.endObject();
+    request->send(response);
+}
+
+void WebServer::handleMetrics(AsyncWebServerRequest *request)
+{
+    // Prometheus text exposition format
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    metrics.writePrometheus(*response);
+    request->send(response);
+}
+
+void WebServer::writeStatusFields(JsonWriter &json)
+{
+    StatusSnapshot::Data status = statusSnapshot.get();
+
+    json.field("freeHeap", status.freeHeap)
+        .field("minFreeHeap", status.minFreeHeap)
+        .field("chipModel", status.chipModel)
+        .field("chipCores", status.chipCores)
+        .field("cpuFreq", status.cpuFreq)
+        .field("uptime", status.uptime)
+        .field("rssi", status.rssi)
+        .field("tcpPort", TCP_SERVER_PORT)
+        .field("udpPort", UDP_SERVER_PORT)
+        .field("webPort", _port)
+        .field("wsClients", static_cast<unsigned int>(_ws.count()));
 }
 
 void WebServer::handleSetPin(AsyncWebServerRequest *request)
@@ -82,17 +237,12 @@ void WebServer::handleSetPin(AsyncWebServerRequest *request)
         return;
     }
 
-    int pin = request->getParam("pin")->value().toInt();
-    int value = request->getParam("value")->value().toInt();
+    Command cmd;
+    cmd.type = CommandType::SET;
+    cmd.pin = request->getParam("pin")->value().toInt();
+    cmd.value = request->getParam("value")->value().toInt();
 
-    if (_pinController.setDigital(pin, value))
-    {
-        sendJSONResponse(request, 200, true, "Pin set successfully");
-    }
-    else
-    {
-        sendJSONResponse(request, 400, false, "Failed to set pin");
-    }
+    sendCommandResult(request, _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB));
 }
 
 void WebServer::handleGetPin(AsyncWebServerRequest *request)
@@ -105,36 +255,89 @@ void WebServer::handleGetPin(AsyncWebServerRequest *request)
 
     int pin = request->getParam("pin")->value().toInt();
 
-    if (!_pinController.isPinConfigured(pin))
+    // The configured flag and mode come back with the result, PinController
+    // is only read in the main loop
+    Command cmd;
+    cmd.type = CommandType::GET;
+    cmd.pin = pin;
+    CommandResult result = _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB);
+    if (!result.success)
+    {
+        sendCommandResult(request, result);
+        return;
+    }
+    if (result.mode == PinMode::NOT_CONFIGURED)
     {
         sendJSONResponse(request, 400, false, "Pin not configured");
         return;
     }
 
-    PinMode mode = _pinController.getPinMode(pin);
-    int value;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonWriter json(*response);
+    json.beginObject()
+        .field("success", true)
+        .field("pin", pin)
+        .field("value", result.value)
+        .field("mode", result.mode == PinMode::PWM_OUTPUT ? "PWM" : "DIGITAL")
+        .endObject();
+    request->send(response);
+}
+
+void WebServer::handleTogglePin(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("pin"))
+    {
+        sendJSONResponse(request, 400, false, "Missing pin parameter");
+        return;
+    }
 
-    if (mode == PinMode::PWM_OUTPUT)
+    Command cmd;
+    cmd.type = CommandType::TOGGLE;
+    cmd.pin = request->getParam("pin")->value().toInt();
+    CommandResult result = _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB);
+    if (!result.success)
     {
-        value = _pinController.getPWM(pin);
+        sendCommandResult(request, result);
+        return;
     }
-    else
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonWriter json(*response);
+    json.beginObject()
+        .field("success", true)
+        .field("message", result.message)
+        .field("newValue", result.value)
+        .endObject();
+    request->send(response);
+}
+
+void WebServer::handleSetPWM(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("pin") || !request->hasParam("value"))
     {
-        value = _pinController.getDigital(pin);
+        sendJSONResponse(request, 400, false, "Missing pin or value parameter");
+        return;
     }
 
-    JsonDocument doc;
-    doc["success"] = true;
-    doc["pin"] = pin;
-    doc["value"] = value;
-    doc["mode"] = (mode == PinMode::PWM_OUTPUT) ? "PWM" : "DIGITAL";
+    Command cmd;
+    cmd.type = CommandType::PWM;
+    cmd.pin = request->getParam("pin")->value().toInt();
+    cmd.value = request->getParam("value")->value().toInt();
+
+    // Optional LEDC settings, 0 keeps the pin's current configuration
+    cmd.frequency = request->hasParam("freq") ? request->getParam("freq")->value().toInt() : 0;
+    cmd.resolution = request->hasParam("resolution") ? request->getParam("resolution")->value().toInt() : 0;
+
+    if (cmd.value < 0)
+    {
+        sendJSONResponse(request, 400, false, "PWM value must not be negative");
+        return;
+    }
 
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendCommandResult(request, _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB));
 }
 
-void WebServer::handleTogglePin(AsyncWebServerRequest *request)
+void WebServer::handleSetInput(AsyncWebServerRequest *request)
 {
     if (!request->hasParam("pin"))
     {
@@ -142,63 +345,203 @@ void WebServer::handleTogglePin(AsyncWebServerRequest *request)
         return;
     }
 
-    int pin = request->getParam("pin")->value().toInt();
+    Command cmd;
+    cmd.type = CommandType::SET_INPUT;
+    cmd.pin = request->getParam("pin")->value().toInt();
 
-    if (_pinController.toggle(pin))
+    if (request->hasParam("pull"))
     {
-        int newValue = _pinController.getDigital(pin);
-        JsonDocument doc;
-        doc["success"] = true;
-        doc["message"] = "Pin toggled successfully";
-        doc["newValue"] = newValue;
-
-        String response;
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
+        const String &pullStr = request->getParam("pull")->value();
+        if (pullStr.equalsIgnoreCase("PULLUP"))
+        {
+            cmd.pull = InputPull::PULLUP;
+        }
+        else if (pullStr.equalsIgnoreCase("PULLDOWN"))
+        {
+            cmd.pull = InputPull::PULLDOWN;
+        }
     }
-    else
+
+    int debounce = request->hasParam("debounce") ? request->getParam("debounce")->value().toInt()
+                                                 : INPUT_DEFAULT_DEBOUNCE_MS;
+    if (debounce < 0 || debounce > 65535)
     {
-        sendJSONResponse(request, 400, false, "Failed to toggle pin");
+        sendJSONResponse(request, 400, false, "Invalid debounce time");
+        return;
+    }
+    cmd.debounceMs = debounce;
+
+    CommandResult result = _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB);
+    if (!result.success)
+    {
+        sendCommandResult(request, result);
+        return;
     }
+
+    char value[8];
+    snprintf(value, sizeof(value), "%d", result.value);
+    sendJSONResponse(request, 200, true, result.message, value);
 }
 
-void WebServer::handleSetPWM(AsyncWebServerRequest *request)
+void WebServer::handleInputEvent(const InputEvent &event)
 {
-    if (!request->hasParam("pin") || !request->hasParam("value"))
+    char buffer[96];
+    BufferPrint data(buffer, sizeof(buffer));
+    JsonWriter json(data);
+    json.beginObject()
+        .field("pin", event.pin)
+        .field("value", event.value)
+        .field("timestamp_us", static_cast<long long>(event.timestampUs))
+        .endObject();
+
+    xSemaphoreTake(_clientsLock, portMAX_DELAY);
+    if (_events.count() > 0)
     {
-        sendJSONResponse(request, 400, false, "Missing pin or value parameter");
-        return;
+        _events.send(data.c_str(), "input", millis());
     }
+    xSemaphoreGive(_clientsLock);
+}
 
-    int pin = request->getParam("pin")->value().toInt();
-    int value = request->getParam("value")->value().toInt();
+void WebServer::handleAnalogBlock(const uint8_t *frame, size_t length)
+{
+    // Queued per client; a client that cannot keep up loses messages
+    // rather than stalling the main loop
+    xSemaphoreTake(_clientsLock, portMAX_DELAY);
+    if (_analogWs.count() > 0)
+    {
+        _analogWs.binaryAll(reinterpret_cast<const char *>(frame), length);
+    }
+    xSemaphoreGive(_clientsLock);
+}
+
+void WebServer::handleWebSocketEvent(AsyncWebSocketClient *client, AwsEventType type,
+                                     void *arg, uint8_t *data, size_t len)
+{
+    switch (type)
+    {
+    case WS_EVT_CONNECT:
+    {
+        LOG_DEBUG("WebServer", "WebSocket client %u connected", client->id());
+        lockDisconnect(client);
+        // Start the new dashboard from a full snapshot, sent by loop()
+        if (!_snapshotClients.push(client->id()))
+        {
+            client->close();
+        }
+        break;
+    }
 
-    if (value < 0 || value > 255)
+    case WS_EVT_DISCONNECT:
+        LOG_DEBUG("WebServer", "WebSocket client %u disconnected", client->id());
+        break;
+
+    case WS_EVT_DATA:
     {
-        sendJSONResponse(request, 400, false, "PWM value must be 0-255");
+        // Commands are small: only accept messages that arrive in one frame
+        AwsFrameInfo *info = static_cast<AwsFrameInfo *>(arg);
+        if (!info->final || info->index != 0 || info->len != len)
+        {
+            sendReply(client, "{\"success\":false,\"message\":\"Fragmented message not supported\"}");
+            break;
+        }
+        handleWebSocketMessage(client, info->opcode == WS_BINARY, data, len);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void WebServer::handleWebSocketMessage(AsyncWebSocketClient *client, bool binary,
+                                       const uint8_t *data, size_t len)
+{
+    if (binary)
+    {
+        if (len > COMMAND_BUFFER_SIZE)
+        {
+            return;
+        }
+
+        uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+        size_t replyLength = _dispatcher.processBinary(data, len, reply, CommandSource::WEB);
+        xSemaphoreTake(_clientsLock, portMAX_DELAY);
+        client->binary(reply, replyLength);
+        xSemaphoreGive(_clientsLock);
         return;
     }
 
-    if (_pinController.setPWM(pin, value))
+    if (len >= COMMAND_BUFFER_SIZE)
     {
-        sendJSONResponse(request, 200, true, "PWM set successfully");
+        sendReply(client, "{\"success\":false,\"message\":\"Command too long\"}");
+        return;
     }
-    else
+
+    // Text frames are not NUL-terminated, copy so the parser can rely on it
+    char command[COMMAND_BUFFER_SIZE];
+    memcpy(command, data, len);
+    command[len] = '\0';
+
+    const char *line = command;
+    size_t length = len;
+    LineFramer::trim(line, length);
+    if (length == 0)
     {
-        sendJSONResponse(request, 400, false, "Failed to set PWM");
+        return;
     }
+
+    BufferPrint response(_wsResponse, sizeof(_wsResponse));
+    _dispatcher.process(line, length, response, nullptr, CommandSource::WEB);
+    if (response.overflowed())
+    {
+        sendReply(client, "{\"success\":false,\"message\":\"Response too large\"}");
+        return;
+    }
+    sendReply(client, response.c_str(), response.length());
 }
 
-void WebServer::handleResetPins(AsyncWebServerRequest *request)
+void WebServer::sendReply(AsyncWebSocketClient *client, const char *text, size_t length)
+{
+    // The command ran without the lock; only the send shares the client's
+    // queue with pushes from loop()
+    xSemaphoreTake(_clientsLock, portMAX_DELAY);
+    client->text(text, length);
+    xSemaphoreGive(_clientsLock);
+}
+
+void WebServer::sendPinStates(uint32_t clientId, const char *type, uint64_t mask)
 {
-    if (_pinController.resetAllPins())
+    // Only called from loop()
+    BufferPrint message(_pushBuffer, sizeof(_pushBuffer));
+    JsonWriter json(message);
+
+    json.beginObject().field("type", type).key("pins");
+    _pinController.writePinStates(json, mask);
+    json.endObject();
+
+    // Look the client up under the lock, it may have gone since it queued
+    xSemaphoreTake(_clientsLock, portMAX_DELAY);
+    if (clientId != 0)
     {
-        sendJSONResponse(request, 200, true, "All pins reset successfully");
+        AsyncWebSocketClient *client = _ws.client(clientId);
+        if (client != nullptr)
+        {
+            client->text(message.c_str(), message.length());
+        }
     }
-    else
+    else if (_ws.count() > 0)
     {
-        sendJSONResponse(request, 500, false, "Failed to reset pins");
+        _ws.textAll(message.c_str(), message.length());
     }
+    xSemaphoreGive(_clientsLock);
+}
+
+void WebServer::handleResetPins(AsyncWebServerRequest *request)
+{
+    Command cmd;
+    cmd.type = CommandType::RESET_PINS;
+    CommandResult result = _dispatcher.execute(cmd, nullptr, nullptr, CommandSource::WEB);
+    sendJSONResponse(request, result.success ? 200 : 500, result.success, result.message);
 }
 
 void WebServer::handleNotFound(AsyncWebServerRequest *request)
@@ -206,633 +549,23 @@ void WebServer::handleNotFound(AsyncWebServerRequest *request)
     sendJSONResponse(request, 404, false, "Endpoint not found");
 }
 
-void WebServer::sendJSONResponse(AsyncWebServerRequest *request, int code, bool success, const String &message, const String &data)
+void WebServer::sendCommandResult(AsyncWebServerRequest *request, const CommandResult &result)
 {
-    JsonDocument doc;
-    doc["success"] = success;
-    doc["message"] = message;
-    if (data.length() > 0)
-    {
-        doc["data"] = data;
-    }
-
-    String response;
-    serializeJson(doc, response);
-    request->send(code, "application/json", response);
+    sendJSONResponse(request, result.success ? 200 : 400, result.success, result.message);
 }
 
-String WebServer::getHTMLPage()
+void WebServer::sendJSONResponse(AsyncWebServerRequest *request, int code, bool success, const char *message, const char *data)
 {
-    return R"rawliteral(
-<!DOCTYPE html>
-<html lang="en">
-<head>
-    <meta charset="UTF-8">
-    <meta name="viewport" content="width=device-width, initial-scale=1.0">
-    <title>ESP32 Pin Controller</title>
-    <style>
-        * {
-            margin: 0;
-            padding: 0;
-            box-sizing: border-box;
-        }
-        
-        body {
-            font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, Oxygen, Ubuntu, Cantarell, sans-serif;
-            background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);
-            min-height: 100vh;
-            padding: 20px;
-            color: #333;
-        }
-        
-        .container {
-            max-width: 1200px;
-            margin: 0 auto;
-        }
-        
-        .header {
-            background: white;
-            padding: 30px;
-            border-radius: 15px;
-            box-shadow: 0 10px 30px rgba(0, 0, 0, 0.2);
-            margin-bottom: 30px;
-            text-align: center;
-        }
-        
-        .header h1 {
-            color: #667eea;
-            font-size: 2.5em;
-            margin-bottom: 10px;
-        }
-        
-        .header p {
-            color: #666;
-            font-size: 1.1em;
-        }
-        
-        .status-bar {
-            background: white;
-            padding: 20px;
-            border-radius: 15px;
-            box-shadow: 0 10px 30px rgba(0, 0, 0, 0.2);
-            margin-bottom: 30px;
-            display: grid;
-            grid-template-columns: repeat(auto-fit, minmax(150px, 1fr));
-            gap: 15px;
-        }
-        
-        .status-item {
-            text-align: center;
-            padding: 15px;
-            background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);
-            border-radius: 10px;
-            color: white;
-        }
-        
-        .status-item .label {
-            font-size: 0.9em;
-            opacity: 0.9;
-            margin-bottom: 5px;
-        }
-        
-        .status-item .value {
-            font-size: 1.5em;
-            font-weight: bold;
-        }
-        
-        .controls {
-            background: white;
-            padding: 30px;
-            border-radius: 15px;
-            box-shadow: 0 10px 30px rgba(0, 0, 0, 0.2);
-            margin-bottom: 30px;
-        }
-        
-        .controls h2 {
-            color: #667eea;
-            margin-bottom: 20px;
-            font-size: 1.8em;
-        }
-        
-        .pin-grid {
-            display: grid;
-            grid-template-columns: repeat(auto-fill, minmax(280px, 1fr));
-            gap: 20px;
-            margin-bottom: 30px;
-        }
-        
-        .pin-card {
-            background: #f8f9fa;
-            padding: 20px;
-            border-radius: 10px;
-            border: 2px solid #e9ecef;
-            transition: all 0.3s ease;
-        }
-        
-        .pin-card:hover {
-            border-color: #667eea;
-            box-shadow: 0 5px 15px rgba(102, 126, 234, 0.2);
-        }
-        
-        .pin-header {
-            display: flex;
-            justify-content: space-between;
-            align-items: center;
-            margin-bottom: 15px;
-        }
-        
-        .pin-header-left {
-            display: flex;
-            align-items: center;
-            gap: 10px;
-        }
-        
-        .pin-number {
-            font-size: 1.5em;
-            font-weight: bold;
-            color: #667eea;
-        }
-        
-        .pin-mode {
-            font-size: 0.9em;
-            padding: 5px 10px;
-            background: #667eea;
-            color: white;
-            border-radius: 5px;
-        }
-        
-        .btn-remove {
-            background: none;
-            border: none;
-            color: #dc3545;
-            font-size: 1.5em;
-            cursor: pointer;
-            padding: 5px 10px;
-            transition: all 0.3s ease;
-            line-height: 1;
-        }
-        
-        .btn-remove:hover {
-            color: #c82333;
-            transform: scale(1.2);
-        }
-        
-        .button-group {
-            display: flex;
-            gap: 10px;
-            margin-bottom: 15px;
-        }
-        
-        button {
-            flex: 1;
-            padding: 12px;
-            border: none;
-            border-radius: 8px;
-            font-size: 1em;
-            font-weight: 600;
-            cursor: pointer;
-            transition: all 0.3s ease;
-            text-transform: uppercase;
-            letter-spacing: 0.5px;
-        }
-        
-        .btn-on {
-            background: #28a745;
-            color: white;
-        }
-        
-        .btn-on:hover {
-            background: #218838;
-            transform: translateY(-2px);
-            box-shadow: 0 5px 15px rgba(40, 167, 69, 0.3);
-        }
-        
-        .btn-off {
-            background: #dc3545;
-            color: white;
-        }
-        
-        .btn-off:hover {
-            background: #c82333;
-            transform: translateY(-2px);
-            box-shadow: 0 5px 15px rgba(220, 53, 69, 0.3);
-        }
-        
-        .btn-toggle {
-            background: #667eea;
-            color: white;
-        }
-        
-        .btn-toggle:hover {
-            background: #5568d3;
-            transform: translateY(-2px);
-            box-shadow: 0 5px 15px rgba(102, 126, 234, 0.3);
-        }
-        
-        .btn-reset {
-            background: #ff6b6b;
-            color: white;
-            width: 100%;
-            padding: 15px;
-            font-size: 1.1em;
-        }
-        
-        .btn-reset:hover {
-            background: #ee5a52;
-            transform: translateY(-2px);
-            box-shadow: 0 5px 15px rgba(255, 107, 107, 0.3);
-        }
-        
-        .pwm-control {
-            margin-top: 15px;
-        }
-        
-        .pwm-slider {
-            width: 100%;
-            height: 8px;
-            border-radius: 5px;
-            background: #d3d3d3;
-            outline: none;
-            -webkit-appearance: none;
-            margin-bottom: 10px;
-        }
-        
-        .pwm-slider::-webkit-slider-thumb {
-            -webkit-appearance: none;
-            appearance: none;
-            width: 20px;
-            height: 20px;
-            border-radius: 50%;
-            background: #667eea;
-            cursor: pointer;
-        }
-        
-        .pwm-slider::-moz-range-thumb {
-            width: 20px;
-            height: 20px;
-            border-radius: 50%;
-            background: #667eea;
-            cursor: pointer;
-            border: none;
-        }
-        
-        .pwm-value {
-            text-align: center;
-            font-size: 1.2em;
-            font-weight: bold;
-            color: #667eea;
-        }
-        
-        .pin-state {
-            text-align: center;
-            padding: 10px;
-            border-radius: 5px;
-            font-weight: bold;
-            margin-top: 10px;
-        }
-        
-        .state-high {
-            background: #28a745;
-            color: white;
-        }
-        
-        .state-low {
-            background: #dc3545;
-            color: white;
-        }
-        
-        .add-pin {
-            background: white;
-            padding: 30px;
-            border-radius: 15px;
-            box-shadow: 0 10px 30px rgba(0, 0, 0, 0.2);
-            margin-bottom: 30px;
-        }
-        
-        .add-pin h2 {
-            color: #667eea;
-            margin-bottom: 20px;
-            font-size: 1.8em;
-        }
-        
-        .input-group {
-            display: flex;
-            gap: 10px;
-            margin-bottom: 15px;
-        }
-        
-        input[type="number"] {
-            flex: 1;
-            padding: 12px;
-            border: 2px solid #e9ecef;
-            border-radius: 8px;
-            font-size: 1em;
-            transition: border-color 0.3s ease;
-        }
-        
-        input[type="number"]:focus {
-            outline: none;
-            border-color: #667eea;
-        }
-        
-        .btn-add {
-            background: #667eea;
-            color: white;
-            padding: 12px 30px;
-        }
-        
-        .btn-add:hover {
-            background: #5568d3;
-            transform: translateY(-2px);
-            box-shadow: 0 5px 15px rgba(102, 126, 234, 0.3);
-        }
-        
-        .notification {
-            position: fixed;
-            top: 20px;
-            right: 20px;
-            padding: 15px 25px;
-            background: white;
-            border-radius: 10px;
-            box-shadow: 0 10px 30px rgba(0, 0, 0, 0.3);
-            z-index: 1000;
-            display: none;
-            animation: slideIn 0.3s ease;
-        }
-        
-        @keyframes slideIn {
-            from {
-                transform: translateX(400px);
-                opacity: 0;
-            }
-            to {
-                transform: translateX(0);
-                opacity: 1;
-            }
-        }
-        
-        .notification.success {
-            border-left: 4px solid #28a745;
-        }
-        
-        .notification.error {
-            border-left: 4px solid #dc3545;
-        }
-        
-        @media (max-width: 768px) {
-            .header h1 {
-                font-size: 1.8em;
-            }
-            
-            .pin-grid {
-                grid-template-columns: 1fr;
-            }
-            
-            .status-bar {
-                grid-template-columns: repeat(2, 1fr);
-            }
-        }
-    </style>
-</head>
-<body>
-    <div class="container">
-        <div class="header">
-            <h1>🎛️ ESP32 Pin Controller</h1>
-            <p>Real-time GPIO control via web interface</p>
-        </div>
-        
-        <div class="status-bar">
-            <div class="status-item">
-                <div class="label">Free Heap</div>
-                <div class="value" id="freeHeap">-</div>
-            </div>
-            <div class="status-item">
-                <div class="label">Uptime</div>
-                <div class="value" id="uptime">-</div>
-            </div>
-            <div class="status-item">
-                <div class="label">CPU Freq</div>
-                <div class="value" id="cpuFreq">-</div>
-            </div>
-            <div class="status-item">
-                <div class="label">Chip Model</div>
-                <div class="value" id="chipModel">-</div>
-            </div>
-        </div>
-        
-        <div class="add-pin">
-            <h2>Add Pin Control</h2>
-            <div class="input-group">
-                <input type="number" id="newPin" placeholder="Pin Number (e.g., 13)" min="0" max="39">
-                <button class="btn-add" onclick="addPin()">Add Digital Pin</button>
-                <button class="btn-add" onclick="addPWMPin()">Add PWM Pin</button>
-            </div>
-        </div>
-        
-        <div class="controls">
-            <h2>Pin Controls</h2>
-            <div class="pin-grid" id="pinGrid">
-                <!-- Pin cards will be added dynamically -->
-            </div>
-            <button class="btn-reset" onclick="resetAllPins()">🔄 Reset All Pins</button>
-        </div>
-    </div>
-    
-    <div class="notification" id="notification"></div>
-    
-    <script>
-        const pins = new Set();
-        
-        function showNotification(message, type = 'success') {
-            const notif = document.getElementById('notification');
-            notif.textContent = message;
-            notif.className = 'notification ' + type;
-            notif.style.display = 'block';
-            setTimeout(() => {
-                notif.style.display = 'none';
-            }, 3000);
-        }
-        
-        async function apiCall(url, method = 'GET') {
-            try {
-                const response = await fetch(url, { method });
-                const data = await response.json();
-                return data;
-            } catch (error) {
-                console.error('API call failed:', error);
-                showNotification('API call failed: ' + error.message, 'error');
-                return null;
-            }
-        }
-        
-        async function updateStatus() {
-            const data = await apiCall('/api/status');
-            if (data && data.success) {
-                document.getElementById('freeHeap').textContent = Math.round(data.freeHeap / 1024) + ' KB';
-                document.getElementById('uptime').textContent = formatUptime(data.uptime);
-                document.getElementById('cpuFreq').textContent = data.cpuFreq + ' MHz';
-                document.getElementById('chipModel').textContent = data.chipModel;
-            }
-        }
-        
-        function formatUptime(seconds) {
-            const hours = Math.floor(seconds / 3600);
-            const minutes = Math.floor((seconds % 3600) / 60);
-            const secs = seconds % 60;
-            return `${hours}h ${minutes}m ${secs}s`;
-        }
-        
-        async function setPin(pin, value) {
-            const data = await apiCall(`/api/pin/set?pin=${pin}&value=${value}`, 'POST');
-            if (data && data.success) {
-                showNotification(`Pin ${pin} set to ${value ? 'HIGH' : 'LOW'}`);
-                updatePinState(pin, value);
-            } else {
-                showNotification('Failed to set pin', 'error');
-            }
-        }
-        
-        async function togglePin(pin) {
-            const data = await apiCall(`/api/pin/toggle?pin=${pin}`, 'POST');
-            if (data && data.success) {
-                showNotification(`Pin ${pin} toggled to ${data.newValue ? 'HIGH' : 'LOW'}`);
-                updatePinState(pin, data.newValue);
-            } else {
-                showNotification('Failed to toggle pin', 'error');
-            }
-        }
-        
-        async function setPWM(pin, value) {
-            const data = await apiCall(`/api/pin/pwm?pin=${pin}&value=${value}`, 'POST');
-            if (data && data.success) {
-                showNotification(`Pin ${pin} PWM set to ${value}`);
-            } else {
-                showNotification('Failed to set PWM', 'error');
-            }
-        }
-        
-        async function resetAllPins() {
-            if (!confirm('Reset all pins to LOW?')) return;
-            
-            const data = await apiCall('/api/reset', 'POST');
-            if (data && data.success) {
-                showNotification('All pins reset successfully');
-                // Update all pin states
-                pins.forEach(pin => updatePinState(pin, 0));
-            } else {
-                showNotification('Failed to reset pins', 'error');
-            }
-        }
-        
-        function updatePinState(pin, value) {
-            const stateDiv = document.getElementById(`state-${pin}`);
-            if (stateDiv) {
-                stateDiv.textContent = value ? 'HIGH' : 'LOW';
-                stateDiv.className = 'pin-state ' + (value ? 'state-high' : 'state-low');
-            }
-        }
-        
-        function removePin(pin) {
-            if (!confirm(`Remove pin ${pin} from interface?`)) return;
-            
-            const card = document.getElementById(`card-${pin}`);
-            if (card) {
-                card.remove();
-                pins.delete(pin);
-                showNotification(`Pin ${pin} removed from interface`);
-            }
-        }
-        
-        function addPin() {
-            const pinInput = document.getElementById('newPin');
-            const pin = parseInt(pinInput.value);
-            
-            if (isNaN(pin) || pin < 0 || pin > 39) {
-                showNotification('Invalid pin number', 'error');
-                return;
-            }
-            
-            if (pins.has(pin)) {
-                showNotification('Pin already added', 'error');
-                return;
-            }
-            
-            pins.add(pin);
-            createPinCard(pin, false);
-            pinInput.value = '';
-            showNotification(`Pin ${pin} added`);
-        }
-        
-        function addPWMPin() {
-            const pinInput = document.getElementById('newPin');
-            const pin = parseInt(pinInput.value);
-            
-            if (isNaN(pin) || pin < 0 || pin > 39) {
-                showNotification('Invalid pin number', 'error');
-                return;
-            }
-            
-            if (pins.has(pin)) {
-                showNotification('Pin already added', 'error');
-                return;
-            }
-            
-            pins.add(pin);
-            createPinCard(pin, true);
-            pinInput.value = '';
-            showNotification(`PWM Pin ${pin} added`);
-        }
-        
-        function createPinCard(pin, isPWM) {
-            const grid = document.getElementById('pinGrid');
-            const card = document.createElement('div');
-            card.className = 'pin-card';
-            card.id = `card-${pin}`;
-            
-            if (isPWM) {
-                card.innerHTML = `
-                    <div class="pin-header">
-                        <div class="pin-header-left">
-                            <div class="pin-number">Pin ${pin}</div>
-                            <div class="pin-mode">PWM</div>
-                        </div>
-                        <button class="btn-remove" onclick="removePin(${pin})" title="Remove pin">✕</button>
-                    </div>
-                    <div class="pwm-control">
-                        <input type="range" class="pwm-slider" min="0" max="255" value="0" 
-                               oninput="document.getElementById('pwm-val-${pin}').textContent = this.value; setPWM(${pin}, this.value)">
-                        <div class="pwm-value">Value: <span id="pwm-val-${pin}">0</span></div>
-                    </div>
-                `;
-            } else {
-                card.innerHTML = `
-                    <div class="pin-header">
-                        <div class="pin-header-left">
-                            <div class="pin-number">Pin ${pin}</div>
-                            <div class="pin-mode">DIGITAL</div>
-                        </div>
-                        <button class="btn-remove" onclick="removePin(${pin})" title="Remove pin">✕</button>
-                    </div>
-                    <div class="button-group">
-                        <button class="btn-on" onclick="setPin(${pin}, 1)">ON</button>
-                        <button class="btn-off" onclick="setPin(${pin}, 0)">OFF</button>
-                    </div>
-                    <button class="btn-toggle" onclick="togglePin(${pin})">Toggle</button>
-                    <div class="pin-state state-low" id="state-${pin}">LOW</div>
-                `;
-            }
-            
-            grid.appendChild(card);
-        }
-        
-        // Initialize with some common pins
-        [13, 12, 14, 27].forEach(pin => createPinCard(pin, false));
-        
-        // Update status every 2 seconds
-        updateStatus();
-        setInterval(updateStatus, 2000);
-    </script>
-</body>
-</html>
-)rawliteral";
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->setCode(code);
+
+    JsonWriter json(*response);
+    json.beginObject().field("success", success).field("message", message);
+    if (data != nullptr)
+    {
+        json.field("data", data);
+    }
+    json.endObject();
+
+    request->send(response);
 }
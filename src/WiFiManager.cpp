@@ -1,63 +1,176 @@
 #include "WiFiManager.h"
-#include "WatchdogManager.h"
+#include "Metrics.h"
+#include <Preferences.h>
+#include <esp_wifi.h>
+#include "Logger.h"
 
-// External reference to global watchdog manager
-extern WatchdogManager watchdogManager;
+// Latency histograms, defined in main.cpp
+extern Metrics metrics;
+
+// Log queue, defined in main.cpp
+extern Logger logger;
+
+// NVS namespace and key of the cached access point
+static const char *NVS_NAMESPACE = "wifi";
+static const char *NVS_KEY = "ap";
+
+WiFiManager *WiFiManager::_instance = nullptr;
 
 WiFiManager::WiFiManager()
-    : _currentNetworkIndex(-1),
-      _lastConnectionAttempt(0),
+    : _state(State::WAITING),
+      _stateSince(0),
+      _outageStartUs(0),
+      _events(0),
+      _candidateCount(0),
+      _nextCandidate(0),
+      _cachedAPValid(false),
+      _fastConnect(false),
+      _currentNetworkIndex(-1),
       _lastConnectionCheck(0),
-      _isConnected(false),
-      _consecutiveFailures(0)
+      _consecutiveFailures(0),
+      _sleepMode(WIFI_PS_MIN_MODEM),
+      _listenInterval(3),
+      _txPower(WIFI_POWER_19_5dBm)
 {
 }
 
 void WiFiManager::begin()
 {
+    _instance = this;
+    _outageStartUs = Metrics::now();
+
     WiFi.mode(WIFI_STA);
     WiFi.setAutoReconnect(false); // We'll handle reconnection manually
     WiFi.persistent(false);       // Don't save WiFi config to flash
+    WiFi.onEvent(handleEvent);
+    WiFi.setSleep(_sleepMode);
+    WiFi.setTxPower(_txPower);
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[WiFi] WiFi Manager initialized");
-    Serial.printf("[WiFi] Found %d configured networks\n", WIFI_NETWORK_COUNT);
-#endif
+    LOG_INFO("WiFi", "WiFi Manager initialized");
+    LOG_INFO("WiFi", "Found %d configured networks", WIFI_NETWORK_COUNT);
 
-    // Try to connect to best available network
-    connectToNextNetwork();
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, true))
+    {
+        _cachedAPValid = prefs.getBytes(NVS_KEY, &_cachedAP, sizeof(_cachedAP)) == sizeof(_cachedAP);
+        _cachedAP.ssid[sizeof(_cachedAP.ssid) - 1] = '\0';
+        prefs.end();
+    }
+
+    startConnecting();
 }
 
-void WiFiManager::loop()
+void WiFiManager::handleEvent(WiFiEvent_t event, WiFiEventInfo_t info)
 {
-    unsigned long currentMillis = millis();
+    if (_instance == nullptr)
+    {
+        return;
+    }
 
-    // Periodic connection check
-    if (currentMillis - _lastConnectionCheck >= CONNECTION_CHECK_INTERVAL)
+    switch (event)
     {
-        _lastConnectionCheck = currentMillis;
-        checkConnection();
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        _instance->_events.fetch_or(EVENT_GOT_IP);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        // Our own disconnect() before a new attempt is not a failure of it
+        if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE)
+        {
+            _instance->_events.fetch_or(EVENT_DISCONNECTED);
+        }
+        break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        _instance->_events.fetch_or(EVENT_DISCONNECTED);
+        break;
+    case ARDUINO_EVENT_WIFI_SCAN_DONE:
+        _instance->_events.fetch_or(EVENT_SCAN_DONE);
+        break;
+    default:
+        break;
     }
+}
 
-    // Handle reconnection if disconnected
-    if (!_isConnected &&
-        (currentMillis - _lastConnectionAttempt >= WIFI_RECONNECT_INTERVAL))
+void WiFiManager::loop()
+{
+    unsigned long currentMillis = millis();
+    uint32_t events = _events.exchange(0);
+
+    switch (_state)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WiFi] Attempting to reconnect...");
-#endif
-        connectToNextNetwork();
+    case State::SCANNING:
+        if ((events & EVENT_SCAN_DONE) || currentMillis - _stateSince >= WIFI_SCAN_TIMEOUT)
+        {
+            buildCandidates(WiFi.scanComplete());
+            connectToNextCandidate();
+        }
+        break;
+
+    case State::CONNECTING:
+        if (events & EVENT_GOT_IP)
+        {
+            _currentNetworkIndex = _candidates[_nextCandidate - 1];
+            _consecutiveFailures = 0;
+            enterState(State::CONNECTED);
+            metrics.record(Metrics::WIFI_CONNECT, Metrics::now() - _outageStartUs);
+            updateCachedAP();
+
+            LOG_INFO("WiFi", "Connected successfully!");
+            LOG_INFO("WiFi", "IP Address: %s", WiFi.localIP().toString().c_str());
+            LOG_INFO("WiFi", "Signal Strength: %d dBm", WiFi.RSSI());
+        }
+        else if ((events & EVENT_DISCONNECTED) || currentMillis - _stateSince >= WIFI_CONNECT_TIMEOUT)
+        {
+            LOG_ERROR("WiFi", "Failed to connect to: %s", WIFI_NETWORKS[_candidates[_nextCandidate - 1]].ssid);
+            if (_fastConnect)
+            {
+                // The access point moved or is gone, find the network again
+                _cachedAPValid = false;
+                startScan();
+            }
+            else
+            {
+                connectToNextCandidate();
+            }
+        }
+        break;
+
+    case State::CONNECTED:
+        if (events & EVENT_DISCONNECTED)
+        {
+            LOG_WARNING("WiFi", "Connection lost!");
+            _outageStartUs = Metrics::now();
+            startConnecting();
+        }
+        else if (currentMillis - _lastConnectionCheck >= CONNECTION_CHECK_INTERVAL)
+        {
+            _lastConnectionCheck = currentMillis;
+            checkConnection();
+        }
+        break;
+
+    case State::WAITING:
+        if (currentMillis - _stateSince >= WIFI_RECONNECT_INTERVAL)
+        {
+            LOG_INFO("WiFi", "Attempting to reconnect...");
+            startScan();
+        }
+        break;
     }
 }
 
 bool WiFiManager::isConnected()
 {
-    return _isConnected && (WiFi.status() == WL_CONNECTED);
+    return _state == State::CONNECTED && (WiFi.status() == WL_CONNECTED);
+}
+
+bool WiFiManager::isConnecting() const
+{
+    return _state == State::SCANNING || _state == State::CONNECTING;
 }
 
 String WiFiManager::getCurrentSSID()
 {
-    if (_isConnected)
+    if (_state == State::CONNECTED)
     {
         return WiFi.SSID();
     }
@@ -66,7 +179,7 @@ String WiFiManager::getCurrentSSID()
 
 String WiFiManager::getIPAddress()
 {
-    if (_isConnected)
+    if (_state == State::CONNECTED)
     {
         return WiFi.localIP().toString();
     }
@@ -75,7 +188,7 @@ String WiFiManager::getIPAddress()
 
 int WiFiManager::getSignalStrength()
 {
-    if (_isConnected)
+    if (_state == State::CONNECTED)
     {
         return WiFi.RSSI();
     }
@@ -84,25 +197,29 @@ int WiFiManager::getSignalStrength()
 
 void WiFiManager::reconnect()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[WiFi] Manual reconnect requested");
-#endif
+    LOG_INFO("WiFi", "Manual reconnect requested");
 
+    if (_state == State::CONNECTED)
+    {
+        _outageStartUs = Metrics::now();
+    }
     WiFi.disconnect();
-    _isConnected = false;
-    connectToNextNetwork();
+    startScan();
 }
 
 String WiFiManager::getStatusString()
 {
-    if (_isConnected)
+    switch (_state)
     {
+    case State::CONNECTED:
         return String("Connected to ") + getCurrentSSID() +
                " (IP: " + getIPAddress() +
                ", RSSI: " + String(getSignalStrength()) + " dBm)";
-    }
-    else
-    {
+    case State::SCANNING:
+        return "Scanning for networks";
+    case State::CONNECTING:
+        return String("Connecting to ") + WIFI_NETWORKS[_candidates[_nextCandidate - 1]].ssid;
+    default:
         return "Disconnected";
     }
 }
@@ -112,167 +229,206 @@ int WiFiManager::getCurrentNetworkIndex()
     return _currentNetworkIndex;
 }
 
-bool WiFiManager::connectToNetwork(int networkIndex)
+void WiFiManager::enterState(State state)
 {
-    if (networkIndex < 0 || networkIndex >= WIFI_NETWORK_COUNT)
+    _state = state;
+    _stateSince = millis();
+}
+
+void WiFiManager::startConnecting()
+{
+    if (!connectToCachedAP())
     {
-        return false;
+        startScan();
     }
+}
 
-    const WiFiCredentials &creds = WIFI_NETWORKS[networkIndex];
+bool WiFiManager::connectToCachedAP()
+{
+    if (!_cachedAPValid)
+    {
+        return false;
+    }
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WiFi] Attempting to connect to: %s\n", creds.ssid);
-#endif
+    // Only if the network is still configured
+    for (int i = 0; i < WIFI_NETWORK_COUNT; i++)
+    {
+        if (strncmp(WIFI_NETWORKS[i].ssid, _cachedAP.ssid, sizeof(_cachedAP.ssid)) == 0)
+        {
+            LOG_DEBUG("WiFi", "Fast reconnect to %s (channel %d)", _cachedAP.ssid, _cachedAP.channel);
+            _candidates[0] = i;
+            _candidateCount = 1;
+            _nextCandidate = 1;
+            _fastConnect = true;
+
+            WiFi.disconnect();
+            _events.fetch_and(~static_cast<uint32_t>(EVENT_GOT_IP | EVENT_DISCONNECTED));
+            beginConnection(WIFI_NETWORKS[i].ssid, WIFI_NETWORKS[i].password, _cachedAP.channel, _cachedAP.bssid);
+            enterState(State::CONNECTING);
+            return true;
+        }
+    }
 
-    WiFi.disconnect();
-    delay(100);
+    _cachedAPValid = false;
+    return false;
+}
 
-    WiFi.begin(creds.ssid, creds.password);
+void WiFiManager::updateCachedAP()
+{
+    CachedAP current;
+    memset(&current, 0, sizeof(current));
+    strlcpy(current.ssid, WIFI_NETWORKS[_currentNetworkIndex].ssid, sizeof(current.ssid));
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid == nullptr)
+    {
+        return;
+    }
+    memcpy(current.bssid, bssid, sizeof(current.bssid));
+    current.channel = WiFi.channel();
 
-    unsigned long startAttempt = millis();
-    while (WiFi.status() != WL_CONNECTED &&
-           millis() - startAttempt < WIFI_CONNECT_TIMEOUT)
+    // Written only when the access point changes, not on every reconnect
+    if (_cachedAPValid && memcmp(&current, &_cachedAP, sizeof(current)) == 0)
     {
-        delay(100);
-        // Feed the watchdog during WiFi connection to prevent timeout
-        watchdogManager.feed();
+        return;
     }
 
-    if (WiFi.status() == WL_CONNECTED)
+    Preferences prefs;
+    if (prefs.begin(NVS_NAMESPACE, false))
     {
-        _isConnected = true;
-        _currentNetworkIndex = networkIndex;
-        _consecutiveFailures = 0;
+        _cachedAPValid = prefs.putBytes(NVS_KEY, &current, sizeof(current)) == sizeof(current);
+        prefs.end();
+        _cachedAP = current;
+    }
+}
 
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[WiFi] Connected successfully!\n");
-        Serial.printf("[WiFi] IP Address: %s\n", WiFi.localIP().toString().c_str());
-        Serial.printf("[WiFi] Signal Strength: %d dBm\n", WiFi.RSSI());
-#endif
+void WiFiManager::startScan()
+{
+    _fastConnect = false;
 
-        return true;
-    }
-    else
+    LOG_DEBUG("WiFi", "Scanning for networks...");
+
+    _events.fetch_and(~static_cast<uint32_t>(EVENT_SCAN_DONE));
+    if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[WiFi] Failed to connect to: %s\n", creds.ssid);
-#endif
-        return false;
+        LOG_ERROR("WiFi", "Scan failed to start, trying networks in order");
+        buildCandidates(WIFI_SCAN_FAILED);
+        connectToNextCandidate();
+        return;
     }
+
+    enterState(State::SCANNING);
 }
 
-bool WiFiManager::connectToNextNetwork()
+void WiFiManager::buildCandidates(int scanCount)
 {
-    _lastConnectionAttempt = millis();
+    int rssi[MAX_WIFI_NETWORKS];
+    _candidateCount = 0;
+    _nextCandidate = 0;
 
-    // First, try to find the best network by scanning
-    int bestNetwork = findBestNetwork();
-
-    if (bestNetwork >= 0)
+    if (scanCount >= 0)
     {
-        if (connectToNetwork(bestNetwork))
-        {
-            return true;
-        }
+        LOG_DEBUG("WiFi", "Found %d networks", scanCount);
+    }
+    else
+    {
+        LOG_DEBUG("WiFi", "No scan results");
     }
 
-    // If scan-based connection failed, try each network in order
+    // Strongest signal of each configured network, -1000 if not seen
     for (int i = 0; i < WIFI_NETWORK_COUNT; i++)
     {
-        if (connectToNetwork(i))
+        rssi[i] = -1000;
+        for (int j = 0; j < scanCount; j++)
         {
-            return true;
+            if (WiFi.SSID(j) == WIFI_NETWORKS[i].ssid && WiFi.RSSI(j) > rssi[i])
+            {
+                rssi[i] = WiFi.RSSI(j);
+            }
         }
-    }
 
-    // All networks failed
-    _isConnected = false;
-    _consecutiveFailures++;
+        if (rssi[i] > -1000)
+        {
+            LOG_DEBUG("WiFi", "Found configured network: %s (RSSI: %d dBm)",
+                      WIFI_NETWORKS[i].ssid, rssi[i]);
+        }
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WiFi] All networks failed. Consecutive failures: %d\n",
-                  _consecutiveFailures);
-#endif
+        // Insertion sort, strongest first; unseen networks (maybe hidden)
+        // keep their configured order at the end
+        int pos = _candidateCount++;
+        while (pos > 0 && rssi[_candidates[pos - 1]] < rssi[i])
+        {
+            _candidates[pos] = _candidates[pos - 1];
+            pos--;
+        }
+        _candidates[pos] = i;
+    }
 
-    return false;
+    if (scanCount >= 0)
+    {
+        WiFi.scanDelete(); // Clean up scan results
+    }
 }
 
-int WiFiManager::findBestNetwork()
+void WiFiManager::connectToNextCandidate()
 {
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[WiFi] Scanning for networks...");
-#endif
-
-    int numNetworks = WiFi.scanNetworks();
-
-    if (numNetworks == 0)
+    if (_nextCandidate >= _candidateCount)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WiFi] No networks found");
-#endif
-        return -1;
+        // All networks failed
+        _consecutiveFailures++;
+        enterState(State::WAITING);
+
+        LOG_ERROR("WiFi", "All networks failed. Consecutive failures: %d",
+                  _consecutiveFailures);
+        return;
     }
 
-#if ENABLE_SERIAL_DEBUG
-    Serial.printf("[WiFi] Found %d networks\n", numNetworks);
-#endif
+    const WiFiCredentials &creds = WIFI_NETWORKS[_candidates[_nextCandidate++]];
+    _fastConnect = false;
 
-    int bestNetwork = -1;
-    int bestRSSI = -100;
+    LOG_DEBUG("WiFi", "Attempting to connect to: %s", creds.ssid);
 
-    // Find the strongest configured network
-    for (int i = 0; i < WIFI_NETWORK_COUNT; i++)
-    {
-        for (int j = 0; j < numNetworks; j++)
-        {
-            if (WiFi.SSID(j) == String(WIFI_NETWORKS[i].ssid))
-            {
-                int rssi = WiFi.RSSI(j);
-#if ENABLE_SERIAL_DEBUG
-                Serial.printf("[WiFi] Found configured network: %s (RSSI: %d dBm)\n",
-                              WIFI_NETWORKS[i].ssid, rssi);
-#endif
-
-                if (rssi > bestRSSI)
-                {
-                    bestRSSI = rssi;
-                    bestNetwork = i;
-                }
-            }
-        }
-    }
+    WiFi.disconnect();
+    _events.fetch_and(~static_cast<uint32_t>(EVENT_GOT_IP | EVENT_DISCONNECTED));
+    beginConnection(creds.ssid, creds.password);
+    enterState(State::CONNECTING);
+}
 
-    WiFi.scanDelete(); // Clean up scan results
+void WiFiManager::beginConnection(const char *ssid, const char *password, int32_t channel,
+                                  const uint8_t *bssid)
+{
+    WiFi.begin(ssid, password, channel, bssid);
 
-    if (bestNetwork >= 0)
+    // begin() rewrites the station config with the default listen interval;
+    // the association request that carries it is only sent after
+    // authentication, so setting it here still counts for this attempt
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK && config.sta.listen_interval != _listenInterval)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.printf("[WiFi] Best network: %s (RSSI: %d dBm)\n",
-                      WIFI_NETWORKS[bestNetwork].ssid, bestRSSI);
-#endif
+        config.sta.listen_interval = _listenInterval;
+        esp_wifi_set_config(WIFI_IF_STA, &config);
     }
-
-    return bestNetwork;
 }
 
-void WiFiManager::checkConnection()
+void WiFiManager::setPowerSave(wifi_ps_type_t sleep, uint16_t listenInterval, wifi_power_t txPower)
 {
-    bool currentlyConnected = (WiFi.status() == WL_CONNECTED);
+    _sleepMode = sleep;
+    _listenInterval = listenInterval;
+    _txPower = txPower;
 
-    if (_isConnected && !currentlyConnected)
+    // Before begin() they are applied when the station starts
+    if (WiFi.getMode() != WIFI_OFF)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WiFi] Connection lost!");
-#endif
-        _isConnected = false;
+        WiFi.setSleep(sleep);
+        WiFi.setTxPower(txPower);
     }
-    else if (!_isConnected && currentlyConnected)
+}
+
+void WiFiManager::checkConnection()
+{
+    if (WiFi.status() != WL_CONNECTED)
     {
-        // Reconnected (shouldn't normally happen with autoReconnect off)
-        _isConnected = true;
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[WiFi] Connection restored");
-#endif
+        LOG_WARNING("WiFi", "Connection lost!");
+        _outageStartUs = Metrics::now();
+        startConnecting();
     }
 }
@@ -21,180 +21,133 @@
 #include "WiFiManager.h"
 #include "WatchdogManager.h"
 #include "CommandParser.h"
+#include "CommandDispatcher.h"
 #include "PinController.h"
 #include "NetworkServer.h"
 #include "SerialCommandHandler.h"
 #include "WebServer.h"
 #include "TelegramNotifier.h"
+#include "StatusSnapshot.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "ServiceAdvertiser.h"
+#include "PowerManager.h"
+#include "AnalogSampler.h"
+#include "LoopScheduler.h"
 
 // Global instances
+Logger logger; // First, so it exists before anything logs
 WiFiManager wifiManager;
 WatchdogManager watchdogManager;
 CommandParser commandParser;
 PinController pinController;
+CommandDispatcher commandDispatcher(commandParser, pinController);
 NetworkServer *networkServer = nullptr;
 SerialCommandHandler *serialHandler = nullptr;
 WebServer *webServer = nullptr;
 TelegramNotifier *telegramNotifier = nullptr;
+StatusSnapshot statusSnapshot;
+Metrics metrics;
+ServiceAdvertiser serviceAdvertiser;
+PowerManager powerManager(wifiManager);
+AnalogSampler analogSampler;
+LoopScheduler loopScheduler(watchdogManager);
+
+// Scheduler id of the analog task, triggered by each finished block
+int analogTask = -1;
+
+// Scheduler id of the UDP task, triggered by each received datagram
+int udpTask = -1;
 
 // Status LED control
 unsigned long lastLEDBlink = 0;
 int ledState = LOW;
 int ledBlinkInterval = LED_BLINK_CONNECTING;
 
-// Heartbeat for periodic status updates
-unsigned long lastHeartbeat = 0;
+// WiFi state seen by the previous loop pass
+bool networkUp = false;
 
 // Restart flag (set by RESET command)
 bool restartRequested = false;
 unsigned long restartTime = 0;
 
-// Restart callback for serial command handler
+// Restart callback for the RESET command
 void requestRestart(unsigned long delayMs)
 {
     restartRequested = true;
     restartTime = millis() + delayMs;
 }
 
-void setup()
-{
-// Initialize serial communication
-#if ENABLE_SERIAL_DEBUG
-    Serial.begin(SERIAL_BAUD_RATE);
-    while (!Serial && millis() < 3000)
-        ; // Wait up to 3 seconds for serial
-    Serial.println();
-    Serial.println("========================================");
-    Serial.println("  ESP32 Generic Pin Controller");
-    Serial.println("========================================");
-    Serial.println();
-#endif
-
-// Initialize status LED
-#if STATUS_LED_PIN >= 0
-    pinMode(STATUS_LED_PIN, OUTPUT);
-    digitalWrite(STATUS_LED_PIN, LOW);
-#endif
-
-// Initialize watchdog manager
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Main] Initializing Watchdog Manager...");
-#endif
-    watchdogManager.begin();
-
-// Initialize pin controller
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Main] Initializing Pin Controller...");
-#endif
-    pinController.begin();
-
-// Initialize serial command handler
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Main] Initializing Serial Command Handler...");
-#endif
-    serialHandler = new SerialCommandHandler(commandParser, pinController, wifiManager, watchdogManager);
-    serialHandler->setRestartCallback(requestRestart);
+// Main loop tasks, registered with loopScheduler at the end of setup()
 
-// Initialize WiFi manager
-#if ENABLE_SERIAL_DEBUG
-    Serial.println("[Main] Initializing WiFi Manager...");
-#endif
-    wifiManager.begin();
+void runQueuedCommands()
+{
+    // Commands queued by the AsyncTCP, web and Telegram tasks
+    commandDispatcher.loop();
+}
 
-    // Wait a bit for WiFi to connect
-    unsigned long wifiStartTime = millis();
-    while (!wifiManager.isConnected() && millis() - wifiStartTime < WIFI_CONNECT_TIMEOUT)
+void runSerialCommands()
+{
+    if (serialHandler != nullptr)
     {
-        wifiManager.loop();
-        watchdogManager.feed();
-        delay(100);
+        serialHandler->processSerialCommands();
     }
+}
 
-    // Initialize network server (only if WiFi is connected)
-    if (wifiManager.isConnected())
-    {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Main] Initializing Network Server...");
-#endif
-
-        networkServer = new NetworkServer(commandParser, pinController);
-        networkServer->begin();
-
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Main] Initializing Web Server...");
-#endif
-
-        webServer = new WebServer(pinController, 80);
-        webServer->begin();
-
-#if ENABLE_TELEGRAM_NOTIFICATIONS
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Main] Initializing Telegram Notifier...");
-#endif
-        telegramNotifier = new TelegramNotifier();
-        telegramNotifier->begin(&watchdogManager);
+void runPins()
+{
+    // PWM fades, timers and debounced input events
+    pinController.loop();
+}
 
-        // Queue IP address notification (will be sent in loop to avoid blocking)
-        telegramNotifier->queueIPNotification(wifiManager.getIPAddress(), wifiManager.getCurrentSSID());
-#endif
+uint32_t pinsIdleMs(uint32_t maxMs)
+{
+    // Wake for the next fade step or timer rather than the profile's wait
+    return pinController.idleTimeMs(maxMs);
+}
 
-        ledBlinkInterval = LED_BLINK_CONNECTED;
+void runNetworkServer()
+{
+    // Also while disconnected, so scheduled UDP commands still apply
+    networkServer->loop();
+}
 
-#if ENABLE_SERIAL_DEBUG
-        Serial.println();
-        Serial.println("========================================");
-        Serial.println("  System Ready!");
-        Serial.println("========================================");
-        Serial.println(wifiManager.getStatusString());
-        Serial.printf("TCP Server: %s:%d\n", wifiManager.getIPAddress().c_str(), TCP_SERVER_PORT);
-        Serial.printf("UDP Server: %s:%d\n", wifiManager.getIPAddress().c_str(), UDP_SERVER_PORT);
-        Serial.printf("Web Server: http://%s/\n", wifiManager.getIPAddress().c_str());
-        Serial.printf("Web Server: http://esp32-controller.local/\n");
-        Serial.println("========================================");
-        Serial.println();
-#endif
-    }
-    else
-    {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Main] WARNING: WiFi not connected, server not started");
-        Serial.println("[Main] Will retry connection in background");
-#endif
+void runUDP()
+{
+    // Datagrams queued by the AsyncUDP task
+    networkServer->handleUDP();
+}
 
-        ledBlinkInterval = LED_BLINK_ERROR;
-        watchdogManager.registerError("Initial WiFi connection failed");
-    }
+void runWebServer()
+{
+    webServer->loop();
 }
 
-void loop()
+void runAnalog()
 {
-    // Feed the watchdog
-    watchdogManager.feed();
+    // Stream analog blocks finished by the sampler task
+    analogSampler.loop();
+}
 
-    // Handle WiFi connection
+void runWiFi()
+{
     wifiManager.loop();
 
-    // Initialize server if WiFi just connected and server not yet started
-    if (wifiManager.isConnected() && networkServer == nullptr)
+    // Announce each (re)connect; the servers themselves keep running
+    bool connected = wifiManager.isConnected();
+    if (connected && !networkUp)
     {
-#if ENABLE_SERIAL_DEBUG
-        Serial.println("[Main] WiFi connected, starting servers...");
-#endif
-
-        networkServer = new NetworkServer(commandParser, pinController);
-        networkServer->begin();
-
-        webServer = new WebServer(pinController, 80);
-        webServer->begin();
+        LOG_INFO("Main", "WiFi connected");
+        networkServer->onNetworkUp();
+        serviceAdvertiser.begin();
 
 #if ENABLE_TELEGRAM_NOTIFICATIONS
         if (telegramNotifier == nullptr)
         {
-#if ENABLE_SERIAL_DEBUG
-            Serial.println("[Main] Initializing Telegram Notifier...");
-#endif
+            LOG_INFO("Main", "Initializing Telegram Notifier...");
             telegramNotifier = new TelegramNotifier();
-            telegramNotifier->begin(&watchdogManager);
+            telegramNotifier->setCommandDispatcher(&commandDispatcher);
+            telegramNotifier->begin();
         }
 
         // Reset notification flag for new connection and queue IP notification
@@ -205,105 +158,204 @@ void loop()
         }
 #endif
 
-        ledBlinkInterval = LED_BLINK_CONNECTED;
         watchdogManager.clearErrors();
 
-#if ENABLE_SERIAL_DEBUG
-        Serial.println(wifiManager.getStatusString());
-        Serial.printf("TCP Server: %s:%d\n", wifiManager.getIPAddress().c_str(), TCP_SERVER_PORT);
-        Serial.printf("UDP Server: %s:%d\n", wifiManager.getIPAddress().c_str(), UDP_SERVER_PORT);
-        Serial.printf("Web Server: http://%s/\n", wifiManager.getIPAddress().c_str());
-#endif
-    }
-
-    // Handle network server if WiFi is connected
-    if (wifiManager.isConnected() && networkServer != nullptr)
-    {
-        networkServer->loop();
-        ledBlinkInterval = LED_BLINK_CONNECTED;
+        if (logger.enabled(LogLevel::INFO))
+        {
+            String ip = wifiManager.getIPAddress();
+            LOG_INFO("Main", "%s", wifiManager.getStatusString().c_str());
+            LOG_INFO("Main", "TCP Server: %s:%d", ip.c_str(), TCP_SERVER_PORT);
+            LOG_INFO("Main", "UDP Server: %s:%d", ip.c_str(), UDP_SERVER_PORT);
+            LOG_INFO("Main", "Web Server: http://%s/", ip.c_str());
+        }
     }
-    else
+    else if (!connected && networkUp)
     {
-        ledBlinkInterval = LED_BLINK_ERROR;
-
-        // Clean up server if WiFi disconnected
-        if (!wifiManager.isConnected() && networkServer != nullptr)
-        {
-#if ENABLE_SERIAL_DEBUG
-            Serial.println("[Main] WiFi disconnected, stopping servers...");
-#endif
-            delete networkServer;
-            networkServer = nullptr;
-
-            delete webServer;
-            webServer = nullptr;
+        LOG_INFO("Main", "WiFi disconnected, servers wait for reconnect");
 
 #if ENABLE_TELEGRAM_NOTIFICATIONS
-            // Keep Telegram instance but reset notification flag
-            if (telegramNotifier != nullptr)
-            {
-                telegramNotifier->resetNotificationFlag();
-            }
-#endif
+        // Keep Telegram instance but reset notification flag
+        if (telegramNotifier != nullptr)
+        {
+            telegramNotifier->resetNotificationFlag();
         }
+#endif
     }
+    networkUp = connected;
 
-#if ENABLE_TELEGRAM_NOTIFICATIONS
-    // Handle Telegram notifications if WiFi is connected
-    if (wifiManager.isConnected() && telegramNotifier != nullptr)
+    if (connected)
     {
-        telegramNotifier->loop();
+        ledBlinkInterval = LED_BLINK_CONNECTED;
     }
-#endif
-
-    // Handle serial commands
-    if (serialHandler != nullptr)
+    else
     {
-        serialHandler->processSerialCommands();
+        ledBlinkInterval = wifiManager.isConnecting() ? LED_BLINK_CONNECTING : LED_BLINK_ERROR;
     }
+}
 
-// Handle status LED
+void runStatusSnapshot()
+{
+    // Refresh the status snapshot shared by every front-end
+    statusSnapshot.update(wifiManager, watchdogManager,
+                          networkServer != nullptr ? networkServer->getConnectedClients() : 0);
+}
+
+void runStatusLED()
+{
 #if STATUS_LED_PIN >= 0
     unsigned long currentMillis = millis();
-    if (currentMillis - lastLEDBlink >= ledBlinkInterval)
+    if (currentMillis - lastLEDBlink >= static_cast<unsigned long>(ledBlinkInterval))
     {
         lastLEDBlink = currentMillis;
         ledState = (ledState == LOW) ? HIGH : LOW;
         digitalWrite(STATUS_LED_PIN, ledState);
     }
 #endif
+}
 
-// Periodic heartbeat
-#if ENABLE_SERIAL_DEBUG && HEARTBEAT_INTERVAL > 0
-    if (millis() - lastHeartbeat >= HEARTBEAT_INTERVAL)
+void runHeartbeat()
+{
+    if (logger.enabled(LogLevel::INFO))
     {
-        lastHeartbeat = millis();
-        Serial.println();
-        Serial.println("--- Heartbeat ---");
-        Serial.printf("Uptime: %lu seconds\n", watchdogManager.getUptimeSeconds());
-        Serial.println(wifiManager.getStatusString());
-        if (networkServer != nullptr)
-        {
-            Serial.printf("TCP Clients: %d\n", networkServer->getConnectedClients());
-        }
-        Serial.printf("Free Heap: %d bytes\n", ESP.getFreeHeap());
-        Serial.println("-----------------");
-        Serial.println();
+        LOG_INFO("Main", "Heartbeat: uptime %lu s, %s, %d TCP clients, %u bytes free heap, %lu loop overruns",
+                 watchdogManager.getUptimeSeconds(), wifiManager.getStatusString().c_str(),
+                 networkServer != nullptr ? networkServer->getConnectedClients() : 0,
+                 static_cast<unsigned>(ESP.getFreeHeap()),
+                 static_cast<unsigned long>(loopScheduler.getOverruns()));
     }
-#endif
+}
+
+void runWatchdog()
+{
+    // Feed the watchdog
+    watchdogManager.feed();
 
     // Handle restart request (from RESET command)
     if (restartRequested && millis() >= restartTime)
     {
+        pinController.flushState();
         watchdogManager.restart("User requested restart");
     }
 
     // Check if watchdog manager recommends restart
     if (watchdogManager.shouldRestart())
     {
+        pinController.flushState();
         watchdogManager.restart("Automatic restart due to errors");
     }
+}
+
+void wakeForAnalog()
+{
+    loopScheduler.trigger(analogTask);
+}
+
+void wakeForUDP()
+{
+    loopScheduler.trigger(udpTask);
+}
+
+void registerLoopTasks()
+{
+    loopScheduler.begin();
+
+    // Commands first, and again between every other task
+    loopScheduler.add("commands", runQueuedCommands, LoopPriority::COMMAND);
+    loopScheduler.add("serial", runSerialCommands, LoopPriority::COMMAND);
+
+    int pinsTask = loopScheduler.add("pins", runPins, LoopPriority::IO);
+    loopScheduler.setIdleFunction(pinsTask, pinsIdleMs);
+    udpTask = loopScheduler.add("udp", runUDP, LoopPriority::IO, LoopScheduler::ON_TRIGGER);
+    networkServer->setPacketReadyHandler(wakeForUDP);
+    loopScheduler.trigger(udpTask); // Datagrams that arrived since begin()
+    loopScheduler.add("network", runNetworkServer, LoopPriority::IO);
+    loopScheduler.add("web", runWebServer, LoopPriority::IO);
+    analogTask = loopScheduler.add("analog", runAnalog, LoopPriority::IO, LoopScheduler::ON_TRIGGER);
+    analogSampler.setBlockReadyHandler(wakeForAnalog);
+
+    loopScheduler.add("wifi", runWiFi, LoopPriority::HOUSEKEEPING);
+    loopScheduler.add("status", runStatusSnapshot, LoopPriority::HOUSEKEEPING);
+    loopScheduler.add("watchdog", runWatchdog, LoopPriority::HOUSEKEEPING);
+    loopScheduler.add("led", runStatusLED, LoopPriority::HOUSEKEEPING, LED_UPDATE_INTERVAL_MS);
+#if ENABLE_SERIAL_DEBUG && HEARTBEAT_INTERVAL > 0
+    loopScheduler.add("heartbeat", runHeartbeat, LoopPriority::HOUSEKEEPING, HEARTBEAT_INTERVAL);
+#endif
+}
+
+void setup()
+{
+// Initialize serial communication
+#if ENABLE_SERIAL_DEBUG
+    Serial.begin(SERIAL_BAUD_RATE);
+    while (!Serial && millis() < 3000)
+        ; // Wait up to 3 seconds for serial
+    Serial.println();
+    Serial.println("========================================");
+    Serial.println("  ESP32 Generic Pin Controller");
+    Serial.println("========================================");
+    Serial.println();
+
+    // Everything after the banner goes through the log queue
+    logger.begin();
+#endif
+
+// Initialize pin controller first: it restores the saved outputs
+    LOG_INFO("Main", "Initializing Pin Controller...");
+    pinController.begin();
+
+// Initialize analog sampler (its task idles until an ANALOG command)
+    LOG_INFO("Main", "Initializing Analog Sampler...");
+    analogSampler.begin();
+
+// Initialize status LED
+#if STATUS_LED_PIN >= 0
+    pinMode(STATUS_LED_PIN, OUTPUT);
+    digitalWrite(STATUS_LED_PIN, LOW);
+#endif
+
+// Initialize watchdog manager
+    LOG_INFO("Main", "Initializing Watchdog Manager...");
+    watchdogManager.begin();
+
+// Initialize serial command handler
+    LOG_INFO("Main", "Initializing Serial Command Handler...");
+    commandDispatcher.setRestartHandler(requestRestart);
+    commandDispatcher.begin(); // setup() and loop() share a task, which owns the pins
+    serialHandler = new SerialCommandHandler(commandDispatcher, pinController, wifiManager, watchdogManager);
+
+// Initialize WiFi manager, with the radio settings of the saved power profile
+    LOG_INFO("Main", "Initializing WiFi Manager...");
+    powerManager.begin();
+    wifiManager.begin();
+
+    // First status snapshot, before any server can be asked for it
+    statusSnapshot.update(wifiManager, watchdogManager, 0, true);
+
+    // Servers listen from boot and stay up across reconnects, so they are
+    // serving as soon as WiFi has an address
+    LOG_INFO("Main", "Initializing Network Server...");
+    networkServer = new NetworkServer(commandDispatcher, pinController);
+    networkServer->begin();
+
+    LOG_INFO("Main", "Initializing Web Server...");
+    webServer = new WebServer(pinController, commandDispatcher, WEB_SERVER_PORT);
+    webServer->begin();
+
+    registerLoopTasks();
+
+    LOG_INFO("Main", "Connecting to WiFi in the background");
+}
+
+void loop()
+{
+    int64_t loopStart = Metrics::now();
+
+    loopScheduler.runOnce();
+
+    // Work done this pass, not counting the idle wait below
+    metrics.record(Metrics::LOOP, Metrics::now() - loopStart);
 
-    // Small delay to prevent tight loop
-    delay(10);
+    // Idle until the next periodic task is due, waking early for commands
+    // queued by other tasks and for triggered tasks
+    commandDispatcher.waitForWork(loopScheduler.idleTimeMs(powerManager.getLoopIdleMs()));
 }
@@ -0,0 +1,406 @@
+/**
+ * CommandDispatcher tests (env:native)
+ *
+ * Commands run directly on the owner task, and from other tasks through the
+ * job queue while the owner runs in its own task (a host thread in the
+ * shim), as the main loop does on the board:
+ *
+ *   pio test -e native -f test_dispatcher
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <atomic>
+#include "CommandDispatcher.h"
+#include "BufferPrint.h"
+
+namespace
+{
+    CommandParser parser;
+    PinController *pins = nullptr;
+    CommandDispatcher *dispatcher = nullptr;
+
+    char response[512];
+
+    // Owner task: begin() in its own task, then wait for work as loop() does
+    std::atomic<bool> ownerRunning(false);
+    std::atomic<bool> ownerStopped(true);
+    std::atomic<bool> ownerStalled(false); // Stop taking work, as a blocked loop would
+    std::atomic<bool> ownerParked(false);
+    std::atomic<uint32_t> ownerBusyMs(0); // Run this long before taking work, as a loop task would
+    TaskHandle_t ownerTask = nullptr;
+
+    void runOwner(void *)
+    {
+        dispatcher->begin();
+        ownerStopped = false;
+        ownerRunning = true;
+        while (ownerRunning)
+        {
+            ownerParked = ownerStalled.load();
+            if (ownerParked)
+            {
+                delay(1);
+                continue;
+            }
+            if (ownerBusyMs > 0)
+            {
+                delay(ownerBusyMs);
+            }
+            dispatcher->waitForWork(10);
+        }
+        ownerStopped = true;
+    }
+
+    void startOwnerTask()
+    {
+        xTaskCreatePinnedToCore(runOwner, "owner", 4096, nullptr, 1, &ownerTask, 1);
+        while (!ownerRunning)
+        {
+            delay(1);
+        }
+    }
+
+    void stopOwnerTask()
+    {
+        if (ownerTask == nullptr)
+        {
+            return;
+        }
+        ownerStalled = false;
+        ownerParked = false;
+        ownerBusyMs = 0;
+        ownerRunning = false;
+        xTaskNotifyGive(ownerTask);
+        while (!ownerStopped)
+        {
+            delay(1);
+        }
+        ownerTask = nullptr;
+    }
+
+    const char *process(const char *text, CommandSource source = CommandSource::INTERNAL)
+    {
+        BufferPrint out(response, sizeof(response) - 1);
+        dispatcher->process(text, strlen(text), out, nullptr, source);
+        response[out.length()] = '\0';
+        return response;
+    }
+
+    // Run text from a task that is not the owner
+    struct Caller
+    {
+        const char *text;
+        CommandSource source;
+        CommandResult result;
+        std::atomic<bool> done;
+    };
+
+    void runCaller(void *arg)
+    {
+        Caller *caller = static_cast<Caller *>(arg);
+        Command cmd = parser.parse(caller->text, strlen(caller->text));
+        caller->result = dispatcher->execute(cmd, nullptr, nullptr, caller->source);
+        caller->done = true;
+    }
+
+    CommandResult executeFromOtherTask(const char *text, CommandSource source = CommandSource::INTERNAL)
+    {
+        Caller caller;
+        caller.text = text;
+        caller.source = source;
+        caller.done = false;
+        xTaskCreatePinnedToCore(runCaller, "caller", 4096, &caller, 1, nullptr, 0);
+        while (!caller.done)
+        {
+            delay(1);
+        }
+        return caller.result;
+    }
+}
+
+void setUp()
+{
+    pins = new PinController();
+    pins->begin();
+    dispatcher = new CommandDispatcher(parser, *pins);
+}
+
+void tearDown()
+{
+    stopOwnerTask();
+    delete dispatcher;
+    delete pins;
+    dispatcher = nullptr;
+    pins = nullptr;
+}
+
+// Owner task
+
+void test_process_set()
+{
+    dispatcher->begin();
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"SET\",\"pin\":13,\"value\":1,"
+                             "\"message\":\"Pin set successfully\"}",
+                             process("SET 13 1"));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+}
+
+void test_process_invalid()
+{
+    dispatcher->begin();
+    TEST_ASSERT_EQUAL_STRING("{\"success\":false,\"command\":\"INVALID\",\"message\":\"Invalid command: FOO\"}",
+                             process("FOO"));
+}
+
+void test_process_rejected_by_controller()
+{
+    dispatcher->begin();
+    TEST_ASSERT_EQUAL_STRING("{\"success\":false,\"command\":\"PWM\",\"pin\":25,\"value\":300,"
+                             "\"message\":\"Failed to set PWM\"}",
+                             process("PWM 25 300"));
+}
+
+void test_process_batch()
+{
+    dispatcher->begin();
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"BATCH\",\"value\":3,"
+                             "\"message\":\"Batch applied successfully\"}",
+                             process("{\"cmd\":\"BATCH\",\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":1},"
+                                     "{\"cmd\":\"SET\",\"pin\":14,\"value\":1},{\"cmd\":\"PWM\",\"pin\":12,\"value\":9}]}"));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(14));
+    TEST_ASSERT_EQUAL_INT(9, pins->getPWM(12));
+}
+
+void test_process_binary()
+{
+    dispatcher->begin();
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_TOGGLE, 0x00, 13, 0x00, 0x00, 0x2A, 0x00};
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    pins->setDigital(13, 0);
+    TEST_ASSERT_EQUAL(BinaryProtocol::RESPONSE_SIZE, dispatcher->processBinary(frame, sizeof(frame), reply));
+    const uint8_t expected[] = {0xA6, BinaryProtocol::OP_TOGGLE, BinaryProtocol::STATUS_OK, 13, 0x01, 0x00, 0x2A, 0x00};
+    TEST_ASSERT_EQUAL_MEMORY(expected, reply, sizeof(expected));
+}
+
+void test_process_binary_invalid()
+{
+    dispatcher->begin();
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 6, 0x01, 0x00, 0x00, 0x00};
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    dispatcher->processBinary(frame, sizeof(frame), reply);
+    TEST_ASSERT_EQUAL_HEX8(BinaryProtocol::STATUS_INVALID_PIN, reply[2]);
+    TEST_ASSERT_FALSE(pins->isPinConfigured(6));
+}
+
+void test_scheduled_apply_rejected()
+{
+    dispatcher->begin();
+    Command cmd = parser.parse("SET 13 1", 8);
+    cmd.applyAt = 1767225600000ULL;
+    CommandResult r = dispatcher->execute(cmd);
+    TEST_ASSERT_FALSE(r.success);
+    TEST_ASSERT_EQUAL_STRING("Scheduled apply is only supported over UDP", r.message);
+}
+
+void test_status_writes_own_body()
+{
+    dispatcher->begin();
+    const char *body = process("STATUS");
+    TEST_ASSERT_EQUAL_INT('{', body[0]);
+    TEST_ASSERT_NOT_NULL(strstr(body, "\"pinStates\":"));
+    TEST_ASSERT_NULL(strstr(body, "\"message\":"));
+
+    Command cmd = parser.parse("STATUS", 6);
+    CommandResult r = dispatcher->execute(cmd);
+    TEST_ASSERT_FALSE(r.success);
+}
+
+// Owner in its own task
+
+void test_execute_from_other_task()
+{
+    startOwnerTask();
+
+    CommandResult r = executeFromOtherTask("SET 13 1");
+    TEST_ASSERT_TRUE(r.success);
+    TEST_ASSERT_EQUAL_INT(1, r.value);
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+
+    r = executeFromOtherTask("TOGGLE 13");
+    TEST_ASSERT_TRUE(r.success);
+    TEST_ASSERT_EQUAL_INT(0, r.value);
+}
+
+void test_get_returns_pin_mode()
+{
+    pins->setPWM(12, 128);
+    startOwnerTask();
+
+    // The web server takes the mode from the result, not from PinController
+    CommandResult r = executeFromOtherTask("GET 12", CommandSource::WEB);
+    TEST_ASSERT_TRUE(r.success);
+    TEST_ASSERT_EQUAL_INT(128, r.value);
+    TEST_ASSERT_TRUE(r.mode == PinMode::PWM_OUTPUT);
+
+    r = executeFromOtherTask("GET 14", CommandSource::WEB);
+    TEST_ASSERT_TRUE(r.success);
+    TEST_ASSERT_TRUE(r.mode == PinMode::NOT_CONFIGURED);
+}
+
+void test_process_from_other_task_writes_response()
+{
+    pins->setDigital(13, 0);
+    startOwnerTask();
+
+    // The test runner is not the owner, so this goes through the queue
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"GET\",\"pin\":13,\"value\":0,"
+                             "\"message\":\"Pin value retrieved\"}",
+                             process("GET 13", CommandSource::TCP));
+}
+
+void test_many_callers()
+{
+    startOwnerTask();
+
+    // More callers than job slots, each toggling its own pin an even number of times
+    static const int PINS[] = {4, 5, 12, 13, 14, 15, 16, 17, 18, 19, 21, 22};
+    static const int CALLERS = sizeof(PINS) / sizeof(PINS[0]);
+    static const int TOGGLES = 100;
+
+    struct Worker
+    {
+        char text[16];
+        std::atomic<bool> done;
+    };
+    static Worker workers[CALLERS];
+
+    for (int i = 0; i < CALLERS; i++)
+    {
+        pins->setDigital(PINS[i], 0);
+    }
+
+    for (int i = 0; i < CALLERS; i++)
+    {
+        snprintf(workers[i].text, sizeof(workers[i].text), "TOGGLE %d", PINS[i]);
+        workers[i].done = false;
+        xTaskCreatePinnedToCore(
+            [](void *arg)
+            {
+                Worker *worker = static_cast<Worker *>(arg);
+                Command cmd = parser.parse(worker->text, strlen(worker->text));
+                for (int round = 0; round < TOGGLES; round++)
+                {
+                    if (!dispatcher->execute(cmd).success)
+                    {
+                        round--; // Every job slot taken, try again
+                        delay(1);
+                    }
+                }
+                worker->done = true;
+            },
+            "worker", 4096, &workers[i], 1, nullptr, 0);
+    }
+
+    for (int i = 0; i < CALLERS; i++)
+    {
+        while (!workers[i].done)
+        {
+            delay(1);
+        }
+    }
+    for (int i = 0; i < CALLERS; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(0, pins->getDigital(PINS[i]));
+    }
+}
+
+void test_owner_stalled_times_out()
+{
+    startOwnerTask();
+    ownerStalled = true;
+    while (!ownerParked)
+    {
+        delay(1);
+    }
+
+    unsigned long start = millis();
+    CommandResult r = executeFromOtherTask("SET 13 1");
+    unsigned long elapsed = millis() - start;
+
+    TEST_ASSERT_FALSE(r.success);
+    TEST_ASSERT_EQUAL_STRING("Pin controller busy", r.message);
+    TEST_ASSERT_GREATER_OR_EQUAL(PIN_COMMAND_TIMEOUT_MS, elapsed);
+
+    // The abandoned job is dropped, not run late
+    ownerStalled = false;
+    xTaskNotifyGive(ownerTask);
+    delay(30);
+    TEST_ASSERT_FALSE(pins->isPinConfigured(13));
+
+    TEST_ASSERT_TRUE(executeFromOtherTask("SET 13 1").success);
+}
+
+void test_async_caller_gives_up_quickly()
+{
+    startOwnerTask();
+    ownerStalled = true;
+    while (!ownerParked)
+    {
+        delay(1);
+    }
+
+    // AsyncTCP callbacks must not hold up every other connection for long
+    unsigned long start = millis();
+    CommandResult r = executeFromOtherTask("SET 13 1", CommandSource::WEB);
+    unsigned long elapsed = millis() - start;
+
+    TEST_ASSERT_FALSE(r.success);
+    TEST_ASSERT_EQUAL_STRING("Pin controller busy", r.message);
+    TEST_ASSERT_LESS_THAN(PIN_COMMAND_TIMEOUT_MS / 2, elapsed);
+
+    ownerStalled = false;
+    xTaskNotifyGive(ownerTask);
+    TEST_ASSERT_TRUE(executeFromOtherTask("SET 13 1", CommandSource::TCP).success);
+}
+
+void test_async_caller_waits_out_a_loop_task()
+{
+    // Longer than the old 5 ms limit, within the longest task budget
+    ownerBusyMs = 8;
+    TEST_ASSERT_LESS_THAN(LOOP_HOUSEKEEPING_BUDGET_US / 1000, ownerBusyMs.load());
+    startOwnerTask();
+
+    for (int i = 0; i < 5; i++)
+    {
+        CommandResult r = executeFromOtherTask(i % 2 == 0 ? "SET 13 1" : "SET 13 0", CommandSource::WEB);
+        TEST_ASSERT_TRUE_MESSAGE(r.success, r.message);
+    }
+    TEST_ASSERT_EQUAL_INT(1, pins->getDigital(13));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_process_set);
+    RUN_TEST(test_process_invalid);
+    RUN_TEST(test_process_rejected_by_controller);
+    RUN_TEST(test_process_batch);
+    RUN_TEST(test_process_binary);
+    RUN_TEST(test_process_binary_invalid);
+    RUN_TEST(test_scheduled_apply_rejected);
+    RUN_TEST(test_status_writes_own_body);
+
+    RUN_TEST(test_execute_from_other_task);
+    RUN_TEST(test_get_returns_pin_mode);
+    RUN_TEST(test_process_from_other_task_writes_response);
+    RUN_TEST(test_many_callers);
+    RUN_TEST(test_owner_stalled_times_out);
+    RUN_TEST(test_async_caller_gives_up_quickly);
+    RUN_TEST(test_async_caller_waits_out_a_loop_task);
+
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+/**
+ * LoopScheduler tests (env:native)
+ *
+ * Priorities, triggers and how long the loop may idle between passes:
+ *
+ *   pio test -e native -f test_loop_scheduler
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "LoopScheduler.h"
+#include "WatchdogManager.h"
+
+namespace
+{
+    WatchdogManager watchdog;
+    LoopScheduler *scheduler = nullptr;
+
+    // Task names in the order they ran
+    char ran[64];
+
+    void record(const char *name)
+    {
+        strncat(ran, name, sizeof(ran) - strlen(ran) - 1);
+    }
+
+    void runCommand() { record("C"); }
+    void runIO() { record("I"); }
+    void runHousekeeping() { record("H"); }
+    void runTriggered() { record("T"); }
+
+    uint32_t idleWithin10(uint32_t maxMs) { return maxMs < 10 ? maxMs : 10; }
+    uint32_t idleNone(uint32_t maxMs) { return maxMs; }
+}
+
+void setUp()
+{
+    scheduler = new LoopScheduler(watchdog);
+    scheduler->begin();
+    ran[0] = '\0';
+}
+
+void tearDown()
+{
+    delete scheduler;
+    scheduler = nullptr;
+}
+
+void test_commands_run_between_tasks()
+{
+    scheduler->add("housekeeping", runHousekeeping, LoopPriority::HOUSEKEEPING);
+    scheduler->add("io", runIO, LoopPriority::IO);
+    scheduler->add("command", runCommand, LoopPriority::COMMAND);
+
+    scheduler->runOnce();
+    TEST_ASSERT_EQUAL_STRING("CICHC", ran);
+}
+
+void test_triggered_task_runs_once()
+{
+    int id = scheduler->add("triggered", runTriggered, LoopPriority::IO, LoopScheduler::ON_TRIGGER);
+
+    scheduler->runOnce();
+    TEST_ASSERT_EQUAL_STRING("", ran);
+
+    scheduler->trigger(id);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler->idleTimeMs(100));
+    scheduler->runOnce();
+    scheduler->runOnce();
+    TEST_ASSERT_EQUAL_STRING("T", ran);
+}
+
+void test_idle_until_next_period()
+{
+    scheduler->add("io", runIO, LoopPriority::IO);
+    scheduler->add("slow", runHousekeeping, LoopPriority::HOUSEKEEPING, 50);
+
+    scheduler->runOnce();
+    uint32_t wait = scheduler->idleTimeMs(100);
+    TEST_ASSERT_LESS_OR_EQUAL(50, wait);
+    TEST_ASSERT_GREATER_THAN(40, wait);
+    TEST_ASSERT_EQUAL_UINT32(20, scheduler->idleTimeMs(20));
+}
+
+void test_idle_function_shortens_wait()
+{
+    int io = scheduler->add("io", runIO, LoopPriority::IO);
+    int other = scheduler->add("other", runHousekeeping, LoopPriority::HOUSEKEEPING);
+    scheduler->runOnce();
+
+    // Period-0 tasks only count through their idle function
+    TEST_ASSERT_EQUAL_UINT32(100, scheduler->idleTimeMs(100));
+
+    scheduler->setIdleFunction(other, idleNone);
+    TEST_ASSERT_EQUAL_UINT32(100, scheduler->idleTimeMs(100));
+
+    scheduler->setIdleFunction(io, idleWithin10);
+    TEST_ASSERT_EQUAL_UINT32(10, scheduler->idleTimeMs(100));
+    TEST_ASSERT_EQUAL_UINT32(5, scheduler->idleTimeMs(5));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_commands_run_between_tasks);
+    RUN_TEST(test_triggered_task_runs_once);
+    RUN_TEST(test_idle_until_next_period);
+    RUN_TEST(test_idle_function_shortens_wait);
+
+    return UNITY_END();
+}
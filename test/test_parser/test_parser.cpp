@@ -0,0 +1,468 @@
+/**
+ * CommandParser tests (env:native)
+ *
+ * JSON, text, BATCH and binary parsing, the JSON and binary response writers
+ * and the validation error paths:
+ *
+ *   pio test -e native -f test_parser
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "CommandParser.h"
+#include "BufferPrint.h"
+
+namespace
+{
+    CommandParser parser;
+
+    // Response text of the last respond() call
+    char response[512];
+
+    Command parse(const char *text)
+    {
+        return parser.parse(text, strlen(text));
+    }
+
+    Command parseFrame(const uint8_t *frame, size_t length)
+    {
+        return parser.parse(reinterpret_cast<const char *>(frame), length);
+    }
+
+    const char *respond(const Command &cmd, bool success, const char *message = "", int value = -1)
+    {
+        BufferPrint out(response, sizeof(response) - 1);
+        parser.writeResponse(out, cmd, success, message, value);
+        response[out.length()] = '\0';
+        return response;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// JSON
+
+void test_json_set()
+{
+    Command cmd = parse("{\"cmd\":\"SET\",\"pin\":13,\"value\":1}");
+    TEST_ASSERT_TRUE(cmd.isValid());
+    TEST_ASSERT_TRUE(cmd.type == CommandType::SET);
+    TEST_ASSERT_TRUE(cmd.format == CommandFormat::JSON);
+    TEST_ASSERT_EQUAL_INT(13, cmd.pin);
+    TEST_ASSERT_EQUAL_INT(1, cmd.value);
+    TEST_ASSERT_FALSE(cmd.sequenced);
+}
+
+void test_json_pwm_with_config()
+{
+    Command cmd = parse("{\"cmd\":\"PWM\",\"pin\":25,\"value\":4915,\"freq\":50,\"resolution\":16}");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::PWM);
+    TEST_ASSERT_EQUAL_INT(25, cmd.pin);
+    TEST_ASSERT_EQUAL_INT(4915, cmd.value);
+    TEST_ASSERT_EQUAL_UINT32(50, cmd.frequency);
+    TEST_ASSERT_EQUAL_UINT8(16, cmd.resolution);
+}
+
+void test_json_sequence_and_ack()
+{
+    Command cmd = parse("{\"cmd\":\"TOGGLE\",\"pin\":13,\"seq\":7,\"ack\":false}");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::TOGGLE);
+    TEST_ASSERT_TRUE(cmd.sequenced);
+    TEST_ASSERT_EQUAL_UINT16(7, cmd.sequence);
+    TEST_ASSERT_TRUE(cmd.noReply);
+}
+
+void test_json_setmask()
+{
+    Command cmd = parse("{\"cmd\":\"SETMASK\",\"set\":\"0x3000\",\"clear\":16384}");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::SETMASK);
+    TEST_ASSERT_EQUAL_HEX64(0x3000, cmd.setMask);
+    TEST_ASSERT_EQUAL_HEX64(0x4000, cmd.clearMask);
+}
+
+void test_json_fade()
+{
+    Command cmd = parse("{\"cmd\":\"FADE\",\"pin\":13,\"value\":255,\"duration\":1000,\"curve\":\"EASE\"}");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::FADE);
+    TEST_ASSERT_EQUAL_INT(255, cmd.value);
+    TEST_ASSERT_EQUAL_UINT32(1000, cmd.duration);
+    TEST_ASSERT_TRUE(cmd.curve == FadeCurve::EASE);
+}
+
+void test_json_syntax_error()
+{
+    Command cmd = parse("{\"cmd\":\"SET\",");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("JSON parse error: IncompleteInput", cmd.errorMessage.c_str());
+}
+
+void test_json_unknown_command()
+{
+    Command cmd = parse("{\"cmd\":\"NOPE\"}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Invalid command type: NOPE", cmd.errorMessage.c_str());
+}
+
+void test_json_missing_value()
+{
+    Command cmd = parse("{\"cmd\":\"SET\",\"pin\":13}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Missing 'value' field", cmd.errorMessage.c_str());
+}
+
+void test_json_invalid_pin()
+{
+    // GPIO 6 is a flash pin
+    Command cmd = parse("{\"cmd\":\"SET\",\"pin\":6,\"value\":1}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Invalid pin number: 6", cmd.errorMessage.c_str());
+}
+
+void test_json_invalid_set_value()
+{
+    Command cmd = parse("{\"cmd\":\"SET\",\"pin\":13,\"value\":2}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("SET value must be 0 or 1", cmd.errorMessage.c_str());
+}
+
+// Text
+
+void test_text_set()
+{
+    Command cmd = parse("SET 13 1");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::SET);
+    TEST_ASSERT_TRUE(cmd.format == CommandFormat::TEXT);
+    TEST_ASSERT_EQUAL_INT(13, cmd.pin);
+    TEST_ASSERT_EQUAL_INT(1, cmd.value);
+}
+
+void test_text_case_insensitive()
+{
+    Command cmd = parse("toggle 14");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::TOGGLE);
+    TEST_ASSERT_EQUAL_INT(14, cmd.pin);
+}
+
+void test_text_pwm_with_config()
+{
+    Command cmd = parse("PWM 13 4915 50 16");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::PWM);
+    TEST_ASSERT_EQUAL_INT(4915, cmd.value);
+    TEST_ASSERT_EQUAL_UINT32(50, cmd.frequency);
+    TEST_ASSERT_EQUAL_UINT8(16, cmd.resolution);
+}
+
+void test_text_setmask()
+{
+    Command cmd = parse("SETMASK 0x3000 0x4000");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::SETMASK);
+    TEST_ASSERT_EQUAL_HEX64(0x3000, cmd.setMask);
+    TEST_ASSERT_EQUAL_HEX64(0x4000, cmd.clearMask);
+}
+
+void test_text_setmask_overlap()
+{
+    Command cmd = parse("SETMASK 0x3000 0x1000");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("A pin cannot be in both the set and clear mask", cmd.errorMessage.c_str());
+}
+
+void test_text_unknown_command()
+{
+    Command cmd = parse("FOO 1");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Invalid command: FOO", cmd.errorMessage.c_str());
+}
+
+void test_text_invalid_value()
+{
+    Command cmd = parse("SET 13 x");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Invalid value: x", cmd.errorMessage.c_str());
+}
+
+void test_text_invalid_pin()
+{
+    Command cmd = parse("SET 6 1");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Invalid pin number: 6", cmd.errorMessage.c_str());
+}
+
+// BATCH
+
+void test_json_batch()
+{
+    Command cmd = parse("{\"cmd\":\"BATCH\",\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":1},"
+                        "{\"cmd\":\"PWM\",\"pin\":12,\"value\":128},{\"cmd\":\"TOGGLE\",\"pin\":14}]}");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::BATCH);
+    TEST_ASSERT_EQUAL_UINT8(3, cmd.batchCount);
+    TEST_ASSERT_TRUE(cmd.batch[0].type == PinOpType::SET);
+    TEST_ASSERT_EQUAL_UINT8(13, cmd.batch[0].pin);
+    TEST_ASSERT_EQUAL_UINT16(1, cmd.batch[0].value);
+    TEST_ASSERT_TRUE(cmd.batch[1].type == PinOpType::PWM);
+    TEST_ASSERT_EQUAL_UINT16(128, cmd.batch[1].value);
+    TEST_ASSERT_TRUE(cmd.batch[2].type == PinOpType::TOGGLE);
+    TEST_ASSERT_EQUAL_UINT8(14, cmd.batch[2].pin);
+}
+
+void test_json_batch_missing_ops()
+{
+    Command cmd = parse("{\"cmd\":\"BATCH\"}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Missing 'ops' array", cmd.errorMessage.c_str());
+}
+
+void test_json_batch_empty()
+{
+    Command cmd = parse("{\"cmd\":\"BATCH\",\"ops\":[]}");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("BATCH requires at least one op", cmd.errorMessage.c_str());
+}
+
+void test_text_batch()
+{
+    Command cmd = parse("BATCH SET 13 1; PWM 12 128; TOGGLE 14");
+    TEST_ASSERT_TRUE(cmd.type == CommandType::BATCH);
+    TEST_ASSERT_EQUAL_UINT8(3, cmd.batchCount);
+    TEST_ASSERT_TRUE(cmd.batch[1].type == PinOpType::PWM);
+    TEST_ASSERT_EQUAL_UINT8(12, cmd.batch[1].pin);
+    TEST_ASSERT_EQUAL_UINT16(128, cmd.batch[1].value);
+}
+
+void test_text_batch_invalid_op()
+{
+    Command cmd = parse("BATCH SET 13 1; SET 6 1");
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_STRING("Batch op 2: Invalid pin number: 6", cmd.errorMessage.c_str());
+}
+
+void test_text_batch_too_many_ops()
+{
+    String text("BATCH SET 13 1");
+    for (int i = 1; i <= MAX_BATCH_OPS; i++)
+    {
+        text += "; TOGGLE 13";
+    }
+    Command cmd = parse(text.c_str());
+    TEST_ASSERT_FALSE(cmd.isValid());
+}
+
+// Binary
+
+void test_binary_set()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 13, 0x01, 0x00, 0x34, 0x12};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(cmd.type == CommandType::SET);
+    TEST_ASSERT_TRUE(cmd.format == CommandFormat::BINARY);
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::OP_SET, cmd.opcode);
+    TEST_ASSERT_EQUAL_INT(13, cmd.pin);
+    TEST_ASSERT_EQUAL_INT(1, cmd.value);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, cmd.sequence);
+    TEST_ASSERT_FALSE(cmd.sequenced);
+}
+
+void test_binary_flags()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_PWM,
+                             BinaryProtocol::FLAG_SEQUENCED | BinaryProtocol::FLAG_NO_REPLY,
+                             25, 0x80, 0x00, 0x02, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(cmd.type == CommandType::PWM);
+    TEST_ASSERT_EQUAL_INT(128, cmd.value);
+    TEST_ASSERT_TRUE(cmd.sequenced);
+    TEST_ASSERT_TRUE(cmd.noReply);
+}
+
+void test_binary_batch()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_BATCH, 0x00, 0, 0x02, 0x00, 0x03, 0x00,
+                             BinaryProtocol::OP_SET, 13, 0x01, 0x00,
+                             BinaryProtocol::OP_PWM, 12, 0x80, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(cmd.type == CommandType::BATCH);
+    TEST_ASSERT_EQUAL_UINT8(2, cmd.batchCount);
+    TEST_ASSERT_TRUE(cmd.batch[0].type == PinOpType::SET);
+    TEST_ASSERT_EQUAL_UINT8(13, cmd.batch[0].pin);
+    TEST_ASSERT_TRUE(cmd.batch[1].type == PinOpType::PWM);
+    TEST_ASSERT_EQUAL_UINT16(128, cmd.batch[1].value);
+}
+
+void test_binary_truncated()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 13};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::STATUS_BAD_FRAME, cmd.binaryStatus);
+}
+
+void test_binary_batch_short()
+{
+    // Claims two ops, carries one
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_BATCH, 0x00, 0, 0x02, 0x00, 0x00, 0x00,
+                             BinaryProtocol::OP_SET, 13, 0x01, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::STATUS_BAD_FRAME, cmd.binaryStatus);
+}
+
+void test_binary_unknown_opcode()
+{
+    const uint8_t frame[] = {0xA5, 0x7F, 0x00, 13, 0x00, 0x00, 0x00, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::STATUS_UNKNOWN_OPCODE, cmd.binaryStatus);
+}
+
+void test_binary_invalid_pin()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 6, 0x01, 0x00, 0x00, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::STATUS_INVALID_PIN, cmd.binaryStatus);
+}
+
+void test_binary_invalid_value()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 13, 0x02, 0x00, 0x00, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(cmd.isValid());
+    TEST_ASSERT_EQUAL_UINT8(BinaryProtocol::STATUS_INVALID_VALUE, cmd.binaryStatus);
+}
+
+// Responses
+
+void test_response_success()
+{
+    Command cmd = parse("SET 13 1");
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"SET\",\"pin\":13,\"value\":1}",
+                             respond(cmd, true, "", 1));
+}
+
+void test_response_sequence_and_message()
+{
+    Command cmd = parse("{\"cmd\":\"TOGGLE\",\"pin\":13,\"seq\":9}");
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"TOGGLE\",\"pin\":13,\"value\":0,\"seq\":9,"
+                             "\"message\":\"done\"}",
+                             respond(cmd, true, "done", 0));
+}
+
+void test_response_parse_error()
+{
+    Command cmd = parse("SET 6 1");
+    TEST_ASSERT_EQUAL_STRING("{\"success\":false,\"command\":\"INVALID\",\"pin\":6,"
+                             "\"message\":\"Invalid pin number: 6\"}",
+                             respond(cmd, false));
+}
+
+void test_response_without_pin()
+{
+    Command cmd = parse("BATCH SET 13 1; SET 14 0");
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true,\"command\":\"BATCH\",\"value\":2}", respond(cmd, true, "", 2));
+}
+
+void test_binary_response_success()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 13, 0x01, 0x00, 0x34, 0x12};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    TEST_ASSERT_EQUAL(BinaryProtocol::RESPONSE_SIZE, parser.generateBinaryResponse(cmd, true, 1, reply));
+    const uint8_t expected[] = {0xA6, BinaryProtocol::OP_SET, BinaryProtocol::STATUS_OK, 13, 0x01, 0x00, 0x34, 0x12};
+    TEST_ASSERT_EQUAL_MEMORY(expected, reply, sizeof(expected));
+}
+
+void test_binary_response_failed()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_PWM, 0x00, 25, 0x80, 0x00, 0x01, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    parser.generateBinaryResponse(cmd, false, -1, reply);
+    TEST_ASSERT_EQUAL_HEX8(BinaryProtocol::STATUS_FAILED, reply[2]);
+    TEST_ASSERT_EQUAL_UINT16(0, BinaryProtocol::readU16(reply + 4));
+    TEST_ASSERT_EQUAL_UINT16(1, BinaryProtocol::readU16(reply + 6));
+}
+
+void test_binary_response_parse_status()
+{
+    const uint8_t frame[] = {0xA5, BinaryProtocol::OP_SET, 0x00, 6, 0x01, 0x00, 0x05, 0x00};
+    Command cmd = parseFrame(frame, sizeof(frame));
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    parser.generateBinaryResponse(cmd, false, -1, reply);
+    TEST_ASSERT_EQUAL_HEX8(BinaryProtocol::STATUS_INVALID_PIN, reply[2]);
+    TEST_ASSERT_EQUAL_UINT8(6, reply[3]);
+    TEST_ASSERT_EQUAL_UINT16(5, BinaryProtocol::readU16(reply + 6));
+}
+
+void test_binary_response_invalid_without_status()
+{
+    // An invalid command that never got a decode status reports a bad frame
+    Command cmd;
+    cmd.format = CommandFormat::BINARY;
+    cmd.opcode = BinaryProtocol::OP_GET;
+    uint8_t reply[BinaryProtocol::RESPONSE_SIZE];
+
+    parser.generateBinaryResponse(cmd, false, -1, reply);
+    TEST_ASSERT_EQUAL_HEX8(BinaryProtocol::STATUS_BAD_FRAME, reply[2]);
+    TEST_ASSERT_EQUAL_UINT8(0, reply[3]);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_json_set);
+    RUN_TEST(test_json_pwm_with_config);
+    RUN_TEST(test_json_sequence_and_ack);
+    RUN_TEST(test_json_setmask);
+    RUN_TEST(test_json_fade);
+    RUN_TEST(test_json_syntax_error);
+    RUN_TEST(test_json_unknown_command);
+    RUN_TEST(test_json_missing_value);
+    RUN_TEST(test_json_invalid_pin);
+    RUN_TEST(test_json_invalid_set_value);
+
+    RUN_TEST(test_text_set);
+    RUN_TEST(test_text_case_insensitive);
+    RUN_TEST(test_text_pwm_with_config);
+    RUN_TEST(test_text_setmask);
+    RUN_TEST(test_text_setmask_overlap);
+    RUN_TEST(test_text_unknown_command);
+    RUN_TEST(test_text_invalid_value);
+    RUN_TEST(test_text_invalid_pin);
+
+    RUN_TEST(test_json_batch);
+    RUN_TEST(test_json_batch_missing_ops);
+    RUN_TEST(test_json_batch_empty);
+    RUN_TEST(test_text_batch);
+    RUN_TEST(test_text_batch_invalid_op);
+    RUN_TEST(test_text_batch_too_many_ops);
+
+    RUN_TEST(test_binary_set);
+    RUN_TEST(test_binary_flags);
+    RUN_TEST(test_binary_batch);
+    RUN_TEST(test_binary_truncated);
+    RUN_TEST(test_binary_batch_short);
+    RUN_TEST(test_binary_unknown_opcode);
+    RUN_TEST(test_binary_invalid_pin);
+    RUN_TEST(test_binary_invalid_value);
+
+    RUN_TEST(test_response_success);
+    RUN_TEST(test_response_sequence_and_message);
+    RUN_TEST(test_response_parse_error);
+    RUN_TEST(test_response_without_pin);
+    RUN_TEST(test_binary_response_success);
+    RUN_TEST(test_binary_response_failed);
+    RUN_TEST(test_binary_response_parse_status);
+    RUN_TEST(test_binary_response_invalid_without_status);
+
+    return UNITY_END();
+}
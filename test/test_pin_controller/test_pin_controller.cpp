@@ -0,0 +1,280 @@
+/**
+ * PinController tests (env:native)
+ *
+ * Batch and mask updates, groups and scenes. GPIO levels live in the shim's
+ * register file, so the tests see what the W1TS/W1TC writes did and how many
+ * there were:
+ *
+ *   pio test -e native -f test_pin_controller
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "PinController.h"
+#include "soc/soc.h"
+
+namespace
+{
+    PinController *pins = nullptr;
+
+    PinOp op(PinOpType type, uint8_t pin, uint16_t value = 0)
+    {
+        PinOp result;
+        result.type = type;
+        result.pin = pin;
+        result.value = value;
+        return result;
+    }
+}
+
+void setUp()
+{
+    pins = new PinController();
+    pins->begin();
+    pins->takeChangedPins();
+}
+
+void tearDown()
+{
+    delete pins;
+    pins = nullptr;
+}
+
+void test_set_digital()
+{
+    TEST_ASSERT_TRUE(pins->setDigital(13, 1));
+    TEST_ASSERT_EQUAL_INT(1, pins->getDigital(13));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+    TEST_ASSERT_TRUE(pins->getPinMode(13) == PinMode::DIGITAL_OUTPUT);
+
+    TEST_ASSERT_TRUE(pins->toggle(13));
+    TEST_ASSERT_EQUAL_INT(0, pins->getDigital(13));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(13));
+}
+
+void test_set_digital_rejects_unsafe_pin()
+{
+    TEST_ASSERT_FALSE(pins->setDigital(6, 1));
+    TEST_ASSERT_FALSE(pins->setDigital(13, 2));
+    TEST_ASSERT_FALSE(pins->isPinConfigured(6));
+}
+
+void test_set_pwm()
+{
+    TEST_ASSERT_TRUE(pins->setPWM(25, 128));
+    TEST_ASSERT_EQUAL_INT(128, pins->getPWM(25));
+    TEST_ASSERT_TRUE(pins->getPinMode(25) == PinMode::PWM_OUTPUT);
+
+    // 8 bit by default
+    TEST_ASSERT_FALSE(pins->setPWM(25, 256));
+    TEST_ASSERT_TRUE(pins->setPWM(25, 4915, 50, 16));
+    TEST_ASSERT_EQUAL_INT(4915, pins->getPWM(25));
+}
+
+void test_batch_digital_ops_share_register_writes()
+{
+    pins->setDigital(14, 1);
+    pins->setDigital(15, 1);
+
+    PinOp ops[] = {op(PinOpType::SET, 12, 1), op(PinOpType::SET, 13, 1),
+                   op(PinOpType::SET, 14, 0), op(PinOpType::TOGGLE, 15)};
+    nativeResetRegWriteCount();
+    TEST_ASSERT_TRUE(pins->applyBatch(ops, 4));
+
+    // One W1TS and one W1TC for the low bank
+    TEST_ASSERT_EQUAL_UINT32(2, nativeRegWriteCount());
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(12));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(14));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(15));
+    TEST_ASSERT_EQUAL_INT(0, pins->getDigital(15));
+}
+
+void test_batch_later_op_on_pin_wins()
+{
+    PinOp ops[] = {op(PinOpType::SET, 13, 1), op(PinOpType::SET, 13, 0)};
+    TEST_ASSERT_TRUE(pins->applyBatch(ops, 2));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(13));
+    TEST_ASSERT_EQUAL_INT(0, pins->getDigital(13));
+
+    PinOp toggles[] = {op(PinOpType::TOGGLE, 13), op(PinOpType::TOGGLE, 13), op(PinOpType::TOGGLE, 13)};
+    TEST_ASSERT_TRUE(pins->applyBatch(toggles, 3));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+}
+
+void test_batch_pwm_op()
+{
+    PinOp ops[] = {op(PinOpType::SET, 13, 1), op(PinOpType::PWM, 12, 64)};
+    TEST_ASSERT_TRUE(pins->applyBatch(ops, 2));
+    TEST_ASSERT_TRUE(pins->getPinMode(12) == PinMode::PWM_OUTPUT);
+    TEST_ASSERT_EQUAL_INT(64, pins->getPWM(12));
+    TEST_ASSERT_EQUAL_HEX64((1ULL << 12) | (1ULL << 13), pins->takeChangedPins());
+}
+
+void test_batch_invalid_op_changes_nothing()
+{
+    pins->setDigital(13, 0);
+
+    // The last op is out of range, so the first must not be applied either
+    PinOp ops[] = {op(PinOpType::SET, 13, 1), op(PinOpType::PWM, 12, 300)};
+    nativeResetRegWriteCount();
+    TEST_ASSERT_FALSE(pins->applyBatch(ops, 2));
+    TEST_ASSERT_EQUAL_UINT32(0, nativeRegWriteCount());
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(13));
+    TEST_ASSERT_FALSE(pins->isPinConfigured(12));
+
+    PinOp unsafe[] = {op(PinOpType::SET, 13, 1), op(PinOpType::SET, 6, 1)};
+    TEST_ASSERT_FALSE(pins->applyBatch(unsafe, 2));
+    TEST_ASSERT_EQUAL_INT(0, pins->getDigital(13));
+
+    PinOp pulse[] = {op(PinOpType::PULSE, 13, 10)};
+    TEST_ASSERT_FALSE(pins->applyBatch(pulse, 1));
+}
+
+void test_set_mask()
+{
+    uint64_t set = (1ULL << 4) | (1ULL << 5) | (1ULL << 32);
+    uint64_t clear = (1ULL << 12) | (1ULL << 33);
+    pins->setDigital(12, 1);
+    pins->setDigital(33, 1);
+    pins->takeChangedPins();
+
+    nativeResetRegWriteCount();
+    TEST_ASSERT_TRUE(pins->setDigitalMask(set, clear));
+
+    // Set and clear for each of the two banks
+    TEST_ASSERT_EQUAL_UINT32(4, nativeRegWriteCount());
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(4));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(5));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(32));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(12));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(33));
+    TEST_ASSERT_EQUAL_INT(1, pins->getDigital(32));
+    TEST_ASSERT_TRUE(pins->getPinMode(4) == PinMode::DIGITAL_OUTPUT);
+    TEST_ASSERT_EQUAL_HEX64(set | clear, pins->takeChangedPins());
+}
+
+void test_set_mask_one_bank_one_write()
+{
+    nativeResetRegWriteCount();
+    TEST_ASSERT_TRUE(pins->setDigitalMask((1ULL << 12) | (1ULL << 13) | (1ULL << 14), 0));
+    TEST_ASSERT_EQUAL_UINT32(1, nativeRegWriteCount());
+}
+
+void test_set_mask_rejects_invalid_masks()
+{
+    nativeResetRegWriteCount();
+    TEST_ASSERT_FALSE(pins->setDigitalMask(1ULL << 6, 0));
+    TEST_ASSERT_FALSE(pins->setDigitalMask(1ULL << 13, 1ULL << 13));
+    TEST_ASSERT_EQUAL_UINT32(0, nativeRegWriteCount());
+    TEST_ASSERT_FALSE(pins->isPinConfigured(13));
+}
+
+void test_group()
+{
+    uint64_t relays = (1ULL << 12) | (1ULL << 13) | (1ULL << 14);
+    TEST_ASSERT_TRUE(pins->defineGroup("relays", relays));
+    TEST_ASSERT_TRUE(pins->hasGroup("RELAYS"));
+
+    nativeResetRegWriteCount();
+    TEST_ASSERT_TRUE(pins->applyGroup("relays", 1, false));
+    TEST_ASSERT_EQUAL_UINT32(1, nativeRegWriteCount());
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(14));
+
+    TEST_ASSERT_TRUE(pins->applyGroup("relays", 128, true));
+    TEST_ASSERT_EQUAL_INT(128, pins->getPWM(13));
+
+    TEST_ASSERT_FALSE(pins->applyGroup("relays", 2, false));
+    TEST_ASSERT_FALSE(pins->applyGroup("missing", 1, false));
+    TEST_ASSERT_FALSE(pins->defineGroup("bad", 1ULL << 6));
+
+    TEST_ASSERT_TRUE(pins->deleteGroup("relays"));
+    TEST_ASSERT_FALSE(pins->hasGroup("relays"));
+}
+
+void test_scene_recall()
+{
+    PinOp ops[] = {op(PinOpType::SET, 13, 1), op(PinOpType::SET, 14, 0), op(PinOpType::PWM, 12, 64)};
+    TEST_ASSERT_TRUE(pins->defineScene("evening", ops, 3));
+
+    pins->setDigital(13, 0);
+    pins->setDigital(14, 1);
+    pins->setPWM(12, 200);
+
+    TEST_ASSERT_TRUE(pins->recallScene("Evening"));
+    TEST_ASSERT_EQUAL_INT(HIGH, digitalRead(13));
+    TEST_ASSERT_EQUAL_INT(LOW, digitalRead(14));
+    TEST_ASSERT_EQUAL_INT(64, pins->getPWM(12));
+    TEST_ASSERT_FALSE(pins->recallScene("morning"));
+}
+
+void test_scene_save_current_outputs()
+{
+    pins->setDigital(13, 1);
+    pins->setPWM(25, 32);
+    TEST_ASSERT_TRUE(pins->saveScene("now"));
+
+    pins->setDigital(13, 0);
+    pins->setPWM(25, 0);
+    TEST_ASSERT_TRUE(pins->recallScene("now"));
+    TEST_ASSERT_EQUAL_INT(1, pins->getDigital(13));
+    TEST_ASSERT_EQUAL_INT(32, pins->getPWM(25));
+}
+
+void test_software_fade_reaches_target()
+{
+    TEST_ASSERT_TRUE(pins->setPWM(25, 0));
+    TEST_ASSERT_TRUE(pins->fadePWM(25, 200, 40, FadeCurve::EASE));
+    TEST_ASSERT_TRUE(pins->isFading(25));
+
+    unsigned long start = millis();
+    while (pins->isFading(25) && millis() - start < 1000)
+    {
+        pins->loop();
+        delay(1);
+    }
+    TEST_ASSERT_FALSE(pins->isFading(25));
+    TEST_ASSERT_EQUAL_INT(200, pins->getPWM(25));
+}
+
+void test_idle_time_follows_timers_and_fades()
+{
+    TEST_ASSERT_EQUAL_UINT32(1000, pins->idleTimeMs(1000));
+
+    TEST_ASSERT_TRUE(pins->scheduleOp(op(PinOpType::SET, 13, 1), 50) > 0);
+    uint32_t wait = pins->idleTimeMs(1000);
+    TEST_ASSERT_LESS_OR_EQUAL(50, wait);
+    TEST_ASSERT_GREATER_THAN(40, wait);
+    TEST_ASSERT_EQUAL_UINT32(20, pins->idleTimeMs(20));
+
+    TEST_ASSERT_TRUE(pins->setPWM(25, 0));
+    TEST_ASSERT_TRUE(pins->fadePWM(25, 200, 500));
+    TEST_ASSERT_LESS_OR_EQUAL(FADE_UPDATE_INTERVAL_MS, pins->idleTimeMs(1000));
+
+    pins->cancelAllTimers();
+    pins->setPWM(25, 0);
+    TEST_ASSERT_EQUAL_UINT32(1000, pins->idleTimeMs(1000));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_set_digital);
+    RUN_TEST(test_set_digital_rejects_unsafe_pin);
+    RUN_TEST(test_set_pwm);
+    RUN_TEST(test_batch_digital_ops_share_register_writes);
+    RUN_TEST(test_batch_later_op_on_pin_wins);
+    RUN_TEST(test_batch_pwm_op);
+    RUN_TEST(test_batch_invalid_op_changes_nothing);
+    RUN_TEST(test_set_mask);
+    RUN_TEST(test_set_mask_one_bank_one_write);
+    RUN_TEST(test_set_mask_rejects_invalid_masks);
+    RUN_TEST(test_group);
+    RUN_TEST(test_scene_recall);
+    RUN_TEST(test_scene_save_current_outputs);
+    RUN_TEST(test_software_fade_reaches_target);
+    RUN_TEST(test_idle_time_follows_timers_and_fades);
+
+    return UNITY_END();
+}
@@ -0,0 +1,171 @@
+/**
+ * SequenceFilter tests (env:native)
+ *
+ * Per-pin last-writer-wins ordering of sequenced UDP commands. accept()
+ * checks and commits as NetworkServer does for a command that runs:
+ *
+ *   pio test -e native -f test_sequence_filter
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "SequenceFilter.h"
+
+namespace
+{
+    CommandParser parser;
+    SequenceFilter *filter = nullptr;
+
+    Command parse(const char *text)
+    {
+        Command cmd = parser.parse(text, strlen(text));
+        TEST_ASSERT_TRUE_MESSAGE(cmd.isValid(), text);
+        TEST_ASSERT_TRUE_MESSAGE(cmd.sequenced, text);
+        return cmd;
+    }
+
+    // Check and, if anything is left, commit, as a command that runs
+    bool accept(Command &cmd, unsigned long now = 1000)
+    {
+        if (!filter->check(cmd, now))
+        {
+            return false;
+        }
+        filter->commit(cmd, now);
+        return true;
+    }
+
+    bool accept(const char *text, unsigned long now = 1000)
+    {
+        Command cmd = parse(text);
+        return accept(cmd, now);
+    }
+}
+
+void setUp()
+{
+    filter = new SequenceFilter();
+}
+
+void tearDown()
+{
+    delete filter;
+    filter = nullptr;
+}
+
+void test_newer_sequence_accepted()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":5}"));
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":0,\"seq\":6}"));
+}
+
+void test_stale_and_duplicate_dropped()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":5}"));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":5}"));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":0,\"seq\":4}"));
+
+    // Other pins are ordered on their own
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":14,\"value\":0,\"seq\":4}"));
+}
+
+void test_sequence_wraps()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":65535}"));
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":0,\"seq\":0}"));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":65534}"));
+}
+
+void test_idle_pin_accepts_any_sequence()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":500}", 1000));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":1}", 1000 + UDP_SEQUENCE_RESET_MS - 1));
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":1}", 1000 + UDP_SEQUENCE_RESET_MS));
+}
+
+void test_setmask_keeps_fresh_pins()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":10}"));
+
+    Command cmd = parse("{\"cmd\":\"SETMASK\",\"set\":\"0x6000\",\"clear\":\"0x10\",\"seq\":8}");
+    TEST_ASSERT_TRUE(accept(cmd));
+    TEST_ASSERT_EQUAL_HEX64(1ULL << 14, cmd.setMask);
+    TEST_ASSERT_EQUAL_HEX64(1ULL << 4, cmd.clearMask);
+}
+
+void test_batch_keeps_fresh_pins()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":10}"));
+
+    Command cmd = parse("{\"cmd\":\"BATCH\",\"seq\":8,\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":0},"
+                        "{\"cmd\":\"SET\",\"pin\":14,\"value\":1}]}");
+    TEST_ASSERT_TRUE(accept(cmd));
+    TEST_ASSERT_EQUAL_UINT8(1, cmd.batchCount);
+    TEST_ASSERT_EQUAL_UINT8(14, cmd.batch[0].pin);
+
+    // Nothing fresh left
+    cmd = parse("{\"cmd\":\"BATCH\",\"seq\":8,\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":0}]}");
+    TEST_ASSERT_FALSE(accept(cmd));
+}
+
+void test_batch_keeps_every_op_on_a_fresh_pin()
+{
+    // Several ops on one pin share the batch's sequence number; the first
+    // must not make the rest look stale
+    Command cmd = parse("{\"cmd\":\"BATCH\",\"seq\":3,\"ops\":[{\"cmd\":\"SET\",\"pin\":13,\"value\":1},"
+                        "{\"cmd\":\"PWM\",\"pin\":12,\"value\":64},{\"cmd\":\"TOGGLE\",\"pin\":13},"
+                        "{\"cmd\":\"PWM\",\"pin\":12,\"value\":128}]}");
+    TEST_ASSERT_TRUE(accept(cmd));
+    TEST_ASSERT_EQUAL_UINT8(4, cmd.batchCount);
+    TEST_ASSERT_TRUE(cmd.batch[2].type == PinOpType::TOGGLE);
+    TEST_ASSERT_EQUAL_UINT16(128, cmd.batch[3].value);
+
+    // Both pins were marked applied
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":0,\"seq\":3}"));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"PWM\",\"pin\":12,\"value\":0,\"seq\":3}"));
+}
+
+void test_check_records_nothing()
+{
+    // A command that was checked but never run leaves its sequence unused
+    Command cmd = parse("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":5}");
+    TEST_ASSERT_TRUE(filter->check(cmd, 1000));
+    TEST_ASSERT_TRUE(filter->check(cmd, 1000));
+    TEST_ASSERT_TRUE(accept(cmd));
+    TEST_ASSERT_FALSE(filter->check(cmd, 1000));
+}
+
+void test_commit_records_only_kept_pins()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":1,\"seq\":10}"));
+
+    // Pin 13 is dropped as stale, so committing must not touch it
+    Command cmd = parse("{\"cmd\":\"SETMASK\",\"set\":\"0x6000\",\"seq\":8}");
+    TEST_ASSERT_TRUE(accept(cmd));
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"SET\",\"pin\":13,\"value\":0,\"seq\":11}"));
+    TEST_ASSERT_FALSE(accept("{\"cmd\":\"SET\",\"pin\":14,\"value\":0,\"seq\":8}"));
+}
+
+void test_unsequenced_types_pass()
+{
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"GET\",\"pin\":13,\"seq\":1}"));
+    TEST_ASSERT_TRUE(accept("{\"cmd\":\"GET\",\"pin\":13,\"seq\":1}"));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_newer_sequence_accepted);
+    RUN_TEST(test_stale_and_duplicate_dropped);
+    RUN_TEST(test_sequence_wraps);
+    RUN_TEST(test_idle_pin_accepts_any_sequence);
+    RUN_TEST(test_setmask_keeps_fresh_pins);
+    RUN_TEST(test_batch_keeps_fresh_pins);
+    RUN_TEST(test_batch_keeps_every_op_on_a_fresh_pin);
+    RUN_TEST(test_check_records_nothing);
+    RUN_TEST(test_commit_records_only_kept_pins);
+    RUN_TEST(test_unsequenced_types_pass);
+
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+/**
+ * TimerWheel tests (env:native)
+ *
+ * Expiry at the level boundaries, cascades, stale ids and large advances:
+ *
+ *   pio test -e native -f test_timer_wheel
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "TimerWheel.h"
+
+namespace
+{
+    typedef TimerWheel<int, 8> Wheel;
+
+    Wheel *wheel = nullptr;
+
+    // Payloads in the order they fired, and the tick each fired on
+    int fired[64];
+    uint32_t firedAt[64];
+    size_t firedCount = 0;
+
+    void advanceTo(uint32_t now)
+    {
+        wheel->advance(now, [now](int payload)
+                       {
+                           if (firedCount < sizeof(fired) / sizeof(fired[0]))
+                           {
+                               fired[firedCount] = payload;
+                               firedAt[firedCount] = now;
+                           }
+                           firedCount++;
+                       });
+    }
+
+    // Advance one tick at a time from start to end, so firedAt is exact
+    void stepTo(uint32_t start, uint32_t end)
+    {
+        for (uint32_t now = start; now != end + 1; now++)
+        {
+            advanceTo(now);
+        }
+    }
+}
+
+void setUp()
+{
+    wheel = new Wheel();
+    firedCount = 0;
+}
+
+void tearDown()
+{
+    delete wheel;
+    wheel = nullptr;
+}
+
+void test_one_shot_at_level_boundaries()
+{
+    const uint32_t delays[] = {1, 255, 256, 16383, 16384, (1UL << 20) - 1, 1UL << 20};
+    const uint32_t starts[] = {0, 1000};
+
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++)
+    {
+        for (size_t d = 0; d < sizeof(delays) / sizeof(delays[0]); d++)
+        {
+            uint32_t start = starts[s];
+            uint32_t delay = delays[d];
+            firedCount = 0;
+
+            TEST_ASSERT_GREATER_THAN(0, wheel->add(start, delay, 0, static_cast<int>(d)));
+            stepTo(start, start + delay + 300);
+
+            TEST_ASSERT_EQUAL_UINT32(1, firedCount);
+            TEST_ASSERT_EQUAL_INT(static_cast<int>(d), fired[0]);
+            TEST_ASSERT_EQUAL_UINT32(start + delay, firedAt[0]);
+            TEST_ASSERT_EQUAL_UINT32(0, wheel->size());
+        }
+    }
+}
+
+void test_delay_out_of_range_rejected()
+{
+    TEST_ASSERT_EQUAL_INT(-1, wheel->add(0, Wheel::MAX_DELAY + 1, 0, 1));
+    TEST_ASSERT_EQUAL_INT(-1, wheel->add(0, 10, Wheel::MAX_DELAY + 1, 1));
+    TEST_ASSERT_GREATER_THAN(0, wheel->add(0, Wheel::MAX_DELAY, 0, 1));
+}
+
+void test_periodic_relinks_across_cascade()
+{
+    // 300 ms is past level 0, so every re-link goes through a level 1 cascade
+    wheel->add(100, 300, 300, 7);
+    stepTo(100, 100 + 300 * 10);
+
+    TEST_ASSERT_EQUAL_UINT32(10, firedCount);
+    for (size_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(7, fired[i]);
+        TEST_ASSERT_EQUAL_UINT32(100 + 300 * (i + 1), firedAt[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, wheel->size());
+
+    // And through level 2
+    wheel->clear();
+    firedCount = 0;
+    wheel->add(5000, 20000, 20000, 8);
+    stepTo(5000, 5000 + 20000 * 3);
+
+    TEST_ASSERT_EQUAL_UINT32(3, firedCount);
+    TEST_ASSERT_EQUAL_UINT32(25000, firedAt[0]);
+    TEST_ASSERT_EQUAL_UINT32(45000, firedAt[1]);
+    TEST_ASSERT_EQUAL_UINT32(65000, firedAt[2]);
+}
+
+void test_cancel_with_stale_id_after_reuse()
+{
+    TimerWheel<int, 1> single;
+
+    int first = single.add(0, 10, 0, 1);
+    TEST_ASSERT_GREATER_THAN(0, first);
+    single.advance(10, [](int) {});
+    TEST_ASSERT_EQUAL_UINT32(0, single.size());
+
+    // The one slot is reused under a new generation
+    int second = single.add(10, 10, 0, 2);
+    TEST_ASSERT_GREATER_THAN(0, second);
+    TEST_ASSERT_NOT_EQUAL(first, second);
+    TEST_ASSERT_EQUAL_INT(first & 0xFFFF, second & 0xFFFF);
+
+    TEST_ASSERT_FALSE(single.cancel(first));
+    TEST_ASSERT_EQUAL_UINT32(1, single.size());
+    TEST_ASSERT_TRUE(single.cancel(second));
+    TEST_ASSERT_FALSE(single.cancel(second));
+
+    // A cancelled id stays stale once the slot is taken again
+    int third = single.add(10, 10, 0, 3);
+    TEST_ASSERT_FALSE(single.cancel(second));
+    TEST_ASSERT_TRUE(single.cancel(third));
+
+    TEST_ASSERT_FALSE(single.cancel(0));
+    TEST_ASSERT_FALSE(single.cancel(-1));
+}
+
+void test_next_expiry()
+{
+    uint32_t tick = 0;
+    TEST_ASSERT_FALSE(wheel->nextExpiry(tick));
+
+    wheel->add(10, 500, 0, 1);
+    wheel->add(10, 50, 200, 2);
+    TEST_ASSERT_TRUE(wheel->nextExpiry(tick));
+    TEST_ASSERT_EQUAL_UINT32(60, tick);
+
+    // The periodic timer re-links to 260, still ahead of the one-shot
+    advanceTo(60);
+    TEST_ASSERT_EQUAL_UINT32(1, firedCount);
+    TEST_ASSERT_TRUE(wheel->nextExpiry(tick));
+    TEST_ASSERT_EQUAL_UINT32(260, tick);
+
+    advanceTo(460);
+    TEST_ASSERT_TRUE(wheel->nextExpiry(tick));
+    TEST_ASSERT_EQUAL_UINT32(510, tick);
+
+    // Nothing fires before the reported tick
+    firedCount = 0;
+    advanceTo(509);
+    TEST_ASSERT_EQUAL_UINT32(0, firedCount);
+    advanceTo(510);
+    TEST_ASSERT_EQUAL_UINT32(1, firedCount);
+    TEST_ASSERT_EQUAL_INT(1, fired[0]);
+
+    wheel->clear();
+    TEST_ASSERT_FALSE(wheel->nextExpiry(tick));
+}
+
+void test_advance_jumps_thousands_of_ticks()
+{
+    wheel->add(0, 100, 0, 1);
+    wheel->add(0, 3000, 0, 2);
+    wheel->add(0, 5000, 0, 3);
+    wheel->add(0, 700, 700, 4);
+
+    // One call covers every tick, cascades included, in tick order
+    advanceTo(7000);
+
+    const int expected[] = {1, 4, 4, 4, 4, 2, 4, 4, 4, 3, 4, 4, 4};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected) / sizeof(expected[0]), firedCount);
+    for (size_t i = 0; i < firedCount; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(expected[i], fired[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, wheel->size());
+
+    uint32_t tick = 0;
+    TEST_ASSERT_TRUE(wheel->nextExpiry(tick));
+    TEST_ASSERT_EQUAL_UINT32(7700, tick);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_one_shot_at_level_boundaries);
+    RUN_TEST(test_delay_out_of_range_rejected);
+    RUN_TEST(test_periodic_relinks_across_cascade);
+    RUN_TEST(test_cancel_with_stale_id_after_reuse);
+    RUN_TEST(test_next_expiry);
+    RUN_TEST(test_advance_jumps_thousands_of_ticks);
+
+    return UNITY_END();
+}